@@ -0,0 +1,96 @@
+#!/usr/bin/perl -w
+
+# script to generate a single-process Click configuration that simulates
+# a grid of DSDV nodes.  Each node's route ads are broadcast to its four
+# grid neighbors; the `all' counter counts every ad sent, so its
+# byte_count measures routing overhead.
+
+use strict;
+
+my $prog = "make-dsdv-grid-sim.pl";
+
+# routing parameters, times in milliseconds
+my $rt_timeout = 6000;
+my $rt_period  = 1000;
+my $rt_jitter  =  500;
+my $rt_min_period = 200;
+my $rt_wst0 = 500;
+my $width = 20;
+my $height = 10;
+my $duration = 30;
+my $dsdv_config = "";  # extra DSDVRouteTable element configuration arguments
+
+sub usage() {
+    print "usage: $prog [OPTIONS]
+  Generate a Click configuration simulating a WIDTH x HEIGHT grid of DSDV nodes.
+
+Options:
+   --width W           Grid width.  Defaults to $width.
+   --height H          Grid height.  Defaults to $height.
+   --duration S        Stop after S seconds.  Defaults to $duration.
+   --timeout T         Expire stale route entries after T milliseconds.  Defaults to $rt_timeout.
+   --period P          Send route ads every P milliseconds.  Defaults to $rt_period.
+   --max-jitter J      Jitter route ad timing up to J milliseconds.  Defaults to $rt_jitter.
+   --min-period M      Don't send route ads more than once every M milliseconds.  Defaults to $rt_min_period.
+   --wst0 W            Initial weighted settling time in milliseconds.  Defaults to $rt_wst0.
+   --dsdv-config C     Pass extra configuration string C to each DSDVRouteTable element.
+   -h, --help          Print this message and exit.
+";
+}
+
+while (@ARGV) {
+    my $opt = shift @ARGV;
+    if ($opt eq "-h" || $opt eq "--help") { usage(); exit 0; }
+    die "$prog: option $opt requires an argument\n" if !@ARGV;
+    my $arg = shift @ARGV;
+    if    ($opt eq "--width")      { $width = $arg; }
+    elsif ($opt eq "--height")     { $height = $arg; }
+    elsif ($opt eq "--duration")   { $duration = $arg; }
+    elsif ($opt eq "--timeout")    { $rt_timeout = $arg; }
+    elsif ($opt eq "--period")     { $rt_period = $arg; }
+    elsif ($opt eq "--max-jitter") { $rt_jitter = $arg; }
+    elsif ($opt eq "--min-period") { $rt_min_period = $arg; }
+    elsif ($opt eq "--wst0")       { $rt_wst0 = $arg; }
+    elsif ($opt eq "--dsdv-config") { $dsdv_config = ", $arg"; }
+    else { usage(); exit 1; }
+}
+
+sub node($$) {
+    my ($x, $y) = @_;
+    return "n_${x}_$y";
+}
+
+print "// generated by $prog: $width x $height DSDV grid\n\n";
+print "all :: Counter -> Discard;\n";
+print "metric :: HopcountMetric;\n\n";
+
+for (my $x = 0; $x < $width; $x++) {
+    for (my $y = 0; $y < $height; $y++) {
+	my $n = node($x, $y);
+	my $eth = sprintf("00:00:00:00:%02x:%02x", $x, $y);
+	print "$n :: DSDVRouteTable($rt_timeout, $rt_period, $rt_jitter, $rt_min_period,
+    $eth, 10.0.$x.$y, MAX_HOPS 100, METRIC metric, WST0 $rt_wst0,
+    VERBOSE false$dsdv_config)
+  -> Paint(0) -> ${n}_tee :: Tee -> all;\n";
+    }
+}
+print "\n";
+
+for (my $x = 0; $x < $width; $x++) {
+    for (my $y = 0; $y < $height; $y++) {
+	my $n = node($x, $y);
+	my @nbrs;
+	push @nbrs, node($x - 1, $y) if $x > 0;
+	push @nbrs, node($x + 1, $y) if $x < $width - 1;
+	push @nbrs, node($x, $y - 1) if $y > 0;
+	push @nbrs, node($x, $y + 1) if $y < $height - 1;
+	for (my $i = 0; $i < @nbrs; $i++) {
+	    print "${n}_tee[", $i + 1, "] -> $nbrs[$i];\n";
+	}
+    }
+}
+print "\n";
+
+my $corner = node($width - 1, $height - 1);
+print "Script(wait ${duration}s, read all.count, read all.byte_count, read n_0_0.ad_stats,
+       read n_0_0.rtes, read $corner.rtes, stop);\n";
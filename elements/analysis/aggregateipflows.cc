@@ -73,8 +73,10 @@ flip_ports(uint32_t ports)
 // actual AggregateIPFlows operations
 
 AggregateIPFlows::AggregateIPFlows()
+    : _fragment_queue_head(0), _fragment_queue_tail(0),
+      _flow_alloc(sizeof(FlowInfo))
 #if CLICK_USERLEVEL
-    : _traceinfo_file(0), _packet_source(0), _filepos_h(0)
+      , _traceinfo_file(0), _packet_source(0), _filepos_h(0)
 #endif
 {
 }
@@ -101,8 +103,9 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
     _tcp_done_timeout = 30;
     _udp_timeout = 60;
     _fragment_timeout = 30;
-    _gc_interval = 20 * 60;
+    _reap_batch = 8;
     _fragments = 2;
+    uint32_t gc_interval;
     bool handle_icmp_errors = false;
     bool gave_fragments = false, fragments = true;
 
@@ -111,7 +114,8 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
 		     "TCP_DONE_TIMEOUT", 0, cpSeconds, &_tcp_done_timeout,
 		     "UDP_TIMEOUT", 0, cpSeconds, &_udp_timeout,
 		     "FRAGMENT_TIMEOUT", 0, cpSeconds, &_fragment_timeout,
-		     "REAP", 0, cpSeconds, &_gc_interval,
+		     "REAP_BATCH", 0, cpUnsigned, &_reap_batch,
+		     "REAP", 0, cpSeconds, &gc_interval,
 		     "ICMP", 0, cpBool, &handle_icmp_errors,
 #if CLICK_USERLEVEL
 		     "TRACEINFO", 0, cpFilename, &_traceinfo_filename,
@@ -120,7 +124,12 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
 		     "FRAGMENTS", cpkC, &gave_fragments, cpBool, &fragments,
 		     cpEnd) < 0)
 	return -1;
+    if (_reap_batch == 0)
+	return errh->error("REAP_BATCH must be positive");
 
+    _timeout[EXPIRY_TCP] = _tcp_timeout;
+    _timeout[EXPIRY_TCP_DONE] = _tcp_done_timeout;
+    _timeout[EXPIRY_UDP] = _udp_timeout;
     _smallest_timeout = (_tcp_timeout < _tcp_done_timeout ? _tcp_timeout : _tcp_done_timeout);
     _smallest_timeout = (_smallest_timeout < _udp_timeout ? _smallest_timeout : _udp_timeout);
     _handle_icmp_errors = handle_icmp_errors;
@@ -133,7 +142,7 @@ int
 AggregateIPFlows::initialize(ErrorHandler *errh)
 {
     _next = 1;
-    _active_sec = _gc_sec = 0;
+    _active_sec = 0;
     _timestamp_warning = false;
 
 #if CLICK_USERLEVEL
@@ -150,6 +159,7 @@ AggregateIPFlows::initialize(ErrorHandler *errh)
 	    (void) HandlerCall::reset_read(_filepos_h, _packet_source, "packet_filepos");
 	}
 	fprintf(_traceinfo_file, ">\n");
+	_flow_alloc.increase_size(sizeof(StatFlowInfo));
     }
 #endif
 
@@ -198,12 +208,10 @@ AggregateIPFlows::delete_flowinfo(const HostPair &hp, FlowInfo *finfo, bool real
   <stream dir='0' packets='%d' /><stream dir='1' packets='%d' />\n\
 </flow>\n",
 		sinfo->_packets[0], sinfo->_packets[1]);
-	if (really_delete)
-	    delete sinfo;
-    } else
+    }
 #endif
-	if (really_delete)
-	    delete finfo;
+    if (really_delete)
+	_flow_alloc.deallocate(finfo);
 }
 
 void
@@ -256,6 +264,14 @@ AggregateIPFlows::packet_emit_hook(const Packet *p, const click_ip *iph, FlowInf
 	    finfo->_flow_over = 0;
     }
 
+    // move to the end of its expiry list
+    int which = (finfo->_hpinfo->_udp ? EXPIRY_UDP
+		 : finfo->_flow_over == 3 ? EXPIRY_TCP_DONE : EXPIRY_TCP);
+    if (finfo->_expiry_next || finfo->_expiry != which) {
+	expiry_unlink(finfo);
+	expiry_append(finfo, which);
+    }
+
 #if CLICK_USERLEVEL
     // count packets
     if (stats() && PAINT_ANNO(p) < 2) {
@@ -265,52 +281,117 @@ AggregateIPFlows::packet_emit_hook(const Packet *p, const click_ip *iph, FlowInf
 #endif
 }
 
-void
-AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout)
+inline void
+AggregateIPFlows::expiry_unlink(FlowInfo *f)
 {
-    timeout = _active_sec - timeout;
-    done_timeout = _active_sec - done_timeout;
-    int frag_timeout = _active_sec - _fragment_timeout;
+    ExpiryList &l = _expiry[f->_expiry];
+    if (f->_expiry_prev)
+	f->_expiry_prev->_expiry_next = f->_expiry_next;
+    else
+	l.head = f->_expiry_next;
+    if (f->_expiry_next)
+	f->_expiry_next->_expiry_prev = f->_expiry_prev;
+    else
+	l.tail = f->_expiry_prev;
+}
 
-    // free completed flows and emit fragments
-    for (Map::iterator iter = table.begin(); iter.live(); iter++) {
-	HostPairInfo *hpinfo = &iter.value();
-	Packet *head;
-	// fragments
-	while ((head = hpinfo->_fragment_head)
-	       && (head->timestamp_anno().sec() < frag_timeout
-		   || !IP_ISFRAG(good_ip_header(head))))
-	    emit_fragment_head(hpinfo);
-
-	// can't delete any flows if there are fragments
-	if (hpinfo->_fragment_head)
-	    continue;
-
-	// completed flows
-	FlowInfo **pprev = &hpinfo->_flows;
-	FlowInfo *f = *pprev;
-	while (f) {
-	    // circular comparison
-	    if (SEC_OLDER(f->_last_timestamp.sec(), (f->_flow_over == 3 ? done_timeout : timeout))) {
-		notify(f->_aggregate, AggregateListener::DELETE_AGG, 0);
-		*pprev = f->_next;
-		delete_flowinfo(iter.key(), f);
-	    } else
-		pprev = &f->_next;
-	    f = *pprev;
-	}
-	// XXX never free host pairs
-    }
+inline void
+AggregateIPFlows::expiry_append(FlowInfo *f, int which)
+{
+    ExpiryList &l = _expiry[which];
+    f->_expiry = which;
+    f->_expiry_prev = l.tail;
+    f->_expiry_next = 0;
+    if (l.tail)
+	l.tail->_expiry_next = f;
+    else
+	l.head = f;
+    l.tail = f;
+}
+
+inline void
+AggregateIPFlows::maybe_free_hostpair(HostPairInfo *hpinfo)
+{
+    if (!hpinfo->_flows && !hpinfo->_fragment_head && !hpinfo->_fragment_queued)
+	(hpinfo->_udp ? _udp_map : _tcp_map).erase(hpinfo->_hosts);
+}
+
+inline void
+AggregateIPFlows::fragment_enqueue(HostPairInfo *hpinfo)
+{
+    hpinfo->_fragment_next = 0;
+    hpinfo->_fragment_queued = true;
+    if (_fragment_queue_tail)
+	_fragment_queue_tail->_fragment_next = hpinfo;
+    else
+	_fragment_queue_head = hpinfo;
+    _fragment_queue_tail = hpinfo;
+}
+
+bool
+AggregateIPFlows::reap_fragments(HostPairInfo *hpinfo)
+{
+    // emit fragments that have timed out, and any packets they held up;
+    // return true if fragments remain
+    int frag_timeout = _active_sec - _fragment_timeout;
+    Packet *head;
+    while ((head = hpinfo->_fragment_head)
+	   && (head->timestamp_anno().sec() < frag_timeout
+	       || !IP_ISFRAG(good_ip_header(head))))
+	emit_fragment_head(hpinfo);
+    return hpinfo->_fragment_head;
 }
 
 void
-AggregateIPFlows::reap()
+AggregateIPFlows::reap(unsigned budget)
 {
-    if (_gc_sec) {
-	reap_map(_tcp_map, _tcp_timeout, _tcp_done_timeout);
-	reap_map(_udp_map, _udp_timeout, _udp_timeout);
+    // address pairs holding fragments
+    while (HostPairInfo *hpinfo = _fragment_queue_head) {
+	if (!budget)
+	    return;
+	budget--;
+	if (!(_fragment_queue_head = hpinfo->_fragment_next))
+	    _fragment_queue_tail = 0;
+	hpinfo->_fragment_queued = false;
+	if (reap_fragments(hpinfo)) {
+	    // still waiting; check it again after the others
+	    fragment_enqueue(hpinfo);
+	    break;
+	}
+	maybe_free_hostpair(hpinfo);
+    }
+
+    // expired flows, oldest first
+    for (int which = 0; which < NEXPIRY; which++) {
+	uint32_t timeout = _active_sec - _timeout[which];
+	while (FlowInfo *f = _expiry[which].head) {
+	    // circular comparison
+	    if (!budget || !SEC_OLDER(f->_last_timestamp.sec(), timeout))
+		break;
+	    budget--;
+
+	    // can't delete any flows if there are fragments
+	    HostPairInfo *hpinfo = f->_hpinfo;
+	    if (hpinfo->_fragment_head) {
+		if (reap_fragments(hpinfo)) {
+		    expiry_unlink(f);
+		    expiry_append(f, which);
+		    break;
+		}
+		// emitting fragments may have refreshed f
+		continue;
+	    }
+
+	    expiry_unlink(f);
+	    FlowInfo **pprev = &hpinfo->_flows;
+	    while (*pprev != f)
+		pprev = &(*pprev)->_next;
+	    *pprev = f->_next;
+	    notify(f->_aggregate, AggregateListener::DELETE_AGG, 0);
+	    delete_flowinfo(hpinfo->_hosts, f);
+	    maybe_free_hostpair(hpinfo);
+	}
     }
-    _gc_sec = _active_sec + _gc_interval;
 }
 
 const click_ip *
@@ -363,15 +444,16 @@ AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, b
 		    && (p->tcp_header()->th_flags & TH_SYN))) {
 		// old aggregate has died
 		notify(finfo->aggregate(), AggregateListener::DELETE_AGG, 0);
-		const click_ip *iph = good_ip_header(p);
-		HostPair hp(iph->ip_src.s_addr, iph->ip_dst.s_addr);
-		delete_flowinfo(hp, finfo, false);
+		delete_flowinfo(hpinfo->_hosts, finfo, false);
 
 		// make a new aggregate
 		finfo->_aggregate = _next;
 		_next++;
 		finfo->_reverse = flipped;
 		finfo->_flow_over = 0;
+		finfo->_last_timestamp = p->timestamp_anno();
+		expiry_unlink(finfo);
+		expiry_append(finfo, hpinfo->_udp ? EXPIRY_UDP : EXPIRY_TCP);
 #if CLICK_USERLEVEL
 		if (stats())
 		    stat_new_flow_hook(p, finfo);
@@ -387,16 +469,21 @@ AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, b
 	}
 
     // make and install new FlowInfo pair
+    void *mem = _flow_alloc.allocate();
+    if (!mem)
+	return 0;
     FlowInfo *finfo;
 #if CLICK_USERLEVEL
     if (stats()) {
-	finfo = new StatFlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new(mem) StatFlowInfo(ports, hpinfo->_flows, _next, hpinfo);
 	stat_new_flow_hook(p, finfo);
     } else
 #endif
-	finfo = new FlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new(mem) FlowInfo(ports, hpinfo->_flows, _next, hpinfo);
 
     finfo->_reverse = flipped;
+    finfo->_last_timestamp = p->timestamp_anno();
+    expiry_append(finfo, hpinfo->_udp ? EXPIRY_UDP : EXPIRY_TCP);
     hpinfo->_flows = finfo;
     _next++;
     notify(finfo->aggregate(), AggregateListener::NEW_AGG, p);
@@ -459,12 +546,8 @@ AggregateIPFlows::handle_fragment(Packet *p, HostPairInfo *hpinfo)
     _active_sec = p->timestamp_anno().sec();
 
     // get rid of old fragments
-    int frag_timeout = _active_sec - _fragment_timeout;
-    Packet *head;
-    while ((head = hpinfo->_fragment_head)
-	   && (head->timestamp_anno().sec() < frag_timeout
-	       || !IP_ISFRAG(good_ip_header(head))))
-	emit_fragment_head(hpinfo);
+    if (reap_fragments(hpinfo) && !hpinfo->_fragment_queued)
+	fragment_enqueue(hpinfo);
 
     return ACT_NONE;
 }
@@ -481,7 +564,7 @@ AggregateIPFlows::handle_packet(Packet *p)
 	    click_chatter("%{element}: warning: packet received without timestamp", this);
 	    _timestamp_warning = true;
 	}
-	p->timestamp_anno().assign_now();
+	p->timestamp_anno() = Timestamp::recent();
     }
 
     // extract encapsulated ICMP header if appropriate
@@ -503,14 +586,20 @@ AggregateIPFlows::handle_packet(Packet *p)
     if (hosts.a != iph->ip_src.s_addr)
 	paint ^= 1;
     HostPairInfo *hpinfo = &m[hosts];
+    if (!hpinfo->_flows) {
+	hpinfo->_hosts = hosts;
+	hpinfo->_udp = (&m == &_udp_map);
+    }
 
     // find relevant FlowInfo, if any
     FlowInfo *finfo;
     if (IP_FIRSTFRAG(iph)) {
 	const uint8_t *udp_ptr = reinterpret_cast<const uint8_t *>(iph) + (iph->ip_hl << 2);
-	if (udp_ptr + 4 > p->end_data())
+	if (udp_ptr + 4 > p->end_data()) {
 	    // packet not big enough
+	    maybe_free_hostpair(hpinfo);
 	    return ACT_DROP;
+	}
 
 	uint32_t ports = *reinterpret_cast<const uint32_t *>(udp_ptr);
 	// 1.Jan.08: handle connections where IP addresses are the same (John
@@ -523,6 +612,7 @@ AggregateIPFlows::handle_packet(Packet *p)
 	finfo = find_flow_info(m, hpinfo, ports, paint & 1, p);
 	if (!finfo) {
 	    click_chatter("out of memory!");
+	    maybe_free_hostpair(hpinfo);
 	    return ACT_DROP;
 	}
 	if (finfo->reverse())
@@ -540,8 +630,10 @@ AggregateIPFlows::handle_packet(Packet *p)
     // check for fragment
     if ((_fragments && IP_ISFRAG(iph)) || hpinfo->_fragment_head)
 	return handle_fragment(p, hpinfo);
-    else if (!finfo)
+    else if (!finfo) {
+	maybe_free_hostpair(hpinfo);
 	return ACT_DROP;
+    }
 
     // packet emit hook
     _active_sec = p->timestamp_anno().sec();
@@ -554,10 +646,7 @@ void
 AggregateIPFlows::push(int, Packet *p)
 {
     int action = handle_packet(p);
-
-    // GC if necessary
-    if (_active_sec >= _gc_sec)
-	reap();
+    reap(_reap_batch);
 
     if (action == ACT_EMIT)
 	output(0).push(p);
@@ -570,10 +659,7 @@ AggregateIPFlows::pull(int)
 {
     Packet *p = input(0).pull();
     int action = (p ? handle_packet(p) : ACT_NONE);
-
-    // GC if necessary
-    if (_active_sec >= _gc_sec)
-	reap();
+    reap(_reap_batch);
 
     if (action == ACT_EMIT)
 	return p;
@@ -590,10 +676,10 @@ AggregateIPFlows::write_handler(const String &, Element *e, void *thunk, ErrorHa
     AggregateIPFlows *af = static_cast<AggregateIPFlows *>(e);
     switch ((intptr_t)thunk) {
       case H_CLEAR: {
-	  int active_sec = af->_active_sec, gc_sec = af->_gc_sec;
-	  af->_active_sec = af->_gc_sec = 0x7FFFFFFF;
-	  af->reap();
-	  af->_active_sec = active_sec, af->_gc_sec = gc_sec;
+	  unsigned active_sec = af->_active_sec;
+	  af->_active_sec = 0x7FFFFFFF;
+	  af->reap((unsigned) -1);
+	  af->_active_sec = active_sec;
 	  return 0;
       }
       default:
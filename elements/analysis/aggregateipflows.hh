@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/ipflowid.hh>
 #include <click/hashtable.hh>
+#include <click/hashallocator.hh>
 #include "aggregatenotifier.hh"
 CLICK_DECLS
 class HandlerCall;
@@ -93,9 +94,15 @@ The timeout for UDP connections, in seconds. Default is 1 minute.
 
 The timeout for fragments, in seconds, Default is 30 seconds.
 
+=item REAP_BATCH
+
+Unsigned. The most flows AggregateIPFlows will examine for expiry per packet.
+Default is 8.
+
 =item REAP
 
-The garbage collection interval. Default is 20 minutes of packet time.
+Ignored; accepted for compatibility. Flows used to be garbage collected in one
+pass over the flow table every REAP seconds of packet time.
 
 =item ICMP
 
@@ -115,6 +122,15 @@ Default is true in a push context and false in a pull context.
 AggregateIPFlows is an AggregateNotifier, so AggregateListeners can request
 notifications when new aggregates are created and old ones are deleted.
 
+Expired flows are removed incrementally. AggregateIPFlows keeps UDP, active
+TCP, and completed TCP flows on separate lists ordered by the time of their
+last packet, so the flows at the list heads are the next to expire. After
+each packet, it examines at most REAP_BATCH flows at those heads, and likewise
+for address pairs holding fragments. A flow is therefore deleted soon after
+its timeout passes, and no packet waits for a pass over the whole flow table.
+Address pairs with no remaining flows are freed too. Flow records come from a
+private pool, not the general-purpose allocator.
+
 =h clear write-only
 
 Clears all flow information. Future packets will get new aggregate annotation
@@ -177,16 +193,20 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
 
   private:
 
+    struct HostPairInfo;
+
     struct FlowInfo {
 	uint32_t _ports;
 	uint32_t _aggregate;
 	Timestamp _last_timestamp;
 	unsigned _flow_over : 2;
 	bool _reverse : 1;
+	unsigned _expiry : 2;	// which expiry list holds this flow
 	FlowInfo *_next;
-	// have 24 bytes; statistics would double
-	// + 8 + 8 = 16 bytes
-	FlowInfo(uint32_t ports, FlowInfo *next, uint32_t agg) : _ports(ports), _aggregate(agg), _flow_over(0), _next(next) { }
+	FlowInfo *_expiry_prev;	// expiry list, oldest first
+	FlowInfo *_expiry_next;
+	HostPairInfo *_hpinfo;
+	FlowInfo(uint32_t ports, FlowInfo *next, uint32_t agg, HostPairInfo *hpinfo) : _ports(ports), _aggregate(agg), _flow_over(0), _next(next), _hpinfo(hpinfo) { }
 	uint32_t aggregate() const { return _aggregate; }
 	bool reverse() const	{ return _reverse; }
     };
@@ -196,7 +216,7 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
 	Timestamp _first_timestamp;
 	uint32_t _filepos;
 	uint32_t _packets[2];
-	StatFlowInfo(uint32_t ports, FlowInfo *next, uint32_t agg) : FlowInfo(ports, next, agg) { _packets[0] = _packets[1] = 0; }
+	StatFlowInfo(uint32_t ports, FlowInfo *next, uint32_t agg, HostPairInfo *hpinfo) : FlowInfo(ports, next, agg, hpinfo) { _packets[0] = _packets[1] = 0; }
     };
 #endif
 
@@ -204,7 +224,11 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
 	FlowInfo *_flows;
 	Packet *_fragment_head;
 	Packet *_fragment_tail;
-	HostPairInfo() : _flows(0), _fragment_head(0), _fragment_tail(0) { }
+	HostPairInfo *_fragment_next;	// in the fragment queue
+	HostPair _hosts;
+	bool _udp : 1;
+	bool _fragment_queued : 1;
+	HostPairInfo() : _flows(0), _fragment_head(0), _fragment_tail(0), _fragment_next(0), _udp(false), _fragment_queued(false) { }
 	FlowInfo *find_force(uint32_t ports);
     };
 
@@ -212,16 +236,30 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     Map _tcp_map;
     Map _udp_map;
 
+    enum { EXPIRY_TCP, EXPIRY_TCP_DONE, EXPIRY_UDP, NEXPIRY };
+    struct ExpiryList {
+	FlowInfo *head;
+	FlowInfo *tail;
+	ExpiryList() : head(0), tail(0) { }
+    };
+    ExpiryList _expiry[NEXPIRY];
+    int _timeout[NEXPIRY];
+
+    // address pairs holding fragments, roughly oldest first
+    HostPairInfo *_fragment_queue_head;
+    HostPairInfo *_fragment_queue_tail;
+
+    HashAllocator _flow_alloc;
+
     uint32_t _next;
     unsigned _active_sec;
-    unsigned _gc_sec;
 
     int _tcp_timeout;
     int _tcp_done_timeout;
     int _udp_timeout;
     int _smallest_timeout;
 
-    unsigned _gc_interval;
+    unsigned _reap_batch;
     unsigned _fragment_timeout;
 
     bool _handle_icmp_errors : 1;
@@ -239,8 +277,12 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     static const click_ip *icmp_encapsulated_header(const Packet *);
 
     void clean_map(Map &);
-    void reap_map(Map &, uint32_t, uint32_t);
-    void reap();
+    inline void expiry_unlink(FlowInfo *);
+    inline void expiry_append(FlowInfo *, int which);
+    inline void maybe_free_hostpair(HostPairInfo *);
+    inline void fragment_enqueue(HostPairInfo *);
+    bool reap_fragments(HostPairInfo *);
+    void reap(unsigned budget);
 
     inline int relevant_timeout(const FlowInfo *, const Map &) const;
 #if CLICK_USERLEVEL
@@ -0,0 +1,368 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * fromipcolumndump.{cc,hh} -- element reads packets from column block dumps
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fromipcolumndump.hh"
+#include "toipcolumndump.hh"
+#include <click/confparse.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <click/error.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+#define GET4(p)		(((p)[0]<<24) | ((p)[1]<<16) | ((p)[2]<<8) | (p)[3])
+
+FromIPColumnDump::FromIPColumnDump()
+    : _nrecords(0), _record(0), _task(this)
+{
+    _ff.set_landmark_pattern("%f:block %l");
+}
+
+FromIPColumnDump::~FromIPColumnDump()
+{
+}
+
+void *
+FromIPColumnDump::cast(const char *n)
+{
+    if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0 && !output_is_push(0))
+	return static_cast<Notifier *>(&_notifier);
+    else
+	return Element::cast(n);
+}
+
+int
+FromIPColumnDump::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    bool stop = false, active = true, zero = true, checksum = false;
+    bool have_start = false, have_end = false;
+    uint8_t default_proto = IP_PROTO_TCP;
+    Timestamp start, end;
+    _burst = 32;
+
+    if (_ff.configure_keywords(conf, this, errh) < 0)
+	return -1;
+    if (cp_va_kparse(conf, this, errh,
+		     "FILENAME", cpkP+cpkM, cpFilename, &_ff.filename(),
+		     "STOP", 0, cpBool, &stop,
+		     "ACTIVE", 0, cpBool, &active,
+		     "ZERO", 0, cpBool, &zero,
+		     "CHECKSUM", 0, cpBool, &checksum,
+		     "PROTO", 0, cpByte, &default_proto,
+		     "START", cpkC, &have_start, cpTimestamp, &start,
+		     "END", cpkC, &have_end, cpTimestamp, &end,
+		     "BURST", 0, cpUnsigned, &_burst,
+		     cpEnd) < 0)
+	return -1;
+    if (_burst < 1)
+	return errh->error("BURST must be positive");
+
+    _default_proto = default_proto;
+    _stop = stop;
+    _active = active;
+    _zero = zero;
+    _checksum = checksum;
+    _have_start = have_start;
+    _have_end = have_end;
+    _start = start;
+    _end = end;
+    return 0;
+}
+
+int
+FromIPColumnDump::sort_fields_compare(const void *ap, const void *bp,
+				      void *user_data)
+{
+    int a = *reinterpret_cast<const int *>(ap);
+    int b = *reinterpret_cast<const int *>(bp);
+    FromIPColumnDump *f = reinterpret_cast<FromIPColumnDump *>(user_data);
+    const IPSummaryDump::FieldReader *fa = f->_fields[a];
+    const IPSummaryDump::FieldReader *fb = f->_fields[b];
+    if (fa->order < fb->order)
+	return -1;
+    if (fa->order > fb->order)
+	return 1;
+    return (a < b ? -1 : (a == b ? 0 : 1));
+}
+
+int
+FromIPColumnDump::read_header(ErrorHandler *errh)
+{
+    String line;
+    if (_ff.read_line(line, errh, true) <= 0
+	|| line.substring(0, 13) != "!IPColumnDump")
+	return _ff.error(errh, "missing banner line; is this an IP column dump?");
+    int major_version, minor_version;
+    if (sscanf(line.c_str() + 13, " %d.%d", &major_version, &minor_version) != 2
+	|| major_version != ToIPColumnDump::MAJOR_VERSION)
+	return _ff.error(errh, "unexpected IPColumnDump version");
+
+    while (1) {
+	if (_ff.read_line(line, errh, true) <= 0)
+	    return _ff.error(errh, "missing '!columns' line");
+	line = cp_uncomment(line);
+	if (line == "!columns")
+	    break;
+	else if (line.substring(0, 6) != "!data ")
+	    continue;
+
+	Vector<String> words;
+	cp_spacevec(line.substring(6), words);
+	for (int i = 0; i < words.size(); i++) {
+	    String word = cp_unquote(words[i]);
+	    const IPSummaryDump::FieldReader *f = IPSummaryDump::FieldReader::find(word);
+	    int w = (f ? ToIPColumnDump::column_width(f->type) : -1);
+	    if (w < 0 || !f->inb)
+		return _ff.error(errh, "cannot read content type '%s'", word.c_str());
+	    else if (!f->inject)
+		_ff.warning(errh, "content type '%s' ignored on input", word.c_str());
+	    _fields.push_back(f);
+	    _widths.push_back(w);
+	    _field_order.push_back(_fields.size() - 1);
+	}
+    }
+
+    if (_fields.size() == 0)
+	return _ff.error(errh, "no '!data' provided");
+    click_qsort(_field_order.begin(), _fields.size(), sizeof(int),
+		sort_fields_compare, this);
+    _columns.resize(_fields.size());
+    _ff.set_lineno(0);
+    return 0;
+}
+
+int
+FromIPColumnDump::initialize(ErrorHandler *errh)
+{
+    // make sure notifier is initialized
+    if (!output_is_push(0))
+	_notifier.initialize(Notifier::EMPTY_NOTIFIER, router());
+
+    if (_ff.initialize(errh) < 0 || read_header(errh) < 0)
+	return -1;
+
+    _count = 0;
+    if (output_is_push(0))
+	ScheduleInfo::initialize_task(this, &_task, _active, errh);
+    return 0;
+}
+
+void
+FromIPColumnDump::cleanup(CleanupStage)
+{
+    _ff.cleanup();
+    _block = String();
+}
+
+bool
+FromIPColumnDump::read_block(ErrorHandler *errh)
+{
+    enum { HSIZE = ToIPColumnDump::BLOCK_HEADER_SIZE };
+    uint8_t header_storage[HSIZE];
+
+    while (1) {
+	const uint8_t *h = _ff.get_unaligned(HSIZE, header_storage, errh);
+	if (!h)
+	    return false;
+	_ff.set_lineno(_ff.lineno() + 1);
+
+	uint32_t nrecords = GET4(h + 4), length = GET4(h + 8);
+	if ((uint32_t) GET4(h) != ToIPColumnDump::BLOCK_MAGIC
+	    || (int) GET4(h + 12) != _fields.size() || length < HSIZE) {
+	    _ff.error(errh, "bad block header");
+	    return false;
+	}
+	// get_string() may invalidate h
+	Timestamp min_ts = Timestamp::make_nsec(GET4(h + 16), GET4(h + 20));
+	Timestamp max_ts = Timestamp::make_nsec(GET4(h + 24), GET4(h + 28));
+	_block = _ff.get_string(length - HSIZE, errh);
+	if (_block.length() != (int) (length - HSIZE)) {
+	    _ff.error(errh, "truncated block");
+	    return false;
+	}
+
+	// skip blocks entirely outside [START, END)
+	if ((_have_start && max_ts < _start) || (_have_end && min_ts >= _end))
+	    continue;
+
+	// check column sizes in 64 bits so a huge 'nrecords' can't wrap
+	uint64_t need = 0;
+	for (int i = 0; i < _fields.size(); i++)
+	    need += ((uint64_t) nrecords * _widths[i] + 7) & ~(uint64_t) 7;
+	if (need > length - HSIZE) {
+	    _ff.error(errh, "block too short");
+	    return false;
+	}
+
+	const uint8_t *s = reinterpret_cast<const uint8_t *>(_block.data());
+	for (int i = 0; i < _fields.size(); i++) {
+	    _columns[i] = s;
+	    s += (nrecords * _widths[i] + 7) & ~7U;
+	}
+	_nrecords = nrecords;
+	_record = 0;
+	return true;
+    }
+}
+
+Packet *
+FromIPColumnDump::read_packet(ErrorHandler *errh)
+{
+    while (1) {
+	if (_record >= _nrecords) {
+	    if (!_ff.initialized() || !read_block(errh)) {
+		_ff.cleanup();
+		_block = String();
+		return 0;
+	    }
+	}
+	uint32_t r = _record++;
+
+	WritablePacket *q = Packet::make(16, (const unsigned char *) 0, 0, 64);
+	if (!q) {
+	    _ff.error(errh, strerror(ENOMEM));
+	    return 0;
+	}
+	if (_zero)
+	    memset(q->buffer(), 0, q->buffer_length());
+
+	IPSummaryDump::PacketOdesc d(this, q, _default_proto, 0, IPSummaryDump::MINOR_VERSION);
+	for (int *fip = _field_order.begin();
+	     fip != _field_order.end() && d.p;
+	     ++fip) {
+	    const IPSummaryDump::FieldReader *f = _fields[*fip];
+	    if (!f->inject)
+		continue;
+	    const uint8_t *v = _columns[*fip] + r * _widths[*fip];
+	    d.clear_values();
+	    if (f->inb(d, v, v + _widths[*fip], f))
+		f->inject(d, f);
+	}
+
+	IPSummaryDump::finish_packet(d, _checksum, _zero);
+	if (!d.p)
+	    continue;
+	const Timestamp &ts = d.p->timestamp_anno();
+	if ((_have_start && ts < _start) || (_have_end && ts >= _end)) {
+	    d.p->kill();
+	    continue;
+	}
+	_count++;
+	return d.p;
+    }
+}
+
+bool
+FromIPColumnDump::run_task(Task *)
+{
+    if (!_active)
+	return false;
+
+    unsigned n;
+    for (n = 0; n < _burst; n++) {
+	Packet *p = read_packet(0);
+	if (!p)
+	    break;
+	output(0).push(p);
+    }
+
+    if (n == 0 && !_ff.initialized()) {
+	if (_stop)
+	    router()->please_stop_driver();
+	return false;
+    }
+    _task.fast_reschedule();
+    return n > 0;
+}
+
+Packet *
+FromIPColumnDump::pull(int)
+{
+    if (!_active)
+	return 0;
+    Packet *p = read_packet(0);
+    if (!p && !_ff.initialized()) {
+	if (_stop)
+	    router()->please_stop_driver();
+	_notifier.sleep();
+	return 0;
+    }
+    _notifier.wake();
+    return p;
+}
+
+
+enum { H_ACTIVE, H_ENCAP, H_COUNT, H_STOP };
+
+String
+FromIPColumnDump::read_handler(Element *e, void *thunk)
+{
+    FromIPColumnDump *fd = static_cast<FromIPColumnDump *>(e);
+    switch ((intptr_t)thunk) {
+      case H_ACTIVE:
+	return cp_unparse_bool(fd->_active);
+      case H_ENCAP:
+	return "IP";
+      case H_COUNT:
+	return String(fd->_count);
+      default:
+	return "<error>";
+    }
+}
+
+int
+FromIPColumnDump::write_handler(const String &s_in, Element *e, void *thunk, ErrorHandler *errh)
+{
+    FromIPColumnDump *fd = static_cast<FromIPColumnDump *>(e);
+    String s = cp_uncomment(s_in);
+    switch ((intptr_t)thunk) {
+      case H_ACTIVE: {
+	  bool active;
+	  if (cp_bool(s, &active)) {
+	      fd->_active = active;
+	      if (fd->output_is_push(0) && active && !fd->_task.scheduled())
+		  fd->_task.reschedule();
+	      else if (!fd->output_is_push(0))
+		  fd->_notifier.set_active(active, true);
+	      return 0;
+	  } else
+	      return errh->error("'active' should be Boolean");
+      }
+      case H_STOP:
+	fd->_active = false;
+	fd->router()->please_stop_driver();
+	return 0;
+      default:
+	return -EINVAL;
+    }
+}
+
+void
+FromIPColumnDump::add_handlers()
+{
+    add_read_handler("active", read_handler, H_ACTIVE, Handler::CHECKBOX);
+    add_write_handler("active", write_handler, H_ACTIVE);
+    add_read_handler("encap", read_handler, H_ENCAP);
+    add_read_handler("count", read_handler, H_COUNT);
+    add_write_handler("stop", write_handler, H_STOP, Handler::BUTTON);
+    _ff.add_handlers(this);
+    if (output_is_push(0))
+	add_task_handlers(&_task);
+}
+
+ELEMENT_REQUIRES(userlevel FromFile IPSummaryDumpInfo)
+EXPORT_ELEMENT(FromIPColumnDump)
+CLICK_ENDDECLS
@@ -0,0 +1,179 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_FROMIPCOLUMNDUMP_HH
+#define CLICK_FROMIPCOLUMNDUMP_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/notifier.hh>
+#include <click/timestamp.hh>
+#include "elements/userlevel/fromfile.hh"
+#include "ipsumdumpinfo.hh"
+CLICK_DECLS
+
+/*
+=c
+
+FromIPColumnDump(FILENAME [, I<keywords> STOP, ACTIVE, ZERO, CHECKSUM, PROTO, START, END, BURST])
+
+=s traces
+
+reads packets from a columnar IP summary dump file
+
+=d
+
+Reads IP packet descriptors from a file produced by ToIPColumnDump, then
+creates packets containing info from the descriptors and pushes them out the
+output.  The packets are built exactly as FromIPSummaryDump builds them from
+the same fields.
+
+Because each block of the file stores every content type in its own array,
+FromIPColumnDump decodes records without parsing or per-record allocation
+beyond the packet itself.  Blocks whose timestamps lie entirely outside the
+START/END range are skipped without being decoded.
+
+Keyword arguments are:
+
+=over 8
+
+=item STOP
+
+Boolean. If true, then FromIPColumnDump will ask the router to stop when it
+is done reading. Default is false.
+
+=item ACTIVE
+
+Boolean. If false, then FromIPColumnDump will not emit packets (until the
+'C<active>' handler is written). Default is true.
+
+=item ZERO
+
+Boolean. Determines the contents of packet data not set by the dump. If
+true (the default), this data is zero. If false, this data is random
+garbage.
+
+=item CHECKSUM
+
+Boolean. If true, then output packets' IP, TCP, and UDP checksums are set.
+If false (the default), the checksum fields contain random garbage.
+
+=item PROTO
+
+Byte (0-255). Sets the IP protocol used for output packets when the dump
+doesn't specify a protocol. Default is 6 (TCP).
+
+=item START
+
+Timestamp. If set, packets with earlier timestamps are not emitted.
+
+=item END
+
+Timestamp. If set, packets with timestamps at or after END are not emitted.
+
+=item BURST
+
+Integer. In push mode, emit at most BURST packets per scheduling.  Default is
+32.
+
+=back
+
+Only push output is scheduled; FromIPColumnDump also supports pull.
+
+=h active read/write
+
+Value is a Boolean.
+
+=h count read-only
+
+Returns the number of packets emitted.
+
+=h encap read-only
+
+Returns 'C<IP>'. Useful for ToDump's USE_ENCAP_FROM option.
+
+=h filesize read-only
+
+Returns the length of the FromIPColumnDump file, in bytes, or "-" if that
+length cannot be determined.
+
+=h filepos read-only
+
+Returns FromIPColumnDump's position in the file, in bytes.
+
+=h stop write-only
+
+When written, sets 'active' to false and stops the driver.
+
+=e
+
+This configuration converts a column dump back to a text IP summary dump.
+
+  FromIPColumnDump(trace.col, STOP true)
+     -> ToIPSummaryDump(trace.txt, CONTENTS timestamp ip_src sport ip_dst dport ip_proto ip_len);
+
+=a
+
+ToIPColumnDump, FromIPSummaryDump, ToIPSummaryDump */
+
+class FromIPColumnDump : public Element, public IPSummaryDumpInfo { public:
+
+    FromIPColumnDump();
+    ~FromIPColumnDump();
+
+    const char *class_name() const	{ return "FromIPColumnDump"; }
+    const char *port_count() const	{ return PORTS_0_1; }
+    const char *processing() const	{ return AGNOSTIC; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *);
+    Packet *pull(int);
+
+  private:
+
+    FromFile _ff;
+
+    Vector<const IPSummaryDump::FieldReader *> _fields;
+    Vector<int> _widths;
+    Vector<int> _field_order;
+    uint16_t _default_proto;
+
+    bool _stop : 1;
+    bool _zero : 1;
+    bool _checksum : 1;
+    bool _active : 1;
+    bool _have_start : 1;
+    bool _have_end : 1;
+    Timestamp _start;
+    Timestamp _end;
+    unsigned _burst;
+
+    String _block;
+    Vector<const uint8_t *> _columns;
+    uint32_t _nrecords;
+    uint32_t _record;
+
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+    counter_t _count;
+
+    Task _task;
+    ActiveNotifier _notifier;
+
+    static int sort_fields_compare(const void *, const void *, void *);
+    int read_header(ErrorHandler *);
+    bool read_block(ErrorHandler *);
+    Packet *read_packet(ErrorHandler *);
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
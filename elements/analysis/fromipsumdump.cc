@@ -75,7 +75,8 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _sampling_prob = (1 << SAMPLING_SHIFT);
     String default_contents, default_flowid;
 
-    if (cp_va_kparse(conf, this, errh,
+    if (_parallel.configure_keywords(conf, this, errh) < 0
+	|| cp_va_kparse(conf, this, errh,
 		     "FILENAME", cpkP+cpkM, cpFilename, &_ff.filename(),
 		     "STOP", 0, cpBool, &stop,
 		     "ACTIVE", 0, cpBool, &active,
@@ -105,6 +106,7 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _timing = timing;
     _have_timing = false;
     _multipacket = multipacket;
+    _parallel_pending = _parallel.enabled();
     _have_flowid = _have_aggregate = _binary = false;
     if (default_contents)
 	bang_data(default_contents, errh);
@@ -185,6 +187,7 @@ FromIPSummaryDump::initialize(ErrorHandler *errh)
 void
 FromIPSummaryDump::cleanup(CleanupStage)
 {
+    _parallel.stop();
     _ff.cleanup();
     if (_work_packet)
 	_work_packet->kill();
@@ -311,36 +314,15 @@ FromIPSummaryDump::bang_binary(const String &line, ErrorHandler *errh)
     _ff.set_lineno(1);
 }
 
-static void
-set_checksums(WritablePacket *q, click_ip *iph)
-{
-    assert(iph == q->ip_header());
-
-    iph->ip_sum = 0;
-    iph->ip_sum = click_in_cksum((uint8_t *)iph, iph->ip_hl << 2);
-
-    if (IP_ISFRAG(iph))
-	/* nada */;
-    else if (iph->ip_p == IP_PROTO_TCP) {
-	click_tcp *tcph = q->tcp_header();
-	tcph->th_sum = 0;
-	unsigned csum = click_in_cksum((uint8_t *)tcph, q->transport_length());
-	tcph->th_sum = click_in_cksum_pseudohdr(csum, iph, q->transport_length());
-    } else if (iph->ip_p == IP_PROTO_UDP) {
-	click_udp *udph = q->udp_header();
-	udph->uh_sum = 0;
-	unsigned csum = click_in_cksum((uint8_t *)udph, q->transport_length());
-	udph->uh_sum = click_in_cksum_pseudohdr(csum, iph, q->transport_length());
-    } else if (iph->ip_p == IP_PROTO_ICMP) {
-	click_icmp *icmph = q->icmp_header();
-	icmph->icmp_cksum = 0;
-	icmph->icmp_cksum = click_in_cksum((const uint8_t *) icmph, q->transport_length());
-    }
-}
-
 Packet *
 FromIPSummaryDump::read_packet(ErrorHandler *errh)
 {
+    if (_parallel.running()) {
+	Packet *p = read_parallel_packet(errh);
+	if (p || !_ff.initialized())
+	    return p;
+    }
+
     // read non-packet lines
     bool binary;
     String line;
@@ -386,6 +368,31 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 	}
     }
 
+    bool bad;
+    Packet *p = parse_packet(line, binary, errh, bad);
+    if (bad && !_format_complaint) {
+	if (_fields.size() == 0)
+	    _ff.error(errh, "no '!data' provided");
+	else
+	    _ff.error(errh, "packet parse error");
+	_format_complaint = true;
+    }
+
+    // hand the rest of a text dump to the worker threads
+    if (_parallel_pending && !binary && _fields.size()) {
+	_parallel_pending = false;
+	_parallel.start(_ff, parse_hook, this, errh);
+    }
+    return p;
+}
+
+Packet *
+FromIPSummaryDump::parse_packet(const String &line, bool binary, ErrorHandler *errh, bool &bad) const
+{
+    const char *data = line.begin();
+    const char *end = line.end();
+    bad = false;
+
     // read packet data
     WritablePacket *q = Packet::make(16, (const unsigned char *) 0, 0, 1000);
     if (!q) {
@@ -449,7 +456,7 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 	    }
 	}
 
-	for (int *fip = _field_order.begin();
+	for (const int *fip = _field_order.begin();
 	     fip != _field_order.end() && d.p;
 	     ++fip) {
 	    const IPSummaryDump::FieldReader *f = _fields[*fip];
@@ -478,7 +485,7 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 		++data;
 	}
 
-	for (int *fip = _field_order.begin();
+	for (const int *fip = _field_order.begin();
 	     fip != _field_order.end() && d.p;
 	     ++fip) {
 	    const IPSummaryDump::FieldReader *f = _fields[*fip];
@@ -493,74 +500,53 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
     }
 
     if (!nfields) {	// bad format
-	if (!_format_complaint) {
-	    // don't complain if the line was all blank
-	    if (binary || !cp_is_space(line)) {
-		if (_fields.size() == 0)
-		    _ff.error(errh, "no '!data' provided");
-		else
-		    _ff.error(errh, "packet parse error");
-		_format_complaint = true;
-	    }
-	}
+	// don't complain if the line was all blank
+	bad = (binary || !cp_is_space(line));
 	if (d.p)
 	    d.p->kill();
 	d.p = 0;
     }
 
-    // set source and destination ports even if no transport info on packet
-    if (d.p && d.default_ip_flowid)
-	(void) d.make_ip(0);	// may fail
-
-    // set up transport header if necessary
-    if (d.p && d.is_ip && d.p->ip_header())
-	(void) d.make_transp();
-
-    if (d.p && d.is_ip && d.p->ip_header()) {
-	// set IP length
-	uint32_t ip_len;
-	if (!d.p->ip_header()->ip_len) {
-	    ip_len = d.want_len;
-	    if (ip_len >= (uint32_t) d.p->network_header_offset())
-		ip_len -= d.p->network_header_offset();
-	    if (ip_len > 0xFFFF)
-		ip_len = 0xFFFF;
-	    else if (ip_len == 0)
-		ip_len = d.p->network_length();
-	    d.p->ip_header()->ip_len = htons(ip_len);
-	} else
-	    ip_len = ntohs(d.p->ip_header()->ip_len);
-
-	// set UDP length
-	if (d.p->ip_header()->ip_p == IP_PROTO_UDP
-	    && IP_FIRSTFRAG(d.p->ip_header())
-	    && !d.p->udp_header()->uh_ulen) {
-	    int len = ip_len - d.p->network_header_length();
-	    d.p->udp_header()->uh_ulen = htons(len);
-	}
+    IPSummaryDump::finish_packet(d, _checksum, _zero);
+    return d.p;
+}
 
-	// set destination IP address annotation
-	d.p->set_dst_ip_anno(d.p->ip_header()->ip_dst);
-
-	// set checksum
-	if (_checksum) {
-	    uint32_t xlen = 0;
-	    if (ip_len > (uint32_t) d.p->network_length())
-		xlen = ip_len - d.p->network_length();
-	    if (!xlen || (d.p = d.p->put(xlen))) {
-		if (xlen && _zero)
-		    memset(d.p->end_data() - xlen, 0, xlen);
-		SET_EXTRA_LENGTH_ANNO(d.p, EXTRA_LENGTH_ANNO(d.p) - xlen);
-		set_checksums(d.p, d.p->ip_header());
-	    }
-	}
-    }
+int
+FromIPSummaryDump::parse_hook(const String &line, Packet **p, void *thunk)
+{
+    // runs on ParallelLineReader threads
+    const FromIPSummaryDump *fd = static_cast<const FromIPSummaryDump *>(thunk);
+    if (!line.length() || line[0] == '#')
+	return ParallelLineReader::LINE_SKIP;
+    else if (line[0] == '!')	// may change _fields and friends
+	return ParallelLineReader::LINE_SERIAL;
+    bool bad;
+    *p = fd->parse_packet(line, false, 0, bad);
+    return (bad ? ParallelLineReader::LINE_BAD : ParallelLineReader::LINE_PACKET);
+}
 
-    // set extra length annotation (post-other length adjustments)
-    if (d.p && d.want_len > d.p->length())
-	SET_EXTRA_LENGTH_ANNO(d.p, d.want_len - d.p->length());
+Packet *
+FromIPSummaryDump::read_parallel_packet(ErrorHandler *errh)
+{
+    Packet *p = _parallel.next();
+    if (_parallel.take_bad_lines() && !_format_complaint) {
+	_ff.error(errh, "packet parse error");
+	_format_complaint = true;
+    }
+    if (p)
+	return p;
 
-    return d.p;
+    // end of file, read error, or a line that must be parsed serially
+    off_t pos = _parallel.serial_pos();
+    int error = _parallel.error();
+    _parallel.stop();
+    if (error)
+	_ff.error(errh, "%s", strerror(error));
+    if (pos < 0 || _ff.seek(pos, errh) < 0)
+	_ff.cleanup();
+    else
+	_parallel_pending = true;
+    return 0;
 }
 
 inline Packet *
@@ -794,6 +780,6 @@ FromIPSummaryDump::add_handlers()
 	add_task_handlers(&_task);
 }
 
-ELEMENT_REQUIRES(userlevel FromFile IPSummaryDumpInfo)
+ELEMENT_REQUIRES(userlevel FromFile ParallelLineReader IPSummaryDumpInfo)
 EXPORT_ELEMENT(FromIPSummaryDump)
 CLICK_ENDDECLS
@@ -7,13 +7,14 @@
 #include <click/notifier.hh>
 #include <click/ipflowid.hh>
 #include "elements/userlevel/fromfile.hh"
+#include "elements/userlevel/parallellinereader.hh"
 #include "ipsumdumpinfo.hh"
 CLICK_DECLS
 
 /*
 =c
 
-FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID])
+FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID, THREADS, CHUNK])
 
 =s traces
 
@@ -100,6 +101,21 @@ destination address, destination port, and, optionally, protocol). Defines the
 IP addresses and ports used by default. Any flow information in the input file
 will override this setting.
 
+=item THREADS
+
+Unsigned.  If positive, parse a text dump on THREADS worker threads.  The file
+is split into CHUNK-byte pieces at line boundaries; each thread parses a
+piece into packets, and FromIPSummaryDump emits the packets in file order, so
+the output is identical to serial parsing.  A 'C<!>' line after the first
+packet is handled serially, after which parallel parsing resumes.  Binary
+dumps, compressed files, and the standard input are always parsed serially.
+Default is 0 (serial).
+
+=item CHUNK
+
+Unsigned.  The size of the pieces parsed by THREADS, in bytes.  Default is
+262144.
+
 =back
 
 Only available in user-level processes.
@@ -168,6 +184,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     enum { SAMPLING_SHIFT = 28 };
 
     FromFile _ff;
+    ParallelLineReader _parallel;
 
     Vector<const IPSummaryDump::FieldReader *> _fields;
     Vector<int> _field_order;
@@ -187,6 +204,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _binary : 1;
     bool _timing : 1;
     bool _have_timing : 1;
+    bool _parallel_pending : 1;
     Packet *_work_packet;
     uint32_t _multipacket_length;
     Timestamp _multipacket_timestamp_delta;
@@ -211,6 +229,9 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     void check_defaults();
     bool check_timing(Packet *p);
     Packet *read_packet(ErrorHandler *);
+    Packet *parse_packet(const String &line, bool binary, ErrorHandler *, bool &bad) const;
+    static int parse_hook(const String &, Packet **, void *);
+    Packet *read_parallel_packet(ErrorHandler *);
     Packet *handle_multipacket(Packet *);
 
     static String read_handler(Element *, void *);
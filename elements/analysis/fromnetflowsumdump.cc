@@ -62,7 +62,8 @@ FromNetFlowSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _multipacket = _timing = false;
     String link = "input";
 
-    if (cp_va_kparse(conf, this, errh,
+    if (_parallel.configure_keywords(conf, this, errh) < 0
+	|| cp_va_kparse(conf, this, errh,
 		     "FILENAME", cpkP+cpkM, cpFilename, &_ff.filename(),
 		     "STOP", 0, cpBool, &stop,
 		     "ACTIVE", 0, cpBool, &_active,
@@ -74,6 +75,7 @@ FromNetFlowSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	return -1;
 
     _stop = stop;
+    _parallel_pending = _parallel.enabled();
     link = link.lower();
     if (link == "input")
 	_link = 0;
@@ -109,6 +111,7 @@ FromNetFlowSummaryDump::initialize(ErrorHandler *errh)
 void
 FromNetFlowSummaryDump::cleanup(CleanupStage)
 {
+    _parallel.stop();
     _ff.cleanup();
     if (_packet)
 	_packet->kill();
@@ -120,6 +123,50 @@ FromNetFlowSummaryDump::cleanup(CleanupStage)
 Packet *
 FromNetFlowSummaryDump::read_packet(ErrorHandler *errh)
 {
+    if (_parallel.running()) {
+	if (Packet *p = _parallel.next())
+	    return p;
+	// end of file, read error, or a bad line to report serially
+	off_t pos = _parallel.serial_pos();
+	if (int error = _parallel.error())
+	    _ff.error(errh, "%s", strerror(error));
+	_parallel.stop();
+	if (pos < 0 || _ff.seek(pos, errh) < 0) {
+	    _ff.cleanup();
+	    return 0;
+	}
+	_parallel_pending = true;
+    }
+
+    String line;
+    while (1) {
+	if (_ff.read_line(line, errh, true) <= 0)
+	    return 0;
+	const char *data = line.data();
+	int len = line.length();
+	if (len != 0 && data[0] != '!' && data[0] != '#')
+	    break;
+    }
+
+    bool bad;
+    Packet *p = parse_packet(line, errh, bad);
+    if (bad && !_format_complaint) {
+	_ff.error(errh, "bad format");
+	_format_complaint = true;
+    }
+
+    // hand the rest of the file to the worker threads
+    if (_parallel_pending && p) {
+	_parallel_pending = false;
+	_parallel.start(_ff, parse_hook, this, errh);
+    }
+    return p;
+}
+
+Packet *
+FromNetFlowSummaryDump::parse_packet(const String &line, ErrorHandler *errh, bool &bad) const
+{
+    bad = false;
     WritablePacket *q = Packet::make((const char *)0, sizeof(click_ip) + sizeof(click_tcp));
     if (!q) {
 	_ff.error(errh, strerror(ENOMEM));
@@ -133,23 +180,13 @@ FromNetFlowSummaryDump::read_packet(ErrorHandler *errh)
     iph->ip_hl = sizeof(click_ip) >> 2;
     iph->ip_off = 0;
 
-    String line;
     String words[15];
     uint32_t j;
 
-    while (1) {
-
-	if (_ff.read_line(line, errh, true) <= 0) {
-	    q->kill();
-	    return 0;
-	}
-
+    do {
 	const char *data = line.data();
 	int len = line.length();
 
-	if (len == 0 || data[0] == '!' || data[0] == '#')
-	    continue;
-
 	int pos = 0, dpos = 0;
 	while (dpos < len && pos < 15) {
 	    int start = dpos;
@@ -234,18 +271,27 @@ FromNetFlowSummaryDump::read_packet(ErrorHandler *errh)
 	    q->take(sizeof(click_tcp));
 	SET_EXTRA_LENGTH_ANNO(q, byte_count - q->length());
 	return q;
-    }
+    } while (0);
 
     // bad format if we get here
-    if (!_format_complaint) {
-	_ff.error(errh, "bad format");
-	_format_complaint = true;
-    }
-    if (q)
-	q->kill();
+    bad = true;
+    q->kill();
     return 0;
 }
 
+int
+FromNetFlowSummaryDump::parse_hook(const String &line, Packet **p, void *thunk)
+{
+    // runs on ParallelLineReader threads
+    const FromNetFlowSummaryDump *fd = static_cast<const FromNetFlowSummaryDump *>(thunk);
+    if (!line.length() || line[0] == '!' || line[0] == '#')
+	return ParallelLineReader::LINE_SKIP;
+    bool bad;
+    *p = fd->parse_packet(line, 0, bad);
+    // a bad line ends the serial stream, so parse it serially
+    return (bad ? ParallelLineReader::LINE_SERIAL : ParallelLineReader::LINE_PACKET);
+}
+
 inline Packet *
 set_packet_lengths(Packet *p, uint32_t extra_length)
 {
@@ -364,7 +410,8 @@ FromNetFlowSummaryDump::run_task(Task *)
 	    return false;
 	}
     }
-    output(0).push(_packet);
+    _packet = 0;
+    output(0).push(p);
     _task.fast_reschedule();
     return true;
 }
@@ -393,6 +440,7 @@ FromNetFlowSummaryDump::pull(int)
 	}
     }
     _notifier.set_active(p != 0, true);
+    _packet = 0;
     return p;
 }
 
@@ -449,5 +497,5 @@ FromNetFlowSummaryDump::add_handlers()
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel FromFile)
+ELEMENT_REQUIRES(userlevel FromFile ParallelLineReader)
 EXPORT_ELEMENT(FromNetFlowSummaryDump)
@@ -6,6 +6,7 @@
 #include <click/timer.hh>
 #include <click/notifier.hh>
 #include "elements/userlevel/fromfile.hh"
+#include "elements/userlevel/parallellinereader.hh"
 CLICK_DECLS
 
 /*
@@ -64,6 +65,17 @@ interface numbers are pinned at 255 (or 15, for "both").  Default is "input".
 Boolean.  If true, FromNetDlowSummaryDump tries to maintain the timing of the
 original packet stream.  TIMING is false by default.
 
+=item THREADS
+
+Unsigned.  If positive, parse the file on THREADS worker threads, as for
+FromIPSummaryDump.  Packets are emitted in file order, so the output is
+identical to serial parsing.  Default is 0 (serial).
+
+=item CHUNK
+
+Unsigned.  The size of the pieces parsed by THREADS, in bytes.  Default is
+262144.
+
 =back
 
 Only available in user-level processes.
@@ -150,11 +162,13 @@ class FromNetFlowSummaryDump : public Element { public:
   private:
 
     FromFile _ff;
+    ParallelLineReader _parallel;
 
     Vector<int> _contents;
 
     bool _stop : 1;
     bool _format_complaint : 1;
+    bool _parallel_pending : 1;
     bool _timing;
     bool _zero;
     bool _active;
@@ -173,6 +187,8 @@ class FromNetFlowSummaryDump : public Element { public:
     Timestamp _time_offset;
 
     Packet *read_packet(ErrorHandler *);
+    Packet *parse_packet(const String &line, ErrorHandler *, bool &bad) const;
+    static int parse_hook(const String &, Packet **, void *);
     Packet *handle_multipacket(Packet *);
     Packet *next_packet();
 
@@ -485,6 +485,87 @@ bool PacketOdesc::hard_make_transp()
     return true;
 }
 
+static void
+set_checksums(WritablePacket *q, click_ip *iph)
+{
+    assert(iph == q->ip_header());
+
+    iph->ip_sum = 0;
+    iph->ip_sum = click_in_cksum((uint8_t *)iph, iph->ip_hl << 2);
+
+    if (IP_ISFRAG(iph))
+	/* nada */;
+    else if (iph->ip_p == IP_PROTO_TCP) {
+	click_tcp *tcph = q->tcp_header();
+	tcph->th_sum = 0;
+	unsigned csum = click_in_cksum((uint8_t *)tcph, q->transport_length());
+	tcph->th_sum = click_in_cksum_pseudohdr(csum, iph, q->transport_length());
+    } else if (iph->ip_p == IP_PROTO_UDP) {
+	click_udp *udph = q->udp_header();
+	udph->uh_sum = 0;
+	unsigned csum = click_in_cksum((uint8_t *)udph, q->transport_length());
+	udph->uh_sum = click_in_cksum_pseudohdr(csum, iph, q->transport_length());
+    } else if (iph->ip_p == IP_PROTO_ICMP) {
+	click_icmp *icmph = q->icmp_header();
+	icmph->icmp_cksum = 0;
+	icmph->icmp_cksum = click_in_cksum((const uint8_t *) icmph, q->transport_length());
+    }
+}
+
+void finish_packet(PacketOdesc &d, bool checksum, bool zero)
+{
+    // set source and destination ports even if no transport info on packet
+    if (d.p && d.default_ip_flowid)
+	(void) d.make_ip(0);	// may fail
+
+    // set up transport header if necessary
+    if (d.p && d.is_ip && d.p->ip_header())
+	(void) d.make_transp();
+
+    if (d.p && d.is_ip && d.p->ip_header()) {
+	// set IP length
+	uint32_t ip_len;
+	if (!d.p->ip_header()->ip_len) {
+	    ip_len = d.want_len;
+	    if (ip_len >= (uint32_t) d.p->network_header_offset())
+		ip_len -= d.p->network_header_offset();
+	    if (ip_len > 0xFFFF)
+		ip_len = 0xFFFF;
+	    else if (ip_len == 0)
+		ip_len = d.p->network_length();
+	    d.p->ip_header()->ip_len = htons(ip_len);
+	} else
+	    ip_len = ntohs(d.p->ip_header()->ip_len);
+
+	// set UDP length
+	if (d.p->ip_header()->ip_p == IP_PROTO_UDP
+	    && IP_FIRSTFRAG(d.p->ip_header())
+	    && !d.p->udp_header()->uh_ulen) {
+	    int len = ip_len - d.p->network_header_length();
+	    d.p->udp_header()->uh_ulen = htons(len);
+	}
+
+	// set destination IP address annotation
+	d.p->set_dst_ip_anno(d.p->ip_header()->ip_dst);
+
+	// set checksum
+	if (checksum) {
+	    uint32_t xlen = 0;
+	    if (ip_len > (uint32_t) d.p->network_length())
+		xlen = ip_len - d.p->network_length();
+	    if (!xlen || (d.p = d.p->put(xlen))) {
+		if (xlen && zero)
+		    memset(d.p->end_data() - xlen, 0, xlen);
+		SET_EXTRA_LENGTH_ANNO(d.p, EXTRA_LENGTH_ANNO(d.p) - xlen);
+		set_checksums(d.p, d.p->ip_header());
+	    }
+	}
+    }
+
+    // set extra length annotation (post-other length adjustments)
+    if (d.p && d.want_len > d.p->length())
+	SET_EXTRA_LENGTH_ANNO(d.p, d.want_len - d.p->length());
+}
 
 const char tcp_flags_word[] = "FSRPAUECN";
 
@@ -153,6 +153,11 @@ void outb(const PacketDesc&, bool ok, const FieldWriter *);
 bool num_ina(PacketOdesc&, const String &, const FieldReader *);
 const uint8_t *inb(PacketOdesc&, const uint8_t*, const uint8_t*, const FieldReader *);
 
+// Complete a packet built by FieldReader::inject functions: add a transport
+// header if needed, set IP and UDP lengths, the destination IP annotation,
+// optionally checksums, and the extra length annotation.  May set d.p to 0.
+void finish_packet(PacketOdesc &d, bool checksum, bool zero);
+
 enum { MISSING_IP = 0,
        MISSING_ETHERNET = 260 };
 inline bool field_missing(const PacketDesc &d, int proto, int l);
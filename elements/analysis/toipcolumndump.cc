@@ -0,0 +1,247 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * toipcolumndump.{cc,hh} -- element writes packet summaries in column blocks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "toipcolumndump.hh"
+#include <click/standard/scheduleinfo.hh>
+#include <click/confparse.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+ToIPColumnDump::ToIPColumnDump()
+    : _f(0), _columns(0), _task(this)
+{
+}
+
+ToIPColumnDump::~ToIPColumnDump()
+{
+    delete[] _columns;
+}
+
+int
+ToIPColumnDump::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    int before = errh->nerrors();
+    String save = "timestamp ip_src";
+    bool careful_trunc = true;
+    bool extra_length = true;
+    _block = 8192;
+
+    if (cp_va_kparse(conf, this, errh,
+		     "FILENAME", cpkP+cpkM, cpFilename, &_filename,
+		     "CONTENTS", 0, cpArgument, &save,
+		     "DATA", 0, cpArgument, &save,
+		     "BLOCK", 0, cpUnsigned, &_block,
+		     "BANNER", 0, cpString, &_banner,
+		     "CAREFUL_TRUNC", 0, cpBool, &careful_trunc,
+		     "EXTRA_LENGTH", 0, cpBool, &extra_length,
+		     cpEnd) < 0)
+	return -1;
+    if (_block < 1)
+	return errh->error("BLOCK must be positive");
+
+    Vector<String> v;
+    cp_spacevec(save, v);
+    for (int i = 0; i < v.size(); i++) {
+	String word = cp_unquote(v[i]);
+	const IPSummaryDump::FieldWriter *f = IPSummaryDump::FieldWriter::find(word);
+	if (!f) {
+	    errh->error("unknown content type '%s'", word.c_str());
+	    continue;
+	} else if (column_width(f->type) < 0 || !f->outb) {
+	    errh->error("content type '%s' has no fixed-size binary form", word.c_str());
+	    continue;
+	}
+
+	_fields.push_back(f);
+	for (int j = 0; j < _prepare_fields.size(); j++)
+	    if (_prepare_fields[j]->prepare == f->prepare)
+		goto found_prepare;
+	if (f->prepare)
+	    _prepare_fields.push_back(f);
+      found_prepare: ;
+    }
+    if (_fields.size() == 0)
+	errh->error("no contents specified");
+
+    _careful_trunc = careful_trunc;
+    _extra_length = extra_length;
+    return (before == errh->nerrors() ? 0 : -1);
+}
+
+int
+ToIPColumnDump::initialize(ErrorHandler *errh)
+{
+    assert(!_f);
+    if (_filename != "-") {
+	_f = fopen(_filename.c_str(), "wb");
+	if (!_f)
+	    return errh->error("%s: %s", _filename.c_str(), strerror(errno));
+    } else {
+	_f = stdout;
+	_filename = "<stdout>";
+    }
+
+    if (input_is_pull(0)) {
+	ScheduleInfo::join_scheduler(this, &_task, errh);
+	_signal = Notifier::upstream_empty_signal(this, 0, &_task);
+    }
+    _active = true;
+    _count = 0;
+    _nrecords = 0;
+
+    _columns = new StringAccum[_fields.size()];
+    for (int i = 0; i < _fields.size(); i++)
+	if (!_columns[i].reserve(_block * column_width(_fields[i]->type) + 8))
+	    return errh->error("out of memory");
+
+    StringAccum sa;
+    sa << "!IPColumnDump " << MAJOR_VERSION << '.' << MINOR_VERSION << '\n';
+    if (_banner)
+	sa << "!creator " << cp_quote(_banner) << '\n';
+    sa << "!data ";
+    for (int i = 0; i < _fields.size(); i++)
+	sa << (i ? " " : "") << _fields[i]->name;
+    sa << "\n!columns\n";
+    ignore_result(fwrite(sa.data(), 1, sa.length(), _f));
+    return 0;
+}
+
+void
+ToIPColumnDump::cleanup(CleanupStage)
+{
+    if (_f) {
+	write_block();
+	if (_f != stdout)
+	    fclose(_f);
+	else
+	    fflush(_f);
+    }
+    _f = 0;
+}
+
+void
+ToIPColumnDump::write_block()
+{
+    if (!_nrecords || !_f)
+	return;
+
+    uint32_t length = BLOCK_HEADER_SIZE;
+    for (int i = 0; i < _fields.size(); i++) {
+	StringAccum &col = _columns[i];
+	while (col.length() & 7)
+	    col << '\0';
+	length += col.length();
+    }
+
+    uint32_t header[BLOCK_HEADER_SIZE / 4];
+    header[0] = htonl(BLOCK_MAGIC);
+    header[1] = htonl(_nrecords);
+    header[2] = htonl(length);
+    header[3] = htonl(_fields.size());
+    header[4] = htonl(_min_ts.sec());
+    header[5] = htonl(_min_ts.nsec());
+    header[6] = htonl(_max_ts.sec());
+    header[7] = htonl(_max_ts.nsec());
+    ignore_result(fwrite(header, 1, sizeof(header), _f));
+    for (int i = 0; i < _fields.size(); i++) {
+	ignore_result(fwrite(_columns[i].data(), 1, _columns[i].length(), _f));
+	_columns[i].clear();
+    }
+    _nrecords = 0;
+}
+
+void
+ToIPColumnDump::write_packet(Packet *p)
+{
+    IPSummaryDump::PacketDesc d(this, p, 0, 0, _careful_trunc, _extra_length);
+    for (int i = 0; i < _prepare_fields.size(); i++)
+	_prepare_fields[i]->prepare(d, _prepare_fields[i]);
+
+    for (int i = 0; i < _fields.size(); i++) {
+	d.sa = &_columns[i];
+	d.clear_values();
+	bool ok = _fields[i]->extract(d, _fields[i]);
+	_fields[i]->outb(d, ok, _fields[i]);
+    }
+
+    const Timestamp &ts = p->timestamp_anno();
+    if (!_nrecords)
+	_min_ts = _max_ts = ts;
+    else if (ts < _min_ts)
+	_min_ts = ts;
+    else if (ts > _max_ts)
+	_max_ts = ts;
+
+    _count++;
+    if (++_nrecords == _block)
+	write_block();
+}
+
+void
+ToIPColumnDump::push(int, Packet *p)
+{
+    if (_active)
+	write_packet(p);
+    p->kill();
+}
+
+bool
+ToIPColumnDump::run_task(Task *)
+{
+    if (!_active)
+	return false;
+    if (Packet *p = input(0).pull()) {
+	write_packet(p);
+	p->kill();
+	_task.fast_reschedule();
+	return true;
+    } else if (_signal) {
+	_task.fast_reschedule();
+	return false;
+    } else
+	return false;
+}
+
+int
+ToIPColumnDump::flush_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    ToIPColumnDump *td = (ToIPColumnDump *) e;
+    if (td->_f) {
+	td->write_block();
+	fflush(td->_f);
+    }
+    return 0;
+}
+
+String
+ToIPColumnDump::read_handler(Element *e, void *)
+{
+    ToIPColumnDump *td = static_cast<ToIPColumnDump *>(e);
+    return String(td->_count);
+}
+
+void
+ToIPColumnDump::add_handlers()
+{
+    if (input_is_pull(0))
+	add_task_handlers(&_task);
+    add_write_handler("flush", flush_handler, 0);
+    add_read_handler("count", read_handler, 0);
+}
+
+ELEMENT_REQUIRES(userlevel IPSummaryDump IPSummaryDump_Anno IPSummaryDump_IP IPSummaryDump_TCP IPSummaryDump_UDP IPSummaryDump_ICMP IPSummaryDump_Link)
+EXPORT_ELEMENT(ToIPColumnDump)
+CLICK_ENDDECLS
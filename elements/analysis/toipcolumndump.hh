@@ -0,0 +1,164 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_TOIPCOLUMNDUMP_HH
+#define CLICK_TOIPCOLUMNDUMP_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/straccum.hh>
+#include <click/notifier.hh>
+#include <click/timestamp.hh>
+#include "ipsumdumpinfo.hh"
+CLICK_DECLS
+
+/*
+=c
+
+ToIPColumnDump(FILENAME [, I<keywords> CONTENTS, BLOCK, BANNER, CAREFUL_TRUNC, EXTRA_LENGTH])
+
+=s traces
+
+writes packet summaries to a columnar binary file
+
+=d
+
+Writes summary information about incoming packets to FILENAME in a compact
+binary format organized in blocks of columns, then drops the packets.
+FromIPColumnDump reads these files.  FILENAME can be `C<->', meaning the
+standard output.
+
+The information is the same as ToIPSummaryDump's: CONTENTS is a
+space-separated list of ToIPSummaryDump content types.  Only content types
+with fixed-size binary representations may be used, such as 'C<timestamp>',
+'C<ip_src>', 'C<sport>', 'C<ip_len>', 'C<tcp_flags>' and 'C<count>'; options
+and payloads may not.  Values are stored as in ToIPSummaryDump's BINARY
+format, so a missing value, such as 'C<sport>' on an ICMP packet, is stored as
+zero.
+
+Rather than writing a record per packet, ToIPColumnDump collects BLOCK
+records and writes each content type's values for the whole block in one
+array.  This makes writing and reading much faster than with text or BINARY
+IP summary dumps, and lets FromIPColumnDump skip blocks by timestamp without
+decoding them.
+
+Keyword arguments are:
+
+=over 8
+
+=item CONTENTS
+
+Space-separated list of content types.  Default is 'C<timestamp ip_src>'.
+
+=item BLOCK
+
+Unsigned.  Number of records per block.  Default is 8192.
+
+=item BANNER
+
+String.  If supplied, writes a 'C<!creator "BANNER">' line to the file
+header.
+
+=item CAREFUL_TRUNC, EXTRA_LENGTH
+
+Booleans.  As for ToIPSummaryDump.  Default is true.
+
+=back
+
+=head1 FILE FORMAT
+
+The file starts with ASCII header lines like those of ToIPSummaryDump.  The
+first is 'C<!IPColumnDump 1.0>'; a 'C<!data>' line lists the content types,
+and a 'C<!columns>' line ends the header.  Blocks follow.  Each starts with
+eight 4-byte words in network byte order: the magic number 0x49504342, the
+number of records N, the block's total length in bytes including this
+header, the number of columns, and the seconds and nanoseconds parts of the
+smallest and then the largest packet timestamp in the block.  Then come the
+columns, in 'C<!data>' order.  Column I is N values of its content type's
+binary size, padded with zeros to a multiple of 8 bytes.
+
+=h flush write-only
+
+Writes any partial block and flushes the file.
+
+=h count read-only
+
+Returns the number of records written.
+
+=e
+
+This configuration converts a text IP summary dump to a column dump.
+
+  FromIPSummaryDump(trace.txt, STOP true)
+     -> ToIPColumnDump(trace.col, CONTENTS timestamp ip_src sport ip_dst dport ip_proto ip_len);
+
+=a
+
+FromIPColumnDump, ToIPSummaryDump, FromIPSummaryDump */
+
+class ToIPColumnDump : public Element, public IPSummaryDumpInfo { public:
+
+    ToIPColumnDump();
+    ~ToIPColumnDump();
+
+    const char *class_name() const	{ return "ToIPColumnDump"; }
+    const char *port_count() const	{ return PORTS_1_0; }
+    const char *processing() const	{ return AGNOSTIC; }
+    const char *flags() const		{ return "S2"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int, Packet *);
+    bool run_task(Task *);
+
+    enum { MAJOR_VERSION = 1, MINOR_VERSION = 0,
+	   BLOCK_MAGIC = 0x49504342, BLOCK_HEADER_SIZE = 32 };
+
+    // Bytes per value in a column of this FieldWriter/FieldReader type, or
+    // -1 if the type has no fixed-size binary form.
+    static int column_width(int type) {
+	if (type == IPSummaryDump::B_4NET)
+	    return 4;
+	else if (type == IPSummaryDump::B_1 || type == IPSummaryDump::B_2
+		 || type == IPSummaryDump::B_4 || type == IPSummaryDump::B_6PTR
+		 || type == IPSummaryDump::B_8)
+	    return type;
+	else
+	    return -1;
+    }
+
+  private:
+
+    String _filename;
+    FILE *_f;
+    Vector<const IPSummaryDump::FieldWriter *> _fields;
+    Vector<const IPSummaryDump::FieldWriter *> _prepare_fields;
+    StringAccum *_columns;
+    uint32_t _block;
+    uint32_t _nrecords;
+    Timestamp _min_ts;
+    Timestamp _max_ts;
+    bool _careful_trunc;
+    bool _extra_length;
+    bool _active;
+    String _banner;
+
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+    counter_t _count;
+
+    Task _task;
+    NotifierSignal _signal;
+
+    void write_packet(Packet *);
+    void write_block();
+    static String read_handler(Element *, void *);
+    static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -52,7 +52,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool header = true;
     bool extra_length = true;
 
-    if (cp_va_kparse(conf, this, errh,
+    if (_writer.configure_keywords(conf, this, errh) < 0
+	|| cp_va_kparse(conf, this, errh,
 		     "FILENAME", cpkP+cpkM, cpFilename, &_filename,
 		     "CONTENTS", 0, cpArgument, &save,
 		     "DATA", 0, cpArgument, &save,
@@ -169,17 +170,30 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     if (_header)
 	ignore_result(fwrite(sa.data(), 1, sa.length(), _f));
 
-    return 0;
+    return _writer.start(_f, _filename, this, errh);
 }
 
 void
 ToIPSummaryDump::cleanup(CleanupStage)
 {
+    _writer.stop();
     if (_f && _f != stdout)
 	fclose(_f);
     _f = 0;
 }
 
+inline void
+ToIPSummaryDump::write_data(const void *a, size_t alen, const void *b, size_t blen)
+{
+    if (_writer.running())
+	_writer.append(a, alen, b, blen);
+    else {
+	ignore_result(fwrite(a, 1, alen, _f));
+	if (blen)
+	    ignore_result(fwrite(b, 1, blen, _f));
+    }
+}
+
 bool
 ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const
 {
@@ -252,7 +266,7 @@ ToIPSummaryDump::write_packet(Packet* p, int multipacket)
 
 	if (_bad_packets && _bad_sa)
 	    write_line(_bad_sa.take_string());
-	ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
+	write_data(_sa.data(), _sa.length());
 
 	_output_count++;
     }
@@ -290,9 +304,9 @@ ToIPSummaryDump::write_line(const String& s)
 	assert(s.back() == '\n');
 	if (_binary) {
 	    uint32_t marker = htonl(s.length() | 0x80000000U);
-	    ignore_result(fwrite(&marker, 4, 1, _f));
-	}
-	ignore_result(fwrite(s.data(), 1, s.length(), _f));
+	    write_data(&marker, 4, s.data(), s.length());
+	} else
+	    write_data(s.data(), s.length());
     }
 }
 
@@ -301,14 +315,15 @@ ToIPSummaryDump::add_note(const String &s)
 {
     if (s.length()) {
 	int extra = 1 + (s.back() == '\n' ? 0 : 1);
+	StringAccum sa;
 	if (_binary) {
 	    uint32_t marker = htonl((s.length() + extra) | 0x80000000U);
-	    ignore_result(fwrite(&marker, 4, 1, _f));
+	    sa.append(reinterpret_cast<const char *>(&marker), 4);
 	}
-	fputc('#', _f);
-	ignore_result(fwrite(s.data(), 1, s.length(), _f));
+	sa << '#' << s;
 	if (extra > 1)
-	    fputc('\n', _f);
+	    sa << '\n';
+	write_data(sa.data(), sa.length());
     }
 }
 
@@ -316,7 +331,9 @@ int
 ToIPSummaryDump::flush_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     ToIPSummaryDump *tod = (ToIPSummaryDump *) e;
-    if (tod->_f)
+    if (tod->_writer.running())
+	tod->_writer.flush(true);
+    else if (tod->_f)
 	fflush(tod->_f);
     return 0;
 }
@@ -327,8 +344,9 @@ ToIPSummaryDump::add_handlers()
     if (input_is_pull(0))
 	add_task_handlers(&_task);
     add_write_handler("flush", flush_handler, 0);
+    _writer.add_handlers(this);
 }
 
-ELEMENT_REQUIRES(userlevel IPSummaryDump IPSummaryDump_Anno IPSummaryDump_IP IPSummaryDump_TCP IPSummaryDump_UDP IPSummaryDump_ICMP IPSummaryDump_Payload IPSummaryDump_Link)
+ELEMENT_REQUIRES(userlevel IPSummaryDump IPSummaryDump_Anno IPSummaryDump_IP IPSummaryDump_TCP IPSummaryDump_UDP IPSummaryDump_ICMP IPSummaryDump_Payload IPSummaryDump_Link AsyncWriter)
 EXPORT_ELEMENT(ToIPSummaryDump)
 CLICK_ENDDECLS
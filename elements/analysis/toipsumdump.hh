@@ -6,6 +6,7 @@
 #include <click/straccum.hh>
 #include <click/notifier.hh>
 #include "ipsumdumpinfo.hh"
+#include "elements/userlevel/asyncwriter.hh"
 CLICK_DECLS
 
 /*
@@ -157,6 +158,12 @@ Actual packet output immediately follows the 'C<!bad>' line.  Default is true.
 
 Boolean.  If false, then ignore extra length annotations.  Defaults to true.
 
+=item ASYNC, ASYNC_BUFFER, ASYNC_NBUFFERS, ASYNC_DROP
+
+Write the dump from a separate thread, as in ToDump.  With ASYNC_DROP,
+records that find every output buffer full are dropped and counted by the
+"drops" handler.  Default ASYNC is false.
+
 =back
 
 =e
@@ -333,7 +340,14 @@ example, are stored this way.
 
 =h flush write-only
 
-Flush all internal buffers to disk.
+Flush all internal buffers to disk.  With ASYNC, waits until the writer
+thread has written everything; with several threads, records in the buffer
+being filled are written after the next packet.
+
+=h drops read-only
+
+Returns the number of records dropped because ASYNC_DROP was true and the
+output buffers were full.
 
 =a
 
@@ -366,6 +380,7 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     String _filename;
     FILE *_f;
+    AsyncWriter _writer;
     Vector<const IPSummaryDump::FieldWriter *> _fields;
     Vector<const IPSummaryDump::FieldWriter *> _prepare_fields;
     bool _verbose : 1;
@@ -388,6 +403,8 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     bool summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const;
     void write_packet(Packet* p, int multipacket);
+    inline void write_data(const void *a, size_t alen,
+			   const void *b = 0, size_t blen = 0);
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
@@ -45,12 +45,12 @@ void AODVDestinationClassifier::push (int port, Packet * packet){
 	else {
 		assert(rrep->originator != rrep->destination);
 		WritablePacket* writable = packet->uniqueify();
-		writable->ip_header()->ip_src = myIP->in_addr(); // make sure next node knows previous hop
+		aodv_set_ip_address(writable, &writable->ip_header()->ip_src, *myIP); // make sure next node knows previous hop
 		
 		IPAddress* nexthop = neighbour_table->nexthop(rrep->originator);
 		if (nexthop){
 			writable->set_dst_ip_anno(*nexthop);
-			writable->ip_header()->ip_dst = nexthop->in_addr();
+			aodv_set_ip_address(writable, &writable->ip_header()->ip_dst, *nexthop);
 			output(1).push(writable);
 		} else {
 			writable->set_dst_ip_anno(rrep->originator); // set annotation for waitinfordiscovery
@@ -55,7 +55,7 @@ void AODVKnownClassifier::push (int port, Packet * p){
 	addKnownRREQ(key); // buffer for next time
 	
 	// increment hopcount according to RFC 6.5
-	++rreq->hopcount;
+	aodv_increment_hopcount(packet, &rreq->hopcount);
 	
 	const click_ip * ipheader = packet->ip_header();
 	
@@ -79,12 +79,16 @@ void AODVKnownClassifier::push (int port, Packet * p){
 	} else {
 		// RFC 6.5: "if a node does not generate a RREP...: update to maximum"
 		if (storedSeqNr && AODVNeighbours::largerSequenceNumber(*storedSeqNr,ntohl(rreq->destinationseqnr))) {
-			rreq->destinationseqnr = htonl(*storedSeqNr);
+			aodv_set_field32(packet, &rreq->destinationseqnr, htonl(*storedSeqNr));
 		}
 		click_ip * ipheader = packet->ip_header();
 		if (ipheader->ip_ttl > 1) {
+			// the TTL shares a halfword with the protocol
+			uint16_t *ttl_hw = reinterpret_cast<uint16_t *>(&ipheader->ip_ttl);
+			uint16_t old_hw = *ttl_hw;
 			--ipheader->ip_ttl;
-			ipheader->ip_src = myIP->in_addr();
+			click_update_in_cksum(&ipheader->ip_sum, old_hw, *ttl_hw);
+			aodv_set_ip_address(packet, &ipheader->ip_src, *myIP);
 			output(1).push(packet);
 		} else {
 			// time's up, kill
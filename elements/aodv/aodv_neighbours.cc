@@ -226,7 +226,7 @@ uint32_t AODVNeighbours::getLifetime(const IPAddress & ip) const{
 	NeighbourMap::Pair* pair = neighbours.find_pair(ip);
 	assert(pair);
 	const Timestamp & expiry = pair->value.expiry->expiry();
-	Timestamp now = Timestamp::now();
+	Timestamp now = Timestamp::recent();
 	uint32_t result = (expiry - now).msecval();
 	return (result == 0)?1:result; // avoid returning 0 to avoid confusion: this entry is still valid!
 }
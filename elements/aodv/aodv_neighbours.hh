@@ -85,7 +85,7 @@ class AODVNeighbours : public Element {
 		static void updateLifetime(NeighbourMap::Pair* pair);
 
 		static inline Timestamp calculateTimeval(int ms) {
-			return Timestamp::now() + Timestamp::make_msec(ms);
+			return Timestamp::recent() + Timestamp::make_msec(ms);
 		}
 };
 
@@ -51,7 +51,7 @@ void AODVUpdateNeighbours::push (int port, Packet * packet){
 			//click_chatter("AODV rrep/hello packet received from %s with seqnr %u", IPAddress(rrep->originator).s().c_str(), ntohl(rrep->destinationseqnr));
 		
 			// increment hopcount according to RFC 6.7
-			++rrep->hopcount;
+			aodv_increment_hopcount(writable, &rrep->hopcount);
 			
 			if (ipheader->ip_ttl == 1){ //HELLO
 				neighbour_table->updateRoutetableEntry(IPAddress(rrep->destination),ntohl(rrep->destinationseqnr),rrep->hopcount, IPAddress(ipheader->ip_src),AODV_ALLOWED_HELLO_LOSS * AODV_HELLO_INTERVAL);
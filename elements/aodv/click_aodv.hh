@@ -3,6 +3,7 @@
 
 #include <click/ipaddress.hh>
 #include <click/string.hh>
+#include <click/packet.hh>
 #include <clicknet/ip.h>
 #include <clicknet/ether.h>
 #include <clicknet/udp.h>
@@ -118,6 +119,46 @@ struct aodv_rrep_ack_header{
 static const int aodv_headeroffset = sizeof(click_ether) + sizeof(click_ip) + sizeof(click_udp);
 #endif
 
+// Fields that AODV changes in transit are patched with incremental (RFC 1624)
+// checksum updates, so forwarded messages need no full recomputation.  A zero
+// UDP checksum means none was computed, and stays zero.
+static inline click_udp *
+aodv_udp_header(WritablePacket *p)
+{
+	return reinterpret_cast<click_udp *>(p->data() + aodv_headeroffset - sizeof(click_udp));
+}
+
+// RREQ and RREP hop counts are byte 3 of the message
+static inline void
+aodv_increment_hopcount(WritablePacket *p, uint8_t *hopcount)
+{
+	uint16_t *hw = reinterpret_cast<uint16_t *>(hopcount - 1);
+	uint16_t old_hw = *hw;
+	++*hopcount;
+	click_udp *udph = aodv_udp_header(p);
+	if (udph->uh_sum)
+		click_update_in_cksum(&udph->uh_sum, old_hw, *hw);
+}
+
+// set a 32-bit message field, such as a sequence number
+static inline void
+aodv_set_field32(WritablePacket *p, uint32_t *field, uint32_t value)
+{
+	click_udp *udph = aodv_udp_header(p);
+	if (udph->uh_sum)
+		click_update_in_cksum32(&udph->uh_sum, *field, value);
+	*field = value;
+}
+
+// set ip_src or ip_dst, which are also part of the UDP pseudoheader
+static inline void
+aodv_set_ip_address(WritablePacket *p, struct in_addr *field, IPAddress addr)
+{
+	click_ip *iph = p->ip_header();
+	click_update_in_cksum32(&iph->ip_sum, field->s_addr, addr.addr());
+	aodv_set_field32(p, &field->s_addr, addr.addr());
+}
+
 CLICK_ENDDECLS
 
 #endif
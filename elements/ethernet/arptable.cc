@@ -28,16 +28,31 @@
 #include <click/router.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/algorithm.hh>
 CLICK_DECLS
 
+ARPTable::Buckets ARPTable::empty_buckets = { 0, { 0 } };
+
 ARPTable::ARPTable()
     : _entry_capacity(0), _packet_capacity(2048), _expire_timer(this)
 {
-    _entry_count = _packet_count = _drops = 0;
+    _entry_count = _packet_count = _drops = _age_clock = 0;
+    // Shards start with no buckets, so unused tables stay small.
+    for (int i = 0; i < NSHARDS; i++) {
+	_shards[i].seq = 0;
+	_shards[i].buckets = &empty_buckets;
+	_shards[i].size = 0;
+    }
 }
 
 ARPTable::~ARPTable()
 {
+    for (int i = 0; i < NSHARDS; i++) {
+	Shard &s = _shards[i];
+	free_buckets(s.buckets);
+	for (int j = 0; j < s.retired.size(); j++)
+	    free_buckets(s.retired[j]);
+    }
 }
 
 int
@@ -64,21 +79,89 @@ ARPTable::cleanup(CleanupStage)
     clear();
 }
 
+ARPTable::Buckets *
+ARPTable::alloc_buckets(uint32_t nbuckets)
+{
+    size_t size = sizeof(Buckets) + (nbuckets - 1) * sizeof(ARPEntry *);
+    Buckets *b = (Buckets *) CLICK_LALLOC(size);
+    if (b) {
+	b->mask = nbuckets - 1;
+	memset(b->head, 0, nbuckets * sizeof(ARPEntry *));
+    }
+    return b;
+}
+
+void
+ARPTable::free_buckets(Buckets *b)
+{
+    if (b != &empty_buckets)
+	CLICK_LFREE(b, sizeof(Buckets) + b->mask * sizeof(ARPEntry *));
+}
+
+void
+ARPTable::lock(Shard &s, bool all)
+{
+    if (all)
+	lock_all();
+    else {
+	s.lock.acquire();
+	s.write_begin();
+    }
+}
+
+void
+ARPTable::unlock(Shard &s, bool all)
+{
+    if (all)
+	unlock_all();
+    else {
+	s.write_end();
+	s.lock.release();
+    }
+}
+
+void
+ARPTable::lock_all()
+{
+    // Always in shard order, so two threads locking everything cannot
+    // deadlock.
+    for (int i = 0; i < NSHARDS; i++) {
+	_shards[i].lock.acquire();
+	_shards[i].write_begin();
+    }
+}
+
+void
+ARPTable::unlock_all()
+{
+    for (int i = NSHARDS - 1; i >= 0; i--) {
+	_shards[i].write_end();
+	_shards[i].lock.release();
+    }
+}
+
+// Returns true if a write may have to make room, which can take entries or
+// packets from any shard.
+bool
+ARPTable::at_capacity(bool packet) const
+{
+    return (_entry_capacity && _entry_count.value() >= _entry_capacity)
+	|| (packet && _packet_capacity
+	    && _packet_count.value() >= _packet_capacity);
+}
+
 void
 ARPTable::clear()
 {
     // Walk the arp cache table and free any stored packets and arp entries.
-    for (Table::iterator it = _table.begin(); it; ) {
-	ARPEntry *ae = _table.erase(it);
-	while (Packet *p = ae->_head) {
-	    ae->_head = p->next();
-	    p->kill();
-	    ++_drops;
-	}
-	_alloc.deallocate(ae);
+    // The bucket arrays stay, since lookups may be reading them.
+    lock_all();
+    for (int i = 0; i < NSHARDS; i++) {
+	Shard &s = _shards[i];
+	while (ARPEntry *ae = s.age.front())
+	    remove(s, ae);
     }
-    _entry_count = _packet_count = 0;
-    _age.__clear();
+    unlock_all();
 }
 
 void
@@ -87,47 +170,156 @@ ARPTable::take_state(Element *e, ErrorHandler *errh)
     ARPTable *arpt = (ARPTable *)e->cast("ARPTable");
     if (!arpt)
 	return;
-    if (_table.size() > 0) {
+    if (_entry_count > 0) {
 	errh->error("late take_state");
 	return;
     }
 
-    _table.swap(arpt->_table);
-    _age.swap(arpt->_age);
+    for (int i = 0; i < NSHARDS; i++) {
+	Shard &s = _shards[i], &x = arpt->_shards[i];
+	Buckets *b = s.buckets;
+	s.buckets = x.buckets;
+	x.buckets = b;
+	click_swap(s.size, x.size);
+	s.age.swap(x.age);
+	s.alloc.swap(x.alloc);
+	s.retired.swap(x.retired);
+    }
     _entry_count = arpt->_entry_count;
     _packet_count = arpt->_packet_count;
     _drops = arpt->_drops;
-    _alloc.swap(arpt->_alloc);
+    _age_clock = arpt->_age_clock;
 
     arpt->_entry_count = 0;
     arpt->_packet_count = 0;
 }
 
+// Orders entries as a single age list would: by the time they were last
+// live; among equal times, entries append_query moved back come first, the
+// latest first, then the others in the order they were queued.
+bool
+ARPTable::age_less(const ARPEntry *a, const ARPEntry *b)
+{
+    if (a->_live_at_j != b->_live_at_j)
+	return click_jiffies_less(a->_live_at_j, b->_live_at_j);
+    if (a->_age_requeued != b->_age_requeued)
+	return a->_age_requeued;
+    int32_t d = a->_age_stamp - b->_age_stamp;
+    return a->_age_requeued ? d > 0 : d < 0;
+}
+
+void
+ARPTable::stamp_age(ARPEntry *ae, bool requeued)
+{
+    ae->_age_requeued = requeued;
+    ae->_age_stamp = _age_clock.fetch_and_add(1);
+}
+
+// Merges the shards' age lists.  CURSOR holds each shard's next entry;
+// returns the oldest of them, and its shard in SI, and advances that cursor.
+ARPTable::ARPEntry *
+ARPTable::next_oldest(ARPEntry **cursor, int *si)
+{
+    int best = -1;
+    for (int i = 0; i < NSHARDS; i++)
+	if (cursor[i] && (best < 0 || age_less(cursor[i], cursor[best])))
+	    best = i;
+    if (best < 0)
+	return 0;
+    ARPEntry *ae = cursor[best];
+    cursor[best] = ae->_age_link.next();
+    if (si)
+	*si = best;
+    return ae;
+}
+
+ARPTable::ARPEntry *
+ARPTable::find(Shard &s, uint32_t h, IPAddress ip)
+{
+    ARPEntry *ae = s.buckets->head[h & s.buckets->mask];
+    while (ae && ae->_ip != ip)
+	ae = ae->_hashnext;
+    return ae;
+}
+
+void
+ARPTable::remove(Shard &s, ARPEntry *ae)
+{
+    ARPEntry **pprev = &s.buckets->head[hash(ae->_ip) & s.buckets->mask];
+    while (*pprev != ae)
+	pprev = &(*pprev)->_hashnext;
+    *pprev = ae->_hashnext;
+    s.age.erase(ae);
+
+    while (Packet *p = ae->_head) {
+	ae->_head = p->next();
+	p->kill();
+	--_packet_count;
+	++_drops;
+    }
+
+    s.alloc.deallocate(ae);
+    --s.size;
+    --_entry_count;
+}
+
+// Doubles the shard's buckets.  The old array is kept until the table is
+// destroyed, since lookups may still be walking it; the arrays only grow, so
+// this at most doubles the buckets' memory.
+void
+ARPTable::grow(Shard &s)
+{
+    Buckets *old = s.buckets;
+    Buckets *b = alloc_buckets(old == &empty_buckets ? (uint32_t) INITIAL_BUCKETS : 2 * (old->mask + 1));
+    if (!b)
+	return;
+    for (uint32_t i = 0; i <= old->mask; i++)
+	for (ARPEntry *ae = old->head[i], *next; ae; ae = next) {
+	    next = ae->_hashnext;
+	    ARPEntry *&head = b->head[hash(ae->_ip) & b->mask];
+	    ae->_hashnext = head;
+	    head = ae;
+	}
+    click_write_fence();
+    s.buckets = b;
+    if (old != &empty_buckets)
+	s.retired.push_back(old);
+}
+
+void
+ARPTable::expire(Shard &s, click_jiffies_t now)
+{
+    while (ARPEntry *ae = s.age.front()) {
+	if (!ae->expired(now, _timeout_j))
+	    break;
+	remove(s, ae);
+    }
+}
+
+// Called with every shard locked.
 void
 ARPTable::slim(click_jiffies_t now)
 {
+    ARPEntry *cursor[NSHARDS];
     ARPEntry *ae;
+    int si;
 
     // Delete old entries.
-    while ((ae = _age.front())
-	   && (ae->expired(now, _timeout_j)
-	       || (_entry_capacity && _entry_count > _entry_capacity))) {
-	_table.erase(ae->_ip);
-	_age.pop_front();
-
-	while (Packet *p = ae->_head) {
-	    ae->_head = p->next();
-	    p->kill();
-	    --_packet_count;
-	    ++_drops;
-	}
-
-	_alloc.deallocate(ae);
-	--_entry_count;
+    for (int i = 0; i < NSHARDS; i++)
+	expire(_shards[i], now);
+    while (_entry_capacity && _entry_count > _entry_capacity) {
+	for (int i = 0; i < NSHARDS; i++)
+	    cursor[i] = _shards[i].age.front();
+	if (!(ae = next_oldest(cursor, &si)))
+	    break;
+	remove(_shards[si], ae);
     }
 
-    // Mark entries for polling, and delete packets to make space.
-    while (_packet_capacity && _packet_count > _packet_capacity) {
+    // Delete packets to make space, oldest entries first.
+    for (int i = 0; i < NSHARDS; i++)
+	cursor[i] = _shards[i].age.front();
+    while (_packet_capacity && _packet_count > _packet_capacity
+	   && (ae = next_oldest(cursor)))
 	while (ae->_head && _packet_count > _packet_capacity) {
 	    Packet *p = ae->_head;
 	    if (!(ae->_head = p->next()))
@@ -136,55 +328,98 @@ ARPTable::slim(click_jiffies_t now)
 	    --_packet_count;
 	    ++_drops;
 	}
-	ae = ae->_age_link.next();
-    }
 }
 
 void
 ARPTable::run_timer(Timer *timer)
 {
-    // Expire any old entries, and make sure there's room for at least one
-    // packet.
-    _lock.acquire_write();
-    slim(click_jiffies());
-    _lock.release_write();
+    // Expire any old entries, one shard at a time, and make sure there's
+    // room for at least one packet.
+    click_jiffies_t now = click_jiffies();
+    for (int i = 0; i < NSHARDS; i++) {
+	lock(_shards[i], false);
+	expire(_shards[i], now);
+	unlock(_shards[i], false);
+    }
+    if ((_entry_capacity && _entry_count > _entry_capacity)
+	|| (_packet_capacity && _packet_count > _packet_capacity)) {
+	lock_all();
+	slim(now);
+	unlock_all();
+    }
     if (_timeout_j)
 	timer->schedule_after_sec(_timeout_j / CLICK_HZ + 1);
 }
 
-ARPTable::ARPEntry *
-ARPTable::ensure(IPAddress ip, click_jiffies_t now)
+int
+ARPTable::lookup_slow(uint32_t h, IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j)
 {
-    _lock.acquire_write();
-    Table::iterator it = _table.find(ip);
-    if (!it) {
-	void *x = _alloc.allocate();
-	if (!x) {
-	    _lock.release_write();
-	    return 0;
+    // Readers take the shard's lock, but do not change its version, so
+    // lock-free lookups go on meanwhile.
+    Shard &s = shard(h);
+    s.lock.acquire();
+    int r = -1;
+    if (ARPEntry *ae = find(s, h, ip)) {
+	click_jiffies_t now = click_jiffies();
+	if (!ae->expired(now, _timeout_j)) {
+	    *eth = ae->_eth;
+	    if (poll_timeout_j
+		&& !click_jiffies_less(now, ae->_live_at_j + poll_timeout_j)
+		&& !click_jiffies_less(now, ae->_polled_at_j + (CLICK_HZ / 10))) {
+		ae->_polled_at_j = now;
+		r = 1;
+	    } else
+		r = 0;
 	}
+    }
+    s.lock.release();
+    return r;
+}
 
-	++_entry_count;
-	if (_entry_capacity && _entry_count > _entry_capacity)
-	    slim(now);
+// Called with shard S, or every shard if ALL, locked.
+ARPTable::ARPEntry *
+ARPTable::ensure(Shard &s, uint32_t h, IPAddress ip, click_jiffies_t now, bool all)
+{
+    if (ARPEntry *ae = find(s, h, ip))
+	return ae;
 
-	ARPEntry *ae = new(x) ARPEntry(ip);
-	ae->_live_at_j = now;
-	ae->_polled_at_j = ae->_live_at_j - CLICK_HZ;
-	_table.set(it, ae);
+    if (s.buckets == &empty_buckets || s.size >= 2 * (s.buckets->mask + 1))
+	grow(s);
+    void *x;
+    if (s.buckets == &empty_buckets || !(x = s.alloc.allocate()))
+	return 0;
 
-	_age.push_back(ae);
-    }
-    return it.get();
+    ++_entry_count;
+    if (all && _entry_capacity && _entry_count > _entry_capacity)
+	slim(now);
+
+    ARPEntry *ae = new(x) ARPEntry(ip);
+    ae->_live_at_j = now;
+    ae->_polled_at_j = ae->_live_at_j - CLICK_HZ;
+    stamp_age(ae, false);
+    s.age.push_back(ae);
+
+    ARPEntry *&head = s.buckets->head[h & s.buckets->mask];
+    ae->_hashnext = head;
+    click_write_fence();
+    head = ae;
+    ++s.size;
+    return ae;
 }
 
 int
 ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
 {
     click_jiffies_t now = click_jiffies();
-    ARPEntry *ae = ensure(ip, now);
-    if (!ae)
+    uint32_t h = hash(ip);
+    Shard &s = shard(h);
+    bool all = at_capacity(false);
+    lock(s, all);
+    ARPEntry *ae = ensure(s, h, ip, now, all);
+    if (!ae) {
+	unlock(s, all);
 	return -ENOMEM;
+    }
 
     ae->_eth = eth;
     ae->_unicast = !eth.is_broadcast();
@@ -193,9 +428,10 @@ ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
     ae->_polled_at_j = ae->_live_at_j - CLICK_HZ;
 
     if (ae->_age_link.next()) {
-	_age.erase(ae);
-	_age.push_back(ae);
+	s.age.erase(ae);
+	s.age.push_back(ae);
     }
+    stamp_age(ae, false);
 
     if (head) {
 	*head = ae->_head;
@@ -204,8 +440,7 @@ ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
 	    --_packet_count;
     }
 
-    _table.balance();
-    _lock.release_write();
+    unlock(s, all);
     return 0;
 }
 
@@ -213,12 +448,18 @@ int
 ARPTable::append_query(IPAddress ip, Packet *p)
 {
     click_jiffies_t now = click_jiffies();
-    ARPEntry *ae = ensure(ip, now);
-    if (!ae)
+    uint32_t h = hash(ip);
+    Shard &s = shard(h);
+    bool all = at_capacity(true);
+    lock(s, all);
+    ARPEntry *ae = ensure(s, h, ip, now, all);
+    if (!ae) {
+	unlock(s, all);
 	return -ENOMEM;
+    }
 
     if (ae->unicast(now, _timeout_j)) {
-	_lock.release_write();
+	unlock(s, all);
 	return -EAGAIN;
     }
 
@@ -236,14 +477,15 @@ ARPTable::append_query(IPAddress ip, Packet *p)
 	    while (next && click_jiffies_less(next->_live_at_j, ae->_live_at_j))
 		next = next->_age_link.next();
 	    if (ae_next != next) {
-		_age.erase(ae);
-		_age.insert(next /* might be null */, ae);
+		s.age.erase(ae);
+		s.age.insert(next /* might be null */, ae);
 	    }
+	    stamp_age(ae, true);
 	}
     }
 
     ++_packet_count;
-    if (_packet_capacity && _packet_count > _packet_capacity)
+    if (all && _packet_capacity && _packet_count > _packet_capacity)
 	slim(now);
 
     if (ae->_tail)
@@ -260,24 +502,26 @@ ARPTable::append_query(IPAddress ip, Packet *p)
     } else
 	r = 0;
 
-    _table.balance();
-    _lock.release_write();
+    unlock(s, all);
     return r;
 }
 
 IPAddress
 ARPTable::reverse_lookup(const EtherAddress &eth)
 {
-    _lock.acquire_read();
-
     IPAddress ip;
-    for (Table::iterator it = _table.begin(); it; ++it)
-	if (it->_eth == eth) {
-	    ip = it->_ip;
-	    break;
-	}
-
-    _lock.release_read();
+    bool found = false;
+    for (int i = 0; i < NSHARDS && !found; i++) {
+	Shard &s = _shards[i];
+	s.lock.acquire();
+	for (ARPEntry *ae = s.age.front(); ae; ae = ae->_age_link.next())
+	    if (ae->_eth == eth) {
+		ip = ae->_ip;
+		found = true;
+		break;
+	    }
+	s.lock.release();
+    }
     return ip;
 }
 
@@ -288,14 +532,23 @@ ARPTable::read_handler(Element *e, void *user_data)
     StringAccum sa;
     click_jiffies_t now = click_jiffies();
     switch (reinterpret_cast<uintptr_t>(user_data)) {
-    case h_table:
-	for (ARPEntry *ae = arpt->_age.front(); ae; ae = ae->_age_link.next()) {
+    case h_table: {
+	// Lock the shards without changing their versions, so lookups go on.
+	ARPEntry *cursor[NSHARDS];
+	for (int i = 0; i < NSHARDS; i++) {
+	    arpt->_shards[i].lock.acquire();
+	    cursor[i] = arpt->_shards[i].age.front();
+	}
+	while (ARPEntry *ae = next_oldest(cursor)) {
 	    int ok = ae->unicast(now, arpt->_timeout_j);
 	    sa << ae->_ip << ' ' << ok << ' ' << ae->_eth << ' '
 	       << Timestamp::make_jiffies(now - ae->_live_at_j) << '\n';
 	}
+	for (int i = NSHARDS - 1; i >= 0; i--)
+	    arpt->_shards[i].lock.release();
 	break;
     }
+    }
     return sa.take_string();
 }
 
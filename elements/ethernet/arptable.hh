@@ -2,7 +2,7 @@
 #define CLICK_ARPTABLE_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/hashcontainer.hh>
+#include <click/vector.hh>
 #include <click/hashallocator.hh>
 #include <click/sync.hh>
 #include <click/timer.hh>
@@ -76,6 +76,18 @@ Return the number of entries in the table.
 
 Return the number of packets stored in the table.
 
+=n
+
+ARPTable is divided into 16 shards by IP address.  Lookups take no locks and
+write no shared memory: each shard has a version counter that writers make
+odd while they change the shard, and a lookup that saw the counter odd or
+changed simply retries.  Writers, such as ARP responses and queued packets,
+lock only their own shard, so lookups for other addresses go on meanwhile.
+Each entry's queue of pending packets belongs to its shard.  The table
+handler, capacity limits, and the C<clear> handler lock every shard.  When
+the table is near CAPACITY or ENTRY_CAPACITY, concurrent writers in different
+shards may exceed it briefly; the next write or timer run trims the excess.
+
 =a
 
 ARPQuerier
@@ -142,10 +154,12 @@ class ARPTable : public Element { public:
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
 
     struct ARPEntry {		// This structure is now larger than I'd like
-	IPAddress _ip;		// (40B) but probably still fine.
-	ARPEntry *_hashnext;
-	EtherAddress _eth;
+	IPAddress _ip;		// (64B) but probably still fine.
+	uint32_t _age_stamp;	// orders entries with equal _live_at_j
+	ARPEntry *_hashnext;	// Not first: a freed entry's first word
+	EtherAddress _eth;	// links it into its allocator's free list.
 	bool _unicast;
+	bool _age_requeued;	// moved back in the age list by append_query
 	click_jiffies_t _live_at_j;
 	click_jiffies_t _polled_at_j;
 	Packet *_head;
@@ -165,52 +179,158 @@ class ARPTable : public Element { public:
 	}
 	ARPEntry(IPAddress ip)
 	    : _ip(ip), _hashnext(), _eth(EtherAddress::make_broadcast()),
-	      _unicast(false), _head(), _tail() {
+	      _unicast(false), _age_requeued(false), _head(), _tail() {
 	}
     };
 
   private:
 
-    ReadWriteLock _lock;
+    enum { SHARD_BITS = 4, NSHARDS = 1 << SHARD_BITS,
+	   INITIAL_BUCKETS = 16, MAX_CHAIN = 32 };
+
+    struct Buckets {
+	uint32_t mask;
+	ARPEntry *head[1];
+    };
 
-    typedef HashContainer<ARPEntry> Table;
-    Table _table;
     typedef List<ARPEntry, &ARPEntry::_age_link> AgeList;
-    AgeList _age;
+
+    struct Shard {
+	volatile uint32_t seq;		// odd while a writer changes the shard
+	Buckets * volatile buckets;
+	Spinlock lock;			// serializes writers
+	uint32_t size;
+	AgeList age;
+	SizedHashAllocator<sizeof(ARPEntry)> alloc;
+	Vector<Buckets *> retired;	// replaced arrays; lookups may use them
+	char pad[64];			// keeps other shards off these lines
+
+	inline uint32_t read_begin() const;
+	inline bool read_retry(uint32_t s) const;
+	inline void write_begin();
+	inline void write_end();
+    };
+
+    Shard _shards[NSHARDS];
     atomic_uint32_t _entry_count;
     atomic_uint32_t _packet_count;
+    atomic_uint32_t _age_clock;
     uint32_t _entry_capacity;
     uint32_t _packet_capacity;
     uint32_t _timeout_j;
     atomic_uint32_t _drops;
-    SizedHashAllocator<sizeof(ARPEntry)> _alloc;
     Timer _expire_timer;
 
-    ARPEntry *ensure(IPAddress ip, click_jiffies_t now);
+    static Buckets empty_buckets;
+
+    static inline uint32_t hash(IPAddress ip);
+    Shard &shard(uint32_t h) {
+	return _shards[h >> (32 - SHARD_BITS)];
+    }
+    static Buckets *alloc_buckets(uint32_t nbuckets);
+    static void free_buckets(Buckets *b);
+
+    int lookup_slow(uint32_t h, IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j);
+    static ARPEntry *find(Shard &s, uint32_t h, IPAddress ip);
+    ARPEntry *ensure(Shard &s, uint32_t h, IPAddress ip, click_jiffies_t now, bool all);
+    void remove(Shard &s, ARPEntry *ae);
+    void grow(Shard &s);
+    void stamp_age(ARPEntry *ae, bool requeued);
+    static bool age_less(const ARPEntry *a, const ARPEntry *b);
+    static ARPEntry *next_oldest(ARPEntry **cursor, int *si = 0);
+    bool at_capacity(bool packet) const;
+    void lock(Shard &s, bool all);
+    void unlock(Shard &s, bool all);
+    void lock_all();
+    void unlock_all();
+    void expire(Shard &s, click_jiffies_t now);
     void slim(click_jiffies_t now);
 
 };
 
+inline uint32_t
+ARPTable::hash(IPAddress ip)
+{
+    // The high bits pick the shard and the low bits the bucket, so mix well.
+    uint32_t h = ip.addr();
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    return h ^ (h >> 16);
+}
+
+inline uint32_t
+ARPTable::Shard::read_begin() const
+{
+    uint32_t s;
+    while ((s = seq) & 1)
+	/* a writer is busy */;
+    click_read_fence();
+    return s;
+}
+
+inline bool
+ARPTable::Shard::read_retry(uint32_t s) const
+{
+    click_read_fence();
+    return seq != s;
+}
+
+inline void
+ARPTable::Shard::write_begin()
+{
+    seq = seq + 1;
+    click_write_fence();
+}
+
+inline void
+ARPTable::Shard::write_end()
+{
+    click_write_fence();
+    seq = seq + 1;
+}
+
 inline int
 ARPTable::lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j)
 {
-    _lock.acquire_read();
-    int r = -1;
-    if (Table::iterator it = _table.find(ip)) {
-	click_jiffies_t now = click_jiffies();
-	if (!it->expired(now, _timeout_j)) {
-	    *eth = it->_eth;
-	    if (poll_timeout_j
-		&& !click_jiffies_less(now, it->_live_at_j + poll_timeout_j)
-		&& !click_jiffies_less(now, it->_polled_at_j + (CLICK_HZ / 10))) {
-		it->_polled_at_j = now;
-		r = 1;
-	    } else
-		r = 0;
+    // Copy the entry out under the shard's version counter.  Entries and
+    // bucket arrays are never returned to the system while the table is in
+    // use, so a lookup racing a writer reads stale memory at worst, and then
+    // retries.
+    uint32_t h = hash(ip);
+    const Shard &s = shard(h);
+    EtherAddress found_eth;
+    click_jiffies_t live_at_j, polled_at_j;
+    bool found;
+    uint32_t seq;
+    do {
+	seq = s.read_begin();
+	const Buckets *b = s.buckets;
+	const ARPEntry *ae = b->head[h & b->mask];
+	for (int n = MAX_CHAIN; ae && ae->_ip != ip; ae = ae->_hashnext)
+	    if (--n == 0)
+		return lookup_slow(h, ip, eth, poll_timeout_j);
+	if ((found = ae)) {
+	    found_eth = ae->_eth;
+	    live_at_j = ae->_live_at_j;
+	    polled_at_j = ae->_polled_at_j;
 	}
-    }
-    _lock.release_read();
-    return r;
+    } while (s.read_retry(seq));
+
+    if (!found)
+	return -1;
+    click_jiffies_t now = click_jiffies();
+    if (_timeout_j && click_jiffies_less(live_at_j + _timeout_j, now))
+	return -1;
+    *eth = found_eth;
+    if (poll_timeout_j
+	&& !click_jiffies_less(now, live_at_j + poll_timeout_j)
+	&& !click_jiffies_less(now, polled_at_j + (CLICK_HZ / 10)))
+	// Time to poll: mark the entry under the shard's lock, so only one
+	// thread sends the query.
+	return lookup_slow(h, ip, eth, poll_timeout_j);
+    return 0;
 }
 
 inline EtherAddress
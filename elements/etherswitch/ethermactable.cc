@@ -0,0 +1,233 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ethermactable.{cc,hh} -- MAC learning table for EtherSwitch
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ethermactable.hh"
+#include <click/straccum.hh>
+CLICK_DECLS
+
+EtherMACTable::EtherMACTable()
+    : _timeout(300), _now(0), _nentries(0), _sweep_pos(0), _sweep_start(0)
+{
+    static_assert(sizeof(Bucket) == 64);
+    enum { INITIAL_BUCKETS = 64 };
+    _rep = alloc_rep(INITIAL_BUCKETS);
+    _buckets = _rep->buckets;
+    _mask = INITIAL_BUCKETS - 1;
+    _shift = 64 - 6;
+    _sweep_pos = _mask + 1;
+    _readers = 0;
+}
+
+EtherMACTable::~EtherMACTable()
+{
+    free_rep(_rep);
+    for (int i = 0; i < _retired.size(); i++)
+	free_rep(_retired[i]);
+}
+
+EtherMACTable::Rep *
+EtherMACTable::alloc_rep(uint32_t nbuckets)
+{
+    // CLICK_LALLOC does not align to cache lines, so over-allocate
+    Rep *rep = new Rep;
+    size_t size = nbuckets * sizeof(Bucket) + 63;
+    rep->mem = CLICK_LALLOC(size);
+    rep->buckets = (Bucket *) (((uintptr_t) rep->mem + 63) & ~(uintptr_t) 63);
+    rep->nbuckets = nbuckets;
+    memset(rep->buckets, 0, nbuckets * sizeof(Bucket));
+    return rep;
+}
+
+void
+EtherMACTable::free_rep(Rep *rep)
+{
+    CLICK_LFREE(rep->mem, rep->nbuckets * sizeof(Bucket) + 63);
+    delete rep;
+}
+
+void
+EtherMACTable::free_retired()
+{
+    // The locked compare-and-swap orders the earlier publication of _rep
+    // before the check: a dump that started after it sees the new array.
+    if (_retired.size() && _readers.compare_and_swap(0, 0)) {
+	for (int i = 0; i < _retired.size(); i++)
+	    free_rep(_retired[i]);
+	_retired.clear();
+    }
+}
+
+void
+EtherMACTable::lookup_batch(const EtherAddress *addr, int *port, int n) const
+{
+    for (int i = 0; i < n; i++)
+	prefetch(addr[i]);
+    for (int i = 0; i < n; i++)
+	port[i] = lookup(addr[i]);
+}
+
+// Empties slot I of bucket B, which lies somewhere on its address's probe
+// sequence, and uncounts the entry from the buckets it passed over.
+void
+EtherMACTable::erase(Bucket *b, int i)
+{
+    uint32_t pos = b - _buckets;
+    for (uint32_t j = home(b->slot[i] & ADDR_MASK); j != pos; j = (j + 1) & _mask)
+	_buckets[j].overflow--;
+    b->slot[i] = 0;
+    _nentries--;
+}
+
+// Puts KEY in the first empty or expired slot on its probe sequence.
+// Returns false if there is none.
+bool
+EtherMACTable::place(uint64_t key, uint16_t stamp)
+{
+    uint32_t h = home(key & ADDR_MASK);
+    for (int d = 0; d < MAX_PROBE; d++) {
+	Bucket *b = &_buckets[(h + d) & _mask];
+	for (int i = 0; i < SLOTS; i++)
+	    if (!b->slot[i] || expired(b->stamp[i])) {
+		if (b->slot[i])
+		    erase(b, i);
+		for (int j = 0; j < d; j++)
+		    _buckets[(h + j) & _mask].overflow++;
+		b->stamp[i] = stamp;
+		b->slot[i] = key;
+		_nentries++;
+		return true;
+	    }
+    }
+    return false;
+}
+
+void
+EtherMACTable::learn_slow(uint64_t a, int port)
+{
+    uint64_t key = a | ((uint64_t) (port + 1) << ADDR_BITS);
+    while (!place(key, _now))
+	grow();
+}
+
+// Doubles the number of buckets, dropping expired entries.
+void
+EtherMACTable::grow()
+{
+    Rep *old = _rep;
+    Rep *rep = 0;
+    uint32_t nbuckets = old->nbuckets;
+    int shift = _shift;
+    while (!rep) {
+	nbuckets *= 2;
+	shift--;
+	rep = alloc_rep(nbuckets);
+	_buckets = rep->buckets;
+	_mask = nbuckets - 1;
+	_shift = shift;
+	_nentries = 0;
+	for (uint32_t b = 0; b < old->nbuckets && rep; b++)
+	    for (int i = 0; i < SLOTS && rep; i++) {
+		const Bucket &ob = old->buckets[b];
+		if (ob.slot[i] && !expired(ob.stamp[i])
+		    && !place(ob.slot[i], ob.stamp[i])) {
+		    free_rep(rep);
+		    rep = 0;
+		}
+	    }
+    }
+
+    click_write_fence();
+    _rep = rep;
+    _retired.push_back(old);
+    free_retired();
+    _sweep_pos = _mask + 1;
+}
+
+void
+EtherMACTable::advance(uint32_t sec)
+{
+    // Every entry expires across a jump longer than the timeout, but its
+    // 16-bit stamp might wrap to look fresh, so drop them all first.
+    if (sec - _now > _timeout)
+	clear();
+    _now = sec;
+    // Start a sweep every quarter timeout, finishing any late one first;
+    // every expired entry is cleared long before its stamp could wrap.
+    uint32_t period = (_timeout / 4 ? _timeout / 4 : 1);
+    if (_now - _sweep_start >= period) {
+	if (_sweep_pos <= _mask)
+	    sweep(_mask + 1 - _sweep_pos);
+	_sweep_pos = 0;
+	_sweep_start = _now;
+	free_retired();
+    }
+}
+
+void
+EtherMACTable::clear()
+{
+    for (uint32_t j = 0; j <= _mask; j++) {
+	Bucket *b = &_buckets[j];
+	for (int i = 0; i < SLOTS; i++)
+	    b->slot[i] = 0;
+	b->overflow = 0;
+    }
+    _nentries = 0;
+    _sweep_pos = _mask + 1;
+}
+
+void
+EtherMACTable::sweep(uint32_t n)
+{
+    uint32_t end = _sweep_pos + n;
+    if (end > _mask + 1)
+	end = _mask + 1;
+    for (; _sweep_pos < end; _sweep_pos++) {
+	Bucket *b = &_buckets[_sweep_pos];
+	for (int i = 0; i < SLOTS; i++)
+	    if (b->slot[i] && expired(b->stamp[i]))
+		erase(b, i);
+    }
+}
+
+String
+EtherMACTable::unparse() const
+{
+    StringAccum sa;
+    _readers++;
+    const Rep *rep = _rep;
+    uint16_t now = _now;
+    uint32_t timeout = _timeout;
+    for (uint32_t b = 0; b < rep->nbuckets; b++) {
+	const volatile Bucket *bucket = &rep->buckets[b];
+	for (int i = 0; i < SLOTS; i++) {
+	    uint64_t key = bucket->slot[i];
+	    if (key && (uint16_t) (now - bucket->stamp[i]) <= timeout) {
+		uint16_t s[3];
+		s[0] = ~key >> 32;
+		s[1] = ~key >> 16;
+		s[2] = ~key;
+		sa << EtherAddress((const unsigned char *) s) << ' '
+		   << (int) (key >> ADDR_BITS) - 1 << '\n';
+	    }
+	}
+    }
+    _readers--;
+    return sa.take_string();
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(EtherMACTable)
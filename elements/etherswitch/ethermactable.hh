@@ -0,0 +1,216 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ETHERMACTABLE_HH
+#define CLICK_ETHERMACTABLE_HH
+#include <click/etheraddress.hh>
+#include <click/atomic.hh>
+#include <click/vector.hh>
+#include <click/string.hh>
+#include <click/glue.hh>
+#include <click/integers.hh>
+CLICK_DECLS
+
+/*
+ * ethermactable.{cc,hh} -- MAC learning table for EtherSwitch
+ *
+ * EtherMACTable maps Ethernet addresses to ports.  It is an open-addressing
+ * hash table of 64-byte, cache-line-aligned buckets, each holding SLOTS
+ * entries, so a lookup usually touches one cache line and follows no
+ * pointers.  An entry is one 64-bit word, the complemented address in the low
+ * 48 bits and the port plus one above, plus a 16-bit stamp: the low bits of
+ * the second it was last learned.  An empty word thus stands for the
+ * broadcast address, and group addresses are never learned.  An address
+ * lives in its home bucket or, if that is full, in one of the next
+ * MAX_PROBE - 1 buckets; each bucket counts the entries that passed over it,
+ * so lookups stop at the first bucket with no such entries.  The table
+ * doubles when an address finds no room.
+ *
+ * Aging is by generation rather than per entry.  The table's clock is set,
+ * in whole seconds, with set_time(), and an entry is live while its stamp is
+ * at most timeout() seconds old: from TIMEOUT to TIMEOUT + 1 seconds after
+ * it was last learned.  Expired entries are ignored by lookups and reused by
+ * learn().  A sweep clears them in bulk, a few buckets per set_time() call,
+ * starting every quarter timeout, long before their stamps could wrap.  A
+ * clock jump longer than the timeout expires every entry at once, so it
+ * clears the whole table instead.  Timeouts are at most MAX_TIMEOUT seconds.
+ *
+ * lookup_batch() prefetches every address's home bucket before looking any
+ * up, so the cache misses overlap.
+ *
+ * Only one thread may change the table or call lookups at a time, but
+ * unparse() may run on any thread meanwhile.  It reads the buckets without
+ * locking, so entries changed during the dump may or may not appear; arrays
+ * replaced by growth while a dump is in progress are freed later.
+ */
+
+class EtherMACTable { public:
+
+    EtherMACTable();
+    ~EtherMACTable();
+
+    enum { SLOTS = 6, MAX_PROBE = 8, SWEEP_BUCKETS = 4, MAX_TIMEOUT = 32767 };
+
+    uint32_t timeout() const			{ return _timeout; }
+    void set_timeout(uint32_t timeout)		{ _timeout = timeout; }
+
+    inline void set_time(uint32_t sec);
+    int size() const				{ return _nentries; }
+    int nbuckets() const			{ return _mask + 1; }
+
+    inline void prefetch(const EtherAddress &addr) const;
+    inline int lookup(const EtherAddress &addr) const;
+    void lookup_batch(const EtherAddress *addr, int *port, int n) const;
+    inline void learn(const EtherAddress &addr, int port);
+
+    String unparse() const;
+
+  private:
+
+    struct Bucket {
+	uint64_t slot[SLOTS];	// ~address | (port + 1) << 48; 0 if empty
+	uint16_t stamp[SLOTS];	// low bits of the second last learned
+	uint16_t overflow;	// entries placed past this bucket
+	uint16_t pad;
+    };
+
+    // published for unparse(), which may run on another thread
+    struct Rep {
+	Bucket *buckets;
+	uint32_t nbuckets;
+	void *mem;
+    };
+
+    Bucket *_buckets;
+    uint32_t _mask;
+    int _shift;
+    uint32_t _timeout;
+    uint32_t _now;
+    int _nentries;
+
+    uint32_t _sweep_pos;
+    uint32_t _sweep_start;
+
+    Rep * volatile _rep;
+    Vector<Rep *> _retired;
+    mutable atomic_uint32_t _readers;	// unparse() calls in progress
+
+    enum { ADDR_BITS = 48 };
+    static const uint64_t ADDR_MASK = (((uint64_t) 1) << ADDR_BITS) - 1;
+
+    static inline uint64_t addr_bits(const EtherAddress &addr);
+    static inline unsigned slot_match(uint64_t slot, uint64_t a);
+    inline uint32_t home(uint64_t a) const;
+    inline bool expired(uint16_t stamp) const;
+    inline int find(uint64_t a, const Bucket *&b, int &i) const;
+
+    void learn_slow(uint64_t a, int port);
+    bool place(uint64_t key, uint16_t stamp);
+    void erase(Bucket *b, int i);
+    void advance(uint32_t sec);
+    void clear();
+    void sweep(uint32_t n);
+    void grow();
+    static Rep *alloc_rep(uint32_t nbuckets);
+    static void free_rep(Rep *rep);
+    void free_retired();
+
+    EtherMACTable(const EtherMACTable &);
+    EtherMACTable &operator=(const EtherMACTable &);
+
+};
+
+inline uint64_t
+EtherMACTable::addr_bits(const EtherAddress &addr)
+{
+    const uint16_t *s = addr.sdata();
+    return ~(((uint64_t) s[0] << 32) | ((uint64_t) s[1] << 16) | s[2]) & ADDR_MASK;
+}
+
+inline unsigned
+EtherMACTable::slot_match(uint64_t slot, uint64_t a)
+{
+    return ((slot ^ a) << (64 - ADDR_BITS)) == 0;
+}
+
+inline uint32_t
+EtherMACTable::home(uint64_t a) const
+{
+    return (uint32_t) ((a * 0x9E3779B97F4A7C15ULL) >> _shift);
+}
+
+inline bool
+EtherMACTable::expired(uint16_t stamp) const
+{
+    return (uint16_t) (_now - stamp) > _timeout;
+}
+
+inline void
+EtherMACTable::set_time(uint32_t sec)
+{
+    if (sec != _now && (int32_t) (sec - _now) > 0)
+	advance(sec);
+    if (_sweep_pos <= _mask)
+	sweep(SWEEP_BUCKETS);
+}
+
+inline void
+EtherMACTable::prefetch(const EtherAddress &addr) const
+{
+    click_prefetch0(&_buckets[home(addr_bits(addr))]);
+}
+
+// Returns the slot index of address A's entry, setting B to its bucket, or
+// -1 if A has no entry.  Expired entries are found too.
+inline int
+EtherMACTable::find(uint64_t a, const Bucket *&b, int &i) const
+{
+    uint32_t h = home(a);
+    for (int d = 0; d < MAX_PROBE; d++) {
+	b = &_buckets[(h + d) & _mask];
+	// compare every slot without branching; a branch per slot
+	// mispredicts more often than not
+	unsigned match = slot_match(b->slot[0], a)
+	    | (slot_match(b->slot[1], a) << 1)
+	    | (slot_match(b->slot[2], a) << 2)
+	    | (slot_match(b->slot[3], a) << 3)
+	    | (slot_match(b->slot[4], a) << 4)
+	    | (slot_match(b->slot[5], a) << 5);
+	if (match)
+	    return (i = ffs_lsb(match) - 1);
+	if (!b->overflow)
+	    break;
+    }
+    return -1;
+}
+
+inline int
+EtherMACTable::lookup(const EtherAddress &addr) const
+{
+    const Bucket *b;
+    int i;
+    if (find(addr_bits(addr), b, i) >= 0 && !expired(b->stamp[i]))
+	return (int) (b->slot[i] >> ADDR_BITS) - 1;
+    return -1;
+}
+
+inline void
+EtherMACTable::learn(const EtherAddress &addr, int port)
+{
+    if (addr.is_group())
+	return;
+    uint64_t a = addr_bits(addr);
+    uint64_t key = a | ((uint64_t) (port + 1) << ADDR_BITS);
+    const Bucket *cb;
+    int i;
+    if (find(a, cb, i) >= 0) {
+	// only write when something changed, to keep the line clean
+	Bucket *b = const_cast<Bucket *>(cb);
+	if (b->stamp[i] != (uint16_t) _now)
+	    b->stamp[i] = _now;
+	if (b->slot[i] != key)
+	    b->slot[i] = key;
+    } else
+	learn_slow(a, port);
+}
+
+CLICK_ENDDECLS
+#endif
@@ -26,21 +26,25 @@
 CLICK_DECLS
 
 EtherSwitch::EtherSwitch()
-    : _table(AddrInfo(-1, Timestamp())), _timeout(300)
 {
 }
 
 EtherSwitch::~EtherSwitch()
 {
-    _table.clear();
 }
 
 int
 EtherSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return cp_va_kparse(conf, this, errh,
-			"TIMEOUT", 0, cpSeconds, &_timeout,
-			cpEnd);
+    uint32_t timeout = 300;
+    if (cp_va_kparse(conf, this, errh,
+		     "TIMEOUT", 0, cpSeconds, &timeout,
+		     cpEnd) < 0)
+	return -1;
+    if (timeout > EtherMACTable::MAX_TIMEOUT)
+	return errh->error("TIMEOUT too large, max %d", EtherMACTable::MAX_TIMEOUT);
+    _table.set_timeout(timeout);
+    return 0;
 }
 
 void
@@ -61,25 +65,7 @@ EtherSwitch::broadcast(int source, Packet *p)
 void
 EtherSwitch::push(int source, Packet *p)
 {
-    click_ether* e = (click_ether*) p->data();
-    int outport = -1;		// Broadcast
-
-    // 0 timeout means dumb switch
-    if (_timeout != 0) {
-	_table.set(EtherAddress(e->ether_shost), AddrInfo(source, p->timestamp_anno()));
-
-	// Set outport if dst is unicast, we have info about it, and the
-	// info is still valid.
-	EtherAddress dst(e->ether_dhost);
-	if (!dst.is_group()) {
-	    if (Table::iterator dst_info = _table.find(dst)) {
-		if (p->timestamp_anno() < dst_info.value().stamp + Timestamp(_timeout, 0))
-		    outport = dst_info.value().port;
-		else
-		    _table.erase(dst_info);
-	    }
-	}
-    }
+    int outport = route(source, p);	// -1 means broadcast
 
   if (outport < 0)
     broadcast(source, p);
@@ -94,14 +80,10 @@ EtherSwitch::reader(Element* f, void *thunk)
 {
     EtherSwitch* sw = (EtherSwitch*)f;
     switch ((intptr_t) thunk) {
-    case 0: {
-	StringAccum sa;
-	for (Table::iterator iter = sw->_table.begin(); iter.live(); iter++)
-	    sa << iter.key() << ' ' << iter.value().port << '\n';
-	return sa.take_string();
-    }
+    case 0:
+	return sw->_table.unparse();
     case 1:
-	return String(sw->_timeout);
+	return String(sw->_table.timeout());
     default:
 	return String();
     }
@@ -111,8 +93,10 @@ int
 EtherSwitch::writer(const String &s, Element *e, void *, ErrorHandler *errh)
 {
     EtherSwitch *sw = (EtherSwitch *) e;
-    if (!cp_seconds_as(s, 0, &sw->_timeout))
-	return errh->error("expected timeout (integer)");
+    uint32_t timeout;
+    if (!cp_seconds_as(s, 0, &timeout) || timeout > EtherMACTable::MAX_TIMEOUT)
+	return errh->error("expected timeout (integer, max %d)", EtherMACTable::MAX_TIMEOUT);
+    sw->_table.set_timeout(timeout);
     return 0;
 }
 
@@ -124,5 +108,6 @@ EtherSwitch::add_handlers()
     add_write_handler("timeout", writer, 0);
 }
 
+ELEMENT_REQUIRES(EtherMACTable)
 EXPORT_ELEMENT(EtherSwitch)
 CLICK_ENDDECLS
@@ -2,7 +2,8 @@
 #define CLICK_ETHERSWITCH_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/hashtable.hh>
+#include <clicknet/ether.h>
+#include "ethermactable.hh"
 CLICK_DECLS
 
 /*
@@ -37,7 +38,8 @@ Keyword arguments are:
 
 The timeout for port associations, in seconds.  Any port mapping (i.e.,
 binding between an address and a port number) is dropped after TIMEOUT seconds
-of inactivity.  If 0, the element acts like a dumb hub.  Default is 300.
+of inactivity.  If 0, the element acts like a dumb hub.  Default is 300; at
+most 32767.
 
 =back
 
@@ -46,9 +48,18 @@ of inactivity.  If 0, the element acts like a dumb hub.  Default is 300.
 The EtherSwitch element has no limit on the memory consumed by cached Ethernet
 addresses.
 
+Port associations are kept in a hash table of cache-line-sized buckets, so
+learning the source and looking up the destination usually cost one cache
+miss each, and the two overlap.  Time is measured by packets' timestamp
+annotations in whole seconds, so a mapping lasts between TIMEOUT and TIMEOUT
++ 1 seconds; expired mappings are cleared in bulk by a sweep spread over
+later packets.  Group source addresses, which are invalid, are not learned.
+The switch must not receive packets on several threads at once.
+
 =h table read-only
 
-Returns the current port association table.
+Returns the current port association table, one `C<ADDR PORT>' line per
+live mapping.  Reading it does not block forwarding, even on other threads.
 
 =h timeout read/write
 
@@ -74,30 +85,41 @@ class EtherSwitch : public Element { public:
 
   void push(int port, Packet* p);
 
-    struct AddrInfo {
-	int port;
-	Timestamp stamp;
-	inline AddrInfo(int p, const Timestamp &t);
-    };
-
-  private:
+  protected:
 
-    typedef HashTable<EtherAddress, AddrInfo> Table;
-    Table _table;
-    uint32_t _timeout;
+    EtherMACTable _table;
 
+    inline int route(int source, Packet *p);
     void broadcast(int source, Packet*);
 
+  private:
+
     static String reader(Element *, void *);
     static int writer(const String &, Element *, void *, ErrorHandler *);
-    friend class ListenEtherSwitch;
 
 };
 
-inline
-EtherSwitch::AddrInfo::AddrInfo(int p, const Timestamp& s)
-    : port(p), stamp(s)
+/* Learns P's source address on port SOURCE, and returns the port for P's
+   destination, or -1 if P should be flooded. */
+inline int
+EtherSwitch::route(int source, Packet *p)
 {
+    // 0 timeout means dumb switch
+    if (_table.timeout() == 0)
+	return -1;
+
+    const click_ether *e = (const click_ether *) p->data();
+    EtherAddress dst(e->ether_dhost);
+    bool unicast = !dst.is_group();
+    // load the destination's bucket while learning the source
+    if (unicast)
+	_table.prefetch(dst);
+    _table.set_time(p->timestamp_anno().sec());
+    _table.learn(EtherAddress(e->ether_shost), source);
+
+    // Set outport if dst is unicast, we have info about it, and the
+    // info is still valid.
+    return (unicast ? _table.lookup(dst) : -1);
 }
 
 CLICK_ENDDECLS
@@ -175,11 +175,16 @@ DSDVRouteTable::DSDVRouteTable() :
   _max_hops(3), _alpha(88), _wst0(6000),
   _last_periodic_update(0),
   _last_triggered_update(0),
+  _last_full_update(0),
   _ignore_invalid_routes(false),
   _hello_timer(static_hello_hook, this),
   _log_dump_timer(static_log_dump_hook, this),
+  _trigger_timer(static_trigger_hook, this),
+  _trigger_timer_jiffies(0),
   _verbose(true)
 {
+  for (int i = 0; i < NAD; i++)
+    _ad_count[i] = _ad_bytes[i] = 0;
 }
 
 DSDVRouteTable::~DSDVRouteTable()
@@ -190,15 +195,8 @@ DSDVRouteTable::~DSDVRouteTable()
       i.value()->unschedule();
     delete i.value();
   }
-  for (TMIter i = _trigger_timers.begin(); i.live(); i++) {
-    if (i.value()->scheduled())
-      i.value()->unschedule();
-    delete i.value();
-  }
   for (HMIter i = _expire_hooks.begin(); i.live(); i++)
     delete i.value();
-  for (HMIter i = _trigger_hooks.begin(); i.live(); i++)
-    delete i.value();
 }
 
 void *
@@ -216,6 +214,7 @@ int
 DSDVRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
 {
   String logfile;
+  _full_period = 0;
   int res = cp_va_kparse(conf, this, errh,
 			 "TIMEOUT", cpkP+cpkM, cpUnsigned, &_timeout,
 			 "PERIOD", cpkP+cpkM, cpUnsigned, &_period,
@@ -232,6 +231,7 @@ DSDVRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
 			 "ALPHA", 0, cpUnsigned, &_alpha,
 			 "SEQ0", 0, cpUnsigned, &_seq_no,
 			 "MTU", 0, cpUnsigned, &_mtu,
+			 "FULL_PERIOD", 0, cpUnsigned, &_full_period,
 			 "IGNORE_INVALID_ROUTES", 0, cpBool, &_ignore_invalid_routes,
 #if SEQ_METRIC
 			 "USE_SEQ_METRIC", 0, cpBool, &_use_seq_metric,
@@ -248,6 +248,12 @@ DSDVRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
     return errh->error("timeout interval must be greater than 0");
   if (_period == 0)
     return errh->error("period must be greater than 0");
+  if (_full_period == 0)
+    _full_period = _period;
+  else if (_full_period < _period)
+    return errh->error("full dump period is less than period");
+  else if (_full_period >= _timeout)
+    return errh->error("full dump period must be less than timeout");
   // _jitter is allowed to be 0
   if (_jitter > _period)
     return errh->error("jitter is bigger than period");
@@ -286,6 +292,7 @@ DSDVRouteTable::initialize(ErrorHandler *)
   _hello_timer.schedule_after_msec(_period);
   _log_dump_timer.initialize(this);
   _log_dump_timer.schedule_after_msec(_log_dump_period);
+  _trigger_timer.initialize(this);
 
   check_invariants();
 #if ENABLE_PAUSE
@@ -385,7 +392,16 @@ DSDVRouteTable::insert_route(const RTEntry &r, const GridGenericLogger::reason_t
     _old_rtes.insert(r.dest_ip, *old_r);
 #endif
 
+  // remember whether the next incremental ad must carry this route.
+  // A sequence number change alone does not count, nor does a switch
+  // between equal-cost next hops, which happens constantly as new
+  // sequence numbers arrive over different paths.
+  bool changed = !old_r || old_r->changed_since_full
+    || old_r->num_hops() != r.num_hops()
+    || old_r->is_gateway != r.is_gateway
+    || metrics_differ(old_r->metric, r.metric);
   _rtes.insert(r.dest_ip, r);
+  _rtes.findp(r.dest_ip)->changed_since_full = changed;
 
   // note, we don't change any pending triggered update for this
   // updated dest.  ... but shouldn't we postpone it?  -- shouldn't
@@ -486,6 +502,7 @@ DSDVRouteTable::expire_hook(const IPAddress &ip)
       old_r->invalidate(jiff);
 #endif
     r->ttl = grid_hello::MAX_TTL_DEFAULT;
+    r->changed_since_full = true;
 
     // set up triggered ad
     r->advertise_ok_jiffies = jiff;
@@ -505,99 +522,81 @@ DSDVRouteTable::schedule_triggered_update(const IPAddress &ip, unsigned int when
 {
   check_invariants();
 
-  // get rid of outstanding triggered request (if any)
-  Timer **old = _trigger_timers.findp(ip);
-  HookPair **oldhp = _trigger_hooks.findp(ip);
-  if (old) {
-    dsdv_assert(*old && (*old)->scheduled() && oldhp && *oldhp);
-    (*old)->unschedule();
-    delete *old;
-    delete *oldhp;
-  }
+  // replaces outstanding triggered request (if any)
+  _trigger_jiffies.insert(ip, when);
 
-  // set up new timer
-  HookPair *hp = new HookPair(this, ip);
-  Timer *t = new Timer(static_trigger_hook, (void *) hp);
-  t->initialize(this);
-  unsigned int jiff = dsdv_jiffies();
-  t->schedule_after_msec(jiff_to_msec(jiff > when ? 0 : when - jiff));
-  _trigger_timers.insert(ip, t);
-  _trigger_hooks.insert(ip, hp);
+  // fire no earlier than the minimum triggered update period allows;
+  // if the timer is already set to fire earlier, the new request will
+  // go out then or be found when it fires
+  unsigned int next_trigger_jiff = _last_triggered_update + msec_to_jiff(_min_triggered_update_period);
+  if (when < next_trigger_jiff)
+    when = next_trigger_jiff;
+  if (!_trigger_timer.scheduled() || when < _trigger_timer_jiffies) {
+    unsigned int jiff = dsdv_jiffies();
+    _trigger_timer.schedule_after_msec(jiff_to_msec(jiff > when ? 0 : when - jiff));
+    _trigger_timer_jiffies = when;
+  }
 
   check_invariants();
 }
 
 void
-DSDVRouteTable::trigger_hook(const IPAddress &ip)
+DSDVRouteTable::schedule_trigger_timer()
 {
-  check_invariants(&ip);
+  if (_trigger_jiffies.size() == 0) {
+    _trigger_timer.unschedule();
+    return;
+  }
 
-  // invariant: the trigger timer must exist for this dest, but must
-  // not be running
-  Timer **old = _trigger_timers.findp(ip);
-  HookPair **oldhp = _trigger_hooks.findp(ip);
-  dsdv_assert(old && *old && !(*old)->scheduled() && oldhp && *oldhp);
+  unsigned int when = ~0U;
+  for (JMIter i = _trigger_jiffies.begin(); i.live(); i++)
+    if (i.value() < when)
+      when = i.value();
+  unsigned int next_trigger_jiff = _last_triggered_update + msec_to_jiff(_min_triggered_update_period);
+  if (when < next_trigger_jiff)
+    when = next_trigger_jiff;
+
+  unsigned int jiff = dsdv_jiffies();
+  _trigger_timer.schedule_after_msec(jiff_to_msec(jiff > when ? 0 : when - jiff));
+  _trigger_timer_jiffies = when;
+}
 
+void
+DSDVRouteTable::trigger_hook()
+{
   unsigned int jiff = dsdv_jiffies();
   unsigned int next_trigger_jiff = _last_triggered_update + msec_to_jiff(_min_triggered_update_period);
 
 #if DBG
-  click_chatter("%s: XXX trigger_hoook(%s)\n", name().c_str(), ip.unparse().c_str());
+  click_chatter("%s: XXX trigger_hook (%d pending)\n", name().c_str(), _trigger_jiffies.size());
 #endif
 
-  if (jiff >= next_trigger_jiff) {
-    // It's ok to send a triggered update now.  Cleanup expired timer.
-    delete *old;
-    delete *oldhp;
-    _trigger_timers.remove(ip);
-    _trigger_hooks.remove(ip);
-
-    send_triggered_update(ip);
+  // Collect the requests that are due.  If it's too early to send a
+  // triggered update (e.g. a full update went out since the timer was
+  // set), they stay pending, and go out together when the timer
+  // fires again.
+  Vector<IPAddress> due;
+  if (jiff >= next_trigger_jiff)
+    for (JMIter i = _trigger_jiffies.begin(); i.live(); i++)
+      if (i.value() <= jiff)
+	due.push_back(i.key());
+
+  for (int i = 0; i < due.size(); i++)
+    _trigger_jiffies.remove(due[i]);
+  schedule_trigger_timer();
+
+  if (due.size()) {
+    // one ad covers every route that needs advertising
+    send_triggered_update();
 #if DBG
     click_chatter("%s: XXX sent triggered update\n", name().c_str());
 #endif
-  }
-  else {
-#if DBG
-    click_chatter("%s: XXX too early to send triggered update (jiff=%d, next_trigger_jiff=%d, _min_triggered_update_period=%d)\n", name().c_str(), jiff, next_trigger_jiff, _min_triggered_update_period);
-#endif
-    // it's too early to send this update, so cancel all oustanding
-    // triggered updates that would also be too early
-    Vector<IPAddress> remove_list;
-    for (TMIter i = _trigger_timers.begin(); i.live(); i++) {
-      if (i.key() == ip)
-	continue; // don't touch this timer, we'll reschedule it
-
-
-      Timer *old2 = i.value();
-      dsdv_assert(old2 && old2->scheduled());
-
-      HookPair **oldhp = _trigger_hooks.findp(i.key());
-      dsdv_assert(oldhp && *oldhp);
-
-      RTEntry *r = _rtes.findp(i.key());
-      if (r->advertise_ok_jiffies < next_trigger_jiff) {
-	delete old2;
-	delete *oldhp;
-	remove_list.push_back(i.key());
-      }
-    }
-
-    for (int i = 0; i < remove_list.size(); i++) {
-      _trigger_timers.remove(remove_list[i]);
-      _trigger_hooks.remove(remove_list[i]);
-    }
-
-    // reschedule this timer to earliest possible time -- when it
-    // fires, its update will also include updates that would have
-    // fired before then but were cancelled just above.
-    (*old)->schedule_after_msec(jiff_to_msec(next_trigger_jiff - jiff));
+    schedule_trigger_timer();
   }
 
   check_invariants();
 }
 
-
 void
 DSDVRouteTable::init_metric(RTEntry &r)
 {
@@ -754,6 +753,41 @@ DSDVRouteTable::metrics_differ(const metric_t &m1, const metric_t &m2)
   return metric_val_lt(m1, m2) || metric_val_lt(m2, m1);
 }
 
+void
+DSDVRouteTable::send_ads(const Vector<RTEntry> &routes, int type)
+{
+  // send out ads and reset ``need advertisement'' flags.  A full dump
+  // is a single ad, as it always was; routes that don't fit wait.
+  int n = routes.size();
+  if (type == AD_FULL && n > max_rtes_per_ad())
+    n = max_rtes_per_ad();
+  Vector<RTEntry> ad_routes;
+  for (int i = 0; i < n; i++) {
+    if (ad_routes.size() == max_rtes_per_ad()) {
+      build_and_tx_ad(ad_routes, type);
+      ad_routes.clear();
+#if DBG
+      click_chatter("%s: too many routes; sending out partial update (%d)\n",
+		    name().c_str(), i);
+#endif
+    }
+
+    ad_routes.push_back(routes[i]);
+
+    RTEntry *r = _rtes.findp(routes[i].dest_ip);
+    dsdv_assert(r);
+    // triggered ads leave need_metric_ad set, as they always have, so
+    // later triggered ads repeat a metric change until a periodic ad
+    r->need_seq_ad = false;
+    if (type != AD_TRIGGERED)
+      r->need_metric_ad = false;
+    if (type == AD_FULL)
+      r->changed_since_full = false;
+    r->last_adv_metric = r->metric;
+  }
+  build_and_tx_ad(ad_routes, type);
+}
+
 void
 DSDVRouteTable::send_full_update()
 {
@@ -774,27 +808,7 @@ DSDVRouteTable::send_full_update()
 #endif
   }
 
-  // send out ads and reset ``need advertisement'' flag
-  Vector<RTEntry> ad_routes;
-  for (int i = 0; i < routes.size() && i < max_rtes_per_ad(); i++) {
-    if (ad_routes.size() == max_rtes_per_ad()) {
-      build_and_tx_ad(ad_routes);
-      ad_routes.clear();
-#if DBG
-      click_chatter("%s: too many routes; sending out partial full dump (%d)\n",
-		    name().c_str(), i);
-#endif
-    }
-
-    ad_routes.push_back(routes[i]);
-
-    RTEntry *r = _rtes.findp(routes[i].dest_ip);
-    dsdv_assert(r);
-    r->need_seq_ad = false;
-    r->need_metric_ad = false;
-    r->last_adv_metric = r->metric;
-  }
-  build_and_tx_ad(ad_routes);
+  send_ads(routes, AD_FULL);
 
   /*
    * Update the sequence number for periodic updates, but not for
@@ -805,21 +819,53 @@ DSDVRouteTable::send_full_update()
   _seq_no += 2;
   _last_periodic_update = jiff;
   _last_triggered_update = jiff;
+  _last_full_update = jiff;
 
   check_invariants();
 }
 
 void
-DSDVRouteTable::send_triggered_update(const IPAddress &ip)
+DSDVRouteTable::send_incremental_update()
 {
   check_invariants();
+  unsigned int jiff = dsdv_jiffies();
 
-  // Check that there is actually a route to the destination which
-  // prompted this trigger.  There ought to be since we never actually
-  // take entries out of the route table; we only mark them as
-  // expired.
-  RTEntry *r = _rtes.findp(ip);
-  dsdv_assert(r);
+  // advertise only the routes that changed since the last full dump
+  Vector<RTEntry> routes;
+  for (RTIter i = _rtes.begin(); i.live(); i++) {
+    const RTEntry &r = i.value();
+    if (r.advertise_ok_jiffies > jiff)
+      continue;
+    if (r.changed_since_full
+#if ENABLE_SEEN
+	// neighbors check our ads for their 1-hop routes
+	|| (_use_seen && r.num_hops() == 1)
+#endif
+	)
+      routes.push_back(r);
+  }
+
+  // as in the DSDV paper, send a full dump once the changes no longer
+  // fit in a single ad
+  if (routes.size() > max_rtes_per_ad()) {
+    send_full_update();
+    return;
+  }
+
+  send_ads(routes, AD_INCREMENTAL);
+
+  // incremental updates are periodic, so they update the sequence number
+  _seq_no += 2;
+  _last_periodic_update = jiff;
+  _last_triggered_update = jiff;
+
+  check_invariants();
+}
+
+void
+DSDVRouteTable::send_triggered_update()
+{
+  check_invariants();
 
   unsigned int jiff = dsdv_jiffies();
 
@@ -842,26 +888,7 @@ DSDVRouteTable::send_triggered_update(const IPAddress &ip)
   if (triggered_routes.size() == 0)
     return;
 
-  // send out ads and reset ``need advertisement'' flag
-  Vector<RTEntry> ad_routes;
-  for (int i = 0; i < triggered_routes.size(); i++) {
-    if (ad_routes.size() == max_rtes_per_ad()) {
-      build_and_tx_ad(ad_routes);
-      ad_routes.clear();
-#if DBG
-      click_chatter("%s: too many routes; sending out partial triggered update (%d)\n",
-		    name().c_str(), i);
-#endif
-    }
-
-    ad_routes.push_back(triggered_routes[i]);
-
-    RTEntry *r = _rtes.findp(triggered_routes[i].dest_ip);
-    dsdv_assert(r);
-    r->need_seq_ad = false; // XXX why not reset need_metric_ad flag as well?
-    r->last_adv_metric = r->metric;
-  }
-  build_and_tx_ad(ad_routes);
+  send_ads(triggered_routes, AD_TRIGGERED);
 
   _last_triggered_update = jiff;
 
@@ -1416,6 +1443,17 @@ DSDVRouteTable::print_dump(Element *e, void *)
   return sa.take_string();
 }
 
+String
+DSDVRouteTable::print_ad_stats(Element *e, void *)
+{
+  DSDVRouteTable *rt = (DSDVRouteTable *) e;
+  static const char * const names[] = { "full", "incremental", "triggered" };
+  StringAccum sa;
+  for (int i = 0; i < NAD; i++)
+    sa << names[i] << " " << rt->_ad_count[i] << " ads " << rt->_ad_bytes[i] << " bytes\n";
+  return sa.take_string();
+}
+
 void
 DSDVRouteTable::add_handlers()
 {
@@ -1434,6 +1472,7 @@ DSDVRouteTable::add_handlers()
   add_read_handler("use_old_route", print_use_old_route, 0);
   add_write_handler("use_old_route", write_use_old_route, 0);
   add_read_handler("dump", print_dump, 0);
+  add_read_handler("ad_stats", print_ad_stats, 0);
 }
 
 void
@@ -1453,7 +1492,12 @@ DSDVRouteTable::hello_hook()
     msecs_to_next_ad = jiff_to_msec(_last_periodic_update + jiff_period - jiff);
   }
   else {
-    send_full_update();
+    // send a full dump if the next periodic ad would be more than half
+    // a period late for it
+    if (jiff_to_msec(jiff - _last_full_update) + _period / 2 >= _full_period)
+      send_full_update();
+    else
+      send_incremental_update();
     _last_periodic_update = jiff;
     _last_triggered_update = jiff;
   }
@@ -1474,7 +1518,7 @@ DSDVRouteTable::hello_hook()
 
 
 void
-DSDVRouteTable::build_and_tx_ad(Vector<RTEntry> &rtes_to_send)
+DSDVRouteTable::build_and_tx_ad(Vector<RTEntry> &rtes_to_send, int type)
 {
   /*
    * Build and send routing update packet advertising the contents of
@@ -1537,6 +1581,8 @@ DSDVRouteTable::build_and_tx_ad(Vector<RTEntry> &rtes_to_send)
   for (int i = 0; i < num_rtes; i++, curr++)
     rtes_to_send[i].fill_in(curr);
 
+  _ad_count[type]++;
+  _ad_bytes[type] += p->length();
   output(0).push(p);
 }
 
@@ -1638,22 +1684,10 @@ DSDVRouteTable::check_invariants(const IPAddress *ignore) const
       dsdv_assert(!hp);
     }
 
-    // check trigger timer invariants
-    t = _trigger_timers.findp(r.dest_ip);
-    hp = _trigger_hooks.findp(r.dest_ip);
-    if (t) {
-      dsdv_assert(*t);
-      dsdv_assert((*t)->scheduled());
-      dsdv_assert(hp);
-      dsdv_assert(*hp);
-      dsdv_assert((*hp)->obj == this);
-      dsdv_assert((*hp)->ip == (unsigned int) r.dest_ip);
-      // dsdv_assert(r.need_seq_ad || r.need_metric_ad); // see note for trigger invariants
-    }
-    else {
-      dsdv_assert(!hp);
-    }
   }
+
+  // check trigger timer invariant
+  dsdv_assert(_trigger_jiffies.size() == 0 || _trigger_timer.scheduled());
 }
 
 void
@@ -120,6 +120,16 @@ CLICK_DECLS
  * interface; route broadcasts will not exceed this size.  Defaults to
  * 2000.
  *
+ * =item FULL_PERIOD
+ *
+ * Unsigned integer.  Milliseconds between full dumps.  Periodic ads
+ * sent between full dumps are incremental: they carry only the route
+ * entries whose hop count, metric, or gateway status changed since the
+ * last full dump.  Sequence number changes alone wait for the
+ * next full dump, so FULL_PERIOD should be well below TIMEOUT.  If the
+ * changed entries do not fit in one ad, a full dump is sent instead.
+ * Defaults to PERIOD, meaning every periodic ad is a full dump.
+ *
  * =item VERBOSE
  *
  * Boolean.  Be verbose about warning and status messages?  Defaults
@@ -139,6 +149,9 @@ CLICK_DECLS
  * Print this node's Ethernet address.
  * =h seqno read/write
  * Get/set this node's current sequence number (unsigned int, must be even).
+ * =h ad_stats read-only
+ * Print the number of full, incremental, and triggered ads sent, and the
+ * total bytes they contained.
  *
  * =h paused read/write
  *
@@ -252,6 +265,7 @@ private:
     unsigned int        advertise_ok_jiffies;  // when it is ok to advertise route
     bool                need_seq_ad;
     bool                need_metric_ad;
+    bool                changed_since_full;    // include in incremental ads
     unsigned int        last_expired_jiffies;  // when the route was expired (if broken)
 
 #if ENABLE_SEEN
@@ -282,7 +296,7 @@ private:
     RTEntry() :
       _init(false), is_gateway(false), ttl(0), last_updated_jiffies(0), wst(0),
       last_seq_jiffies(0), advertise_ok_jiffies(0), need_seq_ad(false),
-      need_metric_ad(false), last_expired_jiffies(0)
+      need_metric_ad(false), changed_since_full(false), last_expired_jiffies(0)
     { }
 
     /* constructor for 1-hop route entry, converting from net byte order */
@@ -291,7 +305,7 @@ private:
       RouteEntry(ip, gh->loc_good, gh->loc_err, gh->loc, eth, ip, interface, hlo->seq_no, 1),
       _init(true), dest_eth(eth), is_gateway(hlo->is_gateway), ttl(hlo->ttl), last_updated_jiffies(jiff),
       wst(0), last_seq_jiffies(jiff), advertise_ok_jiffies(0), need_seq_ad(false),
-      need_metric_ad(false), last_expired_jiffies(0)
+      need_metric_ad(false), changed_since_full(false), last_expired_jiffies(0)
     {
       loc_err = ntohs(loc_err);
       _seq_no = ntohl(_seq_no);
@@ -308,7 +322,7 @@ private:
       _init(true), is_gateway(nbr->is_gateway), ttl(nbr->ttl), last_updated_jiffies(jiff),
       wst(0), last_seq_jiffies(0),
       advertise_ok_jiffies(0), need_seq_ad(false), need_metric_ad(false),
-      last_expired_jiffies(nbr->num_hops > 0 ? 0 : jiff)
+      changed_since_full(false), last_expired_jiffies(nbr->num_hops > 0 ? 0 : jiff)
     {
       loc_err = ntohs(loc_err);
       _seq_no = ntohl(_seq_no);
@@ -353,6 +367,7 @@ private:
 
   void insert_route(const RTEntry &, const GridGenericLogger::reason_t why);
   void schedule_triggered_update(const IPAddress &ip, unsigned int when); // when is in jiffies
+  void schedule_trigger_timer();
   bool lookup_route(const IPAddress &dest_ip, RTEntry &entry);
 
 
@@ -377,20 +392,18 @@ private:
   TMap _expire_timers;
   HMap _expire_hooks;
 
-  // Trigger timer invariants: any route may have a timer in this
-  // table.  All timers in the table must be running.  Every entry in
-  // _trigger_timers has a corresponding TimerHook pointer stored in
-  // _trigger_hooks.  Note: a route entry r may have a trigger timer
-  // even if r.need_seq_ad and r.need_metric_ad flags are false.  We
-  // might have sent a full update before r's triggered update timer
-  // expired, but after r.advertise_ok_jiffies: the triggered update
-  // was delayed past r.advertise_ok_jiffies to enforce the minimum
-  // triggered update period.  In that case there may be other
-  // destinations whose triggered updates were cancelled when r's
-  // trigger was delayed, and which should be advertised when r's
-  // triggered update timer finally fires, even if r needn't be.
-  TMap _trigger_timers;
-  HMap _trigger_hooks;
+  // Triggered updates: _trigger_jiffies maps each destination with a
+  // pending triggered update to the time (in jiffies) it is due.  One
+  // timer, _trigger_timer, fires at the earliest due time, but no
+  // sooner than MIN_TRIGGER_PERIOD after the last triggered update;
+  // the ad it sends carries every route that needs advertising by
+  // then.  Trigger timer invariant: _trigger_timer is scheduled iff
+  // _trigger_jiffies is not empty.  Note: a destination may have a
+  // pending trigger even if its need_seq_ad and need_metric_ad flags
+  // are false, e.g. if a full update was sent in the meantime.
+  typedef HashMap<IPAddress, unsigned> JMap;
+  typedef JMap::const_iterator JMIter;
+  JMap _trigger_jiffies;
 
   // check table, timer, and trigger hook invariants
   void check_invariants(const IPAddress *ignore = 0) const;
@@ -402,6 +415,7 @@ private:
   unsigned int _period; // msecs
   unsigned int _jitter; // msecs
   unsigned int _min_triggered_update_period; // msecs
+  unsigned int _full_period; // msecs
 
   GridGatewayInfo *_gw_info;
   GridGenericMetric *_metric;
@@ -428,6 +442,11 @@ private:
   /* track route ads */
   unsigned int _last_periodic_update;  // jiffies
   unsigned int _last_triggered_update; // jiffies
+  unsigned int _last_full_update;      // jiffies
+
+  enum { AD_FULL, AD_INCREMENTAL, AD_TRIGGERED, NAD };
+  unsigned int _ad_count[NAD];
+  unsigned int _ad_bytes[NAD];
 
   /* Keep and propagate route with invalid metrics? */
   bool _ignore_invalid_routes;
@@ -446,16 +465,21 @@ private:
 
   void expire_hook(const IPAddress &);
 
-  static void static_trigger_hook(Timer *, void *v)
-  { ((HookPair *) v)->obj->trigger_hook(((HookPair *) v)->ip); }
-
-  void trigger_hook(const IPAddress &);
+  Timer _trigger_timer;
+  unsigned int _trigger_timer_jiffies; // when _trigger_timer fires
+  static void static_trigger_hook(Timer *, void *e) { ((DSDVRouteTable *) e)->trigger_hook(); }
+  void trigger_hook();
 
   void send_full_update();
-  void send_triggered_update(const IPAddress &);
+  void send_incremental_update();
+  void send_triggered_update();
+
+  /* send route advertisements containing the specified entries, split
+     into as many packets as needed, and mark the entries advertised */
+  void send_ads(const Vector<RTEntry> &, int type);
 
   /* send a route advertisement containing the specified entries */
-  void build_and_tx_ad(Vector<RTEntry> &);
+  void build_and_tx_ad(Vector<RTEntry> &, int type);
   int max_rtes_per_ad() const {
     int hdr_sz = sizeof(click_ether) + sizeof(grid_hdr) + sizeof(grid_hello);
     return ((_mtu - hdr_sz) / sizeof(grid_nbr_entry));
@@ -513,6 +537,7 @@ private:
   static int write_paused(const String &, Element *, void *, ErrorHandler *);
 
   static String print_dump(Element *e, void *);
+  static String print_ad_stats(Element *e, void *);
 
   const metric_t _bad_metric; // default value is ``bad''
 
@@ -24,6 +24,8 @@
 #include <click/straccum.hh>
 #include <click/router.hh>
 #include <click/error.hh>
+#include <click/confparse.hh>
+#include <click/master.hh>
 CLICK_DECLS
 
 
@@ -253,7 +255,7 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
 	    if (!new_tbl)
 		return -ENOMEM;
 	    memcpy(new_tbl, _tbl_24_31, sizeof(uint16_t) * _tbl_24_31_capacity);
-	    memcpy(new_tbl + _tbl_24_31_capacity, _tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
+	    memcpy(new_tbl + 2 * _tbl_24_31_capacity, _tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
 	    CLICK_LFREE(_tbl_24_31, (sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity);
 	    _tbl_24_31 = new_tbl;
 	    _tbl_24_31_plen = (uint8_t *) (new_tbl + 2 * _tbl_24_31_capacity);
@@ -459,10 +461,12 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 		    }
 		}
 		// Check if we can prune the entire secondary table range?
+		// Only if one route of length <= 24 covers all of it; equal
+		// longer lengths can still mean different routes.
 		for (j = sec_i ; j < sec_i + 255; j++)
 		    if (_tbl_24_31_plen[j] != _tbl_24_31_plen[j+1])
 			break;
-		if (j == sec_i + 255) {
+		if (j == sec_i + 255 && _tbl_24_31_plen[sec_i] <= 24) {
 		    // Yup, adjust entries in primary tables...
 		    _tbl_0_23[i] = _tbl_24_31[sec_i];
 		    _tbl_0_23_plen[i] = _tbl_24_31_plen[sec_i];
@@ -488,6 +492,7 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 // DIRECTIPLOOKUP
 
 DirectIPLookup::DirectIPLookup()
+    : _lookup_t(&_t), _update_t(&_t), _shadow(false)
 {
 }
 
@@ -498,17 +503,37 @@ DirectIPLookup::~DirectIPLookup()
 int
 DirectIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 {
+    if (cp_va_kparse_remove_keywords(conf, this, errh,
+				     "SHADOW", 0, cpBool, &_shadow,
+				     cpEnd) < 0)
+	return -1;
+#if !CLICK_USERLEVEL && !CLICK_NS
+    // publish() could not tell when the old copy is free to update
+    if (_shadow)
+	return errh->error("SHADOW is not supported in this driver");
+#endif
+
     int r;
     if ((r = _t.initialize()) < 0)
 	return r;
     _t.flush();
-    return IPRouteTable::configure(conf, errh);
+    if (_shadow) {
+	if ((r = _t2.initialize()) < 0)
+	    return r;
+	_t2.flush();
+	_lookup_t = &_t2;
+    }
+    r = IPRouteTable::configure(conf, errh);
+    publish();
+    return r;
 }
 
 void
 DirectIPLookup::cleanup(CleanupStage)
 {
     _t.cleanup();
+    _t2.cleanup();
+    _log.clear();
 }
 
 void
@@ -528,26 +553,114 @@ DirectIPLookup::push(int, Packet *p)
 int
 DirectIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
+    const Table *t = _lookup_t;
     uint32_t ip_addr = ntohl(dest.addr());
-    uint16_t vport_i = _t._tbl_0_23[ip_addr >> 8];
+    uint16_t vport_i = t->_tbl_0_23[ip_addr >> 8];
 
     if (vport_i & 0x8000)
-        vport_i = _t._tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
+        vport_i = t->_tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
 
-    gw = _t._vport[vport_i].gw;
-    return _t._vport[vport_i].port;
+    gw = t->_vport[vport_i].gw;
+    return t->_vport[vport_i].port;
+}
+
+void
+DirectIPLookup::lookup_route_batch(const IPAddress *dest, IPAddress *gw, int *port, int n) const
+{
+    // Run the lookups in stages.  Each stage prefetches what the next stage
+    // of every lookup will read, so the batch's cache misses overlap rather
+    // than stalling one after another.
+    const Table *t = _lookup_t;
+    uint32_t ip_addr[BATCH_MAX];
+    uint16_t vport_i[BATCH_MAX];
+    int i;
+
+    for (i = 0; i < n; i++) {
+	ip_addr[i] = ntohl(dest[i].addr());
+	click_prefetch0(&t->_tbl_0_23[ip_addr[i] >> 8]);
+    }
+
+    for (i = 0; i < n; i++) {
+	vport_i[i] = t->_tbl_0_23[ip_addr[i] >> 8];
+	if (vport_i[i] & 0x8000)
+	    click_prefetch0(&t->_tbl_24_31[((vport_i[i] & 0x7fff) << 8) | (ip_addr[i] & 0xff)]);
+	else
+	    click_prefetch0(&t->_vport[vport_i[i]]);
+    }
+
+    for (i = 0; i < n; i++)
+	if (vport_i[i] & 0x8000) {
+	    vport_i[i] = t->_tbl_24_31[((vport_i[i] & 0x7fff) << 8) | (ip_addr[i] & 0xff)];
+	    click_prefetch0(&t->_vport[vport_i[i]]);
+	}
+
+    for (i = 0; i < n; i++) {
+	gw[i] = t->_vport[vport_i[i]].gw;
+	port[i] = t->_vport[vport_i[i]].port;
+    }
+}
+
+inline void
+DirectIPLookup::log(int command, const IPRoute &route)
+{
+    if (_shadow) {
+	_log.push_back(route);
+	_log.back().extra = command;
+    }
 }
 
 int
 DirectIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.add_route(route, allow_replace, old_route, errh);
+    int r = _update_t->add_route(route, allow_replace, old_route, errh);
+    if (r >= 0)
+	log(allow_replace ? LOG_SET : LOG_ADD, route);
+    return r;
 }
 
 int
 DirectIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.remove_route(route, old_route, errh);
+    int r = _update_t->remove_route(route, old_route, errh);
+    if (r >= 0)
+	log(LOG_REMOVE, route);
+    return r;
+}
+
+/** @brief Make changes to the update copy visible to lookups.
+ *
+ * With SHADOW, swaps the lookup and update copies, waits until no thread
+ * can still be reading the old lookup copy, and then brings that copy up to
+ * date from the log.  Does nothing otherwise. */
+void
+DirectIPLookup::publish()
+{
+    if (!_log.size())
+	return;
+
+    click_write_fence();
+    Table *old_lookup_t = _lookup_t;
+    _lookup_t = _update_t;
+    _update_t = old_lookup_t;
+    bool synchronized = master()->synchronize_threads();
+    assert(synchronized);
+    (void) synchronized;
+
+    ErrorHandler *errh = ErrorHandler::silent_handler();
+    for (IPRoute *r = _log.begin(); r != _log.end(); ++r) {
+	int result;
+	if (r->extra == LOG_FLUSH) {
+	    _update_t->flush();
+	    result = 0;
+	} else if (r->extra == LOG_REMOVE)
+	    result = _update_t->remove_route(*r, 0, errh);
+	else
+	    result = _update_t->add_route(*r, r->extra == LOG_SET, 0, errh);
+	if (result < 0)
+	    click_chatter("%s: shadow table out of sync at %s",
+			  declaration().c_str(), r->unparse().c_str());
+    }
+    _log.clear();
 }
 
 int
@@ -555,14 +668,42 @@ DirectIPLookup::flush_handler(const String &, Element *e, void *,
 				ErrorHandler *)
 {
     DirectIPLookup *t = static_cast<DirectIPLookup *>(e);
-    t->_t.flush();
+    t->_update_t->flush();
+    t->log(LOG_FLUSH, IPRoute());
+    t->publish();
     return 0;
 }
 
+enum { H_ADD, H_SET, H_REMOVE, H_CTRL, H_PUBLISH };
+
+int
+DirectIPLookup::update_handler(const String &str, Element *e, void *thunk,
+			       ErrorHandler *errh)
+{
+    DirectIPLookup *t = static_cast<DirectIPLookup *>(e);
+    int r = 0;
+    switch ((intptr_t) thunk) {
+      case H_ADD:
+	r = add_route_handler(str, e, 0, errh);
+	break;
+      case H_SET:
+	r = add_route_handler(str, e, (void *) 1, errh);
+	break;
+      case H_REMOVE:
+	r = remove_route_handler(str, e, 0, errh);
+	break;
+      case H_CTRL:
+	r = ctrl_handler(str, e, 0, errh);
+	break;
+    }
+    t->publish();
+    return r;
+}
+
 String
 DirectIPLookup::dump_routes()
 {
-    return _t.dump();
+    return _update_t->dump();
 }
 
 void
@@ -570,6 +711,13 @@ DirectIPLookup::add_handlers()
 {
     IPRouteTable::add_handlers();
     add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+    add_write_handler("publish", update_handler, (void *) H_PUBLISH, Handler::BUTTON);
+    if (_shadow) {
+	add_write_handler("add", update_handler, (void *) H_ADD);
+	add_write_handler("set", update_handler, (void *) H_SET);
+	add_write_handler("remove", update_handler, (void *) H_REMOVE);
+	add_write_handler("ctrl", update_handler, (void *) H_CTRL);
+    }
 }
 
 CLICK_ENDDECLS
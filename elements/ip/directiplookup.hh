@@ -7,7 +7,7 @@ CLICK_DECLS
 /*
 =c
 
-DirectIPLookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ...)
+DirectIPLookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ..., [SHADOW])
 
 =s iproute
 
@@ -20,6 +20,10 @@ address in its routing table, using longest-prefix-match, sets the destination
 annotation to the corresponding GW (if specified), and emits the packet on the
 indicated OUTput port.
 
+The input may be push or pull.  When it is pull, DirectIPLookup pulls up to
+32 packets at a time and interleaves their lookups, so the DRAM accesses of
+different packets overlap instead of stalling in turn.
+
 Each argument is a route, specifying a destination and mask, an optional
 gateway IP address, and an output port.  No destination-mask pair should occur
 more than once.
@@ -33,6 +37,29 @@ relatively low CPU overhead, allowing for high update rates.
 DirectIPLookup implements the I<DIR-24-8-BASIC> lookup scheme described by
 Gupta, Lin, and McKeown in the paper cited below.
 
+Keyword arguments are:
+
+=over 8
+
+=item SHADOW
+
+Boolean.  If true, keep two copies of the lookup tables so that routes can
+change while other threads look up packets.  Lookups read one copy while
+handlers change the other; when a write handler returns, the copies swap
+roles with a single pointer store, and the changes are replayed on the old
+copy once every thread has left it.  Lookups never wait, and they see each
+handler's changes all at once, so a `C<ctrl>' write is atomic for packets too.
+This doubles DirectIPLookup's memory use.  SHADOW is available only at user
+level; the kernel drivers cannot tell when every thread has left a copy, so
+there the option is an error.  Default is false, which updates the single
+copy in place; that is safe only when lookups and updates run in the same
+thread.
+
+=back
+
+With SHADOW, routes added by other elements calling B<add_route> or
+B<remove_route> directly take effect at the next write to a handler.  Updates must not be made from several threads at once.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -65,6 +92,12 @@ operation.
 
 Clears the entire routing table in a single atomic operation.
 
+=h publish write-only
+
+With SHADOW, makes pending changes visible to lookups.  Write handlers do
+this themselves; use it after other elements have called B<add_route> or
+B<remove_route> directly.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
@@ -91,7 +124,7 @@ class DirectIPLookup : public IPRouteTable { public:
 
     const char *class_name() const	{ return "DirectIPLookup"; }
     const char *port_count() const	{ return "1/-"; }
-    const char *processing() const	{ return PUSH; }
+    const char *processing() const	{ return "a/h"; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
     void cleanup(CleanupStage stage);
@@ -102,9 +135,13 @@ class DirectIPLookup : public IPRouteTable { public:
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_route_batch(const IPAddress*, IPAddress*, int*, int) const;
     String dump_routes();
 
+    void publish();
+
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+    static int update_handler(const String &, Element *, void *, ErrorHandler *);
 
     enum {
 	RT_SIZE_MAX = 256 * 1024, // accomodate a full BGP view and more
@@ -184,6 +221,16 @@ class DirectIPLookup : public IPRouteTable { public:
   protected:
 
     Table _t;
+    Table _t2;			// second copy, allocated only with SHADOW
+    Table * volatile _lookup_t;	// copy read by lookups
+    Table *_update_t;		// copy changed by add_route/remove_route
+    bool _shadow;
+
+    // Changes made to _update_t but not yet to the other copy.  The route's
+    // extra field holds the LOG_ command.
+    enum { LOG_ADD, LOG_SET, LOG_REMOVE, LOG_FLUSH };
+    Vector<IPRoute> _log;
+    void log(int command, const IPRoute &route);
 
     friend class RangeIPLookup;
 
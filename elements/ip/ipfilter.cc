@@ -167,6 +167,15 @@ IPFilter::~IPFilter()
 {
 }
 
+void *
+IPFilter::cast(const char *n)
+{
+  if (strcmp(n, "IPFilter") == 0)
+    return (IPFilter *)this;
+  else
+    return Classifier::cast(n);
+}
+
 //
 // CONFIGURATION
 //
@@ -1073,6 +1082,63 @@ IPFilter::parse_factor(const Vector<String> &words, int pos,
   return pos;
 }
 
+int
+IPFilter::parse_rule(const String &text, int argno, Vector<int> &tree,
+		     ErrorHandler *errh)
+{
+  Vector<String> words;
+  separate_text(cp_unquote(text), words);
+
+  if (words.size() == 0) {
+    errh->error("empty pattern %d", argno);
+    return -1;
+  }
+
+  PrefixErrorHandler cerrh(errh, "pattern " + String(argno) + ": ");
+
+  // get slot
+  int slot = noutputs();
+  {
+    String slotwd = words[0];
+    if (slotwd == "allow") {
+      slot = 0;
+      if (noutputs() == 0)
+	cerrh.error("'allow' is meaningless, element has zero outputs");
+    } else if (slotwd == "deny") {
+      slot = noutputs();
+      if (noutputs() > 1)
+	cerrh.warning("meaning of 'deny' has changed (now it means 'drop')");
+    } else if (slotwd == "drop")
+      slot = noutputs();
+    else if (cp_integer(slotwd, &slot)) {
+      if (slot < 0 || slot >= noutputs()) {
+	cerrh.error("slot '%d' out of range", slot);
+	slot = noutputs();
+      }
+    } else
+      cerrh.error("unknown slot ID '%s'", slotwd.c_str());
+  }
+
+  start_expr_subtree(tree);
+
+  // check for "-"
+  if (words.size() == 1 || (words.size() == 2 && words[1] == "-")
+      || (words.size() == 2 && words[1] == "any")
+      || (words.size() == 2 && words[1] == "all"))
+    add_expr(tree, 0, 0, 0);
+
+  else {
+    // start with a blank primitive
+    Primitive prev_prim;
+
+    int pos = parse_expr(words, 1, tree, prev_prim, &cerrh);
+    if (pos < words.size())
+      cerrh.error("garbage after expression at '%s'", words[pos].c_str());
+  }
+
+  return slot;
+}
+
 int
 IPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -1089,57 +1155,9 @@ IPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
   // QUALS ::= src | dst | src and dst | src or dst | \empty
   //        |  ip | icmp | tcp | udp
   for (int argno = 0; argno < conf.size(); argno++) {
-    Vector<String> words;
-    separate_text(cp_unquote(conf[argno]), words);
-
-    if (words.size() == 0) {
-      errh->error("empty pattern %d", argno);
-      continue;
-    }
-
-    PrefixErrorHandler cerrh(errh, "pattern " + String(argno) + ": ");
-
-    // get slot
-    int slot = noutputs();
-    {
-      String slotwd = words[0];
-      if (slotwd == "allow") {
-	slot = 0;
-	if (noutputs() == 0)
-	  cerrh.error("'allow' is meaningless, element has zero outputs");
-      } else if (slotwd == "deny") {
-	slot = noutputs();
-	if (noutputs() > 1)
-	  cerrh.warning("meaning of 'deny' has changed (now it means 'drop')");
-      } else if (slotwd == "drop")
-	slot = noutputs();
-      else if (cp_integer(slotwd, &slot)) {
-	if (slot < 0 || slot >= noutputs()) {
-	  cerrh.error("slot '%d' out of range", slot);
-	  slot = noutputs();
-	}
-      } else
-	cerrh.error("unknown slot ID '%s'", slotwd.c_str());
-    }
-
-    start_expr_subtree(tree);
-
-    // check for "-"
-    if (words.size() == 1 || (words.size() == 2 && words[1] == "-")
-	|| (words.size() == 2 && words[1] == "any")
-	|| (words.size() == 2 && words[1] == "all"))
-      add_expr(tree, 0, 0, 0);
-
-    else {
-      // start with a blank primitive
-      Primitive prev_prim;
-
-      int pos = parse_expr(words, 1, tree, prev_prim, &cerrh);
-      if (pos < words.size())
-	cerrh.error("garbage after expression at '%s'", words[pos].c_str());
-    }
-
-    finish_expr_subtree(tree, C_AND, -slot);
+    int slot = parse_rule(conf[argno], argno, tree, errh);
+    if (slot >= 0)
+      finish_expr_subtree(tree, C_AND, -slot);
   }
 
   if (tree.size())
@@ -1152,6 +1170,7 @@ IPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
   // It helps to do another bubblesort for things like ports.
   bubble_sort_and_exprs();
   compress_exprs(_prog, PERFORM_BINARY_SEARCH, MIN_BINARY_SEARCH);
+  specialize_exprs(TRANSP_FAKE_OFFSET);
 
   //{ String sxx = program_string(this, 0); click_chatter("%s", sxx.c_str()); }
   return (errh->nerrors() == before_nerrors ? 0 : -1);
@@ -1202,8 +1221,8 @@ IPFilter::add_handlers()
 // RUNNING
 //
 
-void
-IPFilter::length_checked_push(Packet *p)
+int
+IPFilter::length_checked_match(const Packet *p) const
 {
   const unsigned char *neth_data = p->network_header();
   const unsigned char *transph_data = p->transport_header();
@@ -1247,10 +1266,8 @@ IPFilter::length_checked_push(Packet *p)
     failure:
       off = pr[1];
     gotit:
-      if (off <= 0) {
-	  checked_output_push(-off, p);
-	  return;
-      }
+      if (off <= 0)
+	  return -off;
       pr += off;
       continue;
 
@@ -1267,22 +1284,16 @@ IPFilter::length_checked_push(Packet *p)
   }
 }
 
-void
-IPFilter::push(int, Packet *p)
+int
+IPFilter::match_interpreted(const Packet *p) const
 {
   const unsigned char *neth_data = p->network_header();
   const unsigned char *transph_data = p->transport_header();
 
-  if (_output_everything >= 0) {
-    // must use checked_output_push because the output number might be
-    // out of range
-    checked_output_push(_output_everything, p);
-    return;
-  } else if (p->length() + TRANSP_FAKE_OFFSET - p->transport_header_offset() < _safe_length) {
-    // common case never checks packet length
-    length_checked_push(p);
-    return;
-  }
+  if (_output_everything >= 0)
+    return _output_everything;
+  else if (p->length() + TRANSP_FAKE_OFFSET - p->transport_header_offset() < _safe_length)
+    return length_checked_match(p);
 
   const uint32_t *pr = _prog.begin();
   const uint32_t *pp;
@@ -1317,14 +1328,32 @@ IPFilter::push(int, Packet *p)
       }
       off = pr[1];
     gotit:
-      if (off <= 0) {
-	  checked_output_push(-off, p);
-	  return;
-      }
+      if (off <= 0)
+	  return -off;
       pr += off;
   }
 }
 
+int
+IPFilter::match(const Packet *p) const
+{
+  if (_output_everything >= 0)
+    return _output_everything;
+  else if (p->length() + TRANSP_FAKE_OFFSET - p->transport_header_offset() < _safe_length)
+    // common case never checks packet length
+    return length_checked_match(p);
+  return spec_match(p->network_header(),
+		    p->transport_header() - TRANSP_FAKE_OFFSET);
+}
+
+void
+IPFilter::push(int, Packet *p)
+{
+  // must use checked_output_push because the output number might be out of
+  // range
+  checked_output_push(IPFilter::match(p), p);
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(Classifier)
 EXPORT_ELEMENT(IPFilter)
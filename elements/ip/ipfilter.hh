@@ -107,6 +107,11 @@ is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
 classifier pattern.
 
+=h specialized_program read-only
+Returns a human-readable definition of the specialized form of the program,
+which IPFilter runs on packets at least as long as the safe length.  See
+Classifier for details.
+
 =a
 
 IPClassifier, Classifier, CheckIPHeader, MarkIPHeader, CheckIPHeader2,
@@ -126,10 +131,13 @@ class IPFilter : public Classifier { public:
   // this element does not need AlignmentInfo; override Classifier's "A" flag
   const char *flags() const			{ return ""; }
 
+    void *cast(const char *);
     int configure(Vector<String> &, ErrorHandler *);
     void add_handlers();
 
     void push(int port, Packet *);
+    int match(const Packet *) const;
+    int match_interpreted(const Packet *) const;
 
     static String compressed_program_string(Element *, void *);
 
@@ -239,6 +247,14 @@ class IPFilter : public Classifier { public:
 
   };
 
+ protected:
+
+  // Parses an "ACTION PATTERN" argument, adding PATTERN's Exprs to 'tree' as
+  // an unfinished subtree.  Returns ACTION's output port (noutputs() means
+  // drop), or -1 if the argument is empty.
+  int parse_rule(const String &text, int argno, Vector<int> &tree,
+		 ErrorHandler *errh);
+
  private:
 
   Vector<uint32_t> _prog;
@@ -254,7 +270,7 @@ class IPFilter : public Classifier { public:
   int parse_factor(const Vector<String> &, int, Vector<int> &, Primitive &,
 		 bool negated, ErrorHandler *);
 
-  void length_checked_push(Packet *);
+  int length_checked_match(const Packet *) const;
 
 };
 
@@ -26,10 +26,11 @@
 CLICK_DECLS
 
 IPFragmenter::IPFragmenter()
-    : _honor_df(true), _verbose(false), _mtu(0)
+    : _honor_df(true), _verbose(false), _zerocopy(false), _mtu(0)
 {
     _fragments = 0;
     _drops = 0;
+    _bytes_copied = 0;
 }
 
 IPFragmenter::~IPFragmenter()
@@ -44,6 +45,7 @@ IPFragmenter::configure(Vector<String> &conf, ErrorHandler *errh)
 		     "MTU", cpkP+cpkM, cpUnsigned, &_mtu,
 		     "HONOR_DF", cpkP, cpBool, &_honor_df,
 		     "VERBOSE", cpkP, cpBool, &_verbose,
+		     "ZEROCOPY", 0, cpBool, &_zerocopy,
 		     cpEnd) < 0)
 	return -1;
     if (_mtu < 8)
@@ -64,13 +66,14 @@ IPFragmenter::optcopy(const click_ip *ip1, click_ip *ip2)
 	if (opt == IPOPT_NOP)
 	    optlen = 1;
 	else if (opt == IPOPT_EOL || i == opts_len - 1
-		 || i + (optlen = oin[i+1]) > opts_len)
+		 || (optlen = oin[i+1]) < 2 || i + optlen > opts_len)
 	    break;
 	if (opt & 0x80) {	// copy the option
 	    if (ip2)
 		memcpy(oout + outpos, oin + i, optlen);
 	    outpos += optlen;
 	}
+	i += optlen;
     }
 
     for (; (outpos & 3) != 0; outpos++)
@@ -80,6 +83,21 @@ IPFragmenter::optcopy(const click_ip *ip1, click_ip *ip2)
     return outpos;
 }
 
+void
+IPFragmenter::make_header(const click_ip *ip, click_ip *qip, int out_hlen,
+			  int off, int out_dlen, bool last)
+{
+    memcpy(qip, ip, sizeof(click_ip));
+    optcopy(ip, qip);
+    qip->ip_hl = out_hlen >> 2;
+    qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
+    if (last)
+	qip->ip_off &= ~htons(IP_MF);
+    qip->ip_len = htons(out_hlen + out_dlen);
+    qip->ip_sum = 0;
+    qip->ip_sum = click_in_cksum((const unsigned char *)qip, out_hlen);
+}
+
 void
 IPFragmenter::fragment(Packet *p_in)
 {
@@ -96,13 +114,13 @@ IPFragmenter::fragment(Packet *p_in)
 	return;
     }
 
-    // make sure we can modify the packet
-    WritablePacket *p = p_in->uniqueify();
-    if (!p)
-	return;
-    click_ip *ip = p->ip_header();
-
-    // output the first fragment
+    // build the first fragment's header; later headers are based on it
+    union {
+	click_ip ip;
+	unsigned char c[60];
+    } hbuf;
+    click_ip *ip = &hbuf.ip;
+    memcpy(ip, ip_in, hlen);
     // If we're cheating the DF bit, we can't trust the ip_id; set to random.
     if (ip->ip_off & htons(IP_DF)) {
 	ip->ip_id = click_random();
@@ -113,39 +131,65 @@ IPFragmenter::fragment(Packet *p_in)
     ip->ip_off |= htons(IP_MF);
     ip->ip_sum = 0;
     ip->ip_sum = click_in_cksum((const unsigned char *)ip, hlen);
-    Packet *first_fragment = p->clone();
-    first_fragment->take(p->length() - p->network_header_offset() - hlen - first_dlen);
-    output(0).push(first_fragment);
-    _fragments++;
+
+    // Fragments can share the input's data only if we may write into it.
+    // Otherwise copy each fragment's data, rather than uniqueifying the
+    // whole input and then copying most of it again.
+    WritablePacket *p = (p_in->shared() ? 0 : p_in->uniqueify());
+    int first_len = p_in->network_header_offset() + hlen + first_dlen;
+
+    // output the first fragment
+    if (p) {
+	memcpy(p->ip_header(), ip, hlen);
+	Packet *first_fragment = p->clone();
+	if (first_fragment) {
+	    first_fragment->take(p->length() - first_len);
+	    output(0).push(first_fragment);
+	    _fragments++;
+	}
+    } else if (WritablePacket *q = Packet::make(p_in->headroom(), p_in->data(), first_len, 0)) {
+	q->copy_annotations(p_in);
+	if (p_in->has_mac_header())
+	    q->set_mac_header(q->data() + p_in->mac_header_offset());
+	q->set_network_header(q->data() + p_in->network_header_offset(), hlen);
+	memcpy(q->ip_header(), ip, hlen);
+	_bytes_copied += first_len - hlen;
+	output(0).push(q);
+	_fragments++;
+    }
 
     // output the remaining fragments
     int out_hlen = sizeof(click_ip) + optcopy(ip, 0);
-
-    for (int off = first_dlen; off < in_dlen; ) {
-	// prepare packet
-	int out_dlen = (_mtu - out_hlen) & ~7;
+    int out_maxdlen = (_mtu - out_hlen) & ~7;
+    // A header written in place must fit within the previous fragment's
+    // data, which was copied.
+    bool in_place_ok = p && _zerocopy && out_maxdlen >= out_hlen;
+    const unsigned char *in_data = p_in->transport_header();
+
+    for (int off = first_dlen, k = 1; off < in_dlen; k++) {
+	int out_dlen = out_maxdlen;
 	if (out_dlen + off > in_dlen)
 	    out_dlen = in_dlen - off;
-
-	WritablePacket *q = Packet::make(out_hlen + out_dlen);
-	if (q) {
+	bool last = out_dlen + off >= in_dlen && !had_mf;
+
+	if (in_place_ok && (k & 1) == 0) {
+	    // write the header over the end of the previous fragment's data
+	    click_ip *qip = reinterpret_cast<click_ip *>(p->transport_header() + off - out_hlen);
+	    make_header(ip, qip, out_hlen, off, out_dlen, last);
+	    if (Packet *q = p->clone()) {
+		q->pull(reinterpret_cast<unsigned char *>(qip) - q->data());
+		q->take(q->length() - out_hlen - out_dlen);
+		q->clear_mac_header();
+		q->set_network_header(q->data(), out_hlen);
+		output(0).push(q);
+		_fragments++;
+	    }
+	} else if (WritablePacket *q = Packet::make(out_hlen + out_dlen)) {
 	    q->set_network_header(q->data(), out_hlen);
-	    click_ip *qip = q->ip_header();
-
-	    memcpy(qip, ip, sizeof(click_ip));
-	    optcopy(ip, qip);
-	    memcpy(q->transport_header(), p->transport_header() + off, out_dlen);
-
-	    qip->ip_hl = out_hlen >> 2;
-	    qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
-	    if (out_dlen + off >= in_dlen && !had_mf)
-		qip->ip_off &= ~htons(IP_MF);
-	    qip->ip_len = htons(out_hlen + out_dlen);
-	    qip->ip_sum = 0;
-	    qip->ip_sum = click_in_cksum((const unsigned char *)qip, out_hlen);
-
-	    q->copy_annotations(p);
-
+	    make_header(ip, q->ip_header(), out_hlen, off, out_dlen, last);
+	    memcpy(q->transport_header(), in_data + off, out_dlen);
+	    _bytes_copied += out_dlen;
+	    q->copy_annotations(p_in);
 	    output(0).push(q);
 	    _fragments++;
 	}
@@ -153,7 +197,7 @@ IPFragmenter::fragment(Packet *p_in)
 	off += out_dlen;
     }
 
-    p->kill();
+    p_in->kill();
 }
 
 void
@@ -170,6 +214,7 @@ IPFragmenter::add_handlers()
 {
     add_data_handlers("drops", Handler::OP_READ, &_drops);
     add_data_handlers("fragments", Handler::OP_READ, &_fragments);
+    add_data_handlers("bytes_copied", Handler::OP_READ, &_bytes_copied);
 }
 
 CLICK_ENDDECLS
@@ -7,7 +7,7 @@ CLICK_DECLS
 
 /*
  * =c
- * IPFragmenter(MTU, [I<keywords> HONOR_DF, VERBOSE])
+ * IPFragmenter(MTU, [I<keywords> HONOR_DF, VERBOSE, ZEROCOPY])
  * =s ip
  * fragments large IP packets
  * =d
@@ -28,6 +28,10 @@ CLICK_DECLS
  * IPFragmenter, since any MAC header is not copied to second and subsequent
  * fragments.
  *
+ * The first fragment shares the input packet's data unless the input packet
+ * is itself shared, in which case every fragment gets its own copy of its
+ * data.  No fragment's data is ever copied twice.
+ *
  * Keyword arguments are:
  *
  * =over 8
@@ -43,6 +47,29 @@ CLICK_DECLS
  * packet with DF; otherwise, it will print a message only the first 5 times.
  * Default is false.
  *
+ * =item ZEROCOPY
+ *
+ * Boolean.  If true, every second fragment after the first also shares the
+ * input packet's data: its IP header is written over the end of the previous
+ * fragment's data, which has already been copied into its own packet.  This
+ * roughly halves the bytes copied per packet.  The fragments are clones of one
+ * another, so an element that later modifies one of them makes a copy first.
+ * Has no effect on shared input packets.  Default is false.
+ *
+ * =back
+ *
+ * =h fragments read-only
+ *
+ * Returns the number of fragments emitted.
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that could not be fragmented.
+ *
+ * =h bytes_copied read-only
+ *
+ * Returns the number of bytes copied from input packets into fragments.
+ *
  * =e
  *   ... -> fr::IPFragmenter(1024) -> Queue(20) -> ...
  *   fr[1] -> ICMPError(18.26.4.24, 3, 4) -> ...
@@ -71,12 +98,16 @@ class IPFragmenter : public Element { public:
 
   bool _honor_df;
   bool _verbose;
+  bool _zerocopy;
   unsigned _mtu;
   atomic_uint32_t _drops;
   atomic_uint32_t _fragments;
+  atomic_uint32_t _bytes_copied;
 
   void fragment(Packet *);
   int optcopy(const click_ip *ip1, click_ip *ip2);
+  void make_header(const click_ip *ip, click_ip *qip, int out_hlen,
+		   int off, int out_dlen, bool last);
 
 };
 
@@ -36,8 +36,10 @@ CLICK_DECLS
 
 IPReassembler::IPReassembler()
 {
-    for (int i = 0; i < NMAP; i++)
+    for (int i = 0; i < NMAP; i++) {
 	_map[i] = 0;
+	_chains[i] = 0;
+    }
     static_assert(sizeof(ChunkLink) == IPREASSEMBLER_ANNO_SIZE);
 }
 
@@ -49,8 +51,12 @@ int
 IPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _mem_high_thresh = 256 * 1024;
+    _mem_datagram_thresh = 0;
+    _chain = false;
     if (cp_va_kparse(conf, this, errh,
 		     "HIMEM", 0, cpUnsigned, &_mem_high_thresh,
+		     "DATAGRAM_HIMEM", 0, cpUnsigned, &_mem_datagram_thresh,
+		     "CHAIN", 0, cpBool, &_chain,
 		     cpEnd) < 0)
 	return -1;
     _mem_low_thresh = (_mem_high_thresh >> 2) * 3;
@@ -62,6 +68,8 @@ IPReassembler::initialize(ErrorHandler *)
 {
     _mem_used = 0;
     _reap_time = 0;
+    _bytes_copied = 0;
+    _drops = 0;
     return 0;
 }
 
@@ -74,6 +82,15 @@ IPReassembler::cleanup(CleanupStage)
 	    _map[i]->kill();
 	    _map[i] = next;
 	}
+    for (int i = 0; i < NMAP; i++)
+	while (Chain *c = _chains[i]) {
+	    _chains[i] = c->next;
+	    while (Packet *f = c->head) {
+		c->head = f->next();
+		f->kill();
+	    }
+	    _chain_alloc.deallocate(c);
+	}
 }
 
 void
@@ -131,6 +148,25 @@ IPReassembler::check(ErrorHandler *errh)
 		}
 	    } else
 		errh->error("buck %d: missing IP header", b);
+    for (int b = 0; b < NMAP; b++)
+	for (Chain *c = _chains[b]; c; c = c->next) {
+	    uint32_t mem = 0, covered = 0;
+	    int off = -1;
+	    for (Packet *f = c->head; f; f = f->next()) {
+		ChunkLink &ch = PACKET_CHUNK(f);
+		if (bucketno(f->ip_header()) != b)
+		    check_error(errh, b, f, "in wrong bucket");
+		if (ch.off >= ch.lastoff || (int) ch.off < off
+		    || (c->total && ch.lastoff > c->total))
+		    check_error(errh, b, f, "bad fragment (%d, %d) at %d", ch.off, ch.lastoff, off);
+		off = ch.lastoff;
+		mem += IPH_MEM_USED + ch.lastoff - ch.off;
+		covered += ch.lastoff - ch.off;
+	    }
+	    if (mem != c->mem || covered != c->covered)
+		errh->error("buck %d: bad chain totals", b);
+	    mem_used += mem;
+	}
     if (mem_used != _mem_used)
 	errh->error("bad mem_used: have %u, claim %u", mem_used, _mem_used);
     return 0;
@@ -189,6 +225,7 @@ IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
 	return;
     }
     _mem_used += IPH_MEM_USED + p_lastoff;
+    _bytes_copied += PACKET_DLEN(p);
 
     // copy IP header and annotations if appropriate
     q->set_ip_header((click_ip *)q->data(), hl);
@@ -257,6 +294,17 @@ IPReassembler::simple_action(Packet *p)
     if (_mem_used > _mem_high_thresh)
 	reap_overfull(now);
 
+    if (_chain)
+	return chain_fragment(p, p_off, p_lastoff, now);
+
+    // drop fragments that would make their datagram too large
+    if (_mem_datagram_thresh
+	&& (uint32_t) (IPH_MEM_USED + p_lastoff) > _mem_datagram_thresh) {
+	_drops++;
+	p->kill();
+	return 0;
+    }
+
     // get its Packet queue
     WritablePacket **q_pprev;
     WritablePacket *q = find_queue(p, &q_pprev);
@@ -284,6 +332,8 @@ IPReassembler::simple_action(Packet *p)
 	if (iph->ip_off & htons(IP_MF))
 	    want_space += (p_lastoff - p_off);
 	// request space
+	if (q->tailroom() < (uint32_t) want_space)
+	    _bytes_copied += q->buffer_length();
 	if (!(q = q->put(want_space))) {
 	    click_chatter("out of memory");
 	    *q_pprev = q_bucket_next;
@@ -321,6 +371,7 @@ IPReassembler::simple_action(Packet *p)
 
     // copy p's data into q
     memcpy(q->transport_header() + p_off, p->transport_header(), p_lastoff - p_off);
+    _bytes_copied += p_lastoff - p_off;
 
     // copy p's annotations and IP header if it is the first packet
     if (p_off == 0) {
@@ -353,6 +404,202 @@ IPReassembler::simple_action(Packet *p)
     return 0;
 }
 
+Packet *
+IPReassembler::chain_fragment(Packet *p, int p_off, int p_lastoff, int now)
+{
+    const click_ip *iph = p->ip_header();
+    int bucket = bucketno(iph);
+    Chain **pprev = &_chains[bucket];
+    Chain *c;
+    for (c = *pprev; c; pprev = &c->next, c = *pprev)
+	if (same_segment(iph, c->head->ip_header()))
+	    break;
+
+    // drop fragments inconsistent with the datagram's known length, last
+    // fragments that end before data already held, and fragments that would
+    // make the datagram too large
+    bool mf = (iph->ip_off & htons(IP_MF)) != 0;
+    if (c && c->total
+	&& ((uint32_t) p_lastoff > c->total
+	    || (!mf && (uint32_t) p_lastoff != c->total))) {
+	p->kill();
+	return 0;
+    }
+    if (c && !c->total && !mf && c->head) {
+	Packet *f = c->head;
+	while (f->next())
+	    f = f->next();
+	if (PACKET_CHUNK(f).lastoff > p_lastoff) {
+	    p->kill();
+	    return 0;
+	}
+    }
+    if (_mem_datagram_thresh
+	&& (c ? c->mem : 0) + IPH_MEM_USED + p_lastoff - p_off > _mem_datagram_thresh) {
+	_drops++;
+	p->kill();
+	return 0;
+    }
+
+    if (!c) {
+	if (!(c = reinterpret_cast<Chain *>(_chain_alloc.allocate()))) {
+	    click_chatter("out of memory");
+	    p->kill();
+	    return 0;
+	}
+	c->next = _chains[bucket];
+	c->head = 0;
+	c->mem = c->covered = c->total = 0;
+	_chains[bucket] = c;
+	pprev = &_chains[bucket];
+    }
+    c->sec = now;
+    if (!mf)
+	c->total = p_lastoff;
+
+    // Find where p goes.  Where p overlaps earlier data, the earlier data
+    // wins, except that p replaces fragments it covers entirely.  A
+    // fragment's data is the last (lastoff - off) bytes of the packet.
+    Packet **fprev = &c->head;
+    while (*fprev && PACKET_CHUNK(*fprev).lastoff <= p_off)
+	fprev = &(*fprev)->next();
+    if (*fprev && PACKET_CHUNK(*fprev).off <= p_off) {
+	p_off = PACKET_CHUNK(*fprev).lastoff;
+	fprev = &(*fprev)->next();
+    }
+    while (Packet *f = *fprev) {
+	ChunkLink &ch = PACKET_CHUNK(f);
+	if (ch.lastoff > p_lastoff || p_off >= p_lastoff)
+	    break;
+	*fprev = f->next();
+	c->mem -= IPH_MEM_USED + ch.lastoff - ch.off;
+	_mem_used -= IPH_MEM_USED + ch.lastoff - ch.off;
+	c->covered -= ch.lastoff - ch.off;
+	f->kill();
+    }
+    if (*fprev && PACKET_CHUNK(*fprev).off < p_lastoff) {
+	p->take(p_lastoff - PACKET_CHUNK(*fprev).off);
+	p_lastoff = PACKET_CHUNK(*fprev).off;
+    }
+    if (p_off >= p_lastoff) {	// nothing new
+	p->kill();
+	return 0;
+    }
+
+    PACKET_CHUNK(p).off = p_off;
+    PACKET_CHUNK(p).lastoff = p_lastoff;
+    p->set_next(*fprev);
+    *fprev = p;
+    c->mem += IPH_MEM_USED + p_lastoff - p_off;
+    _mem_used += IPH_MEM_USED + p_lastoff - p_off;
+    c->covered += p_lastoff - p_off;
+
+    // Are we done with this datagram?
+    if (c->total && c->covered == c->total) {
+	*pprev = c->next;
+	_mem_used -= c->mem;
+	Timestamp ts = p->timestamp_anno();
+	Packet *q = linearize_chain(c, true);
+	_chain_alloc.deallocate(c);
+	if (q)
+	    q->set_timestamp_anno(ts);
+	return q;
+    }
+    return 0;
+}
+
+Packet *
+IPReassembler::linearize_chain(Chain *c, bool complete)
+{
+    Packet *first = c->head;
+    Packet *rest = first->next();
+    first->set_next(0);
+    ChunkLink fc = PACKET_CHUNK(first);
+
+    uint32_t length = c->total;
+    if (!complete) {
+	length = fc.lastoff;
+	for (Packet *f = rest; f; f = f->next())
+	    length = PACKET_CHUNK(f).lastoff;
+    }
+
+    WritablePacket *q;
+    if (fc.off == 0) {
+	// reuse the first fragment, which has the datagram's IP header
+	first->pull(first->network_header_offset());
+	uint32_t extra = length - fc.lastoff;
+	if (!extra || (!first->shared() && first->tailroom() >= extra))
+	    q = first->put(extra);
+	else {
+	    // copy just the first fragment, not its whole buffer
+	    q = Packet::make(first->headroom(), 0, first->length() + extra, 0);
+	    if (q) {
+		memcpy(q->data(), first->data(), first->length());
+		q->copy_annotations(first);
+		q->set_network_header(q->data(), first->network_header_length());
+		_bytes_copied += first->length();
+	    }
+	    first->kill();
+	}
+	if (q && !complete)
+	    memset(q->transport_header() + fc.lastoff, 0, extra);
+    } else {
+	// no first fragment; borrow another fragment's basic header
+	if ((q = Packet::make(sizeof(click_ip) + length))) {
+	    q->copy_annotations(first);
+	    memcpy(q->data(), first->ip_header(), sizeof(click_ip));
+	    q->set_ip_header(reinterpret_cast<click_ip *>(q->data()), sizeof(click_ip));
+	    q->ip_header()->ip_hl = sizeof(click_ip) >> 2;
+	    memset(q->transport_header(), 0, length);
+	}
+	first->set_next(rest);
+	rest = first;
+    }
+
+    while (Packet *f = rest) {
+	rest = f->next();
+	if (q) {
+	    ChunkLink &ch = PACKET_CHUNK(f);
+	    memcpy(q->transport_header() + ch.off, f->end_data() - (ch.lastoff - ch.off), ch.lastoff - ch.off);
+	    _bytes_copied += ch.lastoff - ch.off;
+	}
+	f->kill();
+    }
+    if (!q) {
+	click_chatter("out of memory");
+	return 0;
+    }
+
+    click_ip *q_iph = q->ip_header();
+    q_iph->ip_off &= ~htons(IP_OFFMASK);
+    if (complete) {
+	q_iph->ip_off &= ~htons(IP_MF);
+	q_iph->ip_len = htons(q->network_length());
+	q_iph->ip_sum = 0;
+	q_iph->ip_sum = click_in_cksum((const unsigned char *)q_iph, q_iph->ip_hl << 2);
+    }
+
+    // zero out the annotations we used
+    memset(&PACKET_CHUNK(q), 0, sizeof(ChunkLink));
+    q->set_next(0);
+    return q;
+}
+
+void
+IPReassembler::drop_chain(Chain *c)
+{
+    _mem_used -= c->mem;
+    if (noutputs() > 1) {
+	if (Packet *q = linearize_chain(c, false))
+	    output(1).push(q);
+    } else
+	while (Packet *f = c->head) {
+	    c->head = f->next();
+	    f->kill();
+	}
+    _chain_alloc.deallocate(c);
+}
+
 void
 IPReassembler::reap_overfull(int now)
 {
@@ -373,6 +620,15 @@ IPReassembler::reap_overfull(int now)
 			return;
 		} else
 		    pprev = (WritablePacket **)&q->next();
+	    Chain **cprev = &_chains[bucket];
+	    for (Chain *c = *cprev; c; c = *cprev)
+		if (c->sec < now - delta) {
+		    *cprev = c->next;
+		    drop_chain(c);
+		    if (_mem_used <= _mem_low_thresh)
+			return;
+		} else
+		    cprev = &c->next;
 	}
 
     click_chatter("IPReassembler: cannot free enough memory!");
@@ -397,10 +653,25 @@ IPReassembler::reap(int now)
 		q_pprev = (WritablePacket **)&q->next();
 	    q = *q_pprev;
 	}
+	Chain **cprev = &_chains[i];
+	for (Chain *c = *cprev; c; c = *cprev)
+	    if (c->sec < kill_time) {
+		*cprev = c->next;
+		drop_chain(c);
+	    } else
+		cprev = &c->next;
     }
 
     _reap_time = now + REAP_INTERVAL;
 }
 
+void
+IPReassembler::add_handlers()
+{
+    add_data_handlers("mem_used", Handler::OP_READ, &_mem_used);
+    add_data_handlers("bytes_copied", Handler::OP_READ, &_bytes_copied);
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(IPReassembler)
@@ -5,6 +5,7 @@
 #include <click/glue.hh>
 #include <clicknet/ip.h>
 #include <click/timer.hh>
+#include <click/hashallocator.hh>
 CLICK_DECLS
 
 /*
@@ -30,6 +31,14 @@ IPReassembler's memory usage is bounded. When memory consumption rises above
 HIMEM bytes, IPReassembler throws away old fragments until memory consumption
 drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
 
+By default, IPReassembler copies each fragment into a buffer for its
+datagram as it arrives, growing the buffer as needed; growing can copy the
+datagram's data again.  In CHAIN mode, it instead keeps the fragments
+themselves, trimmed of any overlap and sorted by offset.  The datagram is
+linearized only once it is complete: the remaining fragments' data is
+appended to the first fragment, which is reused when it has enough tailroom.
+Fragments that time out are linearized only if output 1 exists.
+
 Output packets have no MAC headers, and input MAC headers are ignored.
 
 The IPREASSEMBLER annotation area is used to store packet metadata about
@@ -44,6 +53,17 @@ Keyword arguments are:
 
 The upper bound for memory consumption, in bytes. Default is 256K.
 
+=item DATAGRAM_HIMEM
+
+The upper bound for memory consumption by any one datagram, in bytes.
+Fragments that would take a datagram over this bound are dropped. Default is
+0, meaning no bound other than HIMEM.
+
+=item CHAIN
+
+Boolean. If true, keep fragment chains and linearize datagrams only when they
+are complete, as described above. Default is false.
+
 =back
 
 =n
@@ -53,6 +73,18 @@ second output.
 
 IPReassembler destroys its input packets' "next packet" annotations.
 
+=h mem_used read-only
+
+Returns the memory currently used by incomplete datagrams, in bytes.
+
+=h bytes_copied read-only
+
+Returns the number of bytes of packet data copied while reassembling.
+
+=h drops read-only
+
+Returns the number of fragments dropped because of DATAGRAM_HIMEM.
+
 =a IPFragmenter */
 
 class IPReassembler : public Element { public:
@@ -69,6 +101,7 @@ class IPReassembler : public Element { public:
     void cleanup(CleanupStage);
 
     int check(ErrorHandler * = 0);
+    void add_handlers();
 
     Packet *simple_action(Packet *);
 
@@ -91,6 +124,23 @@ class IPReassembler : public Element { public:
     uint32_t _mem_used;
     uint32_t _mem_high_thresh;	// defaults to 256K
     uint32_t _mem_low_thresh;	// defaults to 3/4 * _mem_high_thresh
+    uint32_t _mem_datagram_thresh;	// 0 means no limit
+
+    bool _chain;
+    uint32_t _bytes_copied;
+    uint32_t _drops;
+
+    // CHAIN mode: fragments in offset order, linked by next()
+    struct Chain {
+	Chain *next;
+	Packet *head;
+	uint32_t mem;		// counted in _mem_used
+	uint32_t covered;	// data bytes held
+	uint32_t total;		// datagram data length, or 0 if not yet known
+	int sec;		// time of latest fragment
+    };
+    Chain *_chains[NMAP];
+    SizedHashAllocator<sizeof(Chain)> _chain_alloc;
 
     static inline int bucketno(const click_ip *);
     static inline bool same_segment(const click_ip *, const click_ip *);
@@ -101,6 +151,10 @@ class IPReassembler : public Element { public:
     Packet *emit_whole_packet(WritablePacket *, WritablePacket **, Packet *);
     void reap_overfull(int);
     void reap(int);
+
+    Packet *chain_fragment(Packet *, int p_off, int p_lastoff, int now);
+    Packet *linearize_chain(Chain *, bool complete);
+    void drop_chain(Chain *);
     static void check_error(ErrorHandler *, int, const Packet *, const char *, ...);
 
 };
@@ -25,6 +25,8 @@
 #include <click/glue.hh>
 #include <click/straccum.hh>
 #include <click/router.hh>
+#include <click/task.hh>
+#include <click/standard/scheduleinfo.hh>
 #include "iproutetable.hh"
 CLICK_DECLS
 
@@ -86,6 +88,16 @@ IPRoute::unparse() const
 }
 
 
+IPRouteTable::IPRouteTable()
+    : _task(0)
+{
+}
+
+IPRouteTable::~IPRouteTable()
+{
+    delete _task;
+}
+
 void *
 IPRouteTable::cast(const char *name)
 {
@@ -119,6 +131,18 @@ IPRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
     return r;
 }
 
+int
+IPRouteTable::initialize(ErrorHandler *errh)
+{
+    if (ninputs() && input_is_pull(0)) {
+	if (!(_task = new Task(this)))
+	    return errh->error("out of memory!");
+	ScheduleInfo::initialize_task(this, _task, errh);
+	_signal = Notifier::upstream_empty_signal(this, 0, _task);
+    }
+    return 0;
+}
+
 int
 IPRouteTable::add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *errh)
 {
@@ -139,6 +163,13 @@ IPRouteTable::lookup_route(IPAddress, IPAddress&) const
     return -1;			// by default, route lookups fail
 }
 
+void
+IPRouteTable::lookup_route_batch(const IPAddress *addr, IPAddress *gw, int *port, int n) const
+{
+    for (int i = 0; i < n; i++)
+	port[i] = lookup_route(addr[i], gw[i]);
+}
+
 String
 IPRouteTable::dump_routes()
 {
@@ -164,6 +195,42 @@ IPRouteTable::push(int, Packet *p)
     }
 }
 
+bool
+IPRouteTable::run_task(Task *)
+{
+    Packet *p[BATCH_MAX];
+    IPAddress addr[BATCH_MAX];
+    IPAddress gw[BATCH_MAX];
+    int port[BATCH_MAX];
+
+    int n = 0;
+    while (n < BATCH_MAX && (p[n] = input(0).pull()))
+	addr[n] = p[n]->dst_ip_anno(), n++;
+    if (n == 0) {
+	if (_signal)
+	    _task->fast_reschedule();
+	return false;
+    }
+
+    lookup_route_batch(addr, gw, port, n);
+
+    for (int i = 0; i < n; i++)
+	if (port[i] >= 0) {
+	    assert(port[i] < noutputs());
+	    if (gw[i])
+		p[i]->set_dst_ip_anno(gw[i]);
+	    output(port[i]).push(p[i]);
+	} else {
+	    static int complained = 0;
+	    if (++complained <= 5)
+		click_chatter("IPRouteTable: no route for %s", addr[i].unparse().c_str());
+	    p[i]->kill();
+	}
+
+    _task->fast_reschedule();
+    return true;
+}
+
 
 int
 IPRouteTable::run_command(int command, const String &str, Vector<IPRoute>* old_routes, ErrorHandler *errh)
@@ -26,6 +26,8 @@
 #include <click/confparse.hh>
 #include <click/straccum.hh>
 #include <click/error.hh>
+#include <click/router.hh>
+#include <click/master.hh>
 
 #ifdef CLICK_LINUXMODULE
 #include <click/cxxprotect.h>
@@ -46,7 +48,8 @@ CLICK_DECLS
 //
 
 IPRw::Mapping::Mapping(bool dst_anno)
-  : _flags(dst_anno ? F_DST_ANNO : 0), _ip_p(0), _pat(0), _free_next(0)
+  : _flags(dst_anno ? F_DST_ANNO : 0), _ip_p(0), _pat(0), _free_next(0),
+    _wheel_next(0), _wheel_pprev(0)
 {
 }
 
@@ -339,7 +342,7 @@ bool
 IPRw::Pattern::create_mapping(int ip_p, const IPFlowID& in,
 			      int fport, int rport,
 			      Mapping* fmap, Mapping* rmap,
-			      const Map& rev_map)
+			      const Map& rev_map, const IPRw* rw, bool spill)
 {
     IPFlowID out(in);
     if (_saddr)
@@ -362,7 +365,10 @@ IPRw::Pattern::create_mapping(int ip_p, const IPFlowID& in,
 		    lookup.set_dport(htons(base + val));
 		else
 		    lookup.set_daddr(htonl(base + val));
-		if (!rev_map.find(lookup)) {
+		// With shards, IPRw decides which reply flows are free; see
+		// IPRw::reply_flow_free.
+		if (rw ? rw->reply_flow_free(ip_p, lookup, in, spill)
+		    : !rev_map.find(lookup)) {
 		    if (_is_napt)
 			out.set_sport(lookup.dport());
 		    else
@@ -544,6 +550,7 @@ IPRw::Mapping::free_from_list(Map &map, bool notify)
 	_pat->mapping_freed(primary());
     map.erase(reverse()->flow_id().reverse());
     map.erase(flow_id().reverse());
+    ExpiryWheel::remove(this);
     delete reverse();
     delete this;
     return next;
@@ -699,5 +706,389 @@ IPRw::clear_map(Map &table)
     table.clear();
 }
 
+
+//
+// IPRw::ExpiryWheel
+//
+
+IPRw::ExpiryWheel::ExpiryWheel()
+    : _timeout(0), _tick_shift(0), _cursor(0)
+{
+}
+
+void
+IPRw::ExpiryWheel::configure(uint32_t timeout, uint32_t tick,
+			     click_jiffies_t now)
+{
+    // A power-of-two tick keeps bucket indexes continuous when jiffies wrap.
+    _tick_shift = 0;
+    while ((2U << _tick_shift) <= tick && _tick_shift < 30)
+	_tick_shift++;
+    int n = 4;
+    while (n < 4096 && (uint32_t) n < (timeout >> _tick_shift) + 2)
+	n *= 2;
+    _timeout = timeout;
+    _buckets.assign(n, 0);
+    _cursor = (now >> _tick_shift) << _tick_shift;
+}
+
+void
+IPRw::ExpiryWheel::clear()
+{
+    for (int i = 0; i < _buckets.size(); i++)
+	_buckets[i] = 0;
+}
+
+inline void
+IPRw::ExpiryWheel::link(Mapping *m, click_jiffies_t when)
+{
+    // Expiry times before the next due bucket go in that bucket; those
+    // beyond the wheel go in its last bucket, to be moved on when it is due.
+    if ((int32_t) (when - _cursor) < 0)
+	when = _cursor;
+    else if ((when - _cursor) >> _tick_shift >= (uint32_t) _buckets.size())
+	when = _cursor + ((_buckets.size() - 1) << _tick_shift);
+    Mapping **pprev = &_buckets[(when >> _tick_shift) & (_buckets.size() - 1)];
+    if ((m->_wheel_next = *pprev))
+	m->_wheel_next->_wheel_pprev = &m->_wheel_next;
+    m->_wheel_pprev = pprev;
+    *pprev = m;
+}
+
+void
+IPRw::ExpiryWheel::insert(Mapping *m)
+{
+    assert(m->is_primary() && !m->_wheel_pprev);
+    click_jiffies_t used = m->_used;
+    if ((int32_t) (m->_reverse->_used - used) > 0)
+	used = m->_reverse->_used;
+    link(m, used + _timeout);
+}
+
+IPRw::Mapping *
+IPRw::ExpiryWheel::expire(click_jiffies_t now, int &budget)
+{
+    // Check due buckets, at most 'budget' mappings in all, and return the
+    // expired mappings linked by free_next().  Mappings on a free-tracked
+    // list are never returned, since that list frees them; they are requeued
+    // like live mappings, in case reuse takes them off the list.
+    Mapping *expired = 0;
+    click_jiffies_t last_use = now - _timeout;
+    while (_buckets.size() && (int32_t) (now - _cursor) >= (int32_t) tick()) {
+	Mapping **bucket = &_buckets[(_cursor >> _tick_shift) & (_buckets.size() - 1)];
+	Mapping *m;
+	while ((m = *bucket) && budget > 0) {
+	    remove(m);
+	    budget--;
+	    if (!m->used_since(last_use) && !m->free_tracked()) {
+		m->set_free_next(expired);
+		expired = m;
+	    } else {
+		click_jiffies_t used = m->_used;
+		if ((int32_t) (m->_reverse->_used - used) > 0)
+		    used = m->_reverse->_used;
+		used += _timeout;
+		if ((int32_t) (used - _cursor) < (int32_t) tick())
+		    used = _cursor + tick();
+		link(m, used);
+	    }
+	}
+	if (*bucket)
+	    break;
+	_cursor += tick();
+    }
+    return expired;
+}
+
+
+//
+// sharded mapping tables
+//
+
+int
+IPRw::configure_shards(int nshards, ErrorHandler *errh)
+{
+    if (nshards == 0)
+	nshards = master()->nthreads();
+    if (nshards < 1 || nshards > MAX_SHARDS)
+	return errh->error("SHARDS must be between 1 and %d", MAX_SHARDS);
+    _nshards = nshards;
+    return 0;
+}
+
+void
+IPRw::initialize_shards(int tcp_reap, int tcp_timeout,
+			int udp_reap, int udp_timeout)
+{
+    // Each wheel tick does 1/16 of a reap interval's work.
+    click_jiffies_t now = click_jiffies();
+    int n = _nshards + (_nshards > 1);
+    for (int i = 0; i < n; i++) {
+	Shard *s = new Shard;
+	s->tcp_wheel.configure(tcp_timeout, tcp_reap * CLICK_HZ / 16, now);
+	s->udp_wheel.configure(udp_timeout, udp_reap * CLICK_HZ / 16, now);
+	_shards.push_back(s);
+    }
+    _spill_used = 0;
+    _gc_pauses = _gc_freed = 0;
+}
+
+void
+IPRw::cleanup_shards()
+{
+    for (int i = 0; i < _shards.size(); i++) {
+	clear_map(_shards[i]->tcp_map);
+	clear_map(_shards[i]->udp_map);
+	delete _shards[i];
+    }
+    _shards.clear();
+}
+
+IPRw::Shard *
+IPRw::mapping_home(const Mapping *m) const
+{
+    const Mapping *f = m->primary();
+    int a = flow_shard(f->reverse()->flow_id(), _nshards);
+    int b = flow_shard(f->flow_id(), _nshards);
+    return _shards[a == b ? a : _nshards];
+}
+
+IPRw::Mapping *
+IPRw::find_mapping(int ip_p, const IPFlowID &flow, Shard *&spill) const
+{
+    // The caller must hold the flow's home shard lock.  If the mapping is
+    // found in the extra shard, returns with that shard locked too.
+    Mapping *m = flow_home(flow)->map(ip_p).get(flow);
+    spill = 0;
+    if (!m && _spill_used.value()) {
+	Shard *s = _shards[_nshards];
+	s->lock.acquire();
+	if ((m = s->map(ip_p).get(flow)))
+	    spill = s;
+	else
+	    s->lock.release();
+    }
+    return m;
+}
+
+bool
+IPRw::reply_flow_free(int ip_p, const IPFlowID &reply, const IPFlowID &flow,
+		      bool spill) const
+{
+    // A reply flow lives in its home shard's map or in the extra shard's,
+    // never both.  Without SPILL, only reply flows that share FLOW's shard
+    // qualify; the caller holds that shard's lock, so no other thread can
+    // claim them meanwhile.  With SPILL, the pair will go in the extra
+    // shard, whose lock the caller also holds, and the reply flow's own
+    // shard is checked if its lock is free right now.  Waiting for it
+    // could deadlock, so values in busy shards are skipped.
+    int home = flow_shard(flow, _nshards);
+    int rhome = flow_shard(reply, _nshards);
+    Shard *x = _shards[_nshards];
+    if (!spill) {
+	if (rhome != home || _shards[home]->map(ip_p).find(reply))
+	    return false;
+	if (!_spill_used.value())
+	    return true;
+	x->lock.acquire();
+	bool used = x->map(ip_p).find(reply);
+	x->lock.release();
+	return !used;
+    }
+
+    if (rhome == home || x->map(ip_p).find(reply))
+	return false;
+    Shard *s = _shards[rhome];
+    if (!s->lock.attempt())
+	return false;
+    bool used = s->map(ip_p).find(reply);
+    s->lock.release();
+    return !used;
+}
+
+bool
+IPRw::create_pair(Pattern *pattern, int ip_p, const IPFlowID &flow,
+		  int fport, int rport, Mapping *forward, Mapping *reverse)
+{
+    // Prefer values whose replies share the flow's shard.  If none is
+    // free, take any free value and put the pair in the extra shard,
+    // holding that shard's lock from the search until the pair is in.
+    Shard *home = flow_home(flow);
+    home->lock.acquire();
+    bool ok = true;
+    if (!pattern)
+	Mapping::make_pair(ip_p, flow, flow, fport, rport, forward, reverse);
+    else if (_nshards == 1)
+	ok = pattern->create_mapping(ip_p, flow, fport, rport, forward, reverse, home->map(ip_p));
+    else if (!(ok = pattern->create_mapping(ip_p, flow, fport, rport, forward, reverse, home->map(ip_p), this))
+	     && pattern->_variation_top) {
+	Shard *x = _shards[_nshards];
+	x->lock.acquire();
+	if ((ok = pattern->create_mapping(ip_p, flow, fport, rport, forward, reverse, home->map(ip_p), this, true)))
+	    insert_pair(ip_p, flow, forward, reverse);
+	x->lock.release();
+	home->lock.release();
+	return ok;
+    }
+    if (ok)
+	insert_pair(ip_p, flow, forward, reverse);
+    home->lock.release();
+    return ok;
+}
+
+void
+IPRw::insert_pair(int ip_p, const IPFlowID &flow, Mapping *forward,
+		  Mapping *reverse)
+{
+    Shard *s = flow_home(flow);
+    s->lock.acquire();
+    if (s != flow_home(forward->flow_id().reverse())) {
+	s->lock.release();
+	s = _shards[_nshards];
+	s->lock.acquire();
+	_spill_used = 1;
+    }
+    Map &map = s->map(ip_p);
+    map.set(flow, forward);
+    map.set(forward->flow_id().reverse(), reverse);
+    s->wheel(ip_p).insert(forward);
+    s->lock.release();
+}
+
+bool
+IPRw::reap_shards(int ip_p)
+{
+    // One wheel step per shard, each under its own lock.  Returns true if
+    // any shard ran out of budget with due mappings left.
+    bool more = false;
+    for (int i = 0; i < _shards.size(); i++) {
+	Shard *s = _shards[i];
+	s->lock.acquire();
+	Timestamp t0 = Timestamp::now();
+	int budget = GC_BUDGET;
+	Mapping *m = s->wheel(ip_p).expire(click_jiffies(), budget);
+	Map &map = s->map(ip_p);
+	int freed = 0;
+	for (; m; freed++)
+	    m = m->free_from_list(map, true);
+	s->lock.release();
+	if (budget < GC_BUDGET)
+	    record_gc_pause(Timestamp::now() - t0, freed);
+	if (budget == 0)
+	    more = true;
+    }
+    return more;
+}
+
+void
+IPRw::reap_shards_done(uint32_t timeout)
+{
+    for (int i = 0; i < _shards.size(); i++) {
+	Shard *s = _shards[i];
+	if (!s->tcp_done)
+	    continue;
+	s->lock.acquire();
+	Timestamp t0 = Timestamp::now();
+	uint32_t n = s->tcp_map.size();
+	clean_map_free_tracked(s->tcp_map, s->tcp_done, s->tcp_done_tail,
+			       click_jiffies() - timeout);
+	n = (n - s->tcp_map.size()) / 2;
+	s->lock.release();
+	record_gc_pause(Timestamp::now() - t0, n);
+    }
+}
+
+void
+IPRw::record_gc_pause(const Timestamp &t, int freed)
+{
+    _gc_pauses++;
+    _gc_freed += freed;
+    _gc_pause_total += t;
+    if (t > _gc_pause_max)
+	_gc_pause_max = t;
+}
+
+String
+IPRw::unparse_gc_stats() const
+{
+    StringAccum sa;
+    Timestamp mean = (_gc_pauses ? _gc_pause_total / _gc_pauses : Timestamp());
+    sa << "pauses " << _gc_pauses << "\nfreed " << _gc_freed
+       << "\nmean_pause " << mean << "\nmax_pause " << _gc_pause_max << '\n';
+    return sa.take_string();
+}
+
+void
+IPRw::take_state_shards(IPRw *rw, ErrorHandler *errh)
+{
+    if (noutputs() != rw->noutputs()) {
+	errh->warning("taking mappings from %<%s%>, although it has %s output ports", rw->declaration().c_str(), (rw->noutputs() > noutputs() ? "more" : "fewer"));
+	if (noutputs() < rw->noutputs())
+	    errh->message("(out of range mappings will be dropped)");
+    }
+
+    // check rw->_all_patterns against our _all_patterns
+    Vector<Pattern *> pattern_map;
+    for (int i = 0; i < rw->_all_patterns.size(); i++) {
+	Pattern *p = rw->_all_patterns[i], *q = 0;
+	for (int j = 0; j < _all_patterns.size() && !q; j++)
+	    if (_all_patterns[j]->can_accept_from(*p))
+		q = _all_patterns[j];
+	pattern_map.push_back(q);
+    }
+
+    // Move each pair to the shard it belongs in here, which depends on our
+    // shard count.  Free-tracked pairs stay free-tracked.
+    int no = noutputs();
+    for (int i = 0; i < rw->_shards.size(); i++) {
+	Shard *os = rw->_shards[i];
+	for (Mapping *m = os->tcp_done, *next; m; m = next) {
+	    next = m->free_next();
+	    m->set_free_next(0);
+	}
+	os->tcp_done = os->tcp_done_tail = 0;
+
+	for (int proto = 0; proto < 2; proto++) {
+	    int ip_p = (proto ? IP_PROTO_UDP : IP_PROTO_TCP);
+	    Map &map = os->map(ip_p);
+	    Mapping *to_free = 0;
+	    for (Map::iterator iter = map.begin(); iter.live(); iter++) {
+		Mapping *m = iter.value();
+		if (!m->is_primary())
+		    continue;
+		ExpiryWheel::remove(m);
+		Pattern *p = m->pattern(), *q = 0;
+		for (int j = 0; j < rw->_all_patterns.size(); j++)
+		    if (rw->_all_patterns[j] == p) {
+			q = pattern_map[j];
+			break;
+		    }
+		if (p)
+		    p->mapping_freed(m);
+		if (q && m->output() < no && m->reverse()->output() < no) {
+		    q->accept_mapping(m);
+		    IPFlowID flow = m->reverse()->flow_id().reverse();
+		    insert_pair(ip_p, flow, m, m->reverse());
+		    if (m->free_tracked()) {
+			Shard *home = mapping_home(m);
+			m->primary()->append_to_free(home->tcp_done, home->tcp_done_tail);
+		    }
+		} else {
+		    m->set_free_next(to_free);
+		    to_free = m;
+		}
+	    }
+	    while (to_free) {
+		Mapping *next = to_free->free_next();
+		delete to_free->reverse();
+		delete to_free;
+		to_free = next;
+	    }
+	    map.clear();
+	    os->wheel(ip_p).clear();
+	}
+    }
+}
+
 ELEMENT_PROVIDES(IPRw)
 CLICK_ENDDECLS
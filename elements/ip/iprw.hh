@@ -5,6 +5,7 @@
 #include <click/timer.hh>
 #include <click/hashtable.hh>
 #include <click/ipflowid.hh>
+#include <click/sync.hh>
 #include <clicknet/ip.h>
 CLICK_DECLS
 class IPMapper;
@@ -13,6 +14,7 @@ class IPRw : public Element { public:
 
     class Pattern;
     class Mapping;
+    class ExpiryWheel;
     typedef HashTable<IPFlowID, Mapping*> Map;
     enum InputSpecName {
 	INPUT_SPEC_NOCHANGE, INPUT_SPEC_KEEP, INPUT_SPEC_DROP,
@@ -49,11 +51,45 @@ class IPRw : public Element { public:
     virtual Mapping* apply_pattern(Pattern*, int ip_p, const IPFlowID&, int, int) = 0;
     virtual Mapping* get_mapping(int ip_p, const IPFlowID&) const = 0;
 
+    static inline uint32_t flow_hash(const IPFlowID&);
+    static inline int flow_shard(const IPFlowID&, int nshards);
+
   protected:
 
     Vector<Pattern*> _all_patterns;
 
-    enum { GC_INTERVAL_SEC = 3600 };
+    enum { GC_INTERVAL_SEC = 3600, GC_BUDGET = 512, MAX_SHARDS = 256 };
+
+    // Sharded mapping tables, used by IPRewriter and TCPRewriter.  A pair
+    // of mappings lives in the shard its flows hash to, or, if the two
+    // directions hash to different shards, in the extra last shard.
+    struct Shard;
+    Vector<Shard*> _shards;
+    int _nshards;
+    atomic_uint32_t _spill_used;	// nonzero once the extra shard has pairs
+
+    uint32_t _gc_pauses;
+    uint32_t _gc_freed;
+    Timestamp _gc_pause_total;
+    Timestamp _gc_pause_max;
+
+    int configure_shards(int nshards, ErrorHandler*);
+    void initialize_shards(int tcp_reap, int tcp_timeout,
+			   int udp_reap, int udp_timeout);
+    void cleanup_shards();
+    void take_state_shards(IPRw*, ErrorHandler*);
+    inline Shard* flow_home(const IPFlowID&) const;
+    Shard* mapping_home(const Mapping*) const;
+    Mapping* find_mapping(int ip_p, const IPFlowID&, Shard*& spill) const;
+    bool reply_flow_free(int ip_p, const IPFlowID& reply,
+			 const IPFlowID& flow, bool spill) const;
+    bool create_pair(Pattern*, int ip_p, const IPFlowID&, int fport, int rport,
+		     Mapping*, Mapping*);
+    void insert_pair(int ip_p, const IPFlowID&, Mapping*, Mapping*);
+    bool reap_shards(int ip_p);
+    void reap_shards_done(uint32_t timeout);
+    void record_gc_pause(const Timestamp&, int freed);
+    String unparse_gc_stats() const;
 
     void take_state_map(Map&, Mapping** free_head, Mapping** free_tail,
 			const Vector<Pattern*>&, const Vector<Pattern*>&);
@@ -130,8 +166,13 @@ class IPRw::Mapping { public:
 
     Mapping* _free_next;
 
+    // maintained by IPRw::ExpiryWheel, for primary mappings
+    Mapping* _wheel_next;
+    Mapping** _wheel_pprev;
+
     friend class IPRw;
     friend class IPRw::Pattern;
+    friend class IPRw::ExpiryWheel;
 
     inline Mapping* free_from_list(Map&, bool notify);
     inline void append_to_free(Mapping*& head, Mapping*& tail);
@@ -165,7 +206,9 @@ class IPRw::Pattern { public:
 
     bool can_accept_from(const Pattern&) const;
 
-    bool create_mapping(int ip_p, const IPFlowID&, int fport, int rport, Mapping*, Mapping*, const Map&);
+    bool create_mapping(int ip_p, const IPFlowID&, int fport, int rport,
+			Mapping*, Mapping*, const Map&,
+			const IPRw* rw = 0, bool spill = false);
     void accept_mapping(Mapping*);
     inline void mapping_freed(Mapping*);
 
@@ -198,6 +241,62 @@ class IPRw::Pattern { public:
 };
 
 
+class IPRw::ExpiryWheel { public:
+
+    // Expires primary mappings TIMEOUT jiffies after their last use.  Each
+    // mapping sits in the bucket for its expiry time as of its insertion;
+    // since use does not move it, a bucket's mappings are checked again when
+    // it comes due, and those used since are moved to later buckets.
+
+    ExpiryWheel();
+
+    void configure(uint32_t timeout, uint32_t tick, click_jiffies_t now);
+    void clear();
+
+    uint32_t timeout() const		{ return _timeout; }
+    uint32_t tick() const		{ return 1U << _tick_shift; }
+
+    void insert(Mapping*);
+    static inline void remove(Mapping*);
+
+    Mapping* expire(click_jiffies_t now, int& budget);
+
+  private:
+
+    Vector<Mapping*> _buckets;
+    uint32_t _timeout;
+    int _tick_shift;
+    click_jiffies_t _cursor;	// start of the next bucket due
+
+    inline void link(Mapping*, click_jiffies_t);
+
+};
+
+
+struct IPRw::Shard {
+
+    Map tcp_map;
+    Map udp_map;
+    Mapping* tcp_done;
+    Mapping* tcp_done_tail;
+    ExpiryWheel tcp_wheel;
+    ExpiryWheel udp_wheel;
+    Spinlock lock;
+
+    Shard()
+	: tcp_map(0), udp_map(0), tcp_done(0), tcp_done_tail(0) {
+    }
+
+    Map& map(int ip_p) {
+	return ip_p == IP_PROTO_TCP ? tcp_map : udp_map;
+    }
+    ExpiryWheel& wheel(int ip_p) {
+	return ip_p == IP_PROTO_TCP ? tcp_wheel : udp_wheel;
+    }
+
+};
+
+
 class IPMapper { public:
 
     IPMapper()				{ }
@@ -245,5 +344,41 @@ IPRw::Mapping::used_since(uint32_t t) const
     return ((int32_t)(_used - t)) >= 0 || ((int32_t)(_reverse->_used - t)) >= 0;
 }
 
+inline void
+IPRw::ExpiryWheel::remove(Mapping* m)
+{
+    if (m->_wheel_pprev) {
+	if ((*m->_wheel_pprev = m->_wheel_next))
+	    m->_wheel_next->_wheel_pprev = m->_wheel_pprev;
+	m->_wheel_next = 0;
+	m->_wheel_pprev = 0;
+    }
+}
+
+inline IPRw::Shard*
+IPRw::flow_home(const IPFlowID& flow) const
+{
+    return _shards[flow_shard(flow, _nshards)];
+}
+
+/** @brief Return a hash of @a flow that is the same in both directions. */
+inline uint32_t
+IPRw::flow_hash(const IPFlowID& flow)
+{
+    uint32_t h = (flow.saddr().addr() ^ flow.daddr().addr()) * 0x9E3779B1U;
+    h ^= (uint32_t) (flow.sport() ^ flow.dport()) * 0x85EBCA6BU;
+    h ^= h >> 15;
+    h *= 0xC2B2AE35U;
+    return h ^ (h >> 16);
+}
+
+/** @brief Return the shard, less than @a nshards, that holds @a flow and
+ * its reply flow. */
+inline int
+IPRw::flow_shard(const IPFlowID& flow, int nshards)
+{
+    return nshards <= 1 ? 0 : (int) (((uint64_t) flow_hash(flow) * nshards) >> 32);
+}
+
 CLICK_ENDDECLS
 #endif
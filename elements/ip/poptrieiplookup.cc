@@ -0,0 +1,490 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * poptrieiplookup.{cc,hh} -- looks up next-hop address in a compressed
+ * multiway trie
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "poptrieiplookup.hh"
+#include <click/ipaddress.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+PoptrieIPLookup::PoptrieIPLookup()
+    : _top(0), _routes_free(-1), _route_map(-1), _slot_head(0), _top_key(0)
+{
+}
+
+PoptrieIPLookup::~PoptrieIPLookup()
+{
+}
+
+int
+PoptrieIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (!(_top = new uint32_t[1 << top_bits])
+	|| !(_slot_head = new int32_t[1 << top_bits])
+	|| !(_top_key = new int32_t[1 << top_bits]))
+	return errh->error("out of memory!");
+    for (int i = 0; i < (1 << top_bits); i++) {
+	_top[i] = LEAF;
+	_slot_head[i] = _top_key[i] = -1;
+    }
+
+    VirtualPort vp;
+    vp.port = -1;
+    vp.refcount = 1;
+    _vport.push_back(vp);
+
+    return IPRouteTable::configure(conf, errh);
+}
+
+void
+PoptrieIPLookup::cleanup(CleanupStage)
+{
+    delete[] _top;
+    delete[] _slot_head;
+    delete[] _top_key;
+    _top = 0;
+    _slot_head = _top_key = 0;
+    _nodes.clear();
+    _leaves.clear();
+    _vport.clear();
+    _routes.clear();
+    _route_map.clear();
+    _short.clear();
+}
+
+
+// VIRTUAL PORTS
+
+int
+PoptrieIPLookup::vport_ref(IPAddress gw, int port)
+{
+    int free = -1;
+    for (int i = 1; i < _vport.size(); i++)
+	if (_vport[i].refcount && _vport[i].gw == gw && _vport[i].port == port) {
+	    _vport[i].refcount++;
+	    return i;
+	} else if (!_vport[i].refcount && free < 0)
+	    free = i;
+    if (free < 0) {
+	if (_vport.size() > 0xFFFF)
+	    return -ENOMEM;
+	free = _vport.size();
+	_vport.push_back(VirtualPort());
+    }
+    _vport[free].gw = gw;
+    _vport[free].port = port;
+    _vport[free].refcount = 1;
+    return free;
+}
+
+void
+PoptrieIPLookup::vport_unref(int vport)
+{
+    if (vport > 0)
+	_vport[vport].refcount--;
+}
+
+
+// TRIE CONSTRUCTION
+
+template <typename T> static uint32_t
+block_alloc(Vector<T> &arena, Vector<uint32_t> *free_blocks, int order)
+{
+    if (free_blocks[order].size()) {
+	uint32_t x = free_blocks[order].back();
+	free_blocks[order].pop_back();
+	return x;
+    } else {
+	uint32_t x = arena.size();
+	arena.resize(x + (1 << order));
+	return x;
+    }
+}
+
+static int
+block_order(int n)
+{
+    int order = 0;
+    while ((1 << order) < n)
+	order++;
+    return order;
+}
+
+void
+PoptrieIPLookup::free_subtree(uint32_t slot)
+{
+    uint32_t e = _top[slot];
+    if (!(e & LEAF)) {
+	const Node &header = _nodes[e - 1];
+	_node_free[header.vector].push_back(e - 1);
+	if (header.leafvec < NORDERS)
+	    _leaf_free[header.leafvec].push_back(header.base0);
+    }
+}
+
+void
+PoptrieIPLookup::build_node(Vector<Node> &nodes, Vector<uint16_t> &leaves,
+			    int ni, int depth, uint16_t def,
+			    Vector<const Route *> &routes)
+{
+    // Routes are sorted by length, so longer prefixes overwrite shorter ones.
+    uint16_t leafval[1 << stride];
+    uint64_t internal = 0;
+    for (int i = 0; i < (1 << stride); i++)
+	leafval[i] = def;
+    for (const Route **rp = routes.begin(); rp != routes.end(); ++rp) {
+	int i = child_index((*rp)->addr, depth);
+	if ((*rp)->len <= depth + stride) {
+	    int n = 1 << (depth + stride - (*rp)->len);
+	    for (int j = i; j < i + n; j++)
+		leafval[j] = (*rp)->vport;
+	} else
+	    internal |= (uint64_t) 1 << i;
+    }
+
+    // Store a leaf wherever the leaf value changes, skipping child nodes.
+    uint64_t leafvec = 0;
+    uint32_t base0 = leaves.size();
+    int prev = -1;
+    for (int i = 0; i < (1 << stride); i++)
+	if (!(internal & ((uint64_t) 1 << i)) && leafval[i] != prev) {
+	    leafvec |= (uint64_t) 1 << i;
+	    leaves.push_back(leafval[i]);
+	    prev = leafval[i];
+	}
+
+    uint32_t base1 = nodes.size();
+    nodes.resize(base1 + popcount(internal));
+    nodes[ni].vector = internal;
+    nodes[ni].leafvec = leafvec;
+    nodes[ni].base0 = base0;
+    nodes[ni].base1 = base1;
+
+    // Build child nodes from the routes that extend past this node.
+    Vector<const Route *> sub;
+    for (int i = 0, ci = base1; i < (1 << stride); i++)
+	if (internal & ((uint64_t) 1 << i)) {
+	    sub.clear();
+	    for (const Route **rp = routes.begin(); rp != routes.end(); ++rp)
+		if ((*rp)->len > depth + stride
+		    && child_index((*rp)->addr, depth) == i)
+		    sub.push_back(*rp);
+	    build_node(nodes, leaves, ci, depth + stride, leafval[i], sub);
+	    ci++;
+	}
+}
+
+void
+PoptrieIPLookup::rebuild_slot(uint32_t slot)
+{
+    uint16_t def = (_top_key[slot] >= 0 ? _routes[_top_key[slot]].vport : 0);
+    if (_slot_head[slot] < 0) {
+	free_subtree(slot);
+	_top[slot] = LEAF | def;
+	return;
+    }
+
+    // Collect the slot's routes, shortest first.
+    Vector<const Route *> routes;
+    for (int k = _slot_head[slot]; k >= 0; k = _routes[k].next) {
+	const Route *r = &_routes[k];
+	int i = routes.size();
+	routes.push_back(r);
+	for (; i > 0 && routes[i - 1]->len > r->len; i--)
+	    routes[i] = routes[i - 1];
+	routes[i] = r;
+    }
+
+    // Build the subtree in temporary vectors.  Node 0 is the block header;
+    // node 1 is the root.
+    Vector<Node> nodes;
+    Vector<uint16_t> leaves;
+    nodes.resize(2);
+    build_node(nodes, leaves, 1, top_bits, def, routes);
+
+    // Copy it into blocks of the lookup arenas.
+    free_subtree(slot);
+    int norder = block_order(nodes.size());
+    int lorder = (leaves.size() ? block_order(leaves.size()) : (int) NORDERS);
+    uint32_t nstart = block_alloc(_nodes, _node_free, norder);
+    uint32_t lstart = (leaves.size() ? block_alloc(_leaves, _leaf_free, lorder) : 0);
+    for (int i = 1; i < nodes.size(); i++) {
+	Node &n = _nodes[nstart + i];
+	n = nodes[i];
+	n.base0 += lstart;
+	n.base1 += nstart;
+    }
+    memcpy(_leaves.begin() + lstart, leaves.begin(), leaves.size() * sizeof(uint16_t));
+    _nodes[nstart].vector = norder;
+    _nodes[nstart].leafvec = lorder;
+    _nodes[nstart].base0 = lstart;
+    _nodes[nstart].base1 = 0;
+    _top[slot] = nstart + 1;
+}
+
+void
+PoptrieIPLookup::short_route_changed(int key, bool removed)
+{
+    // Routes of top_bits or less live in _top_key[] for every slot they
+    // cover; the longest covering route wins.
+    const Route &r = _routes[key];
+    uint32_t s1 = r.addr >> (32 - top_bits);
+    uint32_t s2 = s1 + (1 << (top_bits - r.len));
+
+    int replacement = -1;
+    if (removed)
+	for (int *kp = _short.begin(); kp != _short.end(); ++kp) {
+	    const Route &sr = _routes[*kp];
+	    if (*kp != key && sr.len < r.len
+		&& ((r.addr ^ sr.addr) & ~(0xFFFFFFFFU >> sr.len)) == 0
+		&& (replacement < 0 || _routes[replacement].len < sr.len))
+		replacement = *kp;
+	}
+
+    for (uint32_t s = s1; s < s2; s++) {
+	int old_key = _top_key[s];
+	if (removed) {
+	    if (old_key == key)
+		_top_key[s] = replacement;
+	} else if (old_key < 0 || _routes[old_key].len <= r.len)
+	    _top_key[s] = key;
+	if (_top_key[s] == key || old_key == key)
+	    rebuild_slot(s);
+    }
+}
+
+
+// ROUTES
+
+int
+PoptrieIPLookup::find_route(uint32_t addr, int len) const
+{
+    return _route_map.find(route_key(addr, len));
+}
+
+IPRoute
+PoptrieIPLookup::make_route(int key) const
+{
+    const Route &r = _routes[key];
+    const VirtualPort &vp = _vport[r.vport];
+    return IPRoute(IPAddress(htonl(r.addr)), IPAddress::make_prefix(r.len),
+		   vp.gw, vp.port);
+}
+
+int
+PoptrieIPLookup::add_route(const IPRoute &route, bool allow_replace,
+			   IPRoute *old_route, ErrorHandler *)
+{
+    int len = route.prefix_len();
+    uint32_t addr = ntohl(route.addr.addr()) & ntohl(route.mask.addr());
+    int key = find_route(addr, len);
+
+    if (key >= 0) {
+	if (old_route)
+	    *old_route = make_route(key);
+	if (!allow_replace)
+	    return -EEXIST;
+    }
+
+    int vport = vport_ref(route.gw, route.port);
+    if (vport < 0)
+	return vport;
+
+    if (key >= 0) {
+	vport_unref(_routes[key].vport);
+	_routes[key].vport = vport;
+    } else {
+	if (_routes_free >= 0) {
+	    key = _routes_free;
+	    _routes_free = _routes[key].next;
+	} else {
+	    key = _routes.size();
+	    _routes.push_back(Route());
+	}
+	Route &r = _routes[key];
+	r.addr = addr;
+	r.len = len;
+	r.vport = vport;
+	_route_map.insert(route_key(addr, len), key);
+	if (len > top_bits) {
+	    uint32_t slot = addr >> (32 - top_bits);
+	    r.next = _slot_head[slot];
+	    _slot_head[slot] = key;
+	} else {
+	    r.next = -1;
+	    _short.push_back(key);
+	}
+    }
+
+    if (len > top_bits)
+	rebuild_slot(addr >> (32 - top_bits));
+    else
+	short_route_changed(key, false);
+    return 0;
+}
+
+int
+PoptrieIPLookup::remove_route(const IPRoute &route, IPRoute *old_route,
+			      ErrorHandler *)
+{
+    int len = route.prefix_len();
+    uint32_t addr = ntohl(route.addr.addr()) & ntohl(route.mask.addr());
+    int key = find_route(addr, len);
+    if (key < 0)
+	return -ENOENT;
+
+    IPRoute found_route = make_route(key);
+    if (!route.match(found_route))
+	return -ENOENT;
+    if (old_route)
+	*old_route = found_route;
+
+    _route_map.remove(route_key(addr, len));
+    if (len > top_bits) {
+	uint32_t slot = addr >> (32 - top_bits);
+	int32_t *pprev = &_slot_head[slot];
+	while (*pprev != key)
+	    pprev = &_routes[*pprev].next;
+	*pprev = _routes[key].next;
+	rebuild_slot(slot);
+    } else {
+	short_route_changed(key, true);
+	for (int *kp = _short.begin(); kp != _short.end(); ++kp)
+	    if (*kp == key) {
+		*kp = _short.back();
+		_short.pop_back();
+		break;
+	    }
+    }
+
+    vport_unref(_routes[key].vport);
+    _routes[key].len = -1;
+    _routes[key].next = _routes_free;
+    _routes_free = key;
+    return 0;
+}
+
+
+// LOOKUP
+
+int
+PoptrieIPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
+{
+    uint32_t a = ntohl(addr.addr());
+    uint32_t e = _top[a >> (32 - top_bits)];
+    for (int depth = top_bits; !(e & LEAF); depth += stride) {
+	const Node &n = _nodes[e];
+	uint64_t bit = (uint64_t) 1 << child_index(a, depth);
+	uint64_t mask = (bit << 1) - 1;
+	if (n.vector & bit)
+	    e = n.base1 + popcount(n.vector & mask) - 1;
+	else
+	    e = LEAF | _leaves[n.base0 + popcount(n.leafvec & mask) - 1];
+    }
+    const VirtualPort &vp = _vport[e & ~LEAF];
+    gw = vp.gw;
+    return vp.port;
+}
+
+void
+PoptrieIPLookup::lookup_route_batch(const IPAddress *addr, IPAddress *gw,
+				    int *port, int n) const
+{
+    // Descend for all addresses in lockstep.  Each round reads one node per
+    // unfinished address and prefetches the node or leaf it leads to.
+    uint32_t a[BATCH_MAX], e[BATCH_MAX];
+    int i;
+
+    for (i = 0; i < n; i++) {
+	a[i] = ntohl(addr[i].addr());
+	click_prefetch0(&_top[a[i] >> (32 - top_bits)]);
+    }
+
+    for (i = 0; i < n; i++) {
+	e[i] = _top[a[i] >> (32 - top_bits)];
+	if (!(e[i] & LEAF))
+	    click_prefetch0(&_nodes[e[i]]);
+    }
+
+    for (int depth = top_bits, active = n; active; depth += stride) {
+	active = 0;
+	for (i = 0; i < n; i++)
+	    if (!(e[i] & LEAF)) {
+		const Node &nd = _nodes[e[i]];
+		uint64_t bit = (uint64_t) 1 << child_index(a[i], depth);
+		uint64_t mask = (bit << 1) - 1;
+		if (nd.vector & bit) {
+		    e[i] = nd.base1 + popcount(nd.vector & mask) - 1;
+		    click_prefetch0(&_nodes[e[i]]);
+		    active++;
+		} else {
+		    const uint16_t *leaf = &_leaves[nd.base0 + popcount(nd.leafvec & mask) - 1];
+		    click_prefetch0(leaf);
+		    // leaves are read in the next loop; remember where
+		    e[i] = LEAF | (uint32_t) (leaf - _leaves.begin()) | 0x40000000U;
+		}
+	    }
+    }
+
+    for (i = 0; i < n; i++) {
+	if (e[i] & 0x40000000U)
+	    e[i] = _leaves[e[i] & 0x3FFFFFFFU];
+	else
+	    e[i] &= ~LEAF;
+	click_prefetch0(&_vport[e[i]]);
+    }
+
+    for (i = 0; i < n; i++) {
+	gw[i] = _vport[e[i]].gw;
+	port[i] = _vport[e[i]].port;
+    }
+}
+
+
+// HANDLERS
+
+String
+PoptrieIPLookup::dump_routes()
+{
+    StringAccum sa;
+    for (int i = 0; i < _routes.size(); i++)
+	if (_routes[i].len >= 0)
+	    make_route(i).unparse(sa, true) << '\n';
+    return sa.take_string();
+}
+
+String
+PoptrieIPLookup::read_handler(Element *e, void *)
+{
+    PoptrieIPLookup *t = static_cast<PoptrieIPLookup *>(e);
+    size_t bytes = (sizeof(uint32_t) << top_bits)
+	+ t->_nodes.size() * sizeof(Node)
+	+ t->_leaves.size() * sizeof(uint16_t)
+	+ t->_vport.size() * sizeof(VirtualPort);
+    return String((unsigned long) bytes);
+}
+
+void
+PoptrieIPLookup::add_handlers()
+{
+    IPRouteTable::add_handlers();
+    add_read_handler("memory", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable)
+EXPORT_ELEMENT(PoptrieIPLookup)
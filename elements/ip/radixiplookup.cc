@@ -216,6 +216,53 @@ RadixIPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
     }
 }
 
+void
+RadixIPLookup::lookup_route_batch(const IPAddress *addr, IPAddress *gw, int *port, int n) const
+{
+    // Walk the trie for all addresses in lockstep, one level per round.
+    // Every level below the root indexes 4 fewer bits, so each round can
+    // prefetch the child slot that the next round will read.
+    const Radix *r[BATCH_MAX];
+    uint32_t a[BATCH_MAX];
+    int key[BATCH_MAX];
+    int i, bitshift = _radix->_bitshift;
+
+    for (i = 0; i < n; i++) {
+	a[i] = ntohl(addr[i].addr());
+	key[i] = _default_key;
+	r[i] = _radix;
+	click_prefetch0(&_radix->_children[a[i] >> bitshift]);
+    }
+
+    for (int active = n; active; bitshift -= 4) {
+	active = 0;
+	for (i = 0; i < n; i++)
+	    if (r[i]) {
+		const Radix::Child &c = r[i]->_children[a[i] >> bitshift];
+		a[i] &= (1 << bitshift) - 1;
+		if (c.key >= 0)
+		    key[i] = c.key;
+		if ((r[i] = c.child)) {
+		    click_prefetch0(&r[i]->_children[a[i] >> (bitshift - 4)]);
+		    active++;
+		}
+	    }
+    }
+
+    for (i = 0; i < n; i++)
+	if (key[i] >= 0)
+	    click_prefetch0(&_v[key[i]]);
+
+    for (i = 0; i < n; i++)
+	if (key[i] >= 0 && _v[key[i]].contains(addr[i])) {
+	    gw[i] = _v[key[i]].gw;
+	    port[i] = _v[key[i]].port;
+	} else {
+	    gw[i] = 0;
+	    port[i] = -1;
+	}
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(IPRouteTable)
 EXPORT_ELEMENT(RadixIPLookup)
@@ -26,6 +26,10 @@ address in its routing table, using longest-prefix-match, sets the destination
 annotation to the corresponding GW (if specified), and emits the packet on the
 indicated OUTput port.
 
+The input may be push or pull.  With a pull input, RadixIPLookup walks the
+trie for up to 32 packets at once, prefetching each packet's next node while
+it examines the others.
+
 Each argument is a route, specifying a destination and mask, an optional
 gateway IP address, and an output port.
 
@@ -75,13 +79,14 @@ class RadixIPLookup : public IPRouteTable { public:
 
     const char *class_name() const		{ return "RadixIPLookup"; }
     const char *port_count() const		{ return "1/-"; }
-    const char *processing() const		{ return PUSH; }
+    const char *processing() const		{ return "a/h"; }
 
     void cleanup(CleanupStage);
 
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_route_batch(const IPAddress*, IPAddress*, int*, int) const;
     String dump_routes();
 
   private:
@@ -52,11 +52,11 @@ RangeIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 }
 
 int
-RangeIPLookup::initialize(ErrorHandler *)
+RangeIPLookup::initialize(ErrorHandler *errh)
 {
     expand();
     _active = true;
-    return 0;
+    return IPRouteTable::initialize(errh);
 }
 
 void
@@ -117,6 +117,51 @@ RangeIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
     return _helper._vport[vport_i].port;
 }
 
+void
+RangeIPLookup::lookup_route_batch(const IPAddress *dest, IPAddress *gw, int *port, int n) const
+{
+    // Prefetch every lookup's kickstart entries, then the first probe of
+    // its range, before any binary search runs.
+    uint32_t ip_addr[BATCH_MAX];
+    uint32_t lowerbound[BATCH_MAX], upperbound[BATCH_MAX];
+    uint16_t vport_i[BATCH_MAX];
+    int i;
+
+    for (i = 0; i < n; i++) {
+	ip_addr[i] = ntohl(dest[i].addr());
+	click_prefetch0(&_range_base[ip_addr[i] >> RANGE_SHIFT]);
+	click_prefetch0(&_range_len[ip_addr[i] >> RANGE_SHIFT]);
+    }
+
+    for (i = 0; i < n; i++) {
+	lowerbound[i] = _range_base[ip_addr[i] >> RANGE_SHIFT];
+	upperbound[i] = lowerbound[i] + _range_len[ip_addr[i] >> RANGE_SHIFT];
+	click_prefetch0(&_range_t[(upperbound[i] + lowerbound[i]) >> 1]);
+    }
+
+    for (i = 0; i < n; i++) {
+	uint32_t lb = lowerbound[i], ub = upperbound[i], middle;
+	uint32_t a = ip_addr[i] & RANGE_MASK;
+	while (ub > lb) {
+	    middle = (ub + lb) >> 1;
+	    if (a < (_range_t[middle] & RANGE_MASK))
+		ub = middle;
+	    else if (a < (_range_t[middle + 1] & RANGE_MASK)) {
+		lb = middle;
+		break;
+	    } else
+		lb = middle + 1;
+	}
+	vport_i[i] = _range_t[lb] >> RANGE_SHIFT;
+	click_prefetch0(&_helper._vport[vport_i[i]]);
+    }
+
+    for (i = 0; i < n; i++) {
+	gw[i] = _helper._vport[vport_i[i]].gw;
+	port[i] = _helper._vport[vport_i[i]].port;
+    }
+}
+
 void
 RangeIPLookup::add_handlers()
 {
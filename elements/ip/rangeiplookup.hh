@@ -21,6 +21,10 @@ address in its routing table, using longest-prefix-match, sets the destination
 annotation to the corresponding GW (if specified), and emits the packet on the
 indicated OUTput port.
 
+The input may be push or pull.  A pull input is drained in batches of up to 32
+packets whose kickstart table reads are prefetched together before the range
+searches run.
+
 Each argument is a route, specifying a destination and mask, an optional
 gateway IP address, and an output port.  No destination-mask pair should occur
 more than once.
@@ -87,7 +91,7 @@ class RangeIPLookup : public IPRouteTable { public:
 
     const char *class_name() const      { return "RangeIPLookup"; }
     const char *port_count() const	{ return "1/-"; }
-    const char *processing() const      { return PUSH; }
+    const char *processing() const      { return "a/h"; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
     int initialize(ErrorHandler *errh);
@@ -98,6 +102,7 @@ class RangeIPLookup : public IPRouteTable { public:
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_route_batch(const IPAddress*, IPAddress*, int*, int) const;
     String dump_routes();
 
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
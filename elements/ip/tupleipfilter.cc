@@ -0,0 +1,553 @@
+/*
+ * tupleipfilter.{cc,hh} -- IP-packet filter using tuple space search
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tupleipfilter.hh"
+#include <click/glue.hh>
+#include <click/error.hh>
+#include <click/confparse.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+TupleIPFilter::TupleIPFilter()
+    : _tuple_map(-1), _check_length(0)
+{
+}
+
+TupleIPFilter::~TupleIPFilter()
+{
+}
+
+int
+TupleIPFilter::compile_rule(const String &text, int argno, Rule &r,
+			    ErrorHandler *errh)
+{
+    // Compile the rule alone with IPFilter's compiler, sending matching
+    // packets to [1] and others to [0].
+    int before_nerrors = errh->nerrors();
+    _exprs.clear();
+    _output_everything = -1;
+    _align_offset = 0;
+
+    Vector<int> tree;
+    init_expr_subtree(tree);
+    int slot = parse_rule(text, argno, tree, errh);
+    if (slot < 0 || errh->nerrors() != before_nerrors) {
+	_exprs.clear();
+	return -1;
+    }
+    finish_expr_subtree(tree, C_AND, -1);
+    finish_expr_subtree(tree, C_OR, -1, 0);
+    optimize_exprs(ErrorHandler::silent_handler());
+
+    r.text = cp_unquote(text);
+    r.slot = slot;
+    r.position = -1;
+    r.always = _output_everything;
+    r.length = _safe_length;
+    r.prog.swap(_exprs);
+    _exprs.clear();
+    return 0;
+}
+
+bool
+TupleIPFilter::add_field(Vector<Field> &conj, int offset, uint32_t mask,
+			 uint32_t value)
+{
+    // Add 'word at offset & mask == value' to a conjunction; return false if
+    // the conjunction becomes unsatisfiable.
+    if (!mask)
+	return true;
+    Field *f = conj.begin();
+    while (f < conj.end() && f->offset < offset)
+	f++;
+    if (f == conj.end() || f->offset != offset) {
+	Field nf;
+	nf.offset = offset;
+	nf.mask = mask;
+	nf.value = value & mask;
+	conj.insert(f, nf);
+	return true;
+    }
+    if ((f->value ^ value) & f->mask & mask)
+	return false;
+    f->mask |= mask;
+    f->value |= value & mask;
+    return true;
+}
+
+void
+TupleIPFilter::add_conjunction(const Vector<Field> &pos,
+			       const Vector<Field> &neg,
+			       Vector<Conjunction> &out)
+{
+    // Drop failing tests that the passing tests already decide, and narrow
+    // the rest to the bits the passing tests leave unknown.
+    Conjunction c;
+    c.pos = pos;
+    for (const Field *n = neg.begin(); n != neg.end(); ++n) {
+	uint32_t known_mask = 0, known_value = 0;
+	for (const Field *f = pos.begin(); f != pos.end(); ++f)
+	    if (f->offset == n->offset) {
+		known_mask = f->mask;
+		known_value = f->value;
+	    }
+	if ((known_value ^ n->value) & known_mask & n->mask)
+	    continue;		// certainly fails, as it should
+	Field x;
+	x.offset = n->offset;
+	x.mask = n->mask & ~known_mask;
+	x.value = n->value & x.mask;
+	if (!x.mask)
+	    return;		// certainly passes: no packet takes this path
+	const Field *y = c.neg.begin();
+	while (y != c.neg.end()
+	       && (y->offset != x.offset || y->mask != x.mask || y->value != x.value))
+	    ++y;
+	if (y == c.neg.end())
+	    c.neg.push_back(x);
+    }
+    out.push_back(c);
+}
+
+bool
+TupleIPFilter::flatten(const Rule &r, int step, Vector<Field> &pos,
+		       Vector<Field> &neg, Vector<Conjunction> &out,
+		       int &budget)
+{
+    // Walk every path through the rule's program to [1], collecting the
+    // tests each path passes and fails.
+    if (--budget < 0 || out.size() > MAX_CONJUNCTIONS)
+	return false;
+    const Expr &e = r.prog[step];
+    for (int k = 1; k >= 0; k--) {
+	int next = e.j[k];
+	bool ok = true;
+	if (next <= 0 && next != -1)
+	    continue;
+	if (k) {
+	    Vector<Field> conj(pos);
+	    if (!add_field(conj, e.offset, e.mask.u, e.value.u))
+		continue;
+	    if (next > 0)
+		ok = flatten(r, next, conj, neg, out, budget);
+	    else
+		add_conjunction(conj, neg, out);
+	} else {
+	    if (!e.mask.u)
+		continue;
+	    Field f;
+	    f.offset = e.offset;
+	    f.mask = e.mask.u;
+	    f.value = e.value.u;
+	    neg.push_back(f);
+	    if (next > 0)
+		ok = flatten(r, next, pos, neg, out, budget);
+	    else
+		add_conjunction(pos, neg, out);
+	    neg.pop_back();
+	}
+	if (!ok)
+	    return false;
+    }
+    return true;
+}
+
+TupleIPFilter::Tuple *
+TupleIPFilter::find_tuple(const Vector<Field> &conj)
+{
+    StringAccum sa;
+    for (const Field *f = conj.begin(); f < conj.end(); f++)
+	sa.append((const char *) f, sizeof(f->offset) + sizeof(f->mask));
+    String key = sa.take_string();
+
+    int i = _tuple_map.find(key);
+    if (i >= 0)
+	return _tuple_store[i];
+
+    Tuple *t = new Tuple;
+    t->nwords = conj.size();
+    for (int w = 0; w < t->nwords; w++) {
+	t->offset[w] = conj[w].offset;
+	t->mask[w] = conj[w].mask;
+    }
+    t->min_position = 0x7FFFFFFF;
+    t->min_rule = -1;
+    _tuple_map.insert(key, _tuple_store.size());
+    _tuple_store.push_back(t);
+    tuple_rebuild(t);
+    return t;
+}
+
+void
+TupleIPFilter::tuple_insert(Tuple *t, int entry)
+{
+    // Link entry into the hash table, keeping each key's entries in
+    // position order.
+    const uint32_t *key = t->entry_keys.begin() + entry * t->nwords;
+    int position = _rules[t->entries[entry].rule].position;
+    uint32_t h = 0;
+    for (int w = 0; w < t->nwords; w++)
+	h = hash_step(h, key[w]);
+    for (uint32_t slot = h & t->capmask; ; slot = (slot + 1) & t->capmask) {
+	uint32_t *k = t->keys.begin() + slot * t->nwords;
+	int *pprev = &t->heads[slot];
+	if (*pprev < 0) {
+	    memcpy(k, key, t->nwords * sizeof(uint32_t));
+	    t->nkeys++;
+	} else if (memcmp(k, key, t->nwords * sizeof(uint32_t)) != 0)
+	    continue;
+	while (*pprev >= 0 && _rules[t->entries[*pprev].rule].position <= position)
+	    pprev = &t->entries[*pprev].next;
+	t->entries[entry].next = *pprev;
+	*pprev = entry;
+	break;
+    }
+    if (t->min_rule < 0 || position < _rules[t->min_rule].position)
+	t->min_rule = t->entries[entry].rule;
+}
+
+void
+TupleIPFilter::tuple_rebuild(Tuple *t)
+{
+    int n = t->entries.size();
+    uint32_t cap = 4;
+    while (cap < (uint32_t) 2 * n)
+	cap *= 2;
+    t->capmask = cap - 1;
+    t->nkeys = 0;
+    t->keys.assign(cap * t->nwords, 0);
+    t->heads.assign(cap, -1);
+    t->min_rule = -1;
+    for (int i = 0; i < n; i++)
+	tuple_insert(t, i);
+}
+
+int
+TupleIPFilter::tuple_compar(const void *a, const void *b, void *)
+{
+    const Tuple *ta = *static_cast<Tuple * const *>(a);
+    const Tuple *tb = *static_cast<Tuple * const *>(b);
+    return ta->min_position - tb->min_position;
+}
+
+void
+TupleIPFilter::sort_tuples()
+{
+    // Drop empty tuples from the search order, and sort the rest by their
+    // earliest rule.
+    _tuples.clear();
+    for (Tuple **tp = _tuple_store.begin(); tp != _tuple_store.end(); ++tp)
+	if ((*tp)->min_rule >= 0) {
+	    (*tp)->min_position = _rules[(*tp)->min_rule].position;
+	    _tuples.push_back(*tp);
+	}
+    click_qsort(_tuples.begin(), _tuples.size(), sizeof(Tuple *), tuple_compar);
+}
+
+int
+TupleIPFilter::insert_rule(int position, const String &text, int argno,
+			   ErrorHandler *errh)
+{
+    Rule r;
+    if (compile_rule(text, argno, r, errh) < 0)
+	return -1;
+
+    Vector<Conjunction> conjs;
+    if (r.always == 1)
+	conjs.push_back(Conjunction());
+    else if (r.always < 0) {
+	Vector<Field> pos, neg;
+	int budget = 16 * MAX_CONJUNCTIONS;
+	if (!flatten(r, 0, pos, neg, conjs, budget))
+	    return errh->error("pattern %d: too complex, more than %d conjunctions", argno, MAX_CONJUNCTIONS);
+	for (int i = 0; i < conjs.size(); i++)
+	    if (conjs[i].pos.size() > MAX_WORDS)
+		return errh->error("pattern %d: too complex, tests more than %d words", argno, MAX_WORDS);
+    }
+
+    int id = _rules.size();
+    for (int *ip = _order.begin() + position; ip != _order.end(); ++ip)
+	_rules[*ip].position++;
+    r.position = position;
+    _rules.push_back(r);
+    _order.insert(_order.begin() + position, id);
+
+    for (Conjunction *c = conjs.begin(); c != conjs.end(); ++c) {
+	Tuple *t = find_tuple(c->pos);
+	Entry e;
+	e.rule = id;
+	e.neg = t->negs.size();
+	e.nneg = c->neg.size();
+	for (int w = 0; w < t->nwords; w++)
+	    t->entry_keys.push_back(c->pos[w].value);
+	for (int i = 0; i < c->neg.size(); i++)
+	    t->negs.push_back(c->neg[i]);
+	t->entries.push_back(e);
+	if ((uint32_t) 2 * (t->nkeys + 1) > t->capmask + 1)
+	    tuple_rebuild(t);
+	else
+	    tuple_insert(t, t->entries.size() - 1);
+    }
+    if (r.always < 0 && r.length > _check_length)
+	_check_length = r.length;
+    sort_tuples();
+    return 0;
+}
+
+void
+TupleIPFilter::remove_rule(int position)
+{
+    int id = _order[position];
+    _order.erase(_order.begin() + position);
+    for (int *ip = _order.begin() + position; ip != _order.end(); ++ip)
+	_rules[*ip].position--;
+
+    for (Tuple **tp = _tuple_store.begin(); tp != _tuple_store.end(); ++tp) {
+	Tuple *t = *tp;
+	int j = 0, nneg = 0;
+	for (int i = 0; i < t->entries.size(); i++) {
+	    Entry e = t->entries[i];
+	    if (e.rule == id)
+		continue;
+	    memmove(t->entry_keys.begin() + j * t->nwords, t->entry_keys.begin() + i * t->nwords, t->nwords * sizeof(uint32_t));
+	    memmove(t->negs.begin() + nneg, t->negs.begin() + e.neg, e.nneg * sizeof(Field));
+	    e.neg = nneg;
+	    nneg += e.nneg;
+	    t->entries[j++] = e;
+	}
+	if (j != t->entries.size()) {
+	    t->entry_keys.resize(j * t->nwords);
+	    t->negs.resize(nneg);
+	    t->entries.resize(j);
+	    tuple_rebuild(t);
+	}
+    }
+
+    Rule &r = _rules[id];
+    r.position = -1;
+    r.text = String();
+    r.prog.clear();
+    _check_length = 0;
+    for (int *ip = _order.begin(); ip != _order.end(); ++ip)
+	if (_rules[*ip].always < 0 && _rules[*ip].length > _check_length)
+	    _check_length = _rules[*ip].length;
+    sort_tuples();
+}
+
+int
+TupleIPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    int before_nerrors = errh->nerrors();
+    for (int argno = 0; argno < conf.size(); argno++)
+	(void) insert_rule(_order.size(), conf[argno], argno, errh);
+    return (errh->nerrors() == before_nerrors ? 0 : -1);
+}
+
+void
+TupleIPFilter::cleanup(CleanupStage)
+{
+    for (Tuple **tp = _tuple_store.begin(); tp != _tuple_store.end(); ++tp)
+	delete *tp;
+    _tuple_store.clear();
+    _tuples.clear();
+}
+
+//
+// RUNNING
+//
+
+int
+TupleIPFilter::eval_rule(const Rule &r, const Packet *p)
+{
+    // Run the rule's program with IPFilter::length_checked_match's rules for
+    // missing bytes.
+    if (r.always >= 0)
+	return r.always;
+    const unsigned char *neth_data = p->network_header();
+    const unsigned char *transph_data = p->transport_header();
+    int packet_length = p->length() + TRANSP_FAKE_OFFSET - p->transport_header_offset();
+    const Expr *ex = r.prog.begin();
+    int pos = 0;
+    do {
+	const Expr &e = ex[pos];
+	int off = e.offset;
+	bool yes = false;
+	if (off + 4 <= packet_length
+	    || (off < packet_length
+		&& !(e.mask.c[3]
+		     || (e.mask.c[2] && packet_length - off <= 2)
+		     || (e.mask.c[1] && packet_length - off == 1)))) {
+	    uint32_t data;
+	    if (off >= TRANSP_FAKE_OFFSET)
+		data = *(const uint32_t *)(transph_data + off - TRANSP_FAKE_OFFSET);
+	    else
+		data = *(const uint32_t *)(neth_data + off);
+	    yes = ((data & e.mask.u) == e.value.u);
+	}
+	pos = e.j[yes];
+    } while (pos > 0);
+    return -pos;
+}
+
+int
+TupleIPFilter::match_interpreted(const Packet *p) const
+{
+    for (const int *ip = _order.begin(); ip != _order.end(); ++ip)
+	if (eval_rule(_rules[*ip], p))
+	    return _rules[*ip].slot;
+    return noutputs();
+}
+
+int
+TupleIPFilter::match(const Packet *p) const
+{
+    if (p->length() + TRANSP_FAKE_OFFSET - p->transport_header_offset() < _check_length)
+	return match_interpreted(p);
+
+    const unsigned char *neth_data = p->network_header();
+    const unsigned char *transph_data = p->transport_header() - TRANSP_FAKE_OFFSET;
+    int best_position = 0x7FFFFFFF, best_rule = -1;
+
+    for (Tuple * const *tp = _tuples.begin(); tp != _tuples.end(); ++tp) {
+	const Tuple *t = *tp;
+	if (t->min_position >= best_position)
+	    break;
+	uint32_t key[MAX_WORDS], h = 0;
+	for (int w = 0; w < t->nwords; w++) {
+	    int off = t->offset[w];
+	    const unsigned char *d = (off >= TRANSP_FAKE_OFFSET ? transph_data : neth_data) + off;
+	    key[w] = *(const uint32_t *) d & t->mask[w];
+	    h = hash_step(h, key[w]);
+	}
+	for (uint32_t slot = h & t->capmask; ; slot = (slot + 1) & t->capmask) {
+	    int ei = t->heads[slot];
+	    if (ei < 0)
+		break;
+	    const uint32_t *k = t->keys.begin() + slot * t->nwords;
+	    int w = 0;
+	    while (w < t->nwords && k[w] == key[w])
+		w++;
+	    if (w < t->nwords)
+		continue;
+	    // entries with this key, earliest first
+	    for (; ei >= 0; ei = t->entries[ei].next) {
+		const Entry &e = t->entries[ei];
+		int position = _rules[e.rule].position;
+		if (position >= best_position)
+		    break;
+		const Field *n = t->negs.begin() + e.neg, *nend = n + e.nneg;
+		for (; n != nend; ++n) {
+		    const unsigned char *d = (n->offset >= TRANSP_FAKE_OFFSET ? transph_data : neth_data) + n->offset;
+		    if ((*(const uint32_t *) d & n->mask) == n->value)
+			break;
+		}
+		if (n == nend) {
+		    best_position = position;
+		    best_rule = e.rule;
+		    break;
+		}
+	    }
+	    break;
+	}
+    }
+
+    return (best_rule >= 0 ? _rules[best_rule].slot : noutputs());
+}
+
+void
+TupleIPFilter::push(int, Packet *p)
+{
+    checked_output_push(TupleIPFilter::match(p), p);
+}
+
+//
+// HANDLERS
+//
+
+enum { H_RULES, H_TUPLES, H_MEMORY, H_ADD, H_INSERT, H_REMOVE };
+
+String
+TupleIPFilter::read_handler(Element *e, void *thunk)
+{
+    TupleIPFilter *f = static_cast<TupleIPFilter *>(e);
+    StringAccum sa;
+    switch ((intptr_t) thunk) {
+    case H_RULES:
+	for (int i = 0; i < f->_order.size(); i++)
+	    sa << i << ": " << f->_rules[f->_order[i]].text << '\n';
+	break;
+    case H_TUPLES:
+	for (Tuple **tp = f->_tuples.begin(); tp != f->_tuples.end(); ++tp) {
+	    const Tuple *t = *tp;
+	    sa << t->min_position << ' ' << t->nkeys;
+	    for (int w = 0; w < t->nwords; w++)
+		sa.snprintf(24, "  %d/%08x", t->offset[w], ntohl(t->mask[w]));
+	    sa << '\n';
+	}
+	break;
+    case H_MEMORY: {
+	size_t size = sizeof(TupleIPFilter)
+	    + f->_rules.size() * sizeof(Rule) + f->_order.size() * sizeof(int)
+	    + f->_tuple_store.size() * (2 * sizeof(Tuple *) + sizeof(Tuple));
+	for (const Rule *r = f->_rules.begin(); r != f->_rules.end(); ++r)
+	    size += r->text.length() + r->prog.size() * sizeof(Expr);
+	for (Tuple **tp = f->_tuple_store.begin(); tp != f->_tuple_store.end(); ++tp)
+	    size += ((*tp)->keys.size() + (*tp)->entry_keys.size()) * sizeof(uint32_t)
+		+ (*tp)->heads.size() * sizeof(int)
+		+ (*tp)->entries.size() * sizeof(Entry)
+		+ (*tp)->negs.size() * sizeof(Field);
+	sa << size;
+	break;
+    }
+    }
+    return sa.take_string();
+}
+
+int
+TupleIPFilter::write_handler(const String &str, Element *e, void *thunk,
+			     ErrorHandler *errh)
+{
+    TupleIPFilter *f = static_cast<TupleIPFilter *>(e);
+    String s = str;
+    int position = f->_order.size();
+    if ((intptr_t) thunk != H_ADD) {
+	String word = cp_shift_spacevec(s);
+	int limit = f->_order.size() + ((intptr_t) thunk == H_INSERT);
+	if (!cp_integer(word, &position) || position < 0 || position >= limit)
+	    return errh->error("bad position %<%s%>", word.c_str());
+    }
+    if ((intptr_t) thunk == H_REMOVE) {
+	if (s)
+	    return errh->error("garbage after position");
+	f->remove_rule(position);
+	return 0;
+    }
+    return f->insert_rule(position, s, position, errh);
+}
+
+void
+TupleIPFilter::add_handlers()
+{
+    add_read_handler("rules", read_handler, (void *) H_RULES);
+    add_read_handler("tuples", read_handler, (void *) H_TUPLES);
+    add_read_handler("memory", read_handler, (void *) H_MEMORY);
+    add_write_handler("add", write_handler, (void *) H_ADD);
+    add_write_handler("insert", write_handler, (void *) H_INSERT);
+    add_write_handler("remove", write_handler, (void *) H_REMOVE);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPFilter)
+EXPORT_ELEMENT(TupleIPFilter)
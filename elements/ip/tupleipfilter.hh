@@ -0,0 +1,197 @@
+#ifndef CLICK_TUPLEIPFILTER_HH
+#define CLICK_TUPLEIPFILTER_HH
+#include "elements/ip/ipfilter.hh"
+#include <click/hashmap.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TupleIPFilter(ACTION_1 PATTERN_1, ..., ACTION_N PATTERN_N)
+
+=s ip
+
+filters IP packets by contents, scaling to large rule sets
+
+=d
+
+TupleIPFilter accepts the same arguments as IPFilter and sends every packet
+to the same output, but is built for rule sets with hundreds or thousands of
+rules, such as access control lists.  IPFilter compiles all its rules into
+one decision tree, which can grow very large or degenerate into long chains
+of tests.  TupleIPFilter instead uses tuple space search.
+
+Each rule is compiled on its own, by IPFilter's compiler, and the result is
+flattened into a set of conjunctions.  A conjunction requires some masked
+32-bit packet words to equal given values, such as "source address & mask ==
+10.0.0.0, protocol == TCP, destination port == 80", and may also require some
+masked words to differ from given values, as in `C<dst port E<gt> 1023>' or
+`C<not src net 10.0.0.0/8>'.  Conjunctions whose equal tests examine the same
+words with the same masks form a tuple, and each tuple keeps a hash table from
+masked word values to the rules with those values, earliest first.  A packet
+is classified by probing the tuples in order of the earliest rule each
+contains, stopping when no remaining tuple could improve on the best match so
+far.  A hash hit is confirmed by checking the conjunction's unequal tests, if
+any.  Classification therefore costs about one hash probe per tuple, and a
+typical access control list has a few dozen tuples however many rules it
+contains.
+
+Packets too short to contain every word any rule tests are instead checked
+against each rule in turn, with IPFilter's semantics for missing bytes.
+
+Rules can be added and removed while the router runs; a change touches only
+the tuples that hold the changed rule's conjunctions.
+
+Input packets must have their IP header annotation set; CheckIPHeader and
+MarkIPHeader do this.
+
+=h add write-only
+
+Appends a rule, given as `C<ACTION PATTERN>', to the end of the list.
+
+=h insert write-only
+
+Inserts a rule before an existing one.  Format should be `C<POS ACTION
+PATTERN>', where POS is the rule's position after insertion, counting from 0.
+
+=h remove write-only
+
+Removes the rule at position POS.
+
+=h rules read-only
+
+Returns the current rules, one per line, preceded by their positions.
+
+=h tuples read-only
+
+Returns one line per tuple: the position of its earliest rule, its number of
+distinct keys, and the OFFSET/MASK words it tests.  As in IPFilter's program,
+offsets of 64 and more are in the transport header.
+
+=h memory read-only
+
+Returns the number of bytes used by TupleIPFilter's rules and hash tables.
+
+=e
+
+  IPFilter(allow src net 10.0.0.0/8 && tcp dst port 80,
+           allow src net 10.0.0.0/8 && tcp dst port 443,
+           1 udp dst port > 1023,
+           drop all);
+
+has three tuples.  The first two rules share one, which tests the fragment
+offset, protocol, source address and destination port words.  The third rule's
+tuple tests only the fragment offset and protocol words; the check that the
+destination port's top six bits are not all zero follows a hash hit.  The last
+rule has a tuple that tests nothing.
+
+=a
+
+IPFilter, IPClassifier, ClassifierBenchmark
+
+V. Srinivasan, S. Suri, and G. Varghese.  "Packet Classification using
+Tuple Space Search".  In Proc. ACM SIGCOMM 1999, pp. 135-146. */
+
+class TupleIPFilter : public IPFilter { public:
+
+    TupleIPFilter();
+    ~TupleIPFilter();
+
+    const char *class_name() const		{ return "TupleIPFilter"; }
+    const char *port_count() const		{ return "1/1-"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int port, Packet *);
+    int match(const Packet *) const;
+    int match_interpreted(const Packet *) const;
+
+  private:
+
+    enum { MAX_WORDS = 16, MAX_CONJUNCTIONS = 4096 };
+
+    struct Rule {
+	String text;
+	int slot;		// output port; noutputs() means drop
+	int position;		// -1 if removed
+	int always;		// 0 or 1 if the rule never or always matches
+	unsigned length;	// IPFilter's safe length for this rule
+	Vector<Expr> prog;	// jumps to [1] on match and [0] otherwise
+    };
+
+    struct Field {
+	int offset;
+	uint32_t mask;
+	uint32_t value;
+    };
+
+    struct Conjunction {
+	Vector<Field> pos;	// word & mask == value for each of these
+	Vector<Field> neg;	// word & mask != value for each of these
+    };
+
+    struct Entry {
+	int rule;
+	int next;		// next entry with the same key, by position
+	int neg;		// index of first failing test in Tuple::negs
+	int nneg;
+    };
+
+    struct Tuple {
+	int nwords;
+	int32_t offset[MAX_WORDS];
+	uint32_t mask[MAX_WORDS];
+	int min_position;	// position of min_rule
+	int min_rule;		// earliest rule in the tuple
+	uint32_t capmask;
+	int nkeys;
+	Vector<uint32_t> keys;	// hash table: nwords words per slot
+	Vector<int> heads;	// hash table: first entry per slot, or -1
+	Vector<Entry> entries;
+	Vector<uint32_t> entry_keys;	// nwords words per entry
+	Vector<Field> negs;
+    };
+
+    Vector<Rule> _rules;	// indexed by rule ID
+    Vector<int> _order;		// rule IDs by position
+    Vector<Tuple *> _tuples;	// by min_position
+    HashMap<String, int> _tuple_map;	// masks -> index into _tuple_store
+    Vector<Tuple *> _tuple_store;
+    unsigned _check_length;	// shorter packets are matched rule by rule
+
+    static inline uint32_t hash_step(uint32_t h, uint32_t k);
+    static int eval_rule(const Rule &, const Packet *);
+
+    static bool add_field(Vector<Field> &, int offset, uint32_t mask,
+			  uint32_t value);
+    int compile_rule(const String &, int argno, Rule &, ErrorHandler *);
+    bool flatten(const Rule &, int step, Vector<Field> &pos,
+		 Vector<Field> &neg, Vector<Conjunction> &out, int &budget);
+    static void add_conjunction(const Vector<Field> &pos,
+				const Vector<Field> &neg,
+				Vector<Conjunction> &out);
+
+    int insert_rule(int position, const String &, int argno, ErrorHandler *);
+    void remove_rule(int position);
+    Tuple *find_tuple(const Vector<Field> &);
+    void tuple_insert(Tuple *, int entry);
+    void tuple_rebuild(Tuple *);
+    void sort_tuples();
+
+    static int tuple_compar(const void *, const void *, void *);
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+inline uint32_t
+TupleIPFilter::hash_step(uint32_t h, uint32_t k)
+{
+    h = (h ^ k) * 0x9E3779B1U;
+    return h ^ (h >> 16);
+}
+
+CLICK_ENDDECLS
+#endif
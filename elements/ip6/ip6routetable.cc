@@ -30,7 +30,7 @@ CLICK_DECLS
 void *
 IP6RouteTable::cast(const char *name)
 {
-    if (strcmp(name, "IPRouteTable") == 0)
+    if (strcmp(name, "IP6RouteTable") == 0 || strcmp(name, "IPRouteTable") == 0)
 	return (void *)this;
     else
 	return Element::cast(name);
@@ -51,6 +51,13 @@ IP6RouteTable::remove_route(IP6Address, IP6Address, ErrorHandler *errh)
     return errh->error("cannot delete routes from this routing table");
 }
 
+int
+IP6RouteTable::lookup_route(const IP6Address &, IP6Address &) const
+{
+    // by default, cannot look up routes
+    return -1;
+}
+
 String
 IP6RouteTable::dump_routes()
 {
@@ -118,6 +125,23 @@ IP6RouteTable::ctrl_handler(const String &conf_in, Element *e, void *thunk, Erro
 	return errh->error("bad command, should be `add' or `remove'");
 }
 
+int
+IP6RouteTable::lookup_handler(int, String &s, Element *e, const Handler *, ErrorHandler *errh)
+{
+    IP6RouteTable *r = static_cast<IP6RouteTable *>(e);
+    IP6Address a;
+    if (cp_ip6_address(s, &a, r)) {
+	IP6Address gw;
+	int port = r->lookup_route(a, gw);
+	if (gw)
+	    s = String(port) + " " + gw.unparse();
+	else
+	    s = String(port);
+	return 0;
+    } else
+	return errh->error("expected IP6 address");
+}
+
 String
 IP6RouteTable::table_handler(Element *e, void *)
 {
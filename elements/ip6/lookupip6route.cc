@@ -163,6 +163,16 @@ LookupIP6Route::remove_route(IP6Address addr, IP6Address mask,
   return 0;
 }
 
+int
+LookupIP6Route::lookup_route(const IP6Address &a, IP6Address &gw) const
+{
+  int ifi;
+  if (_t.lookup(a, gw, ifi))
+    return ifi;
+  gw = IP6Address();
+  return -1;
+}
+
 void
 LookupIP6Route::add_handlers()
 {
@@ -170,6 +180,7 @@ LookupIP6Route::add_handlers()
     add_write_handler("remove", remove_route_handler, 0);
     add_write_handler("ctrl", ctrl_handler, 0);
     add_read_handler("table", table_handler, 0);
+    set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
 }
 
 CLICK_ENDDECLS
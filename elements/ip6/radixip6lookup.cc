@@ -0,0 +1,389 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * radixip6lookup.{cc,hh} -- looks up next-hop IP6 address in a multibit trie
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, subject to the conditions listed in the Click LICENSE
+ * file. These conditions include: you must preserve this copyright
+ * notice, and you cannot mention the copyright holders in advertising
+ * related to the Software without their permission.  The Software is
+ * provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/ip6address.hh>
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/straccum.hh>
+#include "radixip6lookup.hh"
+CLICK_DECLS
+
+RadixIP6Lookup::Node *
+RadixIP6Lookup::Node::make_node()
+{
+    return new Node;
+}
+
+void
+RadixIP6Lookup::Node::free_node(Node *n)
+{
+    for (int i = 0; i < n->_nchildren; i++)
+	free_node(n->_children[i]);
+    delete[] n->_results;
+    delete[] n->_children;
+    delete n;
+}
+
+void
+RadixIP6Lookup::Node::update_ranks(const uint32_t *bits, uint16_t *ranks, int nwords)
+{
+    int r = 0;
+    for (int w = 0; w < nwords; w++) {
+	ranks[w] = r;
+	r += bitcount(bits[w]);
+    }
+}
+
+bool
+RadixIP6Lookup::Node::set_result(int i, int32_t key)
+{
+    int r = rank(_internal, _internal_rank, i);
+    if (!has_result(i)) {
+	int32_t *nr = new int32_t[_nresults + 1];
+	if (!nr)
+	    return false;
+	memcpy(nr, _results, r * sizeof(int32_t));
+	memcpy(nr + r + 1, _results + r, (_nresults - r) * sizeof(int32_t));
+	delete[] _results;
+	_results = nr;
+	_nresults++;
+	_internal[i >> 5] |= 1U << (i & 31);
+	update_ranks(_internal, _internal_rank, 16);
+    }
+    _results[r] = key;
+    return true;
+}
+
+void
+RadixIP6Lookup::Node::remove_result(int i)
+{
+    assert(has_result(i));
+    int r = rank(_internal, _internal_rank, i);
+    memmove(_results + r, _results + r + 1, (_nresults - r - 1) * sizeof(int32_t));
+    _nresults--;
+    _internal[i >> 5] &= ~(1U << (i & 31));
+    update_ranks(_internal, _internal_rank, 16);
+}
+
+bool
+RadixIP6Lookup::Node::add_child(int b, Node *child)
+{
+    assert(!this->child(b));
+    int r = rank(_external, _external_rank, b);
+    Node **nc = new Node *[_nchildren + 1];
+    if (!nc)
+	return false;
+    memcpy(nc, _children, r * sizeof(Node *));
+    memcpy(nc + r + 1, _children + r, (_nchildren - r) * sizeof(Node *));
+    nc[r] = child;
+    delete[] _children;
+    _children = nc;
+    _nchildren++;
+    _external[b >> 5] |= 1U << (b & 31);
+    update_ranks(_external, _external_rank, 8);
+    return true;
+}
+
+void
+RadixIP6Lookup::Node::remove_child(int b)
+{
+    assert(child(b));
+    int r = rank(_external, _external_rank, b);
+    memmove(_children + r, _children + r + 1, (_nchildren - r - 1) * sizeof(Node *));
+    _nchildren--;
+    _external[b >> 5] &= ~(1U << (b & 31));
+    update_ranks(_external, _external_rank, 8);
+}
+
+
+RadixIP6Lookup::RadixIP6Lookup()
+    : _vfree(-1), _default_key(-1), _root(0)
+{
+}
+
+RadixIP6Lookup::~RadixIP6Lookup()
+{
+}
+
+int
+RadixIP6Lookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (!(_root = new RootEntry[1 << root_bits]))
+	return errh->error("out of memory!");
+    for (int i = 0; i < (1 << root_bits); i++) {
+	_root[i].key = -1;
+	_root[i].key_priority = 0;
+	_root[i].child = 0;
+    }
+
+    int before = errh->nerrors();
+    for (int i = 0; i < conf.size(); i++)
+	(void) add_route_handler(conf[i], this, 0, errh);
+    return (errh->nerrors() == before ? 0 : -1);
+}
+
+void
+RadixIP6Lookup::cleanup(CleanupStage)
+{
+    if (_root) {
+	for (int i = 0; i < (1 << root_bits); i++)
+	    if (_root[i].child)
+		Node::free_node(_root[i].child);
+	delete[] _root;
+	_root = 0;
+    }
+    _v.clear();
+    _short_keys.clear();
+}
+
+int
+RadixIP6Lookup::alloc_route(const IP6Address &addr, const IP6Address &gw,
+			    int prefix_len, int port)
+{
+    int key;
+    if (_vfree < 0) {
+	key = _v.size();
+	_v.push_back(Route());
+    } else {
+	key = _vfree;
+	_vfree = _v[key].extra;
+    }
+    _v[key].addr = addr;
+    _v[key].gw = gw;
+    _v[key].prefix_len = prefix_len;
+    _v[key].port = port;
+    _v[key].extra = -1;
+    return key;
+}
+
+void
+RadixIP6Lookup::free_route(int key)
+{
+    _v[key].port = -1;
+    _v[key].extra = _vfree;
+    _vfree = key;
+}
+
+void
+RadixIP6Lookup::root_change(const IP6Address &addr, int prefix_len, int key)
+{
+    // Prefixes no longer than root_bits are expanded into every root entry
+    // they cover.  An entry's key_priority is the length of the prefix that
+    // set it, so longer prefixes win.
+    int i1 = root_index(addr.data());
+    int i2 = i1 + (1 << (root_bits - prefix_len));
+    for (; i1 < i2; i1++)
+	if (_root[i1].key_priority <= prefix_len) {
+	    _root[i1].key = key;
+	    _root[i1].key_priority = (key < 0 ? 0 : prefix_len);
+	}
+}
+
+int
+RadixIP6Lookup::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
+			  int port, ErrorHandler *errh)
+{
+    int prefix_len = mask.mask_to_prefix_len();
+    if (prefix_len < 0)
+	return errh->error("mask %s is not a prefix", mask.unparse().c_str());
+    addr &= mask;
+
+    if (prefix_len == 0) {
+	if (_default_key >= 0)
+	    free_route(_default_key);
+	_default_key = alloc_route(addr, gw, prefix_len, port);
+	return 0;
+    }
+
+    if (prefix_len <= root_bits) {
+	for (int *kp = _short_keys.begin(); kp != _short_keys.end(); ++kp)
+	    if (_v[*kp].prefix_len == prefix_len && _v[*kp].addr == addr) {
+		_v[*kp].gw = gw;
+		_v[*kp].port = port;
+		return 0;
+	    }
+	int key = alloc_route(addr, gw, prefix_len, port);
+	_short_keys.push_back(key);
+	root_change(addr, prefix_len, key);
+	return 0;
+    }
+
+    // Walk down to the node where the prefix ends, creating nodes as needed.
+    const unsigned char *d = addr.data();
+    RootEntry &re = _root[root_index(d)];
+    if (!re.child && !(re.child = Node::make_node()))
+	return errh->error("out of memory!");
+    Node *n = re.child;
+    int bit = root_bits;
+    d += root_bits / 8;
+    for (; prefix_len - bit > node_bits; bit += node_bits, d++) {
+	Node *c = n->child(*d);
+	if (!c) {
+	    if (!(c = Node::make_node()))
+		return errh->error("out of memory!");
+	    if (!n->add_child(*d, c)) {
+		Node::free_node(c);
+		return errh->error("out of memory!");
+	    }
+	}
+	n = c;
+    }
+
+    int l = prefix_len - bit;
+    int i = (1 << l) | (*d >> (node_bits - l));
+    if (n->has_result(i)) {
+	int key = n->result(i);
+	_v[key].gw = gw;
+	_v[key].port = port;
+    } else {
+	int key = alloc_route(addr, gw, prefix_len, port);
+	if (!n->set_result(i, key)) {
+	    free_route(key);
+	    return errh->error("out of memory!");
+	}
+    }
+    return 0;
+}
+
+int
+RadixIP6Lookup::remove_route(IP6Address addr, IP6Address mask, ErrorHandler *errh)
+{
+    int prefix_len = mask.mask_to_prefix_len();
+    if (prefix_len < 0)
+	return errh->error("mask %s is not a prefix", mask.unparse().c_str());
+    addr &= mask;
+
+    if (prefix_len == 0) {
+	if (_default_key < 0)
+	    return -ENOENT;
+	free_route(_default_key);
+	_default_key = -1;
+	return 0;
+    }
+
+    if (prefix_len <= root_bits) {
+	int *kp = _short_keys.begin();
+	while (kp != _short_keys.end()
+	       && (_v[*kp].prefix_len != prefix_len || _v[*kp].addr != addr))
+	    ++kp;
+	if (kp == _short_keys.end())
+	    return -ENOENT;
+	free_route(*kp);
+	*kp = _short_keys.back();
+	_short_keys.pop_back();
+
+	// clear the prefix's entries, then restore any shorter prefixes
+	// that cover it
+	root_change(addr, prefix_len, -1);
+	for (kp = _short_keys.begin(); kp != _short_keys.end(); ++kp)
+	    if (_v[*kp].prefix_len < prefix_len
+		&& addr.matches_prefix(_v[*kp].addr, IP6Address::make_prefix(_v[*kp].prefix_len)))
+		root_change(_v[*kp].addr, _v[*kp].prefix_len, *kp);
+	return 0;
+    }
+
+    // Find the node where the prefix ends, remembering the path so that
+    // emptied nodes can be freed.
+    const unsigned char *d = addr.data();
+    Node *path[128 / 8];
+    int npath = 0;
+    Node *n = _root[root_index(d)].child;
+    int bit = root_bits;
+    d += root_bits / 8;
+    for (; n && prefix_len - bit > node_bits; bit += node_bits, d++) {
+	path[npath++] = n;
+	n = n->child(*d);
+    }
+    if (!n)
+	return -ENOENT;
+
+    int l = prefix_len - bit;
+    int i = (1 << l) | (*d >> (node_bits - l));
+    if (!n->has_result(i))
+	return -ENOENT;
+    free_route(n->result(i));
+    n->remove_result(i);
+
+    while (n->empty()) {
+	Node::free_node(n);
+	if (npath == 0) {
+	    _root[root_index(addr.data())].child = 0;
+	    break;
+	}
+	n = path[--npath];
+	n->remove_child(*--d);
+    }
+    return 0;
+}
+
+int
+RadixIP6Lookup::lookup_route(const IP6Address &addr, IP6Address &gw) const
+{
+    const unsigned char *d = addr.data();
+    const RootEntry &re = _root[root_index(d)];
+    int key = (re.key >= 0 ? re.key : _default_key);
+    key = Node::lookup(re.child, key, d + root_bits / 8);
+    if (key >= 0) {
+	gw = _v[key].gw;
+	return _v[key].port;
+    } else {
+	gw = IP6Address();
+	return -1;
+    }
+}
+
+void
+RadixIP6Lookup::push(int, Packet *p)
+{
+    IP6Address gw;
+    int port = lookup_route(DST_IP6_ANNO(p), gw);
+    if (port >= 0) {
+	if (gw)
+	    SET_DST_IP6_ANNO(p, gw);
+	output(port).push(p);
+    } else
+	p->kill();
+}
+
+String
+RadixIP6Lookup::dump_routes()
+{
+    StringAccum sa;
+    for (int i = 0; i < _v.size(); i++)
+	if (_v[i].port >= 0) {
+	    sa << _v[i].addr << '/' << _v[i].prefix_len;
+	    if (_v[i].gw)
+		sa << '\t' << _v[i].gw;
+	    sa << '\t' << _v[i].port << '\n';
+	}
+    return sa.take_string();
+}
+
+void
+RadixIP6Lookup::add_handlers()
+{
+    add_write_handler("add", add_route_handler, 0);
+    add_write_handler("remove", remove_route_handler, 0);
+    add_write_handler("ctrl", ctrl_handler, 0);
+    add_read_handler("table", table_handler, 0, Handler::EXPENSIVE);
+    set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IP6RouteTable)
+EXPORT_ELEMENT(RadixIP6Lookup)
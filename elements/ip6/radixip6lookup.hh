@@ -0,0 +1,226 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_RADIXIP6LOOKUP_HH
+#define CLICK_RADIXIP6LOOKUP_HH
+#include <click/glue.hh>
+#include <click/element.hh>
+#include <click/ip6address.hh>
+#include "ip6routetable.hh"
+CLICK_DECLS
+
+/*
+=c
+
+RadixIP6Lookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ...)
+
+=s ip6
+
+IP6 lookup using a multibit trie
+
+=d
+
+Performs IP6 lookup using a multibit trie.  The first level of the trie is a
+directly indexed table of 65536 entries covering the first 16 address bits;
+each succeeding level covers 8 bits and is stored as a tree bitmap, so a
+level costs a few hundred bytes however few of its 256 slots are used.  The
+maximum number of levels that will be traversed is 15, and most lookups stop
+after two or three.
+
+Expects a destination IP6 address annotation with each packet.  Looks up that
+address in its routing table, using longest-prefix-match, sets the destination
+annotation to the corresponding GW (if specified), and emits the packet on the
+indicated OUTput port.  Packets that match no route are dropped.
+
+Each argument is a route, specifying a destination and mask, an optional
+gateway IP6 address, and an output port.  Masks must be prefixes.
+
+Unlike LookupIP6Route, whose lookup cost grows linearly with the number of
+routes, RadixIP6Lookup's cost depends only on the length of the matching
+prefix.  Routes can be added and removed at run time.
+
+=h table read-only
+
+Outputs a human-readable version of the current routing table.
+
+=h lookup read-only
+
+Reports the OUTput port and GW corresponding to an address.
+
+=h add write-only
+
+Adds a route to the table.  Format should be `C<ADDR/MASK [GW] OUT>'.  Any
+existing route for C<ADDR/MASK> is replaced.
+
+=h remove write-only
+
+Removes a route from the table.  Format should be `C<ADDR/MASK>'.
+
+=h ctrl write-only
+
+Write `C<add ADDR/MASK [GW] OUT>' to add a route, and `C<remove ADDR/MASK>'
+to remove a route.
+
+=a LookupIP6Route, RadixIPLookup, IP6LookupBenchmark
+*/
+
+class RadixIP6Lookup : public IP6RouteTable { public:
+
+    RadixIP6Lookup();
+    ~RadixIP6Lookup();
+
+    const char *class_name() const		{ return "RadixIP6Lookup"; }
+    const char *port_count() const		{ return "1/-"; }
+    const char *processing() const		{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+
+    int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
+    int remove_route(IP6Address, IP6Address, ErrorHandler *);
+    int lookup_route(const IP6Address &, IP6Address &) const;
+    String dump_routes();
+
+  private:
+
+    class Node;
+
+    struct Route {
+	IP6Address addr;
+	IP6Address gw;
+	int prefix_len;
+	int port;		// -1 for free entries
+	int extra;		// next free entry
+    };
+
+    struct RootEntry {
+	int32_t key;
+	int32_t key_priority;
+	Node *child;
+    };
+
+    enum { root_bits = 16, node_bits = 8 };
+
+    // Route storage
+    Vector<Route> _v;
+    int _vfree;
+
+    // Trie
+    int32_t _default_key;
+    RootEntry *_root;
+    Vector<int> _short_keys;	// routes with prefix_len <= root_bits
+
+    int alloc_route(const IP6Address &, const IP6Address &, int, int);
+    void free_route(int key);
+    void root_change(const IP6Address &addr, int prefix_len, int key);
+    static inline int root_index(const unsigned char *d);
+
+};
+
+
+class RadixIP6Lookup::Node { public:
+
+    static Node *make_node();
+    static void free_node(Node *);
+
+    inline bool has_result(int i) const;
+    inline int32_t result(int i) const;
+    bool set_result(int i, int32_t key);
+    void remove_result(int i);
+
+    inline Node *child(int b) const;
+    bool add_child(int b, Node *child);
+    void remove_child(int b);
+
+    bool empty() const			{ return !_nresults && !_nchildren; }
+
+    static inline int lookup(const Node *, int, const unsigned char *d);
+
+  private:
+
+    // Prefixes ending in this node, with relative length l (1-8) and value
+    // v, set bit (1 << l) | v of _internal.  Children set bit b of
+    // _external.  _results and _children are dense arrays in bit order;
+    // the rank arrays count the set bits in all earlier words.
+    uint32_t _internal[16];
+    uint32_t _external[8];
+    uint16_t _internal_rank[16];
+    uint16_t _external_rank[8];
+    int32_t *_results;
+    Node **_children;
+    int _nresults;
+    int _nchildren;
+
+    Node()
+	: _internal(), _external(), _internal_rank(), _external_rank(),
+	  _results(0), _children(0), _nresults(0), _nchildren(0) {
+    }
+    ~Node()				{ }
+
+    static inline int bitcount(uint32_t x);
+    static inline int rank(const uint32_t *bits, const uint16_t *ranks, int i);
+    static void update_ranks(const uint32_t *bits, uint16_t *ranks, int nwords);
+
+};
+
+inline int
+RadixIP6Lookup::Node::bitcount(uint32_t x)
+{
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    x = (x + (x >> 4)) & 0x0F0F0F0F;
+    return (x * 0x01010101) >> 24;
+}
+
+inline int
+RadixIP6Lookup::Node::rank(const uint32_t *bits, const uint16_t *ranks, int i)
+{
+    return ranks[i >> 5] + bitcount(bits[i >> 5] & ((1U << (i & 31)) - 1));
+}
+
+inline bool
+RadixIP6Lookup::Node::has_result(int i) const
+{
+    return _internal[i >> 5] & (1U << (i & 31));
+}
+
+inline int32_t
+RadixIP6Lookup::Node::result(int i) const
+{
+    return _results[rank(_internal, _internal_rank, i)];
+}
+
+inline RadixIP6Lookup::Node *
+RadixIP6Lookup::Node::child(int b) const
+{
+    if (_external[b >> 5] & (1U << (b & 31)))
+	return _children[rank(_external, _external_rank, b)];
+    else
+	return 0;
+}
+
+inline int
+RadixIP6Lookup::Node::lookup(const Node *n, int cur, const unsigned char *d)
+{
+    while (n) {
+	int b = *d++;
+	// longest prefix ending in this node: try lengths 8, 7, ..., 1
+	for (int i = 256 | b; i > 1; i >>= 1)
+	    if (n->has_result(i)) {
+		cur = n->result(i);
+		break;
+	    }
+	n = n->child(b);
+    }
+    return cur;
+}
+
+inline int
+RadixIP6Lookup::root_index(const unsigned char *d)
+{
+    return (d[0] << 8) | d[1];
+}
+
+CLICK_ENDDECLS
+#endif
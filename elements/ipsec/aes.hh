@@ -3,40 +3,49 @@
 #include <click/element.hh>
 #include <click/glue.hh>
 CLICK_DECLS
+class SADataTuple;
 
 /*
  * =c
- * IPsecAES(ENCRYPT)
+ * IPsecAES(ENCRYPT [, I<keywords> MODE, BATCH])
  * =s ipsec
- * encrypt packet using DES-CBC
+ * encrypt packet using AES
  * =d
  *
- * Encrypts or decrypts packet using DES-CBC. If the first argument is 0,
+ * Encrypts or decrypts packet using 128-bit AES. If the first argument is 0,
  * IPsecAES will decrypt. If the first argument is 1, IPsecAES will encrypt.
- * KEY is the DES secret key. Gets IV value from ESP header. IGNORE is the
- * number of bytes at the end of the payload to ignore. By default, IGNORE is
- * 12, which is the number of SHA1 authentication digest bytes for ESP or AH.
+ * The key is taken from the SADataTuple referenced by the packet's IPsec SA
+ * data annotation. Gets IV value from ESP header. The last 12 bytes of the
+ * payload, the SHA1 authentication digest for ESP or AH, are not encrypted.
  *
- * =a IPsecESPEncap, IPsecESPUnencap, IPsecAuthSHA1
+ * IPsecAES uses AES-NI when the CPU supports it; see IPsecCrypto.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item MODE
+ *
+ * Either C<CBC> or C<CTR>. In CBC mode, only the first 8 bytes of each
+ * 16-byte block are chained, and if the payload is not a multiple of 16 bytes
+ * the first 8 digest bytes are encrypted too. CTR mode encrypts exactly the
+ * payload, using the RFC 3686 counter block with a zero nonce. Both ends of
+ * an SA must use the same mode. Default is CBC.
+ *
+ * =item BATCH
+ *
+ * Integer between 1 and 32. When IPsecAES is used in a pull context, it pulls
+ * up to BATCH packets at a time and encrypts them together, interleaving
+ * several packets on the AES units. This speeds up CBC encryption, which is
+ * serial within a packet. Push contexts always process one packet at a time.
+ * Batched packets wait in the element between pulls, so with BATCH above 1
+ * only one thread may pull from it. Default is 1.
+ *
+ * =back
+ *
+ * =a IPsecESPEncap, IPsecESPUnencap, IPsecAuthSHA1, IPsecAuthHMACSHA1
  */
 
-# define GETU32(pt) (((unsigned long)(pt)[0] << 24) ^ ((unsigned long)(pt)[1] << 16) ^ ((unsigned long)(pt)[2] <<  8) ^ ((unsigned long)(pt)[3]))
-# define PUTU32(ct, st) { (ct)[0] = (char)((st) >> 24); (ct)[1] = (char)((st) >> 16); (ct)[2] = (char)((st) >>  8); (ct)[3] = (char)(st); }
-/*#endif*/
-
-#define AES_MAXNR 14
-#define AES_BLOCK_SIZE 16
-
-struct aes_key_st {
-    unsigned long rd_key[4 *(AES_MAXNR + 1)];
-    int rounds;
-};
-typedef struct aes_key_st AES_KEY;
-
-
-class Address;
-
-
 class Aes : public Element {
  public:
    Aes();
@@ -49,19 +58,27 @@ class Aes : public Element {
 
    int configure(Vector<String> &, ErrorHandler *);
    int initialize(ErrorHandler *);
+   void cleanup(CleanupStage);
 
    Packet *simple_action(Packet *);
+   Packet *pull(int);
 
    enum { AES_DECRYPT = 0, AES_ENCRYPT = 1 };
+   enum { MODE_CBC = 0, MODE_CTR = 1 };
+   enum { BATCH_MAX = 32 };
 
  private:
-   int AES_set_encrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
-   int AES_set_decrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
-   void AES_encrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
-   void AES_decrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
    unsigned _op;
    int _ignore;
-   AES_KEY _key;
+   int _mode;
+   int _batch;
+
+   Packet *_stash[BATCH_MAX];
+   int _stash_head;
+   int _stash_tail;
+
+   WritablePacket *prepare(Packet *, SADataTuple *&, unsigned char *&, int &);
+   void process_batch(Packet **, int);
 };
 
 CLICK_ENDDECLS
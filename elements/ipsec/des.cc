@@ -89,7 +89,7 @@ Des::simple_action(Packet *p_in)
   /*sanity check*/
      if(sa_data==NULL) {click_chatter("DES: No SADataTuple annotation. Check man page\n"); p->kill(); return 0;}
   /*Set the key*/
-  des_set_key((unsigned char (*)[8])&sa_data->Encryption_key, _ks);
+  des_set_key((unsigned char (*)[8])&sa_data->keys->Encryption_key, _ks);
 
   // de/encrypt the payload
   while (plen > 0) {
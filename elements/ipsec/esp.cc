@@ -74,12 +74,7 @@ IPsecESPEncap::simple_action(Packet *p)
   // copy in ESP header
   // Get SPI from packet user annotation. This is the fourth user integer.
   esp->esp_spi = htonl((uint32_t)IPSEC_SPI_ANNO(p));
-  esp->esp_rpl = htonl(sa_data->cur_rpl);
-
-  if((sa_data->cur_rpl++) == 0) {
-	//if the replay counter rolls over...set it to the agreed start value
-        sa_data->cur_rpl = sa_data->replay_start_counter;
-  }
+  esp->esp_rpl = htonl(sa_data->next_sequence());
   i = click_random() >> 2;
   memmove(&esp->esp_iv[0], &i, 4);
   i = click_random() >> 2;
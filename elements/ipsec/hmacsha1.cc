@@ -28,15 +28,15 @@
 #include <click/glue.hh>
 #include <click/packet_anno.hh>
 
-#include "elements/ipsec/hmac.hh"
+#include "elements/ipsec/ipseccrypto.hh"
 #include "satable.hh"
 #include "sadatatuple.hh"
 CLICK_DECLS
 
 #define SHA_DIGEST_LEN 20
-#define KEY_SIZE 16
 
 IPsecAuthHMACSHA1::IPsecAuthHMACSHA1()
+  : _batch(1), _stash_head(0), _stash_tail(0)
 {
 }
 
@@ -47,9 +47,14 @@ IPsecAuthHMACSHA1::~IPsecAuthHMACSHA1()
 int
 IPsecAuthHMACSHA1::configure(Vector<String> &conf, ErrorHandler *errh)
 {
+  _batch = 1;
   if (cp_va_kparse(conf, this, errh,
-		   "VERIFY", cpkP+cpkM, cpInteger, &_op, cpEnd) < 0)
+		   "VERIFY", cpkP+cpkM, cpInteger, &_op,
+		   "BATCH", 0, cpInteger, &_batch,
+		   cpEnd) < 0)
     return -1;
+  if (_batch < 1 || _batch > BATCH_MAX)
+    return errh->error("BATCH must be between 1 and %d", BATCH_MAX);
   return 0;
 }
 
@@ -61,17 +66,19 @@ IPsecAuthHMACSHA1::initialize(ErrorHandler *)
 }
 
 
-Packet *
-IPsecAuthHMACSHA1::simple_action(Packet *p)
+void
+IPsecAuthHMACSHA1::cleanup(CleanupStage)
 {
-  SADataTuple * sa_data=(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
-  unsigned int len;
-  // compute HMAC
-  len = SHA_DIGEST_LEN;
+  while (_stash_head < _stash_tail)
+    _stash[_stash_head++]->kill();
+}
 
+// Appends or checks the first 12 bytes of DIGEST, the HMAC of P's data
+// (less the received digest when verifying).
+Packet *
+IPsecAuthHMACSHA1::finish(Packet *p, const unsigned char *digest)
+{
   if (_op == COMPUTE_AUTH) {
-    unsigned char digest [SHA_DIGEST_LEN];
-    HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length(),digest,&len);
     WritablePacket *q = p->put(12);
     u_char *ah = ((u_char*)q->data())+q->length()-12;
     memmove(ah, digest, 12);
@@ -79,9 +86,6 @@ IPsecAuthHMACSHA1::simple_action(Packet *p)
   }
   else {
     const u_char *ah = p->data()+p->length()-12;
-    unsigned char digest [SHA_DIGEST_LEN];
-
-    HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length()-12,digest,&len);
     if (memcmp(ah, digest, 12)) {
       if (_drops == 0)
 	click_chatter("Invalid SHA1 authentication digest");
@@ -98,6 +102,63 @@ IPsecAuthHMACSHA1::simple_action(Packet *p)
   }
 }
 
+Packet *
+IPsecAuthHMACSHA1::simple_action(Packet *p)
+{
+  SADataTuple * sa_data=(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
+  unsigned char digest [SHA_DIGEST_LEN];
+  int len = p->length() - (_op == COMPUTE_AUTH ? 0 : 12);
+  // compute HMAC
+  IPsecCrypto::hmac_sha1(sa_data->keys->Authentication_key, p->data(), len, digest);
+  return finish(p, digest);
+}
+
+void
+IPsecAuthHMACSHA1::process_batch(Packet **batch, int n)
+{
+  // zeroed so the compiler can see the arrays are set before the call
+  const unsigned char *key[BATCH_MAX] = { 0 };
+  const unsigned char *data[BATCH_MAX] = { 0 };
+  int len[BATCH_MAX] = { 0 };
+  unsigned char digest[BATCH_MAX][SHA_DIGEST_LEN];
+  unsigned char *digestp[BATCH_MAX] = { 0 };
+
+  for (int i = 0; i < n; i++) {
+    SADataTuple *sa_data = (SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(batch[i]);
+    key[i] = sa_data->keys->Authentication_key;
+    data[i] = batch[i]->data();
+    len[i] = batch[i]->length() - (_op == COMPUTE_AUTH ? 0 : 12);
+    digestp[i] = digest[i];
+  }
+  IPsecCrypto::hmac_sha1_multi(key, data, len, digestp, n);
+
+  _stash_head = _stash_tail = 0;
+  for (int i = 0; i < n; i++)
+    if (Packet *p = finish(batch[i], digest[i]))
+      _stash[_stash_tail++] = p;
+}
+
+Packet *
+IPsecAuthHMACSHA1::pull(int)
+{
+  if (_batch == 1) {
+    Packet *p = input(0).pull();
+    return p ? simple_action(p) : 0;
+  }
+
+  // As in IPsecAES, only return null when upstream has nothing.
+  while (_stash_head == _stash_tail) {
+    Packet *batch[BATCH_MAX];
+    int n = 0;
+    while (n < _batch && (batch[n] = input(0).pull()))
+      n++;
+    if (n == 0)
+      return 0;
+    process_batch(batch, n);
+  }
+  return _stash[_stash_head++];
+}
+
 String
 IPsecAuthHMACSHA1::drop_handler(Element *e, void *)
 {
@@ -111,9 +172,6 @@ IPsecAuthHMACSHA1::add_handlers()
   add_read_handler("drops", drop_handler, 0);
 }
 
-#include "sha1_impl.cc"
-#include "hmac.cc"
-
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecCrypto)
 EXPORT_ELEMENT(IPsecAuthHMACSHA1)
-ELEMENT_MT_SAFE(IPsecAuthHMACSHA1)
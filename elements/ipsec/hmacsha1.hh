@@ -7,7 +7,7 @@ CLICK_DECLS
 
 /*
  * =c
- * IPsecAuthHMACSHA1(VERIFY)
+ * IPsecAuthHMACSHA1(VERIFY [, I<keywords> BATCH])
  * =s ipsec
  * verify SHA1 authentication digest.
  * =d
@@ -16,6 +16,24 @@ CLICK_DECLS
  * per RFC 2404, 2406. If first argument is 1, verify SHA1 digest and remove
  * authentication bits.
  *
+ * IPsecAuthHMACSHA1 uses the SHA extensions when the CPU supports them; see
+ * IPsecCrypto.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item BATCH
+ *
+ * Integer between 1 and 32. When IPsecAuthHMACSHA1 is used in a pull context,
+ * it pulls up to BATCH packets at a time and digests them together,
+ * interleaving several packets on the SIMD units. Push contexts always
+ * process one packet at a time. Batched packets wait in the element between
+ * pulls, so with BATCH above 1 only one thread may pull from it. Default
+ * is 1.
+ *
+ * =back
+ *
  * =a IPsecESPEncap, IPsecDES
  */
 
@@ -31,8 +49,10 @@ public:
 
   int configure(Vector<String> &, ErrorHandler *);
   int initialize(ErrorHandler *);
+  void cleanup(CleanupStage);
 
   Packet *simple_action(Packet *);
+  Packet *pull(int);
   void add_handlers();
 
   static String drop_handler(Element *e, void *thunk);
@@ -40,9 +60,18 @@ public:
 private:
 
   int _op;
+  int _batch;
   atomic_uint32_t _drops;
 
   enum { COMPUTE_AUTH = 0, VERIFY_AUTH = 1 };
+  enum { BATCH_MAX = 32 };
+
+  Packet *_stash[BATCH_MAX];
+  int _stash_head;
+  int _stash_tail;
+
+  Packet *finish(Packet *, const unsigned char *digest);
+  void process_batch(Packet **, int);
 };
 
 CLICK_ENDDECLS
@@ -0,0 +1,748 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipseccrypto.{cc,hh} -- AES and SHA-1 routines shared by the IPsec elements
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "ipseccrypto.hh"
+#include "elements/ipsec/hmac.hh"
+#if IPSEC_CRYPTO_X86
+# include <immintrin.h>
+# include <cpuid.h>
+#endif
+CLICK_DECLS
+
+#include "aes_impl.cc"
+#include "sha1_impl.cc"
+#include "hmac.cc"
+
+void
+IPsecCrypto::aes_set_key(IPsecAESKey *key, const unsigned char *user_key)
+{
+    AES_set_encrypt_key(user_key, 128, &key->enc);
+    AES_set_decrypt_key(user_key, 128, &key->dec);
+#if IPSEC_CRYPTO_X86
+    // The table-driven decryption schedule is already in the order, and
+    // has the InvMixColumns transform, that AESDEC expects.
+    for (int i = 0; i < 44; i++) {
+	PUTU32(key->ni_enc + 4 * i, key->enc.rd_key[i]);
+	PUTU32(key->ni_dec + 4 * i, key->dec.rd_key[i]);
+    }
+#endif
+}
+
+
+// portable versions
+
+static void
+cbc_encrypt_portable(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    const unsigned char *chain = iv;
+    for (; len > 0; len -= 16, data += 16) {
+	for (int i = 0; i < 8; i++)
+	    data[i] ^= chain[i];
+	AES_encrypt(data, data, &key->enc);
+	chain = data;
+    }
+}
+
+static void
+cbc_decrypt_portable(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    unsigned char chain[8], hold[8];
+    memcpy(chain, iv, 8);
+    for (; len > 0; len -= 16, data += 16) {
+	memcpy(hold, data, 8);
+	AES_decrypt(data, data, &key->dec);
+	for (int i = 0; i < 8; i++)
+	    data[i] ^= chain[i];
+	memcpy(chain, hold, 8);
+    }
+}
+
+static void
+ctr_portable(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    unsigned char block[16];
+    for (uint32_t ctr = 1; len > 0; ctr++, data += 16, len -= 16) {
+	memset(block, 0, 4);
+	memcpy(block + 4, iv, 8);
+	block[12] = ctr >> 24;
+	block[13] = ctr >> 16;
+	block[14] = ctr >> 8;
+	block[15] = ctr;
+	AES_encrypt(block, block, &key->enc);
+	for (int i = 0; i < 16 && i < len; i++)
+	    data[i] ^= block[i];
+    }
+}
+
+static void
+cbc_encrypt_multi_portable(const IPsecAESKey * const *key, unsigned char * const *data, const int *len, const unsigned char * const *iv, int n)
+{
+    for (int i = 0; i < n; i++)
+	cbc_encrypt_portable(key[i], data[i], len[i], iv[i]);
+}
+
+static void
+sha1_portable(const unsigned char *data, int len, unsigned char *digest)
+{
+    SHA1_ctx ctx;
+    SHA1_init(&ctx);
+    SHA1_update(&ctx, const_cast<unsigned char *>(data), len);
+    SHA1_final(digest, &ctx);
+}
+
+static void
+hmac_sha1_multi_portable(const unsigned char * const *key, const unsigned char * const *data, const int *len, unsigned char * const *digest, int n)
+{
+    for (int i = 0; i < n; i++) {
+	unsigned int md_len = IPsecCrypto::SHA1_DIGEST_SIZE;
+	HMAC(const_cast<unsigned char *>(key[i]), IPsecCrypto::KEY_BYTES,
+	     const_cast<unsigned char *>(data[i]), len[i], digest[i], &md_len);
+    }
+}
+
+
+#if IPSEC_CRYPTO_X86
+// AES-NI versions
+
+# define IPSEC_AESNI __attribute__((target("aes,sse4.1")))
+
+IPSEC_AESNI static inline void
+aesni_load_keys(__m128i *k, const unsigned char *schedule)
+{
+    for (int r = 0; r < 11; r++)
+	k[r] = _mm_loadu_si128((const __m128i *) schedule + r);
+}
+
+IPSEC_AESNI static inline __m128i
+aesni_encrypt(__m128i x, const __m128i *k)
+{
+    x = _mm_xor_si128(x, k[0]);
+    for (int r = 1; r < 10; r++)
+	x = _mm_aesenc_si128(x, k[r]);
+    return _mm_aesenclast_si128(x, k[10]);
+}
+
+IPSEC_AESNI static void
+cbc_encrypt_aesni(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    __m128i k[11];
+    aesni_load_keys(k, key->ni_enc);
+    // _mm_move_epi64 keeps the low 8 bytes, which are all that is chained
+    __m128i chain = _mm_loadl_epi64((const __m128i *) iv);
+    for (; len > 0; len -= 16, data += 16) {
+	__m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *) data), chain);
+	x = aesni_encrypt(x, k);
+	_mm_storeu_si128((__m128i *) data, x);
+	chain = _mm_move_epi64(x);
+    }
+}
+
+IPSEC_AESNI static void
+cbc_decrypt_aesni(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    __m128i k[11];
+    aesni_load_keys(k, key->ni_dec);
+    __m128i chain = _mm_loadl_epi64((const __m128i *) iv);
+
+    // blocks decrypt independently, so keep four in flight
+    for (; len >= 64; len -= 64, data += 64) {
+	__m128i *p = (__m128i *) data;
+	__m128i c0 = _mm_loadu_si128(p), c1 = _mm_loadu_si128(p + 1),
+	    c2 = _mm_loadu_si128(p + 2), c3 = _mm_loadu_si128(p + 3);
+	__m128i x0 = _mm_xor_si128(c0, k[0]), x1 = _mm_xor_si128(c1, k[0]),
+	    x2 = _mm_xor_si128(c2, k[0]), x3 = _mm_xor_si128(c3, k[0]);
+	for (int r = 1; r < 10; r++) {
+	    x0 = _mm_aesdec_si128(x0, k[r]);
+	    x1 = _mm_aesdec_si128(x1, k[r]);
+	    x2 = _mm_aesdec_si128(x2, k[r]);
+	    x3 = _mm_aesdec_si128(x3, k[r]);
+	}
+	x0 = _mm_xor_si128(_mm_aesdeclast_si128(x0, k[10]), chain);
+	x1 = _mm_xor_si128(_mm_aesdeclast_si128(x1, k[10]), _mm_move_epi64(c0));
+	x2 = _mm_xor_si128(_mm_aesdeclast_si128(x2, k[10]), _mm_move_epi64(c1));
+	x3 = _mm_xor_si128(_mm_aesdeclast_si128(x3, k[10]), _mm_move_epi64(c2));
+	_mm_storeu_si128(p, x0);
+	_mm_storeu_si128(p + 1, x1);
+	_mm_storeu_si128(p + 2, x2);
+	_mm_storeu_si128(p + 3, x3);
+	chain = _mm_move_epi64(c3);
+    }
+
+    for (; len > 0; len -= 16, data += 16) {
+	__m128i c = _mm_loadu_si128((const __m128i *) data);
+	__m128i x = _mm_xor_si128(c, k[0]);
+	for (int r = 1; r < 10; r++)
+	    x = _mm_aesdec_si128(x, k[r]);
+	x = _mm_xor_si128(_mm_aesdeclast_si128(x, k[10]), chain);
+	_mm_storeu_si128((__m128i *) data, x);
+	chain = _mm_move_epi64(c);
+    }
+}
+
+IPSEC_AESNI static void
+ctr_aesni(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    __m128i k[11];
+    aesni_load_keys(k, key->ni_enc);
+    // nonce (zero) in bytes 0-3, IV in bytes 4-11, counter in bytes 12-15
+    __m128i base = _mm_slli_si128(_mm_loadl_epi64((const __m128i *) iv), 4);
+    uint32_t ctr = 1;
+
+    for (; len >= 64; len -= 64, data += 64, ctr += 4) {
+	__m128i *p = (__m128i *) data;
+	__m128i x0 = _mm_insert_epi32(base, __builtin_bswap32(ctr), 3),
+	    x1 = _mm_insert_epi32(base, __builtin_bswap32(ctr + 1), 3),
+	    x2 = _mm_insert_epi32(base, __builtin_bswap32(ctr + 2), 3),
+	    x3 = _mm_insert_epi32(base, __builtin_bswap32(ctr + 3), 3);
+	x0 = _mm_xor_si128(x0, k[0]);
+	x1 = _mm_xor_si128(x1, k[0]);
+	x2 = _mm_xor_si128(x2, k[0]);
+	x3 = _mm_xor_si128(x3, k[0]);
+	for (int r = 1; r < 10; r++) {
+	    x0 = _mm_aesenc_si128(x0, k[r]);
+	    x1 = _mm_aesenc_si128(x1, k[r]);
+	    x2 = _mm_aesenc_si128(x2, k[r]);
+	    x3 = _mm_aesenc_si128(x3, k[r]);
+	}
+	_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), _mm_aesenclast_si128(x0, k[10])));
+	_mm_storeu_si128(p + 1, _mm_xor_si128(_mm_loadu_si128(p + 1), _mm_aesenclast_si128(x1, k[10])));
+	_mm_storeu_si128(p + 2, _mm_xor_si128(_mm_loadu_si128(p + 2), _mm_aesenclast_si128(x2, k[10])));
+	_mm_storeu_si128(p + 3, _mm_xor_si128(_mm_loadu_si128(p + 3), _mm_aesenclast_si128(x3, k[10])));
+    }
+
+    for (; len > 0; len -= 16, data += 16, ctr++) {
+	__m128i x = aesni_encrypt(_mm_insert_epi32(base, __builtin_bswap32(ctr), 3), k);
+	if (len >= 16)
+	    _mm_storeu_si128((__m128i *) data, _mm_xor_si128(_mm_loadu_si128((const __m128i *) data), x));
+	else {
+	    unsigned char block[16];
+	    _mm_storeu_si128((__m128i *) block, x);
+	    for (int i = 0; i < len; i++)
+		data[i] ^= block[i];
+	}
+    }
+}
+
+IPSEC_AESNI static void
+cbc_encrypt_multi_aesni(const IPsecAESKey * const *key, unsigned char * const *data, const int *len, const unsigned char * const *iv, int n)
+{
+    enum { L = IPsecCrypto::LANES };
+    for (int i = 0; i < n; i += L) {
+	int g = (n - i < L ? n - i : L);
+	if (g == 1) {
+	    cbc_encrypt_aesni(key[i], data[i], len[i], iv[i]);
+	    break;
+	}
+
+	// Unused lanes encrypt a scratch block in place.
+	__m128i chain[L];
+	unsigned char *p[L];
+	const unsigned char *ks[L];
+	int step[L];
+	unsigned char scratch[16];
+	int common = -1;
+	for (int j = 0; j < L; j++)
+	    if (j < g) {
+		chain[j] = _mm_loadl_epi64((const __m128i *) iv[i + j]);
+		p[j] = data[i + j];
+		ks[j] = key[i + j]->ni_enc;
+		step[j] = 16;
+		int nblocks = (len[i + j] > 0 ? (len[i + j] + 15) / 16 : 0);
+		if (common < 0 || nblocks < common)
+		    common = nblocks;
+	    } else {
+		chain[j] = _mm_setzero_si128();
+		p[j] = scratch;
+		ks[j] = key[i]->ni_enc;
+		step[j] = 0;
+	    }
+
+	// Four named lanes, so the compiler keeps them in registers.
+	__m128i c0 = chain[0], c1 = chain[1], c2 = chain[2], c3 = chain[3];
+	const __m128i *k0 = (const __m128i *) ks[0], *k1 = (const __m128i *) ks[1],
+	    *k2 = (const __m128i *) ks[2], *k3 = (const __m128i *) ks[3];
+	for (int b = 0; b < common; b++) {
+	    __m128i x0 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *) p[0]), c0), _mm_loadu_si128(k0));
+	    __m128i x1 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *) p[1]), c1), _mm_loadu_si128(k1));
+	    __m128i x2 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *) p[2]), c2), _mm_loadu_si128(k2));
+	    __m128i x3 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *) p[3]), c3), _mm_loadu_si128(k3));
+	    for (int r = 1; r < 10; r++) {
+		x0 = _mm_aesenc_si128(x0, _mm_loadu_si128(k0 + r));
+		x1 = _mm_aesenc_si128(x1, _mm_loadu_si128(k1 + r));
+		x2 = _mm_aesenc_si128(x2, _mm_loadu_si128(k2 + r));
+		x3 = _mm_aesenc_si128(x3, _mm_loadu_si128(k3 + r));
+	    }
+	    x0 = _mm_aesenclast_si128(x0, _mm_loadu_si128(k0 + 10));
+	    x1 = _mm_aesenclast_si128(x1, _mm_loadu_si128(k1 + 10));
+	    x2 = _mm_aesenclast_si128(x2, _mm_loadu_si128(k2 + 10));
+	    x3 = _mm_aesenclast_si128(x3, _mm_loadu_si128(k3 + 10));
+	    _mm_storeu_si128((__m128i *) p[0], x0);
+	    _mm_storeu_si128((__m128i *) p[1], x1);
+	    _mm_storeu_si128((__m128i *) p[2], x2);
+	    _mm_storeu_si128((__m128i *) p[3], x3);
+	    c0 = _mm_move_epi64(x0);
+	    c1 = _mm_move_epi64(x1);
+	    c2 = _mm_move_epi64(x2);
+	    c3 = _mm_move_epi64(x3);
+	    p[0] += step[0];
+	    p[1] += step[1];
+	    p[2] += step[2];
+	    p[3] += step[3];
+	}
+	chain[0] = c0, chain[1] = c1, chain[2] = c2, chain[3] = c3;
+
+	for (int j = 0; j < g; j++)
+	    if (len[i + j] > common * 16) {
+		unsigned char next_iv[8];
+		_mm_storel_epi64((__m128i *) next_iv, chain[j]);
+		cbc_encrypt_aesni(key[i + j], p[j], len[i + j] - common * 16, next_iv);
+	    }
+    }
+}
+
+
+// SHA-1 versions
+
+static inline uint32_t
+sha1_rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t
+sha1_load_be32(const unsigned char *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static const uint32_t sha1_init_state[5] = {
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+#define SHA1_SCALAR_STEP(f, k, t) do {					\
+	if ((t) >= 16)							\
+	    w[(t) & 15] = sha1_rol(w[((t) + 13) & 15] ^ w[((t) + 8) & 15] \
+				   ^ w[((t) + 2) & 15] ^ w[(t) & 15], 1); \
+	uint32_t tmp = sha1_rol(a, 5) + (f) + e + (k) + w[(t) & 15];	\
+	e = d; d = c; c = sha1_rol(b, 30); b = a; a = tmp;		\
+    } while (0)
+
+static void
+sha1_compress_scalar(uint32_t *h, const unsigned char *p, size_t nblocks)
+{
+    for (; nblocks; nblocks--, p += 64) {
+	uint32_t w[16], a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+	for (int t = 0; t < 16; t++)
+	    w[t] = sha1_load_be32(p + 4 * t);
+	for (int t = 0; t < 20; t++)
+	    SHA1_SCALAR_STEP((b & c) | (~b & d), 0x5A827999, t);
+	for (int t = 20; t < 40; t++)
+	    SHA1_SCALAR_STEP(b ^ c ^ d, 0x6ED9EBA1, t);
+	for (int t = 40; t < 60; t++)
+	    SHA1_SCALAR_STEP((b & c) | (d & (b | c)), 0x8F1BBCDC, t);
+	for (int t = 60; t < 80; t++)
+	    SHA1_SCALAR_STEP(b ^ c ^ d, 0xCA62C1D6, t);
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+    }
+}
+
+// Four rounds with the SHA extensions.  The message schedule runs three
+// groups ahead: group g consumes M0, finishes M1 (SHA1MSG2), adds M0 into M2,
+// and starts M3 (SHA1MSG1) for group g + 3.  In the last groups some of this
+// work is unused, which is harmless.
+#define SHA1_NI_GROUP(E_in, E_out, M0, M1, M2, M3, f)	\
+    E_in = _mm_sha1nexte_epu32(E_in, M0);		\
+    E_out = abcd;					\
+    M1 = _mm_sha1msg2_epu32(M1, M0);			\
+    abcd = _mm_sha1rnds4_epu32(abcd, E_in, f);		\
+    M3 = _mm_sha1msg1_epu32(M3, M0);			\
+    M2 = _mm_xor_si128(M2, M0)
+
+__attribute__((target("sha,sse4.1"))) static void
+sha1_compress_shani(uint32_t *h, const unsigned char *p, size_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) h), 0x1B);
+    __m128i e0 = _mm_set_epi32(h[4], 0, 0, 0), e1;
+
+    for (; nblocks; nblocks--, p += 64) {
+	__m128i abcd_save = abcd, e0_save = e0;
+	__m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) p), bswap);
+	__m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16)), bswap);
+	__m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 32)), bswap);
+	__m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 48)), bswap);
+
+	// rounds 0-15: the schedule is still being loaded
+	e0 = _mm_add_epi32(e0, m0);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+	e1 = _mm_sha1nexte_epu32(e1, m1);
+	e0 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+	m0 = _mm_sha1msg1_epu32(m0, m1);
+
+	e0 = _mm_sha1nexte_epu32(e0, m2);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	m1 = _mm_sha1msg1_epu32(m1, m2);
+	m0 = _mm_xor_si128(m0, m2);
+
+	SHA1_NI_GROUP(e1, e0, m3, m0, m1, m2, 0);
+
+	// rounds 16-79
+	SHA1_NI_GROUP(e0, e1, m0, m1, m2, m3, 0);
+	SHA1_NI_GROUP(e1, e0, m1, m2, m3, m0, 1);
+	SHA1_NI_GROUP(e0, e1, m2, m3, m0, m1, 1);
+	SHA1_NI_GROUP(e1, e0, m3, m0, m1, m2, 1);
+	SHA1_NI_GROUP(e0, e1, m0, m1, m2, m3, 1);
+	SHA1_NI_GROUP(e1, e0, m1, m2, m3, m0, 1);
+	SHA1_NI_GROUP(e0, e1, m2, m3, m0, m1, 2);
+	SHA1_NI_GROUP(e1, e0, m3, m0, m1, m2, 2);
+	SHA1_NI_GROUP(e0, e1, m0, m1, m2, m3, 2);
+	SHA1_NI_GROUP(e1, e0, m1, m2, m3, m0, 2);
+	SHA1_NI_GROUP(e0, e1, m2, m3, m0, m1, 2);
+	SHA1_NI_GROUP(e1, e0, m3, m0, m1, m2, 3);
+	SHA1_NI_GROUP(e0, e1, m0, m1, m2, m3, 3);
+	SHA1_NI_GROUP(e1, e0, m1, m2, m3, m0, 3);
+	SHA1_NI_GROUP(e0, e1, m2, m3, m0, m1, 3);
+	SHA1_NI_GROUP(e1, e0, m3, m0, m1, m2, 3);
+
+	e0 = _mm_sha1nexte_epu32(e0, e0_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *) h, _mm_shuffle_epi32(abcd, 0x1B));
+    h[4] = _mm_extract_epi32(e0, 3);
+}
+
+#define SHA1_X4_ROL(x, n) _mm_or_si128(_mm_slli_epi32((x), (n)), _mm_srli_epi32((x), 32 - (n)))
+#define SHA1_X4_STEP(f, k, t) do {					\
+	if ((t) >= 16)							\
+	    w[(t) & 15] = SHA1_X4_ROL(_mm_xor_si128(_mm_xor_si128(w[((t) + 13) & 15], w[((t) + 8) & 15]), \
+						    _mm_xor_si128(w[((t) + 2) & 15], w[(t) & 15])), 1); \
+	__m128i tmp = _mm_add_epi32(_mm_add_epi32(SHA1_X4_ROL(a, 5), (f)), \
+				    _mm_add_epi32(_mm_add_epi32(e, (k)), w[(t) & 15])); \
+	e = d; d = c; c = SHA1_X4_ROL(b, 30); b = a; a = tmp;		\
+    } while (0)
+
+// One block of four independent messages, one per 32-bit lane.
+__attribute__((target("sse2"))) static void
+sha1_compress_x4(__m128i *s, const unsigned char * const *p)
+{
+    __m128i w[16];
+    for (int t = 0; t < 16; t++)
+	w[t] = _mm_set_epi32(sha1_load_be32(p[3] + 4 * t), sha1_load_be32(p[2] + 4 * t),
+			     sha1_load_be32(p[1] + 4 * t), sha1_load_be32(p[0] + 4 * t));
+    __m128i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4];
+    __m128i k = _mm_set1_epi32(0x5A827999);
+    for (int t = 0; t < 20; t++)
+	SHA1_X4_STEP(_mm_or_si128(_mm_and_si128(b, c), _mm_andnot_si128(b, d)), k, t);
+    k = _mm_set1_epi32(0x6ED9EBA1);
+    for (int t = 20; t < 40; t++)
+	SHA1_X4_STEP(_mm_xor_si128(_mm_xor_si128(b, c), d), k, t);
+    k = _mm_set1_epi32(0x8F1BBCDC);
+    for (int t = 40; t < 60; t++)
+	SHA1_X4_STEP(_mm_or_si128(_mm_and_si128(b, c), _mm_and_si128(d, _mm_or_si128(b, c))), k, t);
+    k = _mm_set1_epi32(0xCA62C1D6);
+    for (int t = 60; t < 80; t++)
+	SHA1_X4_STEP(_mm_xor_si128(_mm_xor_si128(b, c), d), k, t);
+    s[0] = _mm_add_epi32(s[0], a);
+    s[1] = _mm_add_epi32(s[1], b);
+    s[2] = _mm_add_epi32(s[2], c);
+    s[3] = _mm_add_epi32(s[3], d);
+    s[4] = _mm_add_epi32(s[4], e);
+}
+
+typedef void (*sha1_compress_function)(uint32_t *, const unsigned char *, size_t);
+static sha1_compress_function sha1_compress = sha1_compress_scalar;
+
+// A message to hash: an optional 16-byte prefix (an HMAC pad) followed by
+// LEN bytes of data, then SHA-1 padding.
+struct SHA1Message {
+    const unsigned char *prefix;
+    const unsigned char *data;
+    int len;
+    int total;
+    int nblocks;
+
+    void assign(const unsigned char *prefix_, const unsigned char *data_, int len_) {
+	prefix = prefix_;
+	data = data_;
+	len = len_;
+	total = (prefix ? 16 : 0) + len;
+	nblocks = (total + 8) / 64 + 1;
+    }
+
+    // Returns block K of the padded message.  Whole blocks of data are
+    // returned in place; others are assembled in TMP.
+    const unsigned char *block(int k, unsigned char *tmp) const {
+	int off = k * 64 - (total - len);
+	if (off >= 0 && off + 64 <= len)
+	    return data + off;
+	memset(tmp, 0, 64);
+	int pos = 0;
+	if (off < 0) {
+	    memcpy(tmp, prefix, -off);
+	    pos = -off;
+	    off = 0;
+	}
+	if (off < len) {
+	    int n = (len - off < 64 - pos ? len - off : 64 - pos);
+	    memcpy(tmp + pos, data + off, n);
+	}
+	int term = total - k * 64;
+	if (term >= 0 && term < 64)
+	    tmp[term] = 0x80;
+	if (k == nblocks - 1) {
+	    uint64_t bits = (uint64_t) total * 8;
+	    for (int i = 0; i < 8; i++)
+		tmp[56 + i] = bits >> (56 - 8 * i);
+	}
+	return tmp;
+    }
+
+    // Hashes blocks K onward into H, and writes the digest.
+    void finish(int k, uint32_t *h, unsigned char *digest) const {
+	unsigned char tmp[64];
+	while (k < nblocks) {
+	    const unsigned char *b = block(k, tmp);
+	    int n = 1;
+	    if (b != tmp)	// run of whole data blocks
+		n = (len - (k * 64 - (total - len))) / 64;
+	    sha1_compress(h, b, n);
+	    k += n;
+	}
+	for (int i = 0; i < 5; i++) {
+	    digest[4 * i] = h[i] >> 24;
+	    digest[4 * i + 1] = h[i] >> 16;
+	    digest[4 * i + 2] = h[i] >> 8;
+	    digest[4 * i + 3] = h[i];
+	}
+    }
+};
+
+static void
+sha1_accel(const unsigned char *data, int len, unsigned char *digest)
+{
+    SHA1Message m;
+    m.assign(0, data, len);
+    uint32_t h[5];
+    memcpy(h, sha1_init_state, sizeof(h));
+    m.finish(0, h, digest);
+}
+
+// Hashes four messages, in lockstep as long as all have blocks left.
+__attribute__((target("sse2"))) static void
+sha1_x4(const SHA1Message *m, unsigned char (*digest)[20])
+{
+    enum { L = IPsecCrypto::LANES };
+    __m128i s[5];
+    for (int i = 0; i < 5; i++)
+	s[i] = _mm_set1_epi32(sha1_init_state[i]);
+    int common = m[0].nblocks;
+    for (int j = 1; j < L; j++)
+	if (m[j].nblocks < common)
+	    common = m[j].nblocks;
+
+    unsigned char tmp[L][64];
+    const unsigned char *p[L];
+    for (int k = 0; k < common; k++) {
+	for (int j = 0; j < L; j++)
+	    p[j] = m[j].block(k, tmp[j]);
+	sha1_compress_x4(s, p);
+    }
+
+    uint32_t lanes[5][L];
+    for (int i = 0; i < 5; i++)
+	_mm_storeu_si128((__m128i *) lanes[i], s[i]);
+    for (int j = 0; j < L; j++) {
+	uint32_t h[5];
+	for (int i = 0; i < 5; i++)
+	    h[i] = lanes[i][j];
+	m[j].finish(common, h, digest[j]);
+    }
+}
+
+static void
+hmac_sha1_multi_accel(const unsigned char * const *key, const unsigned char * const *data, const int *len, unsigned char * const *digest, int n)
+{
+    enum { L = IPsecCrypto::LANES, KS = IPsecCrypto::KEY_BYTES };
+    unsigned char ipad[L][KS], opad[L][KS], inner[L][20], outer[L][20];
+    SHA1Message m[L];
+
+    for (int i = 0; i < n; i += L) {
+	int g = (n - i < L ? n - i : L);
+	// unused lanes repeat lane 0
+	for (int j = 0; j < L; j++) {
+	    int src = i + (j < g ? j : 0);
+	    for (int x = 0; x < KS; x++) {
+		ipad[j][x] = key[src][x] ^ 0x36;
+		opad[j][x] = key[src][x] ^ 0x5c;
+	    }
+	    m[j].assign(ipad[j], data[src], len[src]);
+	}
+
+	// A single SHA-NI pipeline beats four SSE2 lanes, so with SHA-NI
+	// (or a lone packet) hash the group one packet at a time.
+	if (g == 1 || sha1_compress == sha1_compress_shani) {
+	    for (int j = 0; j < g; j++) {
+		uint32_t h[5];
+		memcpy(h, sha1_init_state, sizeof(h));
+		m[j].finish(0, h, inner[j]);
+		m[j].assign(opad[j], inner[j], 20);
+		memcpy(h, sha1_init_state, sizeof(h));
+		m[j].finish(0, h, digest[i + j]);
+	    }
+	    continue;
+	}
+
+	sha1_x4(m, inner);
+	for (int j = 0; j < L; j++)
+	    m[j].assign(opad[j], inner[j], 20);
+	sha1_x4(m, outer);
+	for (int j = 0; j < g; j++)
+	    memcpy(digest[i + j], outer[j], 20);
+    }
+}
+
+static void
+cpu_features(bool &aesni, bool &shani)
+{
+    unsigned a, b, c, d;
+    aesni = shani = false;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & (1 << 19)))	// SSE4.1
+	return;
+    aesni = (c & (1 << 25)) != 0;
+    if (__get_cpuid_max(0, 0) >= 7) {
+	__cpuid_count(7, 0, a, b, c, d);
+	shani = (b & (1 << 29)) != 0;
+    }
+}
+#endif
+
+
+// dispatch
+
+static const char *aes_name;
+static const char *sha1_name;
+
+static void
+cbc_encrypt_dispatch(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    IPsecCrypto::set_accelerated(true);
+    IPsecCrypto::aes_cbc_encrypt(key, data, len, iv);
+}
+
+static void
+cbc_decrypt_dispatch(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    IPsecCrypto::set_accelerated(true);
+    IPsecCrypto::aes_cbc_decrypt(key, data, len, iv);
+}
+
+static void
+ctr_dispatch(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    IPsecCrypto::set_accelerated(true);
+    IPsecCrypto::aes_ctr(key, data, len, iv);
+}
+
+static void
+cbc_encrypt_multi_dispatch(const IPsecAESKey * const *key, unsigned char * const *data, const int *len, const unsigned char * const *iv, int n)
+{
+    IPsecCrypto::set_accelerated(true);
+    IPsecCrypto::aes_cbc_encrypt_multi(key, data, len, iv, n);
+}
+
+static void
+sha1_dispatch(const unsigned char *data, int len, unsigned char *digest)
+{
+    IPsecCrypto::set_accelerated(true);
+    IPsecCrypto::sha1(data, len, digest);
+}
+
+static void
+hmac_sha1_multi_dispatch(const unsigned char * const *key, const unsigned char * const *data, const int *len, unsigned char * const *digest, int n)
+{
+    IPsecCrypto::set_accelerated(true);
+    IPsecCrypto::hmac_sha1_multi(key, data, len, digest, n);
+}
+
+IPsecCrypto::aes_function IPsecCrypto::_cbc_encrypt = cbc_encrypt_dispatch;
+IPsecCrypto::aes_function IPsecCrypto::_cbc_decrypt = cbc_decrypt_dispatch;
+IPsecCrypto::aes_function IPsecCrypto::_ctr = ctr_dispatch;
+IPsecCrypto::aes_multi_function IPsecCrypto::_cbc_encrypt_multi = cbc_encrypt_multi_dispatch;
+IPsecCrypto::sha1_function IPsecCrypto::_sha1 = sha1_dispatch;
+IPsecCrypto::hmac_multi_function IPsecCrypto::_hmac_sha1_multi = hmac_sha1_multi_dispatch;
+
+/* Racing threads store the same pointers, so no locking is needed. */
+void
+IPsecCrypto::set_accelerated(bool accelerated)
+{
+    _cbc_encrypt = cbc_encrypt_portable;
+    _cbc_decrypt = cbc_decrypt_portable;
+    _ctr = ctr_portable;
+    _cbc_encrypt_multi = cbc_encrypt_multi_portable;
+    _sha1 = sha1_portable;
+    _hmac_sha1_multi = hmac_sha1_multi_portable;
+    aes_name = sha1_name = "portable";
+#if IPSEC_CRYPTO_X86
+    if (accelerated) {
+	bool aesni, shani;
+	cpu_features(aesni, shani);
+	if (aesni) {
+	    _cbc_encrypt = cbc_encrypt_aesni;
+	    _cbc_decrypt = cbc_decrypt_aesni;
+	    _ctr = ctr_aesni;
+	    _cbc_encrypt_multi = cbc_encrypt_multi_aesni;
+	    aes_name = "AES-NI";
+	}
+	sha1_compress = (shani ? sha1_compress_shani : sha1_compress_scalar);
+	_sha1 = sha1_accel;
+	_hmac_sha1_multi = hmac_sha1_multi_accel;
+	sha1_name = (shani ? "SHA-NI" : "scalar, SSE2 multi-buffer");
+    }
+#else
+    (void) accelerated;
+#endif
+}
+
+const char *
+IPsecCrypto::aes_implementation()
+{
+    if (!aes_name)
+	set_accelerated(true);
+    return aes_name;
+}
+
+const char *
+IPsecCrypto::sha1_implementation()
+{
+    if (!sha1_name)
+	set_accelerated(true);
+    return sha1_name;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IPsecCrypto)
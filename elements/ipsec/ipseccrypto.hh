@@ -0,0 +1,140 @@
+#ifndef CLICK_IPSECCRYPTO_HH
+#define CLICK_IPSECCRYPTO_HH
+#include <click/glue.hh>
+#include "elements/ipsec/aes_impl.hh"
+CLICK_DECLS
+
+/*
+ * ipseccrypto.{cc,hh} -- AES and SHA-1 routines shared by the IPsec elements
+ *
+ * IPsecCrypto collects the ciphers and digests used by IPsecAES,
+ * IPsecAuthHMACSHA1 and IPsecAuthSHA1.  Each routine has a portable version,
+ * which is the table-driven AES and SSLeay SHA-1 code the elements have
+ * always used, and at user level on x86 an accelerated version that uses
+ * AES-NI, the SHA extensions, or SSE2.  The best available version is picked
+ * at first use.  The accelerated versions produce exactly the same output.
+ *
+ * The modes are the ones the IPsec elements have always implemented, which
+ * differ from the RFCs:
+ *
+ * aes_cbc_encrypt and aes_cbc_decrypt implement AES-128 CBC with an 8-byte
+ * IV: only the first 8 bytes of each block are chained.  That is, before
+ * block i is encrypted, its first 8 bytes are XORed with the first 8
+ * ciphertext bytes of block i-1, or with the IV for block 0.  LEN must be a
+ * multiple of 16.
+ *
+ * aes_ctr implements AES-128 counter mode in the RFC 3686 layout: the counter
+ * block is a 4-byte nonce, the 8-byte IV, and a 32-bit big-endian block
+ * counter starting at 1.  SAs carry no nonce, so it is always zero.  LEN may
+ * be any length.  Encryption and decryption are the same operation.
+ *
+ * hmac_sha1 computes SHA1((K ^ opad) || SHA1((K ^ ipad) || data)) for a
+ * 16-byte key K, where the pads are only 16 bytes long rather than the
+ * 64 bytes of RFC 2104.
+ *
+ * The _multi variants process N independent packets at once.  CBC encryption
+ * and HMAC are serial within a packet, but several packets can share the
+ * pipelines: the accelerated versions interleave LANES packets, one per lane.
+ * Lanes run in lockstep for as many blocks as the shortest packet in the
+ * group has, and finish the rest one at a time, so batches of similar-sized
+ * packets benefit most.  HMAC uses SSE2 lanes only on CPUs without the SHA
+ * extensions; a single SHA-NI pipeline is faster than four SSE2 lanes.
+ *
+ * set_accelerated(false) forces the portable versions, and
+ * set_accelerated(true) restores the default choice.  It is meant for tests
+ * and benchmarks and is not safe to call while other threads use these
+ * routines.
+ */
+
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && __GNUC__ >= 5
+# define IPSEC_CRYPTO_X86 1
+#endif
+
+struct IPsecAESKey {
+    AES_KEY enc;			// table-driven schedules
+    AES_KEY dec;
+#if IPSEC_CRYPTO_X86
+    unsigned char ni_enc[11 * 16];	// AES-NI schedules
+    unsigned char ni_dec[11 * 16];
+#endif
+};
+
+class IPsecCrypto { public:
+
+    enum { LANES = 4, SHA1_DIGEST_SIZE = 20, KEY_BYTES = 16 };
+
+    static void aes_set_key(IPsecAESKey *key, const unsigned char *user_key);
+
+    static inline void aes_cbc_encrypt(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv);
+    static inline void aes_cbc_decrypt(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv);
+    static inline void aes_ctr(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv);
+    static inline void aes_cbc_encrypt_multi(const IPsecAESKey * const *key, unsigned char * const *data, const int *len, const unsigned char * const *iv, int n);
+
+    static inline void sha1(const unsigned char *data, int len, unsigned char *digest);
+    static inline void hmac_sha1(const unsigned char *key, const unsigned char *data, int len, unsigned char *digest);
+    static inline void hmac_sha1_multi(const unsigned char * const *key, const unsigned char * const *data, const int *len, unsigned char * const *digest, int n);
+
+    static void set_accelerated(bool accelerated);
+    static const char *aes_implementation();
+    static const char *sha1_implementation();
+
+    typedef void (*aes_function)(const IPsecAESKey *, unsigned char *, int, const unsigned char *);
+    typedef void (*aes_multi_function)(const IPsecAESKey * const *, unsigned char * const *, const int *, const unsigned char * const *, int);
+    typedef void (*sha1_function)(const unsigned char *, int, unsigned char *);
+    typedef void (*hmac_multi_function)(const unsigned char * const *, const unsigned char * const *, const int *, unsigned char * const *, int);
+
+  private:
+
+    static aes_function _cbc_encrypt;
+    static aes_function _cbc_decrypt;
+    static aes_function _ctr;
+    static aes_multi_function _cbc_encrypt_multi;
+    static sha1_function _sha1;
+    static hmac_multi_function _hmac_sha1_multi;
+
+};
+
+inline void
+IPsecCrypto::aes_cbc_encrypt(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    _cbc_encrypt(key, data, len, iv);
+}
+
+inline void
+IPsecCrypto::aes_cbc_decrypt(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    _cbc_decrypt(key, data, len, iv);
+}
+
+inline void
+IPsecCrypto::aes_ctr(const IPsecAESKey *key, unsigned char *data, int len, const unsigned char *iv)
+{
+    _ctr(key, data, len, iv);
+}
+
+inline void
+IPsecCrypto::aes_cbc_encrypt_multi(const IPsecAESKey * const *key, unsigned char * const *data, const int *len, const unsigned char * const *iv, int n)
+{
+    _cbc_encrypt_multi(key, data, len, iv, n);
+}
+
+inline void
+IPsecCrypto::sha1(const unsigned char *data, int len, unsigned char *digest)
+{
+    _sha1(data, len, digest);
+}
+
+inline void
+IPsecCrypto::hmac_sha1(const unsigned char *key, const unsigned char *data, int len, unsigned char *digest)
+{
+    _hmac_sha1_multi(&key, &data, &len, &digest, 1);
+}
+
+inline void
+IPsecCrypto::hmac_sha1_multi(const unsigned char * const *key, const unsigned char * const *data, const int *len, unsigned char * const *digest, int n)
+{
+    _hmac_sha1_multi(key, data, len, digest, n);
+}
+
+CLICK_ENDDECLS
+#endif
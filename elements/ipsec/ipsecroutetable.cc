@@ -46,7 +46,7 @@ cp_ipsec_route(String s, IPsecRoute *r_store, bool remove_route, Element *contex
     IPsecRoute r;
     //Data to initialize the SADataTuple
     unsigned int replay;
-    uint8_t  oowin;
+    unsigned int oowin;
 
     SADataTuple * sa_data;
 
@@ -93,10 +93,17 @@ cp_ipsec_route(String s, IPsecRoute *r_store, bool remove_route, Element *contex
 	click_chatter("key has bad length");
 	return false;
     }
+    if (oowin > 255) {
+	click_chatter("OOSIZE must be at most 255");
+	return false;
+    }
 
-    // Create new Security Association Table entry
+    // Create new Security Association Table entry, or rekey the existing
+    // one; routes with the same SPI share the table's SA
     sa_data = new SADataTuple(enc_key.data(), auth_key.data(), replay, oowin);
-    ((IPsecRouteTable*)context)->_sa_table.insert(SPI(r.spi),*sa_data);
+    sa_data = ((IPsecRouteTable*)context)->_sa_table.insert(SPI(r.spi), sa_data);
+    if (!sa_data)
+	return false;
     //Set Tuple reference in the Routing entry
     r.sa_data = sa_data;
     //store routing table
@@ -124,11 +131,9 @@ IPsecRoute::unparse(StringAccum& sa, bool tabs) const
 	sa << "-1";
     else
 	sa << port;
-    if(spi != 0) {
-	sa << "  |TUNNELED CONNECTION| \n|SPI| |ENC KEY| |AUTH KEY| ||\n";
-	sa << " |" <<spi<<"|";
-	sa << sa_data->unparse_entries().c_str() <<"\n";
-    }
+    // the SA itself may have been rekeyed or removed since; see sa_table
+    if(spi != 0)
+	sa << "  |TUNNELED CONNECTION| |SPI| |" << spi << "|";
     return sa;
 }
 
@@ -141,6 +146,11 @@ IPsecRoute::unparse() const
 }
 
 
+IPsecRouteTable::IPsecRouteTable()
+{
+    _sa_table.set_owner(this);
+}
+
 void *
 IPsecRouteTable::cast(const char *name)
 {
@@ -208,8 +218,12 @@ IPsecRouteTable::push(int, Packet *p)
 	  case 1: {
 	   //This packet should be sent over a tunneled connection
 	   //so set proper annotations with references to Security Data to be used by IPsec modules
+	   //The route's SA may since have been removed, so look it up afresh
+	   sa_data = (spi ? _sa_table.lookup(SPI(spi)) : 0);
            if((spi == 0) || (sa_data == NULL)) {
-	       click_chatter("No Ipsec tunnel for %s. Wrong tunnel setup", p->dst_ip_anno().unparse().c_str());
+	       click_chatter("No Ipsec tunnel for %s. Wrong tunnel setup, Dropping packet", p->dst_ip_anno().unparse().c_str());
+	       p->kill();
+	       return;
 	   }
 	   SET_IPSEC_SPI_ANNO(p,(uint32_t)spi);
 	   //ISSUE: This is 32-bit architecture specific passing a pointer to next module through annotations!!
@@ -351,6 +365,46 @@ IPsecRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHa
     return r;
 }
 
+int
+IPsecRouteTable::rekey_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
+{
+    IPsecRouteTable *table = static_cast<IPsecRouteTable *>(e);
+    Vector<String> words;
+    cp_spacevec(cp_uncomment(conf), words);
+    uint32_t spi;
+    String enc_key, auth_key;
+    if (cp_va_kparse(words, table, errh,
+		     "SPI", cpkP+cpkM, cpUnsigned, &spi,
+		     "ENCRYPT_KEY", cpkP+cpkM, cpString, &enc_key,
+		     "AUTH_KEY", cpkP+cpkM, cpString, &auth_key,
+		     cpEnd) < 0)
+	return -1;
+    if (enc_key.length() != 16 || auth_key.length() != 16)
+	return errh->error("key has bad length");
+    if (table->_sa_table.rekey(SPI(spi), enc_key.data(), auth_key.data()) < 0)
+	return errh->error("no SA with SPI %u", spi);
+    return 0;
+}
+
+int
+IPsecRouteTable::remove_sa_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
+{
+    IPsecRouteTable *table = static_cast<IPsecRouteTable *>(e);
+    uint32_t spi;
+    if (!cp_unsigned(cp_uncomment(conf), &spi) || spi == 0)
+	return errh->error("expected SPI");
+    if (table->_sa_table.remove(spi) < 0)
+	return errh->error("no SA with SPI %u", spi);
+    return 0;
+}
+
+String
+IPsecRouteTable::sa_table_handler(Element *e, void *)
+{
+    IPsecRouteTable *table = static_cast<IPsecRouteTable *>(e);
+    return table->_sa_table.print_sa_data();
+}
+
 String
 IPsecRouteTable::table_handler(Element *e, void *)
 {
@@ -385,8 +439,12 @@ IPsecRouteTable::add_handlers()
     add_write_handler("remove", remove_route_handler, 0);
     add_write_handler("ctrl", ctrl_handler, 0);
     add_read_handler("table", table_handler, 0);
+    add_write_handler("rekey", rekey_handler, 0);
+    add_write_handler("remove_sa", remove_sa_handler, 0);
+    add_read_handler("sa_table", sa_table_handler, 0);
     set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecCrypto)
 ELEMENT_PROVIDES(IPsecRouteTable)
@@ -168,6 +168,33 @@ The encryption and authentication keys will generally be specified using
 syntax such as C<\E<lt>0183 A947 1ABE 01FF FA04 103B B102<gt>>.
  This module uses 4 and 5 annotation space integers to pass Security Association Data between IPsec modules.
 
+Routes with the same SPI share one Security Association; adding a route for
+an existing SPI with different keys rekeys that SA.  The SA database can be
+read and changed while packets flow on other threads: lookups never lock or
+wait, and each SA's sequence counter and replay window are updated with
+atomic operations.  The replay window holds up to 255 sequence numbers.
+See the C<rekey>, C<remove_sa> and C<sa_table> handlers below.
+
+=h rekey write-only
+
+Replaces the keys of an SA.  Format is `C<SPI ENCRYPTION_KEY
+AUTHENTICATION_KEY>'.  Sequence numbers and the replay window carry on.
+Packets already past the IPsec elements keep their old keys; a packet
+authenticated with the old keys and encrypted with the new ones, while the
+rekey happens, will fail verification at the other end.
+
+=h remove_sa write-only
+
+Removes the SA with the given SPI.  Routes that use the SPI remain, but
+drop their packets until an SA with that SPI is added again.  Packets may
+wait in queues indefinitely with a reference to the SA, so its memory is
+kept until the router is destroyed.
+
+=h sa_table read-only
+
+Returns one line per SA: SPI, keys, the next outgoing sequence number, and
+the highest sequence number received.
+
 =a RadixIPLookup, RangeIPsecLookup */
 
 
@@ -201,6 +228,8 @@ struct IPsecRoute {
 
 class IPsecRouteTable : public Element { public:
 
+    IPsecRouteTable();
+
     void* cast(const char*);
     int configure(Vector<String>&, ErrorHandler*);
     void add_handlers();
@@ -217,6 +246,9 @@ class IPsecRouteTable : public Element { public:
     static int ctrl_handler(const String&, Element*, void*, ErrorHandler*);
     static int lookup_handler(int operation, String&, Element*, const Handler*, ErrorHandler*);
     static String table_handler(Element*, void*);
+    static int rekey_handler(const String&, Element*, void*, ErrorHandler*);
+    static int remove_sa_handler(const String&, Element*, void*, ErrorHandler*);
+    static String sa_table_handler(Element*, void*);
     /*IPSEC extension: The security association database entry*/
     SATable _sa_table;
 
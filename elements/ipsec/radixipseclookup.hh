@@ -61,6 +61,18 @@ add a route, and `C<remove ADDR/MASK>' to remove a route. You can supply
 multiple commands, one per line; all commands are executed as one atomic
 operation.
 
+=h rekey write-only
+
+Replaces the keys of a Security Association; see IPsecRouteTable.
+
+=h remove_sa write-only
+
+Removes a Security Association; see IPsecRouteTable.
+
+=h sa_table read-only
+
+Outputs the Security Associations; see IPsecRouteTable.
+
 =n
 
 See IPsecRouteTable for a performance comparison of the various IP routing
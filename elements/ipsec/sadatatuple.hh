@@ -5,6 +5,8 @@
 #include <click/etheraddress.hh>
 #include <click/bighashmap.hh>
 #include <click/glue.hh>
+#include <click/atomic.hh>
+#include "elements/ipsec/ipseccrypto.hh"
 CLICK_DECLS
 
 /*
@@ -67,57 +69,155 @@ class SPI {
 	uint32_t _spi;
  };
 
+// Keys of a Security Association.  SATable::rekey replaces an SA's keys as
+// a whole, so no packet sees a mix of old and new keys.
+struct SAKeys {
+    uint8_t Encryption_key[KEY_SIZE]; // The Data key
+    uint8_t Authentication_key[KEY_SIZE];//The Authentication key
+    IPsecAESKey aes_key;	/* AES schedules for Encryption_key */
+
+    SAKeys(const void *enc_key, const void *auth_key) {
+	memcpy(Encryption_key, enc_key, KEY_SIZE);
+	memcpy(Authentication_key, auth_key, KEY_SIZE);
+	IPsecCrypto::aes_set_key(&aes_key, Encryption_key);
+    }
+};
+
 // Security Association Data Tuple
+//
+// Packets carry a pointer to their SA in an annotation, and several threads
+// may process packets of one SA at once, so the per-packet state is kept
+// with atomic operations: next_sequence() for outgoing packets and
+// check_replay() for incoming ones.  Neither ever waits.
 class SADataTuple {
   public:
 
     //SA Data must be added here...
-    uint8_t Encryption_key[KEY_SIZE]; // The Data key
-    uint8_t Authentication_key[KEY_SIZE];//The Authentication key
+    SAKeys * volatile keys;	/* replaced by SATable::rekey */
     /*These fields below deal with replay protection*/
     uint32_t replay_start_counter;
-    uint32_t cur_rpl;
+    atomic_uint32_t cur_rpl;	/* next outgoing sequence number */
     uint8_t  ooowin;	/* out-of-order window size */
-    uint32_t bitmap;	/* Support out-of-order receive support */
-    uint32_t lastseq;	/* in host order */
+    atomic_uint32_t lastseq;	/* highest sequence number received */
 
-    SADataTuple() {
-	memset(this, 0, sizeof(*this));
-    }
+    // Out-of-order receive support.  Word i records sequence numbers in a
+    // block of REPLAY_BLOCK numbers whose block index is i modulo
+    // REPLAY_SLOTS: the low 16 bits mark those seen, and the high 16 bits
+    // hold the block's "tag", its index divided by REPLAY_SLOTS.  A word
+    // whose tag is older than a packet's is recycled for the packet's
+    // block.  ooowin is at most 255, well inside the 512 numbers covered.
+    enum { REPLAY_BLOCK = 16, REPLAY_SLOTS = 32 };
+    volatile uint32_t replay_window[REPLAY_SLOTS];
+
+    enum { REPLAY_OK = 0, REPLAY_ZERO, REPLAY_TOO_OLD, REPLAY_SEEN };
 
     SADataTuple(const void * enc_key , const void * Auth_key, uint32_t counter, uint8_t o_oowin)
-     {
-		memset(this, 0, sizeof(*this));
-		memcpy(Encryption_key, enc_key, KEY_SIZE);
-		memcpy(Authentication_key, Auth_key, KEY_SIZE);
-		replay_start_counter = counter;
-		ooowin = o_oowin;
-	        bitmap=0;
-		lastseq=cur_rpl=counter;
-     }
-
-     operator bool() const
-     {
-         return ((cur_rpl != 0));
-     }
+	: keys(new SAKeys(enc_key, Auth_key)), replay_start_counter(counter),
+	  ooowin(o_oowin)
+    {
+	cur_rpl = counter;
+	reset_replay(counter);
+    }
+
+    ~SADataTuple() {
+	delete keys;
+    }
+
+    // Returns the sequence number for the next outgoing packet.
+    uint32_t next_sequence() {
+	uint32_t seq = cur_rpl.fetch_and_add(1);
+	//if the replay counter rolls over...set it to the agreed start value
+	if (seq == 0)
+	    cur_rpl.compare_and_swap(1, replay_start_counter);
+	return seq;
+    }
+
+    inline int check_replay(uint32_t seq);
 
-String unparse_entries() const
+    String unparse_entries() const
      {
          char buf[71];
 	 int i,j;
+	 const SAKeys *k = keys;
 	 sprintf(buf," |");
 	 for(i=0,j=0;i<16;i++,j+=2) {
-		sprintf(&buf[2+j],"%02x",Encryption_key[i]);
+		sprintf(&buf[2+j],"%02x",k->Encryption_key[i]);
 	 }
 	 sprintf(&buf[34],"| |");
 	 for(i=0,j=0;i<16;i++,j+=2) {
-		sprintf(&buf[37+j],"%02x",Authentication_key[i]);
+		sprintf(&buf[37+j],"%02x",k->Authentication_key[i]);
 	 }
 	 sprintf(&buf[69],"|");
          return String(buf, 70);
     }
+
+  private:
+
+    static uint32_t replay_tag(uint32_t seq) {
+	return (seq / (REPLAY_BLOCK * REPLAY_SLOTS)) << 16;
+    }
+
+    // Empties the window below SEQ.  Not atomic as a whole; it runs only at
+    // creation and when the sequence numbers wrap.
+    void reset_replay(uint32_t seq) {
+	lastseq = seq;
+	for (int i = 0; i < REPLAY_SLOTS; i++)
+	    replay_window[i] = replay_tag(seq) - 0x10000;
+    }
+
+    SADataTuple(const SADataTuple &);
+    SADataTuple &operator=(const SADataTuple &);
+
 };
 
+/*
+ * Checks the sequence number SEQ of an incoming packet against the replay
+ * window, marking it seen if it is acceptable.  Returns REPLAY_OK or the
+ * reason for rejecting the packet.  Every change is a single compare-and-swap,
+ * on a window word or on lastseq, so concurrent checks never wait and never
+ * accept a sequence number twice.
+ */
+inline int
+SADataTuple::check_replay(uint32_t seq)
+{
+    if (seq == 0)
+	return REPLAY_ZERO;		/* first == 0 or wrapped */
+    /* The sender restarts at replay_start_counter after wrapping.  Start
+       over too, but only when the window is far from the start, so that a
+       replayed first packet is still rejected. */
+    if (seq == replay_start_counter
+	&& lastseq - seq >= 0x80000000U) {
+	reset_replay(seq);
+	return REPLAY_OK;
+    }
+
+    uint32_t bit = 1 << (seq % REPLAY_BLOCK);
+    uint32_t tag = replay_tag(seq);
+    volatile uint32_t &w = replay_window[(seq / REPLAY_BLOCK) % REPLAY_SLOTS];
+    while (1) {
+	uint32_t top = lastseq;
+	if (seq <= top && top - seq >= ooowin)
+	    return REPLAY_TOO_OLD;
+	uint32_t old = w;
+	int32_t age = (int32_t) ((old & 0xFFFF0000U) - tag);
+	uint32_t neww;
+	if (age > 0)		/* word belongs to a later block */
+	    return REPLAY_TOO_OLD;
+	else if (age < 0)	/* word belongs to an earlier block: recycle */
+	    neww = tag | bit;
+	else if (old & bit)
+	    return REPLAY_SEEN;
+	else
+	    neww = old | bit;
+	if (atomic_uint32_t::compare_and_swap(w, old, neww))
+	    break;
+    }
+
+    uint32_t top;
+    while (seq > (top = lastseq) && !lastseq.compare_and_swap(top, seq))
+	/* retry */;
+    return REPLAY_OK;
+}
 
 inline hashcode_t SPI::hashcode() const
 {
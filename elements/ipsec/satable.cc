@@ -20,6 +20,8 @@
 #include <click/confparse.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/master.hh>
+#include <click/router.hh>
 #include <click/straccum.hh>
 #include <clicknet/ether.h>
 #include "satable.hh"
@@ -28,57 +30,109 @@
 CLICK_DECLS
 
 SATable::SATable()
+  : _table(new STable), _owner(0)
 {
 }
 
 SATable::~SATable()
 {
+  for (SIter iter = _table->begin(); iter.live(); iter++)
+    delete iter.value();
+  delete _table;
+  for (int i = 0; i < _retired.size(); i++)
+    delete _retired[i];
+  for (int i = 0; i < _retired_tables.size(); i++)
+    delete _retired_tables[i];
+  for (int i = 0; i < _retired_keys.size(); i++)
+    delete _retired_keys[i];
 }
 
-/*Get a reference to SA Data*/
-SADataTuple *
-SATable::lookup(SPI this_spi)
+String
+SATable::owner_name() const
 {
-  if (!this_spi) {
-    click_chatter("%s: lookup called with NULL spi!\n", name().c_str());
-    return NULL;
-  }
-  //retrieve security association
-  SADataTuple  *dat = _table.findp(this_spi);
-  return dat;
+  return (_owner ? _owner->declaration() : String("SATable"));
+}
+
+// Waits until no thread can still be using data unpublished before the call.
+// Returns false if the driver cannot tell; that data must then be kept.
+bool
+SATable::synchronize()
+{
+  if (_owner && _owner->router())
+    return _owner->master()->synchronize_threads();
+  return true;
+}
+
+// Makes TABLE the snapshot seen by lookups and frees the old snapshot.
+void
+SATable::publish(STable *table)
+{
+  STable *old = _table;
+  click_write_fence();
+  _table = table;
+  if (synchronize())
+    delete old;
+  else
+    _retired_tables.push_back(old);
 }
 
 /*Eventually this will be called from userspace Internet Key Exchange transactions*/
-int
-SATable::insert(SPI spi , SADataTuple SA_data)
+/*Takes ownership of SA_data.  If SPI already has an SA, that SA is rekeyed
+  with SA_data's keys and returned instead.*/
+SADataTuple *
+SATable::insert(SPI spi , SADataTuple *SA_data)
 {
   if ((!spi) || (!SA_data)) {
-    click_chatter("SATable %s: Attempt to insert data failed. Invalid arguments\n",name().c_str());
-    return -1;
+    click_chatter("SATable %s: Attempt to insert data failed. Invalid arguments\n", owner_name().c_str());
+    delete SA_data;
+    return 0;
   }
-  SADataTuple * dat = _table.findp(spi);
-  if (!dat) {
-    _table.insert(spi, SA_data);
+  if (SADataTuple *dat = _table->find(spi)) {
+    const SAKeys *k = SA_data->keys;
+    rekey(spi, k->Encryption_key, k->Authentication_key);
+    delete SA_data;
+    return dat;
   }
+  STable *t = new STable(*_table);
+  t->insert(spi, SA_data);
+  publish(t);
+  return SA_data;
+}
+
+/*Replaces the keys of SPI's SA.  Packets being processed keep using the old
+  keys, which are freed after a grace period; sequence numbers and the
+  replay window carry on.*/
+int
+SATable::rekey(SPI spi, const void *enc_key, const void *auth_key)
+{
+  SADataTuple *dat = _table->find(spi);
+  if (!dat)
+    return -ENOENT;
+  SAKeys *old = dat->keys;
+  SAKeys *k = new SAKeys(enc_key, auth_key);
+  click_write_fence();
+  dat->keys = k;
+  if (synchronize())
+    delete old;
+  else
+    _retired_keys.push_back(old);
   return 0;
 }
 
-/*Function to Remove Data*/
+/*Removes SPI's SA.  Returns -EINVAL for a zero SPI and -ENOENT if there is
+  no such SA.*/
 int
 SATable::remove(unsigned int spi)
 {
-  if(!spi){
-	click_chatter("Invalid SPI parameter");
-	return -1;
-  }
-  SADataTuple  *dat = _table.findp(spi);
-  if(!dat) {
-	click_chatter("No such entry");
-	return -1;
-  }
-  delete dat;
-  _table.remove(SPI(spi));
-
+  if (!spi)
+    return -EINVAL;
+  SADataTuple *dat = _table->find(SPI(spi));
+  if (!dat)
+    return -ENOENT;
+  STable *t = new STable(*_table);
+  t->remove(SPI(spi));
+  _retired.push_back(dat);
+  publish(t);
   return 0;
 }
 
@@ -87,19 +141,13 @@ String
 SATable::print_sa_data()
 {
   StringAccum sa;
-  int k;
-  for (SIter iter = _table.begin(); iter.live(); iter++) {
-    SADataTuple n = iter.value();
-    sa << "\nNew Entry\n";
-    for(k=0; k< 16;k++)
-	{sa << n.Encryption_key[k];}
-    sa <<" ";
-    for(k=0; k< 16;k++)
-        {sa << n.Authentication_key[k];}
-    sa << " ";
-  }
+  for (SIter iter = _table->begin(); iter.live(); iter++)
+    sa << iter.key().getValue() << iter.value()->unparse_entries()
+       << " next " << iter.value()->cur_rpl.value()
+       << " last " << iter.value()->lastseq.value() << '\n';
   return sa.take_string();
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecCrypto)
 EXPORT_ELEMENT(SATable)
@@ -9,24 +9,65 @@
 
 CLICK_DECLS
 
+/*
+ * The Security Association database of an IPsecRouteTable.
+ *
+ * Lookups never lock or wait.  They read an immutable snapshot of the table
+ * through one pointer.  insert() and remove() copy the snapshot, change the
+ * copy, and publish it with a single pointer store; the old snapshot is
+ * freed once Master::synchronize_threads() shows that no thread can still be
+ * reading it.  rekey() swaps an SA's keys the same way without touching the
+ * table.  Only the writer waits, so handlers can change SAs while packets
+ * flow.  Changes must not be made from several threads at once.
+ *
+ * The kernel drivers offer no such grace period, so there old snapshots and
+ * keys are kept until the table is destroyed, like removed SAs below.
+ *
+ * Packets keep pointers to their SAs in annotations, possibly while sitting
+ * in a Queue for any length of time, so a removed SA is kept until the table
+ * is destroyed.  Each removal therefore costs one SADataTuple of memory for
+ * the life of the router.
+ */
 class SATable : public Element { public:
 
   SATable();
   ~SATable();
 
   const char *class_name() const		{ return "SATable"; }
+  void set_owner(Element *owner)		{ _owner = owner; }
   String print_sa_data();
-  int insert(SPI this_spi , SADataTuple SA_data) ;
+  SADataTuple *insert(SPI this_spi, SADataTuple *SA_data);
+  int rekey(SPI this_spi, const void *enc_key, const void *auth_key);
   int remove(unsigned int spi);
-  SADataTuple * lookup(SPI this_spi);
+  inline SADataTuple * lookup(SPI this_spi) const;
 
 private:
   //Defines a click hashmap object the SA table in our case
-  typedef HashMap<SPI,SADataTuple> STable;
+  typedef HashMap<SPI,SADataTuple *> STable;
   typedef STable::const_iterator SIter;
-  STable _table;
+  STable * volatile _table;	// snapshot read by lookup()
+  Element *_owner;		// for its name and its Master
+  Vector<SADataTuple *> _retired;	// removed; packets may still use them
+  Vector<STable *> _retired_tables;	// kept where synchronize() fails
+  Vector<SAKeys *> _retired_keys;
+
+  void publish(STable *table);
+  bool synchronize();
+  String owner_name() const;
 
 };
 
+/*Get a reference to SA Data*/
+inline SADataTuple *
+SATable::lookup(SPI this_spi) const
+{
+  if (!this_spi) {
+    click_chatter("%s: lookup called with NULL spi!\n", owner_name().c_str());
+    return NULL;
+  }
+  //retrieve security association
+  return _table->find(this_spi);
+}
+
 CLICK_ENDDECLS
 #endif
@@ -26,7 +26,7 @@
 #include <clicknet/ip.h>
 #include <click/error.hh>
 #include <click/glue.hh>
-#include "elements/ipsec/sha1_impl.hh"
+#include "elements/ipsec/ipseccrypto.hh"
 CLICK_DECLS
 
 #define SHA_DIGEST_LEN 20
@@ -62,10 +62,7 @@ IPsecAuthSHA1::simple_action(Packet *p)
   // compute sha1
   if (_op == COMPUTE_AUTH) {
     unsigned char digest [SHA_DIGEST_LEN];
-    SHA1_ctx ctx;
-    SHA1_init (&ctx);
-    SHA1_update (&ctx, (u_char*) p->data(), p->length());
-    SHA1_final (digest, &ctx);
+    IPsecCrypto::sha1(p->data(), p->length(), digest);
     WritablePacket *q = p->put(12);
     u_char *ah = ((u_char*)q->data())+q->length()-12;
     memmove(ah, digest, 12);
@@ -75,10 +72,7 @@ IPsecAuthSHA1::simple_action(Packet *p)
   else {
     const u_char *ah = p->data()+p->length()-12;
     unsigned char digest [SHA_DIGEST_LEN];
-    SHA1_ctx ctx;
-    SHA1_init (&ctx);
-    SHA1_update (&ctx, (u_char*) p->data(), p->length()-12);
-    SHA1_final (digest, &ctx);
+    IPsecCrypto::sha1(p->data(), p->length()-12, digest);
     if (memcmp(ah, digest, 12)) {
       if (_drops == 0)
 	click_chatter("Invalid SHA1 authentication digest");
@@ -108,5 +102,6 @@ IPsecAuthSHA1::add_handlers()
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecCrypto)
 EXPORT_ELEMENT(IPsecAuthSHA1)
 ELEMENT_MT_SAFE(IPsecAuthSHA1)
@@ -158,6 +158,15 @@ Classifier::~Classifier()
 {
 }
 
+void *
+Classifier::cast(const char *n)
+{
+  if (strcmp(n, "Classifier") == 0)
+    return (Classifier *)this;
+  else
+    return Element::cast(n);
+}
+
 //
 // COMPILATION
 //
@@ -961,6 +970,7 @@ Classifier::configure(Vector<String> &conf, ErrorHandler *errh)
   //{ String sxx = program_string(this, 0); click_chatter("%s", sxx.c_str()); }
   optimize_exprs(errh);
   //{ String sxx = program_string(this, 0); click_chatter("%s", sxx.c_str()); }
+  specialize_exprs();
   return (errh->nerrors() == before ? 0 : -1);
 }
 
@@ -981,10 +991,55 @@ Classifier::program_string(Element *element, void *)
   return sa.take_string();
 }
 
+String
+Classifier::specialized_program_string(Element *element, void *)
+{
+  Classifier *c = (Classifier *)element;
+  StringAccum sa;
+  for (int i = 0; i < c->_spec.size(); i++) {
+    const SpecInsn &in = c->_spec[i];
+    int offset = in.offset - c->_align_offset;
+    sa.snprintf(64, "%2d  %d/%08x", i, offset, ntohl(in.mask[0]));
+    if (in.op == SPEC_EQ64)
+      sa.snprintf(32, "%08x", ntohl(in.mask[1]));
+    if (in.op == SPEC_SWITCH) {
+      sa << "  switch";
+      for (int k = 0; k < in.ncases; k++) {
+	const SpecCase &sc = c->_spec_cases[in.value[0] + k];
+	sa.snprintf(32, " %08x->", ntohl(sc.value));
+	if (sc.j > 0)
+	  sa << sc.j;
+	else
+	  sa << '[' << -sc.j << ']';
+      }
+      sa << "  default->";
+    } else {
+      sa.snprintf(32, "  ==%08x", ntohl(in.value[0]));
+      if (in.op == SPEC_EQ64)
+	sa.snprintf(32, "%08x", ntohl(in.value[1]));
+      sa << "  yes->";
+      if (in.j[1] > 0)
+	sa << in.j[1];
+      else
+	sa << '[' << -in.j[1] << ']';
+      sa << "  no->";
+    }
+    if (in.j[0] > 0)
+      sa << in.j[0] << '\n';
+    else
+      sa << '[' << -in.j[0] << "]\n";
+  }
+  if (c->_spec.size() == 0)
+    sa << "all->[" << c->_output_everything << "]\n";
+  sa << "safe length " << c->_safe_length << "\n";
+  return sa.take_string();
+}
+
 void
 Classifier::add_handlers()
 {
     add_read_handler("program", Classifier::program_string, 0, Handler::CALM);
+    add_read_handler("specialized_program", Classifier::specialized_program_string, 0, Handler::CALM);
 }
 
 //
@@ -1072,15 +1127,137 @@ Classifier::compress_exprs(Vector<uint32_t> &prog, bool perform_binary_search,
 }
 
 //
-// RUNNING
+// SPECIALIZED PROGRAMS
 //
 
 void
-Classifier::length_checked_push(Packet *p)
+Classifier::specialize_exprs(int base1_offset)
+{
+  // Lower _exprs into _spec.  Runs of Exprs that test the same masked word,
+  // each falling through to the next on failure, become one SPEC_SWITCH;
+  // an Expr whose success leads only to a test of the following word, with
+  // the same failure branch, fuses with it into one SPEC_EQ64.  Expr
+  // offsets >= base1_offset are added to spec_match()'s second base
+  // pointer instead of the first; IPFilter uses this for transport header
+  // offsets.
+
+  _spec.clear();
+  _spec_cases.clear();
+  if (_output_everything >= 0)
+    return;
+
+  int n = _exprs.size();
+  Vector<int> inbranch(n, 0);
+  Vector<int> insn(n, -1);
+  Vector<int> stack;
+  Vector<int> reached(n, 0);
+  stack.push_back(0);
+  reached[0] = 1;
+  while (stack.size()) {
+    const Expr &e = _exprs[stack.back()];
+    stack.pop_back();
+    for (int k = 0; k < 2; k++)
+      if (e.j[k] > 0) {
+	inbranch[e.j[k]]++;
+	if (!reached[e.j[k]]) {
+	  reached[e.j[k]] = 1;
+	  stack.push_back(e.j[k]);
+	}
+      }
+  }
+
+  // build instructions, with jumps still naming Exprs
+  Vector<int> absorbed(n, 0);
+  for (int i = 0; i < n; i++) {
+    if (!reached[i] || absorbed[i])
+      continue;
+    const Expr &e = _exprs[i];
+    SpecInsn in;
+    in.op = SPEC_EQ;
+    in.base = (e.offset >= base1_offset);
+    in.ncases = 0;
+    in.offset = e.offset;
+    in.j[0] = e.no();
+    in.j[1] = e.yes();
+    in.mask[0] = e.mask.u;
+    in.value[0] = e.value.u;
+    in.mask[1] = in.value[1] = 0;
+
+    int k = e.no();
+    if (k > 0 && inbranch[k] == 1 && _exprs[k].offset == e.offset
+	&& _exprs[k].mask.u == e.mask.u) {
+      in.op = SPEC_SWITCH;
+      in.value[0] = _spec_cases.size();
+      for (k = i; ; k = _exprs[k].no()) {
+	SpecCase sc;
+	sc.value = _exprs[k].value.u;
+	sc.j = _exprs[k].yes();
+	// an earlier case with the same value shadows this one
+	int c;
+	for (c = in.value[0]; c < _spec_cases.size(); c++)
+	  if (_spec_cases[c].value == sc.value)
+	    break;
+	if (c == _spec_cases.size())
+	  _spec_cases.push_back(sc);
+	absorbed[k] = (k != i);
+	int next = _exprs[k].no();
+	if (next <= 0 || inbranch[next] != 1 || _exprs[next].offset != e.offset
+	    || _exprs[next].mask.u != e.mask.u
+	    || _spec_cases.size() - (int) in.value[0] == 0xFFFF)
+	  break;
+      }
+      in.j[0] = _exprs[k].no();
+      in.ncases = _spec_cases.size() - in.value[0];
+      // short switches scan their cases in rule order; long ones search
+      if (in.ncases >= SPEC_BSEARCH_MIN)
+	click_qsort(_spec_cases.begin() + in.value[0], in.ncases, sizeof(SpecCase), spec_case_compar);
+    } else if ((k = e.yes()) > 0 && inbranch[k] == 1
+	       && _exprs[k].no() == e.no()
+	       && _exprs[k].offset == e.offset + UBYTES
+	       && (_exprs[k].offset >= base1_offset) == in.base) {
+      in.op = SPEC_EQ64;
+      in.j[1] = _exprs[k].yes();
+      in.mask[1] = _exprs[k].mask.u;
+      in.value[1] = _exprs[k].value.u;
+      absorbed[k] = 1;
+    }
+
+    insn[i] = _spec.size();
+    _spec.push_back(in);
+  }
+
+  // translate jumps
+  for (SpecInsn *in = _spec.begin(); in != _spec.end(); ++in) {
+    for (int k = 0; k < 2; k++)
+      if (in->j[k] > 0)
+	in->j[k] = insn[in->j[k]];
+    if (in->op == SPEC_SWITCH)
+      for (int c = 0; c < in->ncases; c++) {
+	SpecCase &sc = _spec_cases[in->value[0] + c];
+	if (sc.j > 0)
+	  sc.j = insn[sc.j];
+      }
+  }
+}
+
+int
+Classifier::spec_case_compar(const void *a, const void *b, void *)
+{
+  uint32_t av = static_cast<const SpecCase *>(a)->value;
+  uint32_t bv = static_cast<const SpecCase *>(b)->value;
+  return (av < bv ? -1 : (av == bv ? 0 : 1));
+}
+
+//
+// RUNNING
+//
+
+int
+Classifier::length_checked_match(const Packet *p) const
 {
   const unsigned char *packet_data = p->data() - _align_offset;
   int packet_length = p->length() + _align_offset; // XXX >= MAXINT?
-  Expr *ex = &_exprs[0];	// avoid bounds checking
+  const Expr *ex = &_exprs[0];	// avoid bounds checking
   int pos = 0;
   uint32_t data;
 
@@ -1105,26 +1282,26 @@ Classifier::length_checked_push(Packet *p)
     pos = ex[pos].no();
   } while (pos > 0);
 
-  checked_output_push(-pos, p);
+  return -pos;
 }
 
 void
-Classifier::push(int, Packet *p)
+Classifier::length_checked_push(Packet *p)
+{
+  checked_output_push(length_checked_match(p), p);
+}
+
+int
+Classifier::match_interpreted(const Packet *p) const
 {
   const unsigned char *packet_data = p->data() - _align_offset;
-  Expr *ex = &_exprs[0];	// avoid bounds checking
+  const Expr *ex = &_exprs[0];	// avoid bounds checking
   int pos = 0;
 
-  if (_output_everything >= 0) {
-    // must use checked_output_push because the output number might be
-    // out of range
-    pos = -_output_everything;
-    goto found;
-  } else if (p->length() < _safe_length) {
-    // common case never checks packet length
-    length_checked_push(p);
-    return;
-  }
+  if (_output_everything >= 0)
+    return _output_everything;
+  else if (p->length() < _safe_length)
+    return length_checked_match(p);
 
   do {
       uint32_t data = *((const uint32_t *)(packet_data + ex[pos].offset));
@@ -1132,8 +1309,27 @@ Classifier::push(int, Packet *p)
       pos = ex[pos].j[data == ex[pos].value.u];
   } while (pos > 0);
 
- found:
-  checked_output_push(-pos, p);
+  return -pos;
+}
+
+int
+Classifier::match(const Packet *p) const
+{
+  if (_output_everything >= 0)
+    return _output_everything;
+  else if (p->length() < _safe_length)
+    // common case never checks packet length
+    return length_checked_match(p);
+  const unsigned char *packet_data = p->data() - _align_offset;
+  return spec_match(packet_data, packet_data);
+}
+
+void
+Classifier::push(int, Packet *p)
+{
+  // must use checked_output_push because the output number might be out of
+  // range
+  checked_output_push(Classifier::match(p), p);
 }
 
 CLICK_ENDDECLS
@@ -69,7 +69,23 @@ CLICK_DECLS
  *   safe length 22
  *   alignment offset 0
  *
- * =a IPClassifier, IPFilter */
+ * =h specialized_program read-only
+ * Returns a human-readable definition of the specialized program that the
+ * Classifier element actually runs.  After configuration, the program above
+ * is lowered into a compact table of instructions.  A chain of tests on the
+ * same masked word becomes one "switch" instruction, which looks up the
+ * word's value among all the chain's values at once.  A test on a word
+ * followed by a test on the next word becomes one 8-byte test.  Packets
+ * shorter than the safe length still go through the original program, which
+ * checks lengths.
+ *
+ * The Classifier patterns above specialize into:
+ *
+ *   0  12/ffff0000  switch 08060000->1 08000000->[2]  default->[3]
+ *   1  20/ffff0000  switch 00010000->[0] 00020000->[1]  default->[3]
+ *   safe length 22
+ *
+ * =a IPClassifier, IPFilter, ClassifierBenchmark */
 
 class Classifier : public Element { public:
 
@@ -83,6 +99,7 @@ class Classifier : public Element { public:
   const char *processing() const		{ return PUSH; }
   // this element needs AlignmentInfo, so supply the "A" flag
   const char *flags() const			{ return "A"; }
+  void *cast(const char *);
 
   int configure(Vector<String> &, ErrorHandler *);
   void add_handlers();
@@ -99,6 +116,9 @@ class Classifier : public Element { public:
 
   void push(int port, Packet *);
 
+  virtual int match(const Packet *) const;
+  virtual int match_interpreted(const Packet *) const;
+
   struct Expr {
     int offset;
     union {
@@ -148,8 +168,34 @@ class Classifier : public Element { public:
 
   static String program_string(Element *, void *);
 
+  int length_checked_match(const Packet *) const;
   void length_checked_push(Packet *);
 
+  // The specialized program is a table of SpecInsns.  Jumps are as in
+  // Exprs: positive values index _spec, others are negated output ports.
+  enum { SPEC_EQ, SPEC_EQ64, SPEC_SWITCH, SPEC_BSEARCH_MIN = 12 };
+  struct SpecInsn {
+    uint8_t op;
+    uint8_t base;		// 1 if offset is relative to base 1
+    uint16_t ncases;		// SPEC_SWITCH: number of cases
+    int32_t offset;
+    int32_t j[2];		// no, yes
+    uint32_t mask[2];		// SPEC_EQ64 tests a second word at offset+4
+    uint32_t value[2];		// SPEC_SWITCH: value[0] indexes _spec_cases
+  };
+  struct SpecCase {
+    uint32_t value;
+    int32_t j;
+  };
+  Vector<SpecInsn> _spec;
+  Vector<SpecCase> _spec_cases;
+
+  void specialize_exprs(int base1_offset = 0x7FFFFFFF);
+  inline int spec_match(const unsigned char *base0,
+			const unsigned char *base1) const;
+  static int spec_case_compar(const void *, const void *, void *);
+  static String specialized_program_string(Element *, void *);
+
  private:
 
   class DominatorOptimizer { public:
@@ -196,5 +242,52 @@ class Classifier : public Element { public:
 
 };
 
+inline int
+Classifier::spec_match(const unsigned char *base0,
+		       const unsigned char *base1) const
+{
+  const SpecInsn *spec = _spec.begin();
+  int pos = 0;
+  do {
+    const SpecInsn &in = spec[pos];
+    const unsigned char *d = (in.base ? base1 : base0) + in.offset;
+    uint32_t data = *(const uint32_t *) d & in.mask[0];
+    if (in.op == SPEC_EQ) {
+      if (data == in.value[0])
+	pos = in.j[1];
+      else
+	pos = in.j[0];
+    } else if (in.op == SPEC_EQ64) {
+      uint32_t data1 = *(const uint32_t *) (d + 4) & in.mask[1];
+      if (((data ^ in.value[0]) | (data1 ^ in.value[1])) == 0)
+	pos = in.j[1];
+      else
+	pos = in.j[0];
+    } else {
+      const SpecCase *lo = _spec_cases.begin() + in.value[0];
+      const SpecCase *hi = lo + in.ncases;
+      pos = in.j[0];
+      if (in.ncases < SPEC_BSEARCH_MIN) {
+	for (; lo < hi; ++lo)
+	  if (lo->value == data) {
+	    pos = lo->j;
+	    break;
+	  }
+      } else
+	while (lo < hi) {
+	  const SpecCase *mid = lo + (hi - lo) / 2;
+	  if (mid->value == data) {
+	    pos = mid->j;
+	    break;
+	  } else if (mid->value < data)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+    }
+  } while (pos > 0);
+  return -pos;
+}
+
 CLICK_ENDDECLS
 #endif
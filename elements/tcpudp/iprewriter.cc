@@ -29,9 +29,7 @@
 CLICK_DECLS
 
 IPRewriter::IPRewriter()
-  : _tcp_map(0), _udp_map(0), _tcp_done(0),
-    _tcp_done_tail(0),
-    _tcp_done_gc_timer(tcp_done_gc_hook, this),
+  : _tcp_done_gc_timer(tcp_done_gc_hook, this),
     _tcp_gc_timer(tcp_gc_hook, this),
     _udp_gc_timer(udp_gc_hook, this)
 {
@@ -67,6 +65,7 @@ IPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
   _udp_gc_interval = 10;		// 10 seconds
   _tcp_done_gc_incr = false;
   _dst_anno = true;
+  int nshards = 1;
 
   if (cp_va_kparse_remove_keywords
       (conf, this, errh,
@@ -78,11 +77,13 @@ IPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
        "UDP_TIMEOUT", 0, cpSeconds, &_udp_timeout_jiffies,
        "TCP_DONE_GC_INCR", 0, cpBool, &_tcp_done_gc_incr,
        "DST_ANNO", 0, cpBool, &_dst_anno,
+       "SHARDS", 0, cpInteger, &nshards,
        cpEnd) < 0)
     return -1;
 
   if (conf.size() != ninputs())
       return errh->error("need %d arguments, one per input port", ninputs());
+  configure_shards(nshards, errh);
 
   for (int i = 0; i < conf.size(); i++) {
     InputSpec is;
@@ -102,13 +103,15 @@ int
 IPRewriter::initialize(ErrorHandler *)
 {
   _nmapping_failures = 0;
+  initialize_shards(_tcp_gc_interval, _tcp_timeout_jiffies,
+		    _udp_gc_interval, _udp_timeout_jiffies);
 
   _tcp_gc_timer.initialize(this);
   _tcp_done_gc_timer.initialize(this);
   _udp_gc_timer.initialize(this);
 
-  _tcp_gc_timer.schedule_after_sec(_tcp_gc_interval);
-  _udp_gc_timer.schedule_after_sec(_udp_gc_interval);
+  _tcp_gc_timer.schedule_after(Timestamp::make_jiffies((click_jiffies_t) _shards[0]->tcp_wheel.tick()));
+  _udp_gc_timer.schedule_after(Timestamp::make_jiffies((click_jiffies_t) _shards[0]->udp_wheel.tick()));
   _tcp_done_gc_timer.schedule_after_sec(_tcp_done_gc_interval);
 
   return 0;
@@ -117,8 +120,7 @@ IPRewriter::initialize(ErrorHandler *)
 void
 IPRewriter::cleanup(CleanupStage)
 {
-  clear_map(_tcp_map);
-  clear_map(_udp_map);
+  cleanup_shards();
 
   for (int i = 0; i < _input_specs.size(); i++)
     if (_input_specs[i].kind == INPUT_SPEC_PATTERN)
@@ -138,101 +140,36 @@ void
 IPRewriter::take_state(Element *e, ErrorHandler *errh)
 {
   IPRewriter *rw = (IPRewriter *)e->cast("IPRewriter");
-  if (!rw) return;
-
-  if (noutputs() != rw->noutputs()) {
-    errh->warning("taking mappings from `%s', although it has %s output ports", rw->declaration().c_str(), (rw->noutputs() > noutputs() ? "more" : "fewer"));
-    if (noutputs() < rw->noutputs())
-      errh->message("(out of range mappings will be dropped)");
-  }
-
-  _tcp_map.swap(rw->_tcp_map);
-  _udp_map.swap(rw->_udp_map);
-
-  // check rw->_all_patterns against our _all_patterns
-  Vector<Pattern *> pattern_map;
-  for (int i = 0; i < rw->_all_patterns.size(); i++) {
-    Pattern *p = rw->_all_patterns[i], *q = 0;
-    for (int j = 0; j < _all_patterns.size() && !q; j++)
-      if (_all_patterns[j]->can_accept_from(*p))
-	q = _all_patterns[j];
-    pattern_map.push_back(q);
-  }
-
-  take_state_map(_tcp_map, &_tcp_done, &_tcp_done_tail, rw->_all_patterns, pattern_map);
-  take_state_map(_udp_map, 0, 0, rw->_all_patterns, pattern_map);
-  Mapping *m = _tcp_done;
-  Mapping *mp = 0;
-  while (m) {
-    mp = m;
-    m = m->free_next();
-  }
-  _tcp_done_tail = mp;
+  if (rw)
+    take_state_shards(rw, errh);
 }
 
 void
 IPRewriter::tcp_gc_hook(Timer *timer, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)thunk;
-  unsigned wait = rw->_tcp_gc_interval;
-#if IPRW_RWLOCKS
-  if (rw->_rwlock.attempt_write()) {
-#elif IPRW_SPINLOCKS
-  if (rw->_spinlock.attempt()) {
-#endif
-  rw->clean_map(rw->_tcp_map, click_jiffies() - rw->_tcp_timeout_jiffies);
-#if IPRW_RWLOCKS
-  rw->_rwlock.release_write();
-  } else wait = 1;		// XXX too long a wait?
-#elif IPRW_SPINLOCKS
-  rw->_spinlock.release();
-  } else wait = 1;
-#endif
-  timer->reschedule_after_sec(wait);
+  if (rw->reap_shards(IP_PROTO_TCP))
+    timer->schedule_now();
+  else
+    timer->schedule_after(Timestamp::make_jiffies((click_jiffies_t) rw->_shards[0]->tcp_wheel.tick()));
 }
 
 void
 IPRewriter::tcp_done_gc_hook(Timer *timer, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)thunk;
-  unsigned wait = rw->_tcp_done_gc_interval;
-#if IPRW_RWLOCKS
-  if (rw->_rwlock.attempt_write()) {
-#elif IPRW_SPINLOCKS
-  if (rw->_spinlock.attempt()) {
-#endif
-  rw->clean_map_free_tracked
-    (rw->_tcp_map, rw->_tcp_done, rw->_tcp_done_tail,
-     click_jiffies() - rw->_tcp_done_timeout_jiffies);
-#if IPRW_RWLOCKS
-  rw->_rwlock.release_write();
-  } else wait = 1;		// XXX too long a wait?
-#elif IPRW_SPINLOCKS
-  rw->_spinlock.release();
-  } else wait = 1;
-#endif
-  timer->reschedule_after_sec(wait);
+  rw->reap_shards_done(rw->_tcp_done_timeout_jiffies);
+  timer->reschedule_after_sec(rw->_tcp_done_gc_interval);
 }
 
 void
 IPRewriter::udp_gc_hook(Timer *timer, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)thunk;
-  unsigned wait = rw->_udp_gc_interval;
-#if IPRW_RWLOCKS
-  if (rw->_rwlock.attempt_write()) {
-#elif IPRW_SPINLOCKS
-  if (rw->_spinlock.attempt()) {
-#endif
-  rw->clean_map(rw->_udp_map, click_jiffies() - rw->_udp_timeout_jiffies);
-#if IPRW_RWLOCKS
-  rw->_rwlock.release_write();
-  } else wait = 1;		// XXX too long a wait?
-#elif IPRW_SPINLOCKS
-  rw->_spinlock.release();
-  } else wait = 1;
-#endif
-  timer->reschedule_after_sec(wait);
+  if (rw->reap_shards(IP_PROTO_UDP))
+    timer->schedule_now();
+  else
+    timer->schedule_after(Timestamp::make_jiffies((click_jiffies_t) rw->_shards[0]->udp_wheel.tick()));
 }
 
 IPRw::Mapping *
@@ -247,20 +184,10 @@ IPRewriter::apply_pattern(Pattern *pattern, int ip_p, const IPFlowID &flow,
   Mapping *forward = new Mapping(_dst_anno);
   Mapping *reverse = new Mapping(_dst_anno);
 
-  if (forward && reverse) {
-    Map& map = (ip_p == IP_PROTO_TCP ? _tcp_map : _udp_map);
-
-    if (!pattern)
-      Mapping::make_pair(ip_p, flow, flow, fport, rport, forward, reverse);
-    else if (!pattern->create_mapping(ip_p, flow, fport, rport, forward, reverse, map))
-      goto failure;
-
-    map.set(flow, forward);
-    map.set(forward->flow_id().reverse(), reverse);
+  if (forward && reverse
+      && create_pair(pattern, ip_p, flow, fport, rport, forward, reverse))
     return forward;
-  }
 
- failure:
   _nmapping_failures++;
   delete forward;
   delete reverse;
@@ -275,9 +202,6 @@ IPRewriter::push(int port, Packet *p_in)
       return;
 
   click_ip *iph = p->ip_header();
-#if IPRW_RWLOCKS
-  bool has_lock = false;
-#endif
 
   // handle non-TCP and non-first fragments
   int ip_p = iph->ip_p;
@@ -290,33 +214,17 @@ IPRewriter::push(int port, Packet *p_in)
     return;
   }
 
-#if IPRW_RWLOCKS
-  _rwlock.acquire_read();
-#elif IPRW_SPINLOCKS
-  _spinlock.acquire();
-#endif
   IPFlowID flow(p);
-  Mapping *m = (ip_p == IP_PROTO_TCP ? _tcp_map.get(flow) : _udp_map.get(flow));
-
-#if IPRW_RWLOCKS
-  _rwlock.release_read();
-#endif
+  Shard *home = flow_home(flow), *spill;
+  home->lock.acquire();
+  Mapping *m = find_mapping(ip_p, flow, spill);
 
   if (!m) {			// create new mapping
     const InputSpec &is = _input_specs[port];
-#if IPRW_RWLOCKS
-    _rwlock.acquire_write();
-    has_lock = true;
-#endif
     switch (is.kind) {
 
      case INPUT_SPEC_NOCHANGE:
-#if IPRW_RWLOCKS
-      _rwlock.release_write();
-      has_lock = false;
-#elif IPRW_SPINLOCKS
-      _spinlock.release();
-#endif
+      home->lock.release();
       output(is.u.output).push(p);
       return;
 
@@ -339,12 +247,7 @@ IPRewriter::push(int port, Packet *p_in)
 
     }
     if (!m) {
-#if IPRW_RWLOCKS
-      _rwlock.release_write();
-      has_lock = false;
-#elif IPRW_SPINLOCKS
-      _spinlock.release();
-#endif
+      home->lock.release();
       p->kill();
       return;
     }
@@ -355,34 +258,27 @@ IPRewriter::push(int port, Packet *p_in)
   if (ip_p == IP_PROTO_TCP) {
     click_tcp *tcph = p->tcp_header();
     if (tcph->th_flags & (TH_SYN | TH_FIN | TH_RST)) {
+      Shard *s = (spill ? spill : mapping_home(m));
+      s->lock.acquire();
 
-#if IPRW_RWLOCKS
-      if (!has_lock) {
-        _rwlock.acquire_write();
-        has_lock = true;
-      }
-#endif
-
-      if (_tcp_done_gc_incr && (tcph->th_flags & TH_SYN))
+      if (_tcp_done_gc_incr && (tcph->th_flags & TH_SYN) && s->tcp_done)
         incr_clean_map_free_tracked
-	  (_tcp_map, _tcp_done, _tcp_done_tail, click_jiffies() - _tcp_done_timeout_jiffies);
+	  (s->tcp_map, s->tcp_done, s->tcp_done_tail, click_jiffies() - _tcp_done_timeout_jiffies);
 
       // add to list for dropping TCP connections faster
       if (!m->free_tracked() && (tcph->th_flags & (TH_FIN | TH_RST))
 	  && m->session_over())
-	m->add_to_free_tracked_tail(_tcp_done, _tcp_done_tail);
+	m->add_to_free_tracked_tail(s->tcp_done, s->tcp_done_tail);
+
+      s->lock.release();
     }
   }
 
-#if IPRW_RWLOCKS
-  if (has_lock) {
-    _rwlock.release_write();
-    has_lock = false;
-  }
-#elif IPRW_SPINLOCKS
-  _spinlock.release();
-#endif
-  output(m->output()).push(p);
+  int out = m->output();
+  if (spill)
+    spill->lock.release();
+  home->lock.release();
+  output(out).push(p);
 }
 
 
@@ -390,20 +286,18 @@ String
 IPRewriter::dump_mappings_handler(Element *e, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)e;
-  Map *map = (thunk ? &rw->_udp_map : &rw->_tcp_map);
-
-#if IPRW_SPINLOCKS
-  rw->_spinlock.acquire();
-#endif
   StringAccum sa;
-  for (Map::iterator iter = map->begin(); iter.live(); iter++) {
-    Mapping *m = iter.value();
-    if (m->is_primary())
-      sa << m->unparse() << "\n";
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *s = rw->_shards[i];
+    Map *map = (thunk ? &s->udp_map : &s->tcp_map);
+    s->lock.acquire();
+    for (Map::iterator iter = map->begin(); iter.live(); iter++) {
+      Mapping *m = iter.value();
+      if (m->is_primary())
+	sa << m->unparse() << "\n";
+    }
+    s->lock.release();
   }
-#if IPRW_SPINLOCKS
-  rw->_spinlock.release();
-#endif
   return sa.take_string();
 }
 
@@ -411,18 +305,16 @@ String
 IPRewriter::dump_tcp_done_mappings_handler(Element *e, void *)
 {
   IPRewriter *rw = (IPRewriter *)e;
-
-#if IPRW_SPINLOCKS
-  rw->_spinlock.acquire();
-#endif
   StringAccum sa;
-  for (Mapping *m = rw->_tcp_done; m; m = m->free_next()) {
-    if (m->session_over())
-      sa << m->unparse() << "\n";
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *s = rw->_shards[i];
+    s->lock.acquire();
+    for (Mapping *m = s->tcp_done; m; m = m->free_next()) {
+      if (m->session_over())
+	sa << m->unparse() << "\n";
+    }
+    s->lock.release();
   }
-#if IPRW_SPINLOCKS
-  rw->_spinlock.release();
-#endif
   return sa.take_string();
 }
 
@@ -430,9 +322,14 @@ String
 IPRewriter::dump_nmappings_handler(Element *e, void *thunk)
 {
   IPRewriter *rw = (IPRewriter *)e;
-  if (!thunk)
-      return String(rw->_tcp_map.size()) + " " + String(rw->_udp_map.size());
-  else
+  if (!thunk) {
+      uint32_t ntcp = 0, nudp = 0;
+      for (int i = 0; i < rw->_shards.size(); i++) {
+	  ntcp += rw->_shards[i]->tcp_map.size();
+	  nudp += rw->_shards[i]->udp_map.size();
+      }
+      return String(ntcp) + " " + String(nudp);
+  } else
       return String(rw->_nmapping_failures);
 }
 
@@ -441,18 +338,19 @@ IPRewriter::dump_patterns_handler(Element *e, void *)
 {
   IPRewriter *rw = (IPRewriter *)e;
   String s;
-#if IPRW_SPINLOCKS
-  rw->_spinlock.acquire();
-#endif
   for (int i = 0; i < rw->_input_specs.size(); i++)
     if (rw->_input_specs[i].kind == INPUT_SPEC_PATTERN)
       s += rw->_input_specs[i].u.pattern.p->unparse() + "\n";
-#if IPRW_SPINLOCKS
-  rw->_spinlock.release();
-#endif
   return s;
 }
 
+String
+IPRewriter::gc_stats_handler(Element *e, void *)
+{
+  IPRewriter *rw = (IPRewriter *)e;
+  return rw->unparse_gc_stats();
+}
+
 void
 IPRewriter::add_handlers()
 {
@@ -462,37 +360,14 @@ IPRewriter::add_handlers()
   add_read_handler("nmappings", dump_nmappings_handler, (void *)0);
   add_read_handler("mapping_failures", dump_nmappings_handler, (void *)1);
   add_read_handler("patterns", dump_patterns_handler, (void *)0);
+  add_read_handler("gc_stats", gc_stats_handler, 0);
 }
 
 int
 IPRewriter::llrpc(unsigned command, void *data)
 {
-  if (command == CLICK_LLRPC_IPREWRITER_MAP_TCP) {
-
-    // Data	: unsigned saddr, daddr; unsigned short sport, dport
-    // Incoming : the flow ID
-    // Outgoing : If there is a mapping for that flow ID, then stores the
-    //		  mapping into 'data' and returns zero. Otherwise, returns
-    //		  -EAGAIN.
-
-    IPFlowID *val = reinterpret_cast<IPFlowID *>(data);
-#if IPRW_SPINLOCKS
-    _spinlock.acquire();
-#endif
-    Mapping *m = get_mapping(IP_PROTO_TCP, *val);
-    if (!m) {
-#if IPRW_SPINLOCKS
-      _spinlock.release();
-#endif
-      return -EAGAIN;
-    }
-    *val = m->flow_id();
-#if IPRW_SPINLOCKS
-    _spinlock.release();
-#endif
-    return 0;
-
-  } else if (command == CLICK_LLRPC_IPREWRITER_MAP_UDP) {
+  if (command == CLICK_LLRPC_IPREWRITER_MAP_TCP
+      || command == CLICK_LLRPC_IPREWRITER_MAP_UDP) {
 
     // Data	: unsigned saddr, daddr; unsigned short sport, dport
     // Incoming : the flow ID
@@ -501,20 +376,11 @@ IPRewriter::llrpc(unsigned command, void *data)
     //		  -EAGAIN.
 
     IPFlowID *val = reinterpret_cast<IPFlowID *>(data);
-#if IPRW_SPINLOCKS
-    _spinlock.acquire();
-#endif
-    Mapping *m = get_mapping(IP_PROTO_UDP, *val);
-    if (!m) {
-#if IPRW_SPINLOCKS
-      _spinlock.release();
-#endif
+    int ip_p = (command == CLICK_LLRPC_IPREWRITER_MAP_TCP ? IP_PROTO_TCP : IP_PROTO_UDP);
+    Mapping *m = get_mapping(ip_p, *val);
+    if (!m)
       return -EAGAIN;
-    }
     *val = m->flow_id();
-#if IPRW_SPINLOCKS
-    _spinlock.release();
-#endif
     return 0;
 
   } else
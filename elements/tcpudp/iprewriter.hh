@@ -1,7 +1,6 @@
 #ifndef CLICK_IPREWRITER_HH
 #define CLICK_IPREWRITER_HH
 #include "elements/ip/iprw.hh"
-#include <click/sync.hh>
 CLICK_DECLS
 
 /*
@@ -140,6 +139,11 @@ seconds.
 
 Reap timed-out UDP connections every I<time> seconds. Default is 10 seconds.
 
+=item SHARDS I<n>
+
+Integer. Split the mapping table into I<n> shards, each with its own lock.
+Zero means one shard per Click thread. Default is 1.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -162,13 +166,39 @@ UDP mappings.
 Returns a human-readable description of the IPRewriter's current set of
 mappings for completed TCP sessions.
 
-=a TCPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
-RoundRobinIPMapper, FTPPortMapper, ICMPRewriter, ICMPPingRewriter */
+=h nmappings read-only
 
-#if defined(CLICK_LINUXMODULE) && __MTCLICK__
-# define IPRW_SPINLOCKS 1
-# define IPRW_RWLOCKS 0
-#endif
+Returns the number of TCP and of UDP mappings, counting each direction.
+
+=h gc_stats read-only
+
+Returns statistics on stale mapping removal: the number of times it held a
+shard's lock, the number of mapping pairs freed, and the mean and maximum time
+it held the lock.
+
+=n
+
+Stale mappings are removed incrementally.  Each shard keeps its mappings in a
+timing wheel ordered by expiry time, and every 1/16 of a reap interval
+IPRewriter checks the mappings that have come due, at most 512 per shard at a
+time, rather than scanning the whole table once per interval.  A mapping may
+therefore outlive its timeout by up to 1/16 of a reap interval, and packets
+wait for at most one short step while a shard is locked.
+
+With SHARDS, a flow's shard is chosen by a hash of its addresses and ports
+that is the same in both directions, and IPRewriter chooses new source ports
+(or addresses) so that the rewritten flow's replies hash to the same shard.
+Threads contend only when they handle flows in the same shard; to avoid
+contention entirely, send each flow to the same thread, for instance with one
+input per thread.  Mappings whose directions cannot share a shard, such as
+those made by patterns without a port range, go in one extra shared shard.
+So do mappings from a range with no free value whose replies would share the
+original flow's shard; any free value in the range is used then, so a narrow
+range holds as many mappings with SHARDS as without.
+
+=a TCPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
+RoundRobinIPMapper, FTPPortMapper, ICMPRewriter, ICMPPingRewriter,
+IPRewriterBenchmark */
 
 class IPRewriter : public IPRw { public:
 
@@ -196,11 +226,6 @@ class IPRewriter : public IPRw { public:
 
  private:
 
-  Map _tcp_map;
-  Map _udp_map;
-  Mapping *_tcp_done;
-  Mapping *_tcp_done_tail;
-
   Vector<InputSpec> _input_specs;
   bool _dst_anno;
 
@@ -215,13 +240,6 @@ class IPRewriter : public IPRw { public:
   int _tcp_timeout_jiffies;
   int _tcp_done_timeout_jiffies;
 
-#if IPRW_SPINLOCKS
-  Spinlock _spinlock;
-#endif
-#if IPRW_RWLOCKS
-  ReadWriteLock _rwlock;
-#endif
-
   int _nmapping_failures;
 
   static void tcp_gc_hook(Timer *, void *);
@@ -232,6 +250,7 @@ class IPRewriter : public IPRw { public:
   static String dump_tcp_done_mappings_handler(Element *, void *);
   static String dump_nmappings_handler(Element *, void *);
   static String dump_patterns_handler(Element *, void *);
+  static String gc_stats_handler(Element *, void *);
 
 };
 
@@ -239,12 +258,15 @@ class IPRewriter : public IPRw { public:
 inline IPRw::Mapping *
 IPRewriter::get_mapping(int ip_p, const IPFlowID &in) const
 {
-  if (ip_p == IP_PROTO_TCP)
-    return _tcp_map[in];
-  else if (ip_p == IP_PROTO_UDP)
-    return _udp_map[in];
-  else
+  if (ip_p != IP_PROTO_TCP && ip_p != IP_PROTO_UDP)
     return 0;
+  Shard *home = flow_home(in), *spill;
+  home->lock.acquire();
+  Mapping *m = find_mapping(ip_p, in, spill);
+  if (spill)
+    spill->lock.release();
+  home->lock.release();
+  return m;
 }
 
 CLICK_ENDDECLS
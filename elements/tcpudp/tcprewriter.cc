@@ -185,8 +185,7 @@ TCPRewriter::TCPMapping::s() const
 // TCPRewriter
 
 TCPRewriter::TCPRewriter()
-  : _tcp_map(0), _tcp_done(0), _tcp_done_tail(0),
-    _tcp_gc_timer(tcp_gc_hook, this),
+  : _tcp_gc_timer(tcp_gc_hook, this),
     _tcp_done_gc_timer(tcp_done_gc_hook, this)
 {
 }
@@ -218,6 +217,7 @@ TCPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
   _tcp_gc_interval = 3600;		// 1 hour
   _tcp_done_gc_interval = 10;		// 10 seconds
   _dst_anno = true;
+  int nshards = 1;
 
   if (cp_va_kparse_remove_keywords
       (conf, this, errh,
@@ -226,11 +226,13 @@ TCPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
        "TCP_TIMEOUT", 0, cpSeconds, &_tcp_timeout_jiffies,
        "TCP_DONE_TIMEOUT", 0, cpSeconds, &_tcp_done_timeout_jiffies,
        "DST_ANNO", 0, cpBool, &_dst_anno,
+       "SHARDS", 0, cpInteger, &nshards,
        cpEnd) < 0)
     return -1;
 
   if (conf.size() != ninputs())
       return errh->error("need %d arguments, one per input port", ninputs());
+  configure_shards(nshards, errh);
 
   for (int i = 0; i < conf.size(); i++) {
     InputSpec is;
@@ -248,8 +250,10 @@ TCPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 TCPRewriter::initialize(ErrorHandler *)
 {
+  initialize_shards(_tcp_gc_interval, _tcp_timeout_jiffies,
+		    _tcp_gc_interval, _tcp_timeout_jiffies);
   _tcp_gc_timer.initialize(this);
-  _tcp_gc_timer.schedule_after_sec(_tcp_gc_interval);
+  _tcp_gc_timer.schedule_after(Timestamp::make_jiffies((click_jiffies_t) _shards[0]->tcp_wheel.tick()));
   _tcp_done_gc_timer.initialize(this);
   _tcp_done_gc_timer.schedule_after_sec(_tcp_done_gc_interval);
 
@@ -260,7 +264,7 @@ TCPRewriter::initialize(ErrorHandler *)
 void
 TCPRewriter::cleanup(CleanupStage)
 {
-  clear_map(_tcp_map);
+  cleanup_shards();
   for (int i = 0; i < _input_specs.size(); i++)
     if (_input_specs[i].kind == INPUT_SPEC_PATTERN)
       _input_specs[i].u.pattern.p->unuse();
@@ -279,44 +283,25 @@ void
 TCPRewriter::take_state(Element *e, ErrorHandler *errh)
 {
   TCPRewriter *rw = (TCPRewriter *)e->cast("TCPRewriter");
-  if (!rw) return;
-
-  if (noutputs() != rw->noutputs()) {
-    errh->warning("taking mappings from `%s', although it has %s output ports", rw->declaration().c_str(), (rw->noutputs() > noutputs() ? "more" : "fewer"));
-    if (noutputs() < rw->noutputs())
-      errh->message("(out of range mappings will be dropped)");
-  }
-
-  _tcp_map.swap(rw->_tcp_map);
-
-  // check rw->_all_patterns against our _all_patterns
-  Vector<Pattern *> pattern_map;
-  for (int i = 0; i < rw->_all_patterns.size(); i++) {
-    Pattern *p = rw->_all_patterns[i], *q = 0;
-    for (int j = 0; j < _all_patterns.size() && !q; j++)
-      if (_all_patterns[j]->can_accept_from(*p))
-	q = _all_patterns[j];
-    pattern_map.push_back(q);
-  }
-
-  take_state_map(_tcp_map, &_tcp_done, &_tcp_done_tail, rw->_all_patterns, pattern_map);
+  if (rw)
+    take_state_shards(rw, errh);
 }
 
 void
 TCPRewriter::tcp_gc_hook(Timer *timer, void *thunk)
 {
   TCPRewriter *rw = (TCPRewriter *)thunk;
-  rw->clean_map(rw->_tcp_map, click_jiffies() - rw->_tcp_timeout_jiffies);
-  timer->reschedule_after_sec(rw->_tcp_gc_interval);
+  if (rw->reap_shards(IP_PROTO_TCP))
+    timer->schedule_now();
+  else
+    timer->schedule_after(Timestamp::make_jiffies((click_jiffies_t) rw->_shards[0]->tcp_wheel.tick()));
 }
 
 void
 TCPRewriter::tcp_done_gc_hook(Timer *timer, void *thunk)
 {
   TCPRewriter *rw = (TCPRewriter *)thunk;
-  rw->clean_map_free_tracked
-    (rw->_tcp_map, rw->_tcp_done, rw->_tcp_done_tail,
-     click_jiffies() - rw->_tcp_done_timeout_jiffies);
+  rw->reap_shards_done(rw->_tcp_done_timeout_jiffies);
   timer->reschedule_after_sec(rw->_tcp_done_gc_interval);
 }
 
@@ -329,19 +314,10 @@ TCPRewriter::apply_pattern(Pattern *pattern, int ip_p, const IPFlowID &flow,
   TCPMapping *forward = new TCPMapping(_dst_anno);
   TCPMapping *reverse = new TCPMapping(_dst_anno);
 
-  if (forward && reverse) {
-    if (!pattern)
-      Mapping::make_pair(ip_p, flow, flow, fport, rport, forward, reverse);
-    else if (!pattern->create_mapping(ip_p, flow, fport, rport, forward, reverse, _tcp_map))
-      goto failure;
-
-    IPFlowID reverse_flow = forward->flow_id().reverse();
-    _tcp_map.set(flow, forward);
-    _tcp_map.set(reverse_flow, reverse);
+  if (forward && reverse
+      && create_pair(pattern, ip_p, flow, fport, rport, forward, reverse))
     return forward;
-  }
 
- failure:
   _nmapping_failures++;
   delete forward;
   delete reverse;
@@ -366,13 +342,16 @@ TCPRewriter::push(int port, Packet *p_in)
     return;
   }
 
-  TCPMapping *m = static_cast<TCPMapping *>(_tcp_map.get(flow));
+  Shard *home = flow_home(flow), *spill;
+  home->lock.acquire();
+  TCPMapping *m = static_cast<TCPMapping *>(find_mapping(IP_PROTO_TCP, flow, spill));
 
   if (!m) {			// create new mapping
     const InputSpec &is = _input_specs[port];
     switch (is.kind) {
 
      case INPUT_SPEC_NOCHANGE:
+      home->lock.release();
       output(is.u.output).push(p);
       return;
 
@@ -395,18 +374,28 @@ TCPRewriter::push(int port, Packet *p_in)
 
     }
     if (!m) {
+      home->lock.release();
       p->kill();
       return;
     }
   }
 
   m->apply(p);
-  output(m->output()).push(p);
 
   // add to list for dropping TCP connections faster
   if (!m->free_tracked() && (tcph->th_flags & (TH_FIN | TH_RST))
-      && m->session_over())
-    m->add_to_free_tracked_tail(_tcp_done, _tcp_done_tail);
+      && m->session_over()) {
+    Shard *s = (spill ? spill : mapping_home(m));
+    s->lock.acquire();
+    m->add_to_free_tracked_tail(s->tcp_done, s->tcp_done_tail);
+    s->lock.release();
+  }
+
+  int out = m->output();
+  if (spill)
+    spill->lock.release();
+  home->lock.release();
+  output(out).push(p);
 }
 
 
@@ -415,10 +404,15 @@ TCPRewriter::dump_mappings_handler(Element *e, void *)
 {
   TCPRewriter *rw = (TCPRewriter *)e;
   StringAccum tcps;
-  for (Map::iterator iter = rw->_tcp_map.begin(); iter.live(); iter++) {
-    TCPMapping *m = static_cast<TCPMapping *>(iter.value());
-    if (m->is_primary())
-      tcps << m->s() << "\n";
+  for (int i = 0; i < rw->_shards.size(); i++) {
+    Shard *s = rw->_shards[i];
+    s->lock.acquire();
+    for (Map::iterator iter = s->tcp_map.begin(); iter.live(); iter++) {
+      TCPMapping *m = static_cast<TCPMapping *>(iter.value());
+      if (m->is_primary())
+	tcps << m->s() << "\n";
+    }
+    s->lock.release();
   }
   return tcps.take_string();
 }
@@ -438,12 +432,23 @@ String
 TCPRewriter::dump_nmappings_handler(Element *e, void *thunk)
 {
   TCPRewriter *rw = (TCPRewriter *)e;
-  if (!thunk)
-      return String(rw->_tcp_map.size());
+  if (!thunk) {
+      uint32_t n = 0;
+      for (int i = 0; i < rw->_shards.size(); i++)
+	  n += rw->_shards[i]->tcp_map.size();
+      return String(n);
+  }
   else
       return String(rw->_nmapping_failures);
 }
 
+String
+TCPRewriter::gc_stats_handler(Element *e, void *)
+{
+  TCPRewriter *rw = (TCPRewriter *)e;
+  return rw->unparse_gc_stats();
+}
+
 void
 TCPRewriter::add_handlers()
 {
@@ -451,6 +456,7 @@ TCPRewriter::add_handlers()
   add_read_handler("nmappings", dump_nmappings_handler, (void *)0);
   add_read_handler("mapping_failures", dump_nmappings_handler, (void *)1);
   add_read_handler("patterns", dump_patterns_handler, (void *)0);
+  add_read_handler("gc_stats", gc_stats_handler, 0);
 }
 
 int
@@ -59,13 +59,25 @@ seconds.
 Boolean. If true, then set the destination IP address annotation on passing
 packets to the rewritten destination address. Default is true.
 
+=item SHARDS I<n>
+
+Integer. Split the mapping table into I<n> shards, each with its own lock.
+Zero means one shard per Click thread. Default is 1.
+
 =back
 
+As in IPRewriter, stale mappings are removed incrementally, and shards are
+chosen by a hash that is the same for both directions of a flow.
+
 =h mappings read-only
 
 Returns a human-readable description of the TCPRewriter's current set of
 mappings.
 
+=h gc_stats read-only
+
+Returns statistics on stale mapping removal; see IPRewriter.
+
 =a IPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
 FTPPortMapper */
 
@@ -121,10 +133,6 @@ class TCPRewriter : public IPRw { public:
 
  private:
 
-  Map _tcp_map;
-  Mapping *_tcp_done;
-  Mapping *_tcp_done_tail;
-
   Vector<InputSpec> _input_specs;
   bool _dst_anno;
 
@@ -143,16 +151,22 @@ class TCPRewriter : public IPRw { public:
   static String dump_mappings_handler(Element *, void *);
   static String dump_nmappings_handler(Element *, void *);
   static String dump_patterns_handler(Element *, void *);
+  static String gc_stats_handler(Element *, void *);
 
 };
 
 inline TCPRewriter::TCPMapping *
 TCPRewriter::get_mapping(int ip_p, const IPFlowID &in) const
 {
-  if (ip_p == IP_PROTO_TCP)
-    return static_cast<TCPMapping *>(_tcp_map[in]);
-  else
+  if (ip_p != IP_PROTO_TCP)
     return 0;
+  Shard *home = flow_home(in), *spill;
+  home->lock.acquire();
+  Mapping *m = find_mapping(ip_p, in, spill);
+  if (spill)
+    spill->lock.release();
+  home->lock.release();
+  return static_cast<TCPMapping *>(m);
 }
 
 inline tcp_seq_t
@@ -0,0 +1,189 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * aggregateipflowsbenchmark.{cc,hh} -- measure AggregateIPFlows speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "aggregateipflowsbenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+AggregateIPFlowsBenchmark::AggregateIPFlowsBenchmark()
+    : _aggregator(0), _nflows(10000000), _npackets(4), _nactive(10000),
+      _rate(100000), _seed(1), _stop(true), _task(this), _packet_rate(0)
+{
+}
+
+AggregateIPFlowsBenchmark::~AggregateIPFlowsBenchmark()
+{
+}
+
+int
+AggregateIPFlowsBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "AGGREGATOR", cpkP+cpkM, cpElement, &_aggregator,
+		     "FLOWS", 0, cpUnsigned, &_nflows,
+		     "PACKETS", 0, cpUnsigned, &_npackets,
+		     "ACTIVE", 0, cpUnsigned, &_nactive,
+		     "RATE", 0, cpUnsigned, &_rate,
+		     "SEED", 0, cpUnsigned, &_seed,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_nflows < 1 || _npackets < 1 || _nactive < 1 || _rate < 1)
+	return errh->error("FLOWS, PACKETS, ACTIVE, and RATE must be positive");
+    if (_aggregator->ninputs() < 1)
+	return errh->error("AGGREGATOR has no inputs");
+    return 0;
+}
+
+int
+AggregateIPFlowsBenchmark::initialize(ErrorHandler *errh)
+{
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+Packet *
+AggregateIPFlowsBenchmark::make_packet(const Slot &s, const Timestamp &ts)
+{
+    bool tcp = s.flow & 1;
+    uint32_t hlen = (tcp ? sizeof(click_tcp) : sizeof(click_udp));
+    WritablePacket *p = Packet::make(sizeof(click_ip) + hlen);
+    if (!p)
+	return 0;
+    memset(p->data(), 0, p->length());
+    click_ip *iph = reinterpret_cast<click_ip *>(p->data());
+    iph->ip_v = 4;
+    iph->ip_hl = sizeof(click_ip) >> 2;
+    iph->ip_len = htons(p->length());
+    iph->ip_ttl = 64;
+    iph->ip_p = (tcp ? IP_PROTO_TCP : IP_PROTO_UDP);
+
+    // odd packets travel in the reverse direction
+    uint32_t src = htonl(0x0A000000 | (s.flow & 0x00FFFFFF));
+    uint32_t dst = htonl(0xC0000000 | (s.dst & 0x3FFFFFFF));
+    uint16_t sport = htons(1024 + ((s.ports >> 16) & 0x7FFF) + (s.flow >> 24));
+    uint16_t dport = htons(s.ports & 0xFFFF);
+    bool reverse = s.sent & 1;
+    iph->ip_src.s_addr = (reverse ? dst : src);
+    iph->ip_dst.s_addr = (reverse ? src : dst);
+    p->set_ip_header(iph, sizeof(click_ip));
+
+    if (tcp) {
+	click_tcp *tcph = p->tcp_header();
+	tcph->th_sport = (reverse ? dport : sport);
+	tcph->th_dport = (reverse ? sport : dport);
+	tcph->th_off = sizeof(click_tcp) >> 2;
+	if (s.sent == 0)
+	    tcph->th_flags = TH_SYN;
+	else if (_npackets >= 3 && s.sent + 2 >= _npackets)
+	    tcph->th_flags = TH_FIN | TH_ACK;
+	else
+	    tcph->th_flags = TH_ACK;
+    } else {
+	click_udp *udph = p->udp_header();
+	udph->uh_sport = (reverse ? dport : sport);
+	udph->uh_dport = (reverse ? sport : dport);
+	udph->uh_ulen = htons(sizeof(click_udp));
+    }
+
+    p->timestamp_anno() = ts;
+    return p;
+}
+
+bool
+AggregateIPFlowsBenchmark::run_task(Task *)
+{
+    click_srandom(_seed);
+    uint32_t nactive = (_nactive < _nflows ? _nactive : _nflows);
+    Vector<Slot> slots;
+    uint32_t next_flow = 0;
+    for (uint32_t i = 0; i < nactive; i++) {
+	Slot s;
+	s.flow = next_flow++;
+	s.dst = (click_random() << 16) ^ click_random();
+	s.ports = (click_random() << 16) ^ click_random();
+	s.sent = 0;
+	slots.push_back(s);
+    }
+
+    Timestamp base = Timestamp::make_sec(1000000000);
+    Timestamp total, max_pause;
+    uint64_t npackets = 0;
+    while (slots.size()) {
+	int which = click_random() % slots.size();
+	Slot &s = slots[which];
+	Timestamp ts = base + Timestamp::make_usec(npackets / _rate, (npackets % _rate) * 1000000 / _rate);
+	Packet *p = make_packet(s, ts);
+	if (!p)
+	    break;
+
+	Timestamp t0 = Timestamp::now();
+	_aggregator->push(0, p);
+	Timestamp pause = Timestamp::now() - t0;
+	total += pause;
+	if (pause > max_pause)
+	    max_pause = pause;
+	npackets++;
+
+	if (++s.sent == _npackets) {
+	    if (next_flow < _nflows) {
+		s.flow = next_flow++;
+		s.dst = (click_random() << 16) ^ click_random();
+		s.ports = (click_random() << 16) ^ click_random();
+		s.sent = 0;
+	    } else {
+		s = slots.back();
+		slots.pop_back();
+	    }
+	}
+    }
+
+    _packet_rate = (total ? npackets / total.doubleval() : 0);
+    _max_pause = max_pause;
+    if (_stop) {
+	click_chatter("%s: %u flows, %.0f packets/s, longest packet " PRITIMESTAMP "s",
+		      declaration().c_str(), next_flow, _packet_rate,
+		      _max_pause.sec(), _max_pause.subsec());
+	router()->please_stop_driver();
+    }
+    return true;
+}
+
+String
+AggregateIPFlowsBenchmark::read_handler(Element *e, void *thunk)
+{
+    AggregateIPFlowsBenchmark *b = static_cast<AggregateIPFlowsBenchmark *>(e);
+    if (thunk)
+	return b->_max_pause.unparse();
+    else
+	return String(b->_packet_rate);
+}
+
+void
+AggregateIPFlowsBenchmark::add_handlers()
+{
+    add_read_handler("packet_rate", read_handler, 0);
+    add_read_handler("max_pause", read_handler, (void *) 1);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(AggregateIPFlowsBenchmark)
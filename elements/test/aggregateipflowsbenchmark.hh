@@ -0,0 +1,120 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_AGGREGATEIPFLOWSBENCHMARK_HH
+#define CLICK_AGGREGATEIPFLOWSBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+AggregateIPFlowsBenchmark(AGGREGATOR, [<keyword> FLOWS, PACKETS, ACTIVE, RATE, SEED, STOP])
+
+=s test
+
+measures AggregateIPFlows speed on a synthetic trace
+
+=d
+
+AggregateIPFlowsBenchmark pushes a synthetic packet trace directly into
+AGGREGATOR, an AggregateIPFlows or similar element, and measures how fast it
+handles the trace and how long the slowest packet took.  The slowest packet
+shows the cost of removing expired flows, which some designs do all at once.
+AGGREGATOR's outputs should lead to Discard or similar.
+
+The trace has FLOWS flows of PACKETS packets each, half of them TCP and half
+UDP.  About ACTIVE flows are open at any moment; each packet belongs to a
+random open flow, and a flow that has sent all its packets is replaced by a
+new one.  Packets alternate between the two directions of their flow.  TCP
+flows start with a SYN and finish with a FIN in each direction.  Timestamps
+advance by 1/RATE seconds per packet, so the trace spans FLOWS*PACKETS/RATE
+seconds of packet time, and flows expire according to AGGREGATOR's timeouts.
+
+Each packet is built just before it is pushed, but only the push is timed.
+
+Keyword arguments are:
+
+=over 8
+
+=item FLOWS
+
+Unsigned.  Number of flows.  Default is 10000000.
+
+=item PACKETS
+
+Unsigned.  Packets per flow.  Default is 4.
+
+=item ACTIVE
+
+Unsigned.  Number of concurrently open flows.  Default is 10000.
+
+=item RATE
+
+Unsigned.  Packets per second of packet time.  Default is 100000.
+
+=item SEED
+
+Unsigned.  Random number seed.  Default is 1.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h packet_rate read-only
+
+Returns the measured packets per second.
+
+=h max_pause read-only
+
+Returns the longest time AGGREGATOR took to handle one packet, in seconds.
+
+=a
+
+AggregateIPFlows, IPRewriterBenchmark */
+
+class AggregateIPFlowsBenchmark : public Element { public:
+
+    AggregateIPFlowsBenchmark();
+    ~AggregateIPFlowsBenchmark();
+
+    const char *class_name() const	{ return "AggregateIPFlowsBenchmark"; }
+    const char *port_count() const	{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    struct Slot {
+	uint32_t flow;
+	uint32_t dst;
+	uint32_t ports;
+	uint32_t sent;
+    };
+
+    Element *_aggregator;
+    uint32_t _nflows;
+    uint32_t _npackets;
+    uint32_t _nactive;
+    uint32_t _rate;
+    uint32_t _seed;
+    bool _stop;
+
+    Task _task;
+    double _packet_rate;
+    Timestamp _max_pause;
+
+    Packet *make_packet(const Slot &, const Timestamp &);
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,190 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * arptablebenchmark.{cc,hh} -- measure ARP table lookup speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "arptablebenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/standard/scheduleinfo.hh>
+#include "elements/ethernet/arptable.hh"
+CLICK_DECLS
+
+ARPTableBenchmark::ARPTableBenchmark()
+    : _table(0), _nentries(1000), _nthreads(1), _nlookups(10000000),
+      _updates_on(true), _locked(false), _stop(true), _control_task(this),
+      _workers(0), _updates(0), _lookup_rate(0), _update_rate(0)
+{
+}
+
+ARPTableBenchmark::~ARPTableBenchmark()
+{
+}
+
+int
+ARPTableBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "TABLE", cpkP+cpkM, cpElementCast, "ARPTable", &_table,
+		     "ENTRIES", 0, cpUnsigned, &_nentries,
+		     "THREADS", 0, cpUnsigned, &_nthreads,
+		     "LOOKUPS", 0, cpUnsigned, &_nlookups,
+		     "UPDATE", 0, cpBool, &_updates_on,
+		     "LOCK", 0, cpBool, &_locked,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_nentries < 1 || _nthreads < 1)
+	return errh->error("ENTRIES and THREADS must be positive");
+    return 0;
+}
+
+inline IPAddress
+ARPTableBenchmark::address(uint32_t i)
+{
+    return IPAddress(htonl(ADDR_BASE + i));
+}
+
+inline EtherAddress
+ARPTableBenchmark::ether_address(uint32_t i, uint32_t version)
+{
+    uint16_t s[3];
+    s[0] = htons(0x0200 | (version & 0xFF));
+    s[1] = htons(i >> 16);
+    s[2] = htons(i);
+    return EtherAddress((const unsigned char *) s);
+}
+
+int
+ARPTableBenchmark::initialize(ErrorHandler *errh)
+{
+    if ((int) _nthreads > master()->nthreads())
+	errh->warning("THREADS %u, but only %d threads running", _nthreads, master()->nthreads());
+
+    for (uint32_t i = 0; i < _nentries; i++)
+	if (_table->insert(address(i), ether_address(i, 0)) < 0)
+	    return errh->error("could not add address %u", i);
+
+    _workers = new Worker[_nthreads];
+    _nfinished = 0;
+    for (uint32_t i = 0; i < _nthreads; i++) {
+	Worker &w = _workers[i];
+	w.task = new Task(this);
+	w.nlookups = w.misses = w.sum = 0;
+	ScheduleInfo::initialize_task(this, w.task, false, errh);
+	w.task->move_thread(i % master()->nthreads());
+    }
+    ScheduleInfo::initialize_task(this, &_control_task, errh);
+    return 0;
+}
+
+void
+ARPTableBenchmark::cleanup(CleanupStage)
+{
+    if (_workers)
+	for (uint32_t i = 0; i < _nthreads; i++)
+	    delete _workers[i].task;
+    delete[] _workers;
+    _workers = 0;
+}
+
+bool
+ARPTableBenchmark::run_worker(Worker &w)
+{
+    uint32_t x = (uintptr_t) &w ^ w.nlookups;
+    int n = (_nlookups - w.nlookups < 4096 ? _nlookups - w.nlookups : 4096);
+    for (int i = 0; i < n; i++) {
+	x = x * 1103515245 + 12345;
+	EtherAddress eth;
+	if (_locked)
+	    _lock.acquire_read();
+	int r = _table->lookup(address((x >> 8) % _nentries), &eth, 0);
+	if (_locked)
+	    _lock.release_read();
+	if (r < 0)
+	    w.misses++;
+	else
+	    w.sum += eth.data()[5];
+    }
+    w.nlookups += n;
+    if (w.nlookups < _nlookups) {
+	w.task->fast_reschedule();
+	return true;
+    }
+    _nfinished.fetch_and_add(1);
+    return n > 0;
+}
+
+bool
+ARPTableBenchmark::run_task(Task *t)
+{
+    if (t != &_control_task) {
+	for (uint32_t i = 0; i < _nthreads; i++)
+	    if (_workers[i].task == t)
+		return run_worker(_workers[i]);
+	return false;
+    }
+
+    if (!_t0) {
+	_t0 = Timestamp::now();
+	for (uint32_t i = 0; i < _nthreads; i++)
+	    _workers[i].task->reschedule();
+    } else if (_nfinished.value() == _nthreads) {
+	finish();
+	return false;
+    } else if (_updates_on) {
+	uint32_t i = click_random(0, _nentries - 1);
+	_table->insert(address(i), ether_address(i, ++_updates));
+    }
+    _control_task.fast_reschedule();
+    return true;
+}
+
+void
+ARPTableBenchmark::finish()
+{
+    double delta = (Timestamp::now() - _t0).doubleval();
+    uint32_t lookups = 0, misses = 0;
+    for (uint32_t i = 0; i < _nthreads; i++) {
+	lookups += _workers[i].nlookups;
+	misses += _workers[i].misses;
+    }
+    _lookup_rate = lookups / delta;
+    _update_rate = _updates / delta;
+    if (_stop) {
+	click_chatter("%s: %u threads, %u lookups, %u missed, %.3f s", declaration().c_str(), _nthreads, lookups, misses, delta);
+	click_chatter("%s: %.0f lookups/s, %.0f updates/s", declaration().c_str(), _lookup_rate, _update_rate);
+	router()->please_stop_driver();
+    }
+}
+
+String
+ARPTableBenchmark::read_handler(Element *e, void *thunk)
+{
+    ARPTableBenchmark *atb = static_cast<ARPTableBenchmark *>(e);
+    return String(thunk ? atb->_update_rate : atb->_lookup_rate);
+}
+
+void
+ARPTableBenchmark::add_handlers()
+{
+    add_read_handler("lookup_rate", read_handler, 0);
+    add_read_handler("update_rate", read_handler, (void *) 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(ARPTable)
+EXPORT_ELEMENT(ARPTableBenchmark)
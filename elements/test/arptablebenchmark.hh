@@ -0,0 +1,131 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ARPTABLEBENCHMARK_HH
+#define CLICK_ARPTABLEBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/atomic.hh>
+#include <click/sync.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+class ARPTable;
+
+/*
+=c
+
+ARPTableBenchmark(TABLE, [<keyword> ENTRIES, THREADS, LOOKUPS, UPDATE, LOCK, STOP])
+
+=s test
+
+measures ARP table lookup speed across threads
+
+=d
+
+ARPTableBenchmark adds ENTRIES addresses to TABLE, an ARPTable element, and
+then runs THREADS tasks, on threads 0 through THREADS-1, that each look up
+LOOKUPS random addresses, as ARPQuerier does for every IP packet it sends.
+Meanwhile, if UPDATE is true, another task repeatedly refreshes random
+entries, as ARP responses would.
+
+The total lookup rate and the number of updates done meanwhile are
+reported.  Run Click with at least THREADS threads to measure scaling.
+
+Keyword arguments are:
+
+=over 8
+
+=item ENTRIES
+
+Unsigned.  Number of addresses.  Default is 1000.
+
+=item THREADS
+
+Unsigned.  Number of lookup tasks.  Default is 1.
+
+=item LOOKUPS
+
+Unsigned.  Number of lookups per task.  Default is 10000000.
+
+=item UPDATE
+
+Boolean.  If true, refresh entries while the lookups run.  Default is true.
+
+=item LOCK
+
+Boolean.  If true, each lookup also takes and releases a read lock shared by
+all tasks, as every ARPTable lookup once did.  This measures what the shared
+lock costs.  Default is false.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h lookup_rate read-only
+
+Returns the measured lookups per second, summed over all tasks.
+
+=h update_rate read-only
+
+Returns the updates per second done while the lookups ran.
+
+=a
+
+ARPTable, ARPQuerier */
+
+class ARPTableBenchmark : public Element { public:
+
+    ARPTableBenchmark();
+    ~ARPTableBenchmark();
+
+    const char *class_name() const		{ return "ARPTableBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    enum { ADDR_BASE = 0x0A000000 };	// 10.0.0.0
+
+    // one per lookup task, padded so tasks do not share cache lines
+    struct Worker {
+	Task *task;
+	uint32_t nlookups;
+	uint32_t misses;
+	uint32_t sum;
+	char pad[64];
+    };
+
+    ARPTable *_table;
+    uint32_t _nentries;
+    uint32_t _nthreads;
+    uint32_t _nlookups;
+    bool _updates_on;
+    bool _locked;
+    bool _stop;
+
+    Task _control_task;
+    Worker *_workers;
+    ReadWriteLock _lock;
+    uint32_t _updates;
+    atomic_uint32_t _nfinished;
+    Timestamp _t0;
+    double _lookup_rate;
+    double _update_rate;
+
+    static inline IPAddress address(uint32_t i);
+    static inline EtherAddress ether_address(uint32_t i, uint32_t version);
+    bool run_worker(Worker &);
+    void finish();
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
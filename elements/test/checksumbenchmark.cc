@@ -0,0 +1,197 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * checksumbenchmark.{cc,hh} -- measure Internet checksum speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "checksumbenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+ChecksumBenchmark::ChecksumBenchmark()
+    : _nbytes(1000000000), _stop(true), _task(this), _buf(0)
+{
+}
+
+ChecksumBenchmark::~ChecksumBenchmark()
+{
+}
+
+int
+ChecksumBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String sizes = "20 64 128 256 512 1024 1500 9000";
+    if (cp_va_kparse(conf, this, errh,
+		     "SIZES", cpkP, cpArgument, &sizes,
+		     "BYTES", 0, cpUnsigned, &_nbytes,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    Vector<String> words;
+    cp_spacevec(sizes, words);
+    _sizes.clear();
+    for (int i = 0; i < words.size(); i++) {
+	int size;
+	if (!cp_integer(words[i], 0, &size) || size < 1 || size > 65535)
+	    return errh->error("SIZES should be byte counts between 1 and 65535");
+	_sizes.push_back(size);
+    }
+    return 0;
+}
+
+// the original 16-bit-at-a-time checksum loop
+static uint16_t
+reference_cksum(const unsigned char *addr, int len)
+{
+    const uint16_t *w = (const uint16_t *) addr;
+    uint32_t sum = 0;
+    uint16_t answer = 0;
+    for (; len > 1; len -= 2)
+	sum += *w++;
+    if (len == 1) {
+	*(unsigned char *) (&answer) = *(const unsigned char *) w;
+	sum += answer;
+    }
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum += (sum >> 16);
+    return ~sum;
+}
+
+// called through a pointer so it is not inlined, as the library version
+// could not be
+static uint16_t (* volatile reference_cksum_ptr)(const unsigned char *, int) = reference_cksum;
+
+#define CHECK(x, len) if (!(x)) return errh->error("%s:%d: test `%s' failed for length %d", __FILE__, __LINE__, #x, (len));
+
+int
+ChecksumBenchmark::check(ErrorHandler *errh)
+{
+    for (int off = 0; off < 8; off += 2)
+	for (int len = 0; len <= 2048; len++) {
+	    const unsigned char *x = _buf + off + len * 16;
+	    CHECK(click_in_cksum(x, len) == reference_cksum(x, len), len);
+	}
+
+    // all-ones data exercises carries out of every accumulator
+    unsigned char *ones = _buf + BUFSIZE - 70000;
+    memset(ones, 0xFF, 65536);
+    CHECK(click_in_cksum(ones, 65535) == reference_cksum(ones, 65535), 65535);
+    CHECK(click_in_cksum(ones, 65536) == reference_cksum(ones, 65536), 65536);
+    for (int i = 0; i < 65536; i++)
+	ones[i] = click_random();
+
+    // incremental updates match recomputation
+    for (int i = 0; i < 1000; i++) {
+	unsigned char *x = _buf + 2 * click_random(0, 4000);
+	int len = 2 * click_random(4, 750);
+	int pos = 2 * click_random(0, len / 2 - 2);
+	uint16_t csum = click_in_cksum(x, len);
+	uint16_t hw;
+	uint32_t w;
+	if (i % 2) {
+	    memcpy(&hw, x + pos, 2);
+	    uint16_t new_hw = click_random();
+	    memcpy(x + pos, &new_hw, 2);
+	    click_update_in_cksum(&csum, hw, new_hw);
+	} else {
+	    memcpy(&w, x + pos, 4);
+	    uint32_t new_w = (click_random() << 16) ^ click_random();
+	    memcpy(x + pos, &new_w, 4);
+	    click_update_in_cksum32(&csum, w, new_w);
+	}
+	uint16_t fresh = click_in_cksum(x, len);
+	// 0x0000 and 0xFFFF are both one's-complement zero
+	CHECK(csum == fresh || (uint16_t) (csum + fresh) == 0xFFFF, len);
+    }
+    return 0;
+}
+
+int
+ChecksumBenchmark::initialize(ErrorHandler *errh)
+{
+    if (!(_buf = new unsigned char[BUFSIZE + 8]))
+	return errh->error("out of memory!");
+    for (int i = 0; i < BUFSIZE + 8; i++)
+	_buf[i] = click_random();
+    if (check(errh) < 0)
+	return -1;
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+void
+ChecksumBenchmark::cleanup(CleanupStage)
+{
+    delete[] _buf;
+}
+
+double
+ChecksumBenchmark::measure(int size, bool reference, uint32_t &sum)
+{
+    int stride = (size + 1) & ~1;
+    int npackets = _nbytes / size + 1;
+    int pos = 0;
+    Timestamp t0 = Timestamp::now();
+    for (int i = 0; i < npackets; i++) {
+	if (pos + size > BUFSIZE)
+	    pos = 0;
+	if (reference)
+	    sum += reference_cksum_ptr(_buf + pos, size);
+	else
+	    sum += click_in_cksum(_buf + pos, size);
+	pos += stride;
+    }
+    Timestamp t1 = Timestamp::now();
+    return (double) npackets * size * 8 / (t1 - t0).doubleval() / 1e9;
+}
+
+bool
+ChecksumBenchmark::run_task(Task *)
+{
+    StringAccum sa;
+    uint32_t sum = 0;
+    for (int i = 0; i < _sizes.size(); i++) {
+	double rate = measure(_sizes[i], false, sum);
+	double ref_rate = measure(_sizes[i], true, sum);
+	sa << _sizes[i] << ' ' << rate << ' ' << ref_rate << '\n';
+	if (_stop)
+	    click_chatter("%s: %d bytes, %.2f Gbit/s (reference %.2f Gbit/s)",
+			  declaration().c_str(), _sizes[i], rate, ref_rate);
+    }
+    _results = sa.take_string();
+    if (_stop) {
+	click_chatter("%s: (%u)", declaration().c_str(), sum);
+	router()->please_stop_driver();
+    }
+    return true;
+}
+
+String
+ChecksumBenchmark::read_handler(Element *e, void *)
+{
+    return static_cast<ChecksumBenchmark *>(e)->_results;
+}
+
+void
+ChecksumBenchmark::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(ChecksumBenchmark)
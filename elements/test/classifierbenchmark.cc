@@ -0,0 +1,266 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * classifierbenchmark.{cc,hh} -- check and measure specialized Classifiers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "classifierbenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/standard/scheduleinfo.hh>
+#include "elements/standard/classifier.hh"
+#include "elements/ip/ipfilter.hh"
+CLICK_DECLS
+
+ClassifierBenchmark::ClassifierBenchmark()
+    : _classifier(0), _reference(0), _ip(false), _npackets(4096), _length(128),
+      _rounds(1000), _seed(1), _check(true), _stop(true), _task(this)
+{
+    _rate[0] = _rate[1] = _rate[2] = 0;
+}
+
+ClassifierBenchmark::~ClassifierBenchmark()
+{
+}
+
+int
+ClassifierBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Element *e, *ref = 0;
+    if (cp_va_kparse(conf, this, errh,
+		     "CLASSIFIER", cpkP+cpkM, cpElement, &e,
+		     "REFERENCE", 0, cpElement, &ref,
+		     "PACKETS", 0, cpInteger, &_npackets,
+		     "LENGTH", 0, cpInteger, &_length,
+		     "ROUNDS", 0, cpInteger, &_rounds,
+		     "SEED", 0, cpUnsigned, &_seed,
+		     "CHECK", 0, cpBool, &_check,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (!(_classifier = static_cast<Classifier *>(e->cast("Classifier"))))
+	return errh->error("CLASSIFIER must be a Classifier element");
+    if (ref && !(_reference = static_cast<Classifier *>(ref->cast("Classifier"))))
+	return errh->error("REFERENCE must be a Classifier element");
+    _ip = (e->cast("IPFilter") != 0);
+    if (_npackets < 1 || _length < 1 || _length > 4096 || _rounds < 1)
+	return errh->error("bad PACKETS, LENGTH, or ROUNDS");
+    return 0;
+}
+
+static int
+parse_jump(const String &word, const char *prefix)
+{
+    // "yes->step 3" is split as "yes->step", "3"; "no->[2]" stays whole
+    int x;
+    String s = word.substring(strlen(prefix));
+    if (s.length() > 2 && s[0] == '[' && cp_integer(s.substring(1, s.length() - 2), &x))
+	return -x;
+    return 0;
+}
+
+int
+ClassifierBenchmark::parse_program(Vector<Test> &tests, ErrorHandler *errh)
+{
+    // Parse the program handler's text, as click-fastclassifier does, e.g.
+    //  0  12/08060000%ffff0000  yes->step 1  no->step 3
+    Classifier *c = (_reference ? _reference : _classifier);
+    const Handler *h = Router::handler(c, "program");
+    if (!h || !h->readable())
+	return errh->error("%<%s%> has no %<program%> handler", c->name().c_str());
+    String text = h->call_read(c);
+    const char *s = text.begin(), *end = text.end();
+    while (s < end) {
+	const char *eol = s;
+	while (eol < end && *eol != '\n')
+	    eol++;
+	Vector<String> words;
+	cp_spacevec(text.substring(s, eol), words);
+	s = eol + 1;
+	int step, slash;
+	if (words.size() < 4 || !cp_integer(words[0], &step)
+	    || (slash = words[1].find_left('/')) < 0)
+	    continue;
+	Test t;
+	String value = words[1].substring(slash + 1, 8);
+	String mask = words[1].substring(slash + 10, 8);
+	if (!cp_integer(words[1].substring(0, slash), &t.offset))
+	    return errh->error("cannot parse program line %d", step);
+	for (int k = 0; k < 4; k++) {
+	    int v, m;
+	    cp_integer(value.substring(2 * k, 2), 16, &v);
+	    cp_integer(mask.substring(2 * k, 2), 16, &m);
+	    t.value[k] = v;
+	    t.mask[k] = m;
+	}
+	int w = 2;
+	for (int k = 1; k >= 0; k--) {
+	    const char *prefix = (k ? "yes->" : "no->");
+	    if (words[w] == String(prefix) + "step") {
+		cp_integer(words[w + 1], &t.j[k]);
+		w += 2;
+	    } else {
+		t.j[k] = parse_jump(words[w], prefix);
+		w++;
+	    }
+	}
+	tests.push_back(t);
+    }
+    return 0;
+}
+
+Packet *
+ClassifierBenchmark::make_packet(const Vector<Test> &tests, int safe_length)
+{
+    WritablePacket *p = Packet::make(_length);
+    if (!p)
+	return 0;
+    unsigned char *data = p->data();
+    for (int i = 0; i < _length; i++)
+	data[i] = click_random();
+
+    // Walk the program, mostly choosing to satisfy each test.
+    for (int pos = 0; tests.size() && pos >= 0; ) {
+	const Test &t = tests[pos];
+	bool yes = click_random(0, 3) != 0;
+	if (yes)
+	    for (int k = 0; k < 4; k++) {
+		int off = t.offset + k;
+		if (_ip && off >= IPFilter::TRANSP_FAKE_OFFSET)
+		    off += 20 - IPFilter::TRANSP_FAKE_OFFSET;
+		if (t.mask[k] && off >= 0 && off < _length)
+		    data[off] = (data[off] & ~t.mask[k]) | t.value[k];
+	    }
+	int next = t.j[yes];
+	pos = (next > pos ? next : -1);
+    }
+
+    if (_ip) {
+	p->set_network_header(data, 20);
+	if (_length < 20)
+	    p->set_network_header(data, 0);
+    }
+    if (click_random(0, 7) == 0 && safe_length > 0)
+	p->take(click_random(1, safe_length < _length ? safe_length : _length));
+    return p;
+}
+
+int
+ClassifierBenchmark::initialize(ErrorHandler *errh)
+{
+    Vector<Test> tests;
+    if (parse_program(tests, errh) < 0)
+	return -1;
+
+    // find the safe length
+    int safe_length = 0;
+    Classifier *c = (_reference ? _reference : _classifier);
+    String text = Router::handler(c, "program")->call_read(c);
+    int sl = text.find_left("safe length ");
+    if (sl >= 0)
+	cp_integer(text.substring(sl + 12, text.find_left('\n', sl) - sl - 12), &safe_length);
+
+    click_srandom(_seed);
+    for (int i = 0; i < _npackets; i++) {
+	Packet *p = make_packet(tests, safe_length);
+	if (!p)
+	    return errh->error("out of memory!");
+	_packets.push_back(p);
+    }
+    if (_check && mismatches(errh) > 0)
+	return -1;
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+int
+ClassifierBenchmark::mismatches(ErrorHandler *errh) const
+{
+    int n = 0;
+    for (int i = 0; i < _packets.size(); i++) {
+	const Packet *p = _packets[i];
+	int spec = _classifier->match(p);
+	int interp = _classifier->match_interpreted(p);
+	int ref = (_reference ? _reference->match(p) : spec);
+	if ((spec != interp || spec != ref) && n++ == 0) {
+	    if (_reference)
+		errh->error("packet %d (length %d): specialized program says %d, interpreter says %d, reference says %d",
+			    i, p->length(), spec, interp, ref);
+	    else
+		errh->error("packet %d (length %d): specialized program says %d, interpreter says %d",
+			    i, p->length(), spec, interp);
+	}
+    }
+    return n;
+}
+
+void
+ClassifierBenchmark::cleanup(CleanupStage)
+{
+    for (int i = 0; i < _packets.size(); i++)
+	_packets[i]->kill();
+}
+
+bool
+ClassifierBenchmark::run_task(Task *)
+{
+    uint32_t sum = 0;
+    for (int which = 0; which < (_reference ? 3 : 2); which++) {
+	Timestamp t0 = Timestamp::now();
+	for (int r = 0; r < _rounds; r++)
+	    for (Packet **pp = _packets.begin(); pp != _packets.end(); ++pp)
+		if (which == 0)
+		    sum += _classifier->match(*pp);
+		else if (which == 1)
+		    sum += _classifier->match_interpreted(*pp);
+		else
+		    sum += _reference->match(*pp);
+	Timestamp t1 = Timestamp::now();
+	_rate[which] = (double) _rounds * _packets.size() / (t1 - t0).doubleval();
+    }
+
+    if (_stop) {
+	StringAccum sa;
+	sa.snprintf(100, "specialized %.0f packets/s, interpreted %.0f packets/s", _rate[0], _rate[1]);
+	if (_reference)
+	    sa.snprintf(40, ", reference %.0f packets/s", _rate[2]);
+	click_chatter("%s: %d packets agree; %s (%u)", declaration().c_str(),
+		      _packets.size(), sa.c_str(), sum);
+	router()->please_stop_driver();
+    }
+    return true;
+}
+
+String
+ClassifierBenchmark::read_handler(Element *e, void *thunk)
+{
+    ClassifierBenchmark *b = static_cast<ClassifierBenchmark *>(e);
+    if ((intptr_t) thunk == 3)
+	return String(b->mismatches(ErrorHandler::silent_handler()));
+    return String(b->_rate[(intptr_t) thunk]);
+}
+
+void
+ClassifierBenchmark::add_handlers()
+{
+    add_read_handler("specialized_rate", read_handler, 0);
+    add_read_handler("interpreted_rate", read_handler, (void *) 1);
+    add_read_handler("reference_rate", read_handler, (void *) 2);
+    add_read_handler("mismatches", read_handler, (void *) 3);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(Classifier IPFilter)
+EXPORT_ELEMENT(ClassifierBenchmark)
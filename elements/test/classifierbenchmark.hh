@@ -0,0 +1,144 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CLASSIFIERBENCHMARK_HH
+#define CLICK_CLASSIFIERBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+CLICK_DECLS
+class Classifier;
+
+/*
+=c
+
+ClassifierBenchmark(CLASSIFIER, [<keyword> REFERENCE, PACKETS, LENGTH, ROUNDS, SEED, CHECK, STOP])
+
+=s test
+
+checks and measures specialized Classifier programs
+
+=d
+
+ClassifierBenchmark compares the specialized program of CLASSIFIER, which
+must be a Classifier, IPClassifier, IPFilter, or TupleIPFilter element, with its
+original interpreted program.
+
+At initialization time, it generates PACKETS packets by walking CLASSIFIER's
+program (as reported by its `C<program>' handler), writing each test's
+value into the packet most of the time, so that the packets reach every
+output.  One packet in eight is cut shorter than the program's safe length.
+For IPClassifier and IPFilter, each packet's network header starts at its
+first byte and its transport header 20 bytes later.  Each packet is
+classified with both programs; any disagreement is an initialization error.
+
+Then it measures how many packets per second each program classifies,
+making ROUNDS passes over the packets.
+
+If REFERENCE is given, it is another classifier of the same type that
+should send every packet to the same output as CLASSIFIER; for instance, an
+IPFilter with the same rules as a TupleIPFilter CLASSIFIER.  Packets are then
+generated from REFERENCE's program, checked against REFERENCE as well, and
+REFERENCE's speed is measured too.
+
+Keyword arguments are:
+
+=over 8
+
+=item REFERENCE
+
+Element.  A reference Classifier, IPClassifier, or IPFilter.  Default is none.
+
+=item PACKETS
+
+Integer.  Number of packets to generate.  Default is 4096.
+
+=item LENGTH
+
+Integer.  Length of the generated packets, before any cutting.  Default is
+128.
+
+=item ROUNDS
+
+Integer.  Number of passes to time.  Default is 1000.
+
+=item SEED
+
+Unsigned.  Random number seed.  Default is 1.
+
+=item CHECK
+
+Boolean.  If false, do not check the classifiers at initialization time.
+Default is true.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h specialized_rate read-only
+
+Returns the specialized program's packets per second.
+
+=h interpreted_rate read-only
+
+Returns the interpreted program's packets per second.
+
+=h reference_rate read-only
+
+Returns REFERENCE's packets per second.
+
+=h mismatches read-only
+
+Classifies the packets again and returns how many are classified
+inconsistently.  This allows checks after CLASSIFIER's rules change.
+
+=a
+
+Classifier, IPClassifier, IPFilter, TupleIPFilter */
+
+class ClassifierBenchmark : public Element { public:
+
+    ClassifierBenchmark();
+    ~ClassifierBenchmark();
+
+    const char *class_name() const		{ return "ClassifierBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    struct Test {
+	int offset;
+	unsigned char value[4];
+	unsigned char mask[4];
+	int j[2];
+    };
+
+    Classifier *_classifier;
+    Classifier *_reference;
+    bool _ip;
+    int _npackets;
+    int _length;
+    int _rounds;
+    uint32_t _seed;
+    bool _check;
+    bool _stop;
+    Task _task;
+    Vector<Packet *> _packets;
+    double _rate[3];
+
+    int parse_program(Vector<Test> &, ErrorHandler *);
+    Packet *make_packet(const Vector<Test> &, int safe_length);
+    int mismatches(ErrorHandler *) const;
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
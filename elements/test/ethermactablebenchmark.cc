@@ -0,0 +1,243 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ethermactablebenchmark.{cc,hh} -- measure EtherSwitch MAC table speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ethermactablebenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/hashtable.hh>
+#include <click/standard/scheduleinfo.hh>
+#include "elements/etherswitch/ethermactable.hh"
+CLICK_DECLS
+
+namespace {
+// the table EtherSwitch used to keep
+struct AddrInfo {
+    int port;
+    Timestamp stamp;
+    AddrInfo(int p, const Timestamp &t) : port(p), stamp(t) { }
+};
+typedef HashTable<EtherAddress, AddrInfo> OldTable;
+}
+
+EtherMACTableBenchmark::EtherMACTableBenchmark()
+    : _naddrs(65536), _nframes(10000000), _nports(8), _stop(true), _task(this)
+{
+}
+
+EtherMACTableBenchmark::~EtherMACTableBenchmark()
+{
+}
+
+int
+EtherMACTableBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "N", cpkP, cpUnsigned, &_naddrs,
+		     "FRAMES", 0, cpUnsigned, &_nframes,
+		     "PORTS", 0, cpUnsigned, &_nports,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_naddrs < 1 || _nports < 1 || _nports > 65534)
+	return errh->error("N must be positive and PORTS between 1 and 65534");
+    return 0;
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+int
+EtherMACTableBenchmark::check(ErrorHandler *errh)
+{
+    EtherMACTable t;
+    OldTable old(AddrInfo(-1, Timestamp()));
+    t.set_timeout(10);
+    t.set_time(1000);
+    for (int i = 0; i < _addrs.size(); i++) {
+	t.learn(_addrs[i], _ports[i]);
+	old.set(_addrs[i], AddrInfo(_ports[i], Timestamp(1000, 0)));
+    }
+    CHECK((OldTable::size_type) t.size() == old.size());
+    for (int i = 0; i < _addrs.size(); i++) {
+	OldTable::iterator it = old.find(_addrs[i]);
+	CHECK(it && t.lookup(_addrs[i]) == it.value().port);
+    }
+
+    // moves, and addresses never learned
+    for (int i = 0; i < _addrs.size(); i += 3)
+	t.learn(_addrs[i], _ports[i] + 1);
+    for (int i = 0; i < _addrs.size(); i++)
+	CHECK(t.lookup(_addrs[i]) == _ports[i] + (i % 3 == 0));
+    for (int i = 0; i < 1000; i++) {
+	unsigned char data[6];
+	for (int j = 0; j < 6; j++)
+	    data[j] = click_random();
+	data[0] &= 0xFE;
+	EtherAddress a(data);
+	CHECK(old.find(a) || t.lookup(a) == -1);
+    }
+
+    // aging: entries last TIMEOUT seconds, then are swept
+    t.set_time(1010);
+    CHECK(t.lookup(_addrs[0]) == _ports[0] + 1);
+    t.learn(_addrs[0], _ports[0]);
+    t.set_time(1011);
+    CHECK(t.lookup(_addrs[0]) == _ports[0]);
+    if (_addrs.size() > 1)
+	CHECK(t.lookup(_addrs[1]) == -1);
+    // a sweep starts every TIMEOUT/4 seconds
+    for (int i = 0; i < t.nbuckets(); i++)
+	t.set_time(1013);
+    CHECK(t.size() == 1);
+    CHECK(t.unparse() == _addrs[0].unparse() + " " + String(_ports[0]) + "\n");
+    // a jump that would wrap the 16-bit stamps clears the table
+    t.set_time(1013 + 65536);
+    CHECK(t.lookup(_addrs[0]) == -1);
+    CHECK(t.size() == 0);
+    return 0;
+}
+
+int
+EtherMACTableBenchmark::initialize(ErrorHandler *errh)
+{
+    HashTable<EtherAddress, int> seen(0);
+    while (_addrs.size() < (int) _naddrs) {
+	unsigned char data[6];
+	for (int j = 0; j < 6; j++)
+	    data[j] = click_random();
+	data[0] &= 0xFE;	// unicast
+	EtherAddress a(data);
+	if (!seen[a]) {
+	    seen[a] = 1;
+	    _addrs.push_back(a);
+	    _ports.push_back(click_random(0, _nports - 1));
+	}
+    }
+    if (check(errh) < 0)
+	return -1;
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+enum { NFRAMES = 1 << 16 };
+
+double
+EtherMACTableBenchmark::measure_hashtable(uint32_t &sum)
+{
+    OldTable table(AddrInfo(-1, Timestamp()));
+    Vector<int> idx;
+    for (int i = 0; i < 2 * NFRAMES; i++)
+	idx.push_back(click_random(0, _addrs.size() - 1));
+    Timestamp now(1000, 0), timeout(300, 0);
+
+    Timestamp t0 = Timestamp::now();
+    for (uint32_t f = 0; f < _nframes; f++) {
+	int s = idx[(2 * f) & (2 * NFRAMES - 1)];
+	int d = idx[(2 * f + 1) & (2 * NFRAMES - 1)];
+	table.set(_addrs[s], AddrInfo(_ports[s], now));
+	if (OldTable::iterator it = table.find(_addrs[d])) {
+	    if (now < it.value().stamp + timeout)
+		sum += it.value().port;
+	    else
+		table.erase(it);
+	}
+    }
+    Timestamp t1 = Timestamp::now();
+    return _nframes / (t1 - t0).doubleval();
+}
+
+double
+EtherMACTableBenchmark::measure_table(bool batch, uint32_t &sum)
+{
+    EtherMACTable table;
+    Vector<int> idx;
+    for (int i = 0; i < 2 * NFRAMES; i++)
+	idx.push_back(click_random(0, _addrs.size() - 1));
+    EtherAddress dst[BATCH];
+    int port[BATCH];
+
+    Timestamp t0 = Timestamp::now();
+    for (uint32_t f = 0; f < _nframes; f += BATCH) {
+	table.set_time(1000);
+	int n = (_nframes - f < (uint32_t) BATCH ? _nframes - f : (uint32_t) BATCH);
+	if (batch) {
+	    for (int i = 0; i < n; i++) {
+		int s = idx[(2 * (f + i)) & (2 * NFRAMES - 1)];
+		table.learn(_addrs[s], _ports[s]);
+		dst[i] = _addrs[idx[(2 * (f + i) + 1) & (2 * NFRAMES - 1)]];
+	    }
+	    table.lookup_batch(dst, port, n);
+	    for (int i = 0; i < n; i++)
+		sum += port[i];
+	} else
+	    for (int i = 0; i < n; i++) {
+		int s = idx[(2 * (f + i)) & (2 * NFRAMES - 1)];
+		const EtherAddress &d = _addrs[idx[(2 * (f + i) + 1) & (2 * NFRAMES - 1)]];
+		table.prefetch(d);
+		table.learn(_addrs[s], _ports[s]);
+		sum += table.lookup(d);
+	    }
+    }
+    Timestamp t1 = Timestamp::now();
+    return _nframes / (t1 - t0).doubleval();
+}
+
+bool
+EtherMACTableBenchmark::run_task(Task *)
+{
+    uint32_t sum = 0;
+    double old_rate = measure_hashtable(sum);
+    double rate = measure_table(false, sum);
+    double batch_rate = measure_table(true, sum);
+
+    EtherMACTable table;
+    for (int i = 0; i < _addrs.size(); i++)
+	table.learn(_addrs[i], _ports[i]);
+    Timestamp t0 = Timestamp::now();
+    String dump = table.unparse();
+    double dump_time = (Timestamp::now() - t0).doubleval();
+    sum += dump.length();
+
+    StringAccum sa;
+    sa << old_rate << ' ' << rate << ' ' << batch_rate << ' ' << dump_time << '\n';
+    _results = sa.take_string();
+    if (_stop) {
+	click_chatter("%s: %d addresses, HashTable %.2f Mframes/s", declaration().c_str(), _addrs.size(), old_rate / 1e6);
+	click_chatter("%s: %d addresses, EtherMACTable %.2f Mframes/s", declaration().c_str(), _addrs.size(), rate / 1e6);
+	click_chatter("%s: %d addresses, batched EtherMACTable %.2f Mframes/s", declaration().c_str(), _addrs.size(), batch_rate / 1e6);
+	click_chatter("%s: %d addresses, table dump %.3f ms", declaration().c_str(), _addrs.size(), dump_time * 1e3);
+	click_chatter("%s: (%u)", declaration().c_str(), sum);
+	router()->please_stop_driver();
+    }
+    return true;
+}
+
+String
+EtherMACTableBenchmark::read_handler(Element *e, void *)
+{
+    return static_cast<EtherMACTableBenchmark *>(e)->_results;
+}
+
+void
+EtherMACTableBenchmark::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(EtherMACTable)
+EXPORT_ELEMENT(EtherMACTableBenchmark)
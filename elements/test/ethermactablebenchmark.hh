@@ -0,0 +1,98 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ETHERMACTABLEBENCHMARK_HH
+#define CLICK_ETHERMACTABLEBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/etheraddress.hh>
+CLICK_DECLS
+
+/*
+=c
+
+EtherMACTableBenchmark([N, <keyword> FRAMES, PORTS, STOP])
+
+=s test
+
+measures EtherSwitch MAC learning table speed
+
+=d
+
+EtherMACTableBenchmark measures the MAC learning table used by EtherSwitch
+against the HashTable it replaced, with N random unicast addresses, default
+65536, spread over PORTS ports, default 8.
+
+It first checks that both tables learn the same mappings, that addresses
+that were never learned are not found, and that mappings expire and are
+swept after TIMEOUT seconds.  Any mismatch is an initialization error.
+
+Then each table switches FRAMES frames, default 10000000, between random
+addresses: it learns the source and looks up the destination, as
+EtherSwitch does for each packet.  The new table is also measured looking
+up destinations in batches of 32.  Finally the time to read the table
+handler's contents is measured.
+
+Keyword arguments are:
+
+=over 8
+
+=item FRAMES
+
+Unsigned.  Number of frames to switch with each table.  Default is
+10000000.
+
+=item PORTS
+
+Unsigned.  Number of switch ports.  Default is 8.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h results read-only
+
+Returns the frames per second of the HashTable, of the new table, and of
+the new table's batched lookups, and the table dump time in seconds.
+
+=a
+
+EtherSwitch */
+
+class EtherMACTableBenchmark : public Element { public:
+
+    EtherMACTableBenchmark();
+    ~EtherMACTableBenchmark();
+
+    const char *class_name() const		{ return "EtherMACTableBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    enum { BATCH = 32 };
+
+    uint32_t _naddrs;
+    uint32_t _nframes;
+    uint32_t _nports;
+    bool _stop;
+    Task _task;
+    Vector<EtherAddress> _addrs;
+    Vector<int> _ports;
+    String _results;
+
+    int check(ErrorHandler *);
+    double measure_hashtable(uint32_t &sum);
+    double measure_table(bool batch, uint32_t &sum);
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,151 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ip6lookupbenchmark.{cc,hh} -- measure IP6 route lookup speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6lookupbenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+#include "elements/ip6/ip6routetable.hh"
+CLICK_DECLS
+
+IP6LookupBenchmark::IP6LookupBenchmark()
+    : _table(0), _nroutes(0), _nlookups(1000000), _seed(1), _stop(true),
+      _task(this), _insert_rate(0), _lookup_rate(0)
+{
+}
+
+IP6LookupBenchmark::~IP6LookupBenchmark()
+{
+}
+
+int
+IP6LookupBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "TABLE", cpkP+cpkM, cpElementCast, "IP6RouteTable", &_table,
+		     "N", cpkP+cpkM, cpInteger, &_nroutes,
+		     "LOOKUPS", 0, cpUnsigned, &_nlookups,
+		     "SEED", 0, cpUnsigned, &_seed,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_nroutes < 1)
+	return errh->error("N must be positive");
+    if (_table->noutputs() < 1)
+	return errh->error("TABLE must have at least one output");
+    return 0;
+}
+
+int
+IP6LookupBenchmark::initialize(ErrorHandler *errh)
+{
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+static void
+random_address(IP6Address &a)
+{
+    uint32_t *d = a.data32();
+    for (int i = 0; i < 4; i++)
+	d[i] = htonl((click_random() << 16) ^ click_random());
+    a.data()[0] = 0x20 | (a.data()[0] & 0x0F);
+}
+
+static int
+random_prefix_len()
+{
+    static const int lens[] = { 20, 24, 28, 29, 32, 32, 32, 32, 32, 32,
+				36, 40, 44, 46, 47, 48, 48, 48, 48, 48,
+				48, 48, 48, 48, 48, 56, 60, 64 };
+    return lens[click_random(0, sizeof(lens) / sizeof(lens[0]) - 1)];
+}
+
+bool
+IP6LookupBenchmark::run_task(Task *)
+{
+    click_srandom(_seed);
+    ErrorHandler *errh = ErrorHandler::default_handler();
+    int nout = _table->noutputs();
+
+    // build the table
+    Vector<IP6Address> prefixes;
+    Vector<int> lens;
+    for (int i = 0; i < _nroutes; i++) {
+	IP6Address a;
+	random_address(a);
+	int len = random_prefix_len();
+	a &= IP6Address::make_prefix(len);
+	prefixes.push_back(a);
+	lens.push_back(len);
+    }
+    Timestamp t0 = Timestamp::now();
+    for (int i = 0; i < _nroutes; i++)
+	if (_table->add_route(prefixes[i], IP6Address::make_prefix(lens[i]),
+			      IP6Address(), i % nout, errh) < 0)
+	    break;
+    Timestamp t1 = Timestamp::now();
+    _insert_rate = _nroutes / (t1 - t0).doubleval();
+
+    // generate addresses: mostly within routes, some random
+    Vector<IP6Address> addrs;
+    for (int i = 0; i < 65536; i++) {
+	IP6Address a;
+	random_address(a);
+	if (click_random(0, 9) != 0) {
+	    int r = click_random(0, _nroutes - 1);
+	    IP6Address m = IP6Address::make_prefix(lens[r]);
+	    a = (a & ~m) | prefixes[r];
+	}
+	addrs.push_back(a);
+    }
+
+    // measure lookups
+    uint32_t sum = 0;
+    IP6Address gw;
+    t0 = Timestamp::now();
+    for (uint32_t i = 0; i < _nlookups; i++)
+	sum += _table->lookup_route(addrs[i & 65535], gw);
+    t1 = Timestamp::now();
+    _lookup_rate = _nlookups / (t1 - t0).doubleval();
+
+    if (_stop) {
+	click_chatter("%s: %d routes, %.0f inserts/s, %.0f lookups/s (%u)",
+		      declaration().c_str(), _nroutes, _insert_rate,
+		      _lookup_rate, sum);
+	router()->please_stop_driver();
+    }
+    return true;
+}
+
+String
+IP6LookupBenchmark::read_handler(Element *e, void *thunk)
+{
+    IP6LookupBenchmark *b = static_cast<IP6LookupBenchmark *>(e);
+    return String(thunk ? b->_lookup_rate : b->_insert_rate);
+}
+
+void
+IP6LookupBenchmark::add_handlers()
+{
+    add_read_handler("insert_rate", read_handler, (void *) 0);
+    add_read_handler("lookup_rate", read_handler, (void *) 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IP6RouteTable)
+EXPORT_ELEMENT(IP6LookupBenchmark)
@@ -0,0 +1,91 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IP6LOOKUPBENCHMARK_HH
+#define CLICK_IP6LOOKUPBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/ip6address.hh>
+CLICK_DECLS
+class IP6RouteTable;
+
+/*
+=c
+
+IP6LookupBenchmark(TABLE, N, [<keyword> LOOKUPS, SEED, STOP])
+
+=s test
+
+measures IP6 route lookup speed
+
+=d
+
+IP6LookupBenchmark adds N random routes to TABLE, which must be an
+IP6RouteTable element such as RadixIP6Lookup or LookupIP6Route, and then
+measures how many lookups per second TABLE can perform.
+
+The routes resemble a global routing table.  Their prefixes lie within
+2000::/4.  Their lengths range from /20 to /64, and most are /32 or /48.
+Nine out of ten looked-up addresses fall within some route, and the rest are
+random.
+
+Keyword arguments are:
+
+=over 8
+
+=item LOOKUPS
+
+Unsigned.  Number of lookups to measure.  Default is 1000000.
+
+=item SEED
+
+Unsigned.  Random number seed.  Default is 1.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h insert_rate read-only
+
+Returns the measured route insertions per second.
+
+=h lookup_rate read-only
+
+Returns the measured lookups per second.
+
+=a
+
+RadixIP6Lookup, LookupIP6Route */
+
+class IP6LookupBenchmark : public Element { public:
+
+    IP6LookupBenchmark();
+    ~IP6LookupBenchmark();
+
+    const char *class_name() const		{ return "IP6LookupBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    IP6RouteTable *_table;
+    int _nroutes;
+    uint32_t _nlookups;
+    uint32_t _seed;
+    bool _stop;
+    Task _task;
+    double _insert_rate;
+    double _lookup_rate;
+
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,139 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * iplookupbenchmark.{cc,hh} -- measure IP route lookup speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "iplookupbenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+#include "elements/ip/iproutetable.hh"
+CLICK_DECLS
+
+IPLookupBenchmark::IPLookupBenchmark()
+    : _table(0), _nroutes(0), _nlookups(4000000), _batch(true), _seed(1),
+      _stop(true), _task(this), _lookup_rate(0)
+{
+}
+
+IPLookupBenchmark::~IPLookupBenchmark()
+{
+}
+
+int
+IPLookupBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "TABLE", cpkP+cpkM, cpElementCast, "IPRouteTable", &_table,
+		     "N", cpkP+cpkM, cpInteger, &_nroutes,
+		     "LOOKUPS", 0, cpUnsigned, &_nlookups,
+		     "BATCH", 0, cpBool, &_batch,
+		     "SEED", 0, cpUnsigned, &_seed,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_nroutes < 1)
+	return errh->error("N must be positive");
+    if (_table->noutputs() < 1)
+	return errh->error("TABLE must have at least one output");
+    return 0;
+}
+
+int
+IPLookupBenchmark::initialize(ErrorHandler *errh)
+{
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+static int
+random_prefix_len()
+{
+    static const int lens[] = { 8, 12, 16, 16, 17, 18, 19, 20, 20, 21,
+				22, 22, 23, 23, 24, 24, 24, 24, 24, 24,
+				24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
+				25, 27, 30, 32 };
+    return lens[click_random(0, sizeof(lens) / sizeof(lens[0]) - 1)];
+}
+
+bool
+IPLookupBenchmark::run_task(Task *)
+{
+    click_srandom(_seed);
+    ErrorHandler *errh = ErrorHandler::default_handler();
+    int nout = _table->noutputs();
+
+    // build the table
+    for (int i = 0; i < _nroutes; i++) {
+	int len = random_prefix_len();
+	IPAddress mask = IPAddress::make_prefix(len);
+	IPAddress addr = IPAddress(htonl((click_random() << 16) ^ click_random())) & mask;
+	IPRoute r(addr, mask, IPAddress(htonl(0x0A000000 + i % 64)), i % nout);
+	if (_table->add_route(r, true, 0, errh) < 0)
+	    break;
+    }
+
+    // generate addresses
+    enum { NADDRS = 1 << 20 };
+    Vector<IPAddress> addrs;
+    for (int i = 0; i < NADDRS; i++)
+	addrs.push_back(IPAddress(htonl((click_random() << 16) ^ click_random())));
+
+    // measure lookups
+    uint32_t sum = 0;
+    IPAddress gw[IPRouteTable::BATCH_MAX];
+    int port[IPRouteTable::BATCH_MAX];
+    Timestamp t0 = Timestamp::now();
+    if (_batch) {
+	for (uint32_t i = 0; i < _nlookups; i += IPRouteTable::BATCH_MAX) {
+	    _table->lookup_route_batch(&addrs[i & (NADDRS - 1)], gw, port,
+				       IPRouteTable::BATCH_MAX);
+	    for (int j = 0; j < IPRouteTable::BATCH_MAX; j++)
+		sum += port[j] + gw[j].addr();
+	}
+    } else {
+	for (uint32_t i = 0; i < _nlookups; i++) {
+	    sum += _table->lookup_route(addrs[i & (NADDRS - 1)], gw[0]);
+	    sum += gw[0].addr();
+	}
+    }
+    Timestamp t1 = Timestamp::now();
+    _lookup_rate = _nlookups / (t1 - t0).doubleval();
+
+    if (_stop) {
+	click_chatter("%s: %d routes, %s, %.0f lookups/s (%u)",
+		      declaration().c_str(), _nroutes,
+		      _batch ? "batched" : "unbatched", _lookup_rate, sum);
+	router()->please_stop_driver();
+    }
+    return true;
+}
+
+String
+IPLookupBenchmark::read_handler(Element *e, void *)
+{
+    IPLookupBenchmark *b = static_cast<IPLookupBenchmark *>(e);
+    return String(b->_lookup_rate);
+}
+
+void
+IPLookupBenchmark::add_handlers()
+{
+    add_read_handler("lookup_rate", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable)
+EXPORT_ELEMENT(IPLookupBenchmark)
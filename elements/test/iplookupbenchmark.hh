@@ -0,0 +1,90 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPLOOKUPBENCHMARK_HH
+#define CLICK_IPLOOKUPBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+CLICK_DECLS
+class IPRouteTable;
+
+/*
+=c
+
+IPLookupBenchmark(TABLE, N, [<keyword> LOOKUPS, BATCH, SEED, STOP])
+
+=s test
+
+measures IP route lookup speed
+
+=d
+
+IPLookupBenchmark adds N random routes to TABLE, which must be an
+IPRouteTable element such as RadixIPLookup or DirectIPLookup, and then
+measures how many lookups per second TABLE can perform on random addresses.
+
+Route lengths follow a BGP table's shape: more than half are /24, and most
+of the rest are /16 to /23.  With BATCH true, lookups go through
+IPRouteTable::lookup_route_batch() in groups of IPRouteTable::BATCH_MAX;
+otherwise, each address is looked up with lookup_route().
+
+Keyword arguments are:
+
+=over 8
+
+=item LOOKUPS
+
+Unsigned.  Number of lookups to measure.  Default is 4000000.
+
+=item BATCH
+
+Boolean.  If true, measure batched lookups.  Default is true.
+
+=item SEED
+
+Unsigned.  Random number seed.  Default is 1.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h lookup_rate read-only
+
+Returns the measured lookups per second.
+
+=a
+
+IPRouteTable, IP6LookupBenchmark */
+
+class IPLookupBenchmark : public Element { public:
+
+    IPLookupBenchmark();
+    ~IPLookupBenchmark();
+
+    const char *class_name() const		{ return "IPLookupBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    IPRouteTable *_table;
+    int _nroutes;
+    uint32_t _nlookups;
+    bool _batch;
+    uint32_t _seed;
+    bool _stop;
+    Task _task;
+    double _lookup_rate;
+
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
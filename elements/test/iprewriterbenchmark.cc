@@ -0,0 +1,148 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * iprewriterbenchmark.{cc,hh} -- measure IPRewriter mapping speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "iprewriterbenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <clicknet/ip.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+IPRewriterBenchmark::IPRewriterBenchmark()
+    : _rewriter(0), _nflows(100000), _port(0), _rounds(4), _seed(1),
+      _stop(true), _task(this), _mapping_rate(0), _packet_rate(0)
+{
+}
+
+IPRewriterBenchmark::~IPRewriterBenchmark()
+{
+}
+
+int
+IPRewriterBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "REWRITER", cpkP+cpkM, cpElementCast, "IPRw", &_rewriter,
+		     "FLOWS", 0, cpUnsigned, &_nflows,
+		     "PORT", 0, cpInteger, &_port,
+		     "ROUNDS", 0, cpUnsigned, &_rounds,
+		     "SEED", 0, cpUnsigned, &_seed,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_nflows < 1)
+	return errh->error("FLOWS must be positive");
+    if (_port < 0 || _port >= _rewriter->ninputs())
+	return errh->error("REWRITER has no input %d", _port);
+    return 0;
+}
+
+int
+IPRewriterBenchmark::initialize(ErrorHandler *errh)
+{
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+void
+IPRewriterBenchmark::make_packets(const Vector<uint32_t> &flows,
+				  Vector<Packet *> &packets)
+{
+    // Each flow is two random words: source address, and the two ports.
+    // Destinations vary too, so that flows spread over the address space.
+    packets.clear();
+    for (int i = 0; i < flows.size(); i += 2) {
+	WritablePacket *p = Packet::make(sizeof(click_ip) + sizeof(click_udp) + 8);
+	if (!p)
+	    break;
+	memset(p->data(), 0, p->length());
+	click_ip *iph = reinterpret_cast<click_ip *>(p->data());
+	iph->ip_v = 4;
+	iph->ip_hl = sizeof(click_ip) >> 2;
+	iph->ip_len = htons(p->length());
+	iph->ip_ttl = 64;
+	iph->ip_p = IP_PROTO_UDP;
+	iph->ip_src.s_addr = htonl(0x0A000000 | (flows[i] & 0x00FFFFFF));
+	iph->ip_dst.s_addr = htonl(0xC0000000 | (flows[i+1] & 0x3FFFFFFF));
+	iph->ip_sum = click_in_cksum(p->data(), sizeof(click_ip));
+	click_udp *udph = reinterpret_cast<click_udp *>(iph + 1);
+	udph->uh_sport = htons(1024 + (flows[i+1] >> 22));
+	udph->uh_dport = htons(flows[i] >> 24 ? 53 : 80);
+	udph->uh_ulen = htons(sizeof(click_udp) + 8);
+	p->set_ip_header(iph, sizeof(click_ip));
+	p->set_dst_ip_anno(iph->ip_dst);
+	packets.push_back(p);
+    }
+}
+
+double
+IPRewriterBenchmark::push_packets(Vector<Packet *> &packets)
+{
+    Timestamp t0 = Timestamp::now();
+    for (Packet **pp = packets.begin(); pp != packets.end(); ++pp)
+	_rewriter->push(_port, *pp);
+    Timestamp t1 = Timestamp::now();
+    packets.clear();
+    return (t1 - t0).doubleval();
+}
+
+bool
+IPRewriterBenchmark::run_task(Task *)
+{
+    click_srandom(_seed);
+    Vector<uint32_t> flows;
+    for (uint32_t i = 0; i < 2 * _nflows; i++)
+	flows.push_back((click_random() << 16) ^ click_random());
+
+    Vector<Packet *> packets;
+    make_packets(flows, packets);
+    int n = packets.size();
+    double new_time = push_packets(packets);
+    double old_time = 0;
+    for (uint32_t r = 0; r < _rounds; r++) {
+	make_packets(flows, packets);
+	old_time += push_packets(packets);
+    }
+
+    _mapping_rate = n / new_time;
+    _packet_rate = (_rounds ? n * _rounds / old_time : 0);
+    if (_stop) {
+	click_chatter("%s: %d flows, %.0f new mappings/s, %.0f packets/s on existing mappings",
+		      declaration().c_str(), n, _mapping_rate, _packet_rate);
+	router()->please_stop_driver();
+    }
+    return true;
+}
+
+String
+IPRewriterBenchmark::read_handler(Element *e, void *thunk)
+{
+    IPRewriterBenchmark *b = static_cast<IPRewriterBenchmark *>(e);
+    return String(thunk ? b->_packet_rate : b->_mapping_rate);
+}
+
+void
+IPRewriterBenchmark::add_handlers()
+{
+    add_read_handler("mapping_rate", read_handler, 0);
+    add_read_handler("packet_rate", read_handler, (void *) 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRw)
+EXPORT_ELEMENT(IPRewriterBenchmark)
@@ -0,0 +1,102 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPREWRITERBENCHMARK_HH
+#define CLICK_IPREWRITERBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IPRewriterBenchmark(REWRITER, [<keyword> FLOWS, PORT, ROUNDS, SEED, STOP])
+
+=s test
+
+measures IPRewriter mapping creation and lookup speed
+
+=d
+
+IPRewriterBenchmark pushes UDP packets from FLOWS random flows directly into
+input PORT of REWRITER, an IPRewriter or similar element, and measures how
+fast it handles them.  The first packet of each flow makes REWRITER create a
+mapping; ROUNDS further packets per flow then find existing mappings.  Both
+rates are reported.  REWRITER's outputs should lead to Discard or similar.
+
+Packets are built before they are timed, so the rates count only the work
+REWRITER does, including its checksum updates.  Read REWRITER's `C<gc_stats>'
+handler later to see how long removing the stale mappings held its locks.
+
+Keyword arguments are:
+
+=over 8
+
+=item FLOWS
+
+Unsigned.  Number of flows.  Default is 100000.
+
+=item PORT
+
+Integer.  REWRITER's input port.  Default is 0.
+
+=item ROUNDS
+
+Unsigned.  Packets per flow after the first.  Default is 4.
+
+=item SEED
+
+Unsigned.  Random number seed.  Default is 1.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h mapping_rate read-only
+
+Returns the measured new mappings per second.
+
+=h packet_rate read-only
+
+Returns the measured packets per second on existing mappings.
+
+=a
+
+IPRewriter, TCPRewriter, ClassifierBenchmark */
+
+class IPRewriterBenchmark : public Element { public:
+
+    IPRewriterBenchmark();
+    ~IPRewriterBenchmark();
+
+    const char *class_name() const		{ return "IPRewriterBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    Element *_rewriter;
+    uint32_t _nflows;
+    int _port;
+    uint32_t _rounds;
+    uint32_t _seed;
+    bool _stop;
+
+    Task _task;
+    double _mapping_rate;
+    double _packet_rate;
+
+    void make_packets(const Vector<uint32_t> &flows, Vector<Packet *> &);
+    double push_packets(Vector<Packet *> &);
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,182 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * iprouteupdatebenchmark.{cc,hh} -- measure IP route update speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "iprouteupdatebenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/standard/scheduleinfo.hh>
+#include "elements/ip/iproutetable.hh"
+CLICK_DECLS
+
+IPRouteUpdateBenchmark::IPRouteUpdateBenchmark()
+    : _table(0), _ctrl(0), _nroutes(0), _nupdates(100000), _batch(64),
+      _lookup_thread(1), _seed(1), _stop(true),
+      _update_task(this), _lookup_task(this), _nlookups(0), _done(false),
+      _sum(0), _update_rate(0), _lookup_rate(0)
+{
+}
+
+IPRouteUpdateBenchmark::~IPRouteUpdateBenchmark()
+{
+}
+
+int
+IPRouteUpdateBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "TABLE", cpkP+cpkM, cpElementCast, "IPRouteTable", &_table,
+		     "N", cpkP+cpkM, cpInteger, &_nroutes,
+		     "UPDATES", 0, cpUnsigned, &_nupdates,
+		     "BATCH", 0, cpUnsigned, &_batch,
+		     "LOOKUP_THREAD", 0, cpInteger, &_lookup_thread,
+		     "SEED", 0, cpUnsigned, &_seed,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_nroutes < 1 || _batch < 2)
+	return errh->error("N must be positive and BATCH at least 2");
+    if (_table->noutputs() < 1)
+	return errh->error("TABLE must have at least one output");
+    return 0;
+}
+
+int
+IPRouteUpdateBenchmark::initialize(ErrorHandler *errh)
+{
+    if (!(_ctrl = Router::handler(_table, "ctrl")) || !_ctrl->writable())
+	return errh->error("TABLE has no %<ctrl%> handler");
+    ScheduleInfo::initialize_task(this, &_update_task, errh);
+    ScheduleInfo::initialize_task(this, &_lookup_task, false, errh);
+    _lookup_task.move_thread(_lookup_thread);
+    return 0;
+}
+
+void
+IPRouteUpdateBenchmark::random_route(IPAddress &addr, int &len)
+{
+    // Successive routes get distinct /24 bases (the multiplier is odd, so
+    // it permutes 24-bit values), and so never collide.
+    static uint32_t counter = 0;
+    uint32_t base = ((++counter) * 0x9E3779U) & 0xFFFFFF;
+    len = (click_random(0, 7) ? 24 : click_random(25, 28));
+    addr = IPAddress(htonl((base << 8) | (click_random() & 0xFF)))
+	& IPAddress::make_prefix(len);
+}
+
+int
+IPRouteUpdateBenchmark::write_ctrl(const String &s, ErrorHandler *errh)
+{
+    return _ctrl->call_write(s, _table, errh);
+}
+
+bool
+IPRouteUpdateBenchmark::run_task(Task *t)
+{
+    if (t == &_lookup_task) {
+	// Look up addresses until the updates are done.
+	IPAddress gw[IPRouteTable::BATCH_MAX];
+	int port[IPRouteTable::BATCH_MAX];
+	if (_done || !_addrs.size())
+	    return false;
+	for (int i = 0; i < 4096; i += IPRouteTable::BATCH_MAX) {
+	    _table->lookup_route_batch(&_addrs[(_nlookups + i) & (_addrs.size() - 1)],
+				       gw, port, IPRouteTable::BATCH_MAX);
+	    _sum += port[0];
+	}
+	_nlookups += 4096;
+	_lookup_task.fast_reschedule();
+	return true;
+    }
+
+    click_srandom(_seed);
+    ErrorHandler *errh = ErrorHandler::default_handler();
+    int nout = _table->noutputs();
+    Vector<IPAddress> addrs;
+    Vector<int> lens;
+
+    // fill the table, one batch at a time
+    StringAccum sa;
+    while (addrs.size() < _nroutes) {
+	IPAddress a;
+	int len;
+	random_route(a, len);
+	addrs.push_back(a);
+	lens.push_back(len);
+	sa << "add " << a.unparse_with_mask(IPAddress::make_prefix(len))
+	   << " 10.0.0." << (addrs.size() % 64) << ' ' << (addrs.size() % nout)
+	   << '\n';
+	if (addrs.size() % _batch == 0 || addrs.size() == _nroutes) {
+	    if (write_ctrl(sa.take_string(), errh) < 0)
+		return false;
+	}
+    }
+
+    // start the lookups
+    enum { NADDRS = 1 << 16 };
+    for (int i = 0; i < NADDRS; i++)
+	_addrs.push_back(IPAddress(htonl((click_random() << 16) ^ click_random())));
+    _lookup_task.reschedule();
+
+    // replace random routes with new ones
+    uint32_t lookups0 = _nlookups;
+    Timestamp t0 = Timestamp::now();
+    uint32_t n;
+    for (n = 0; n < _nupdates; n += _batch) {
+	for (uint32_t j = 0; j < _batch; j += 2) {
+	    int i = click_random(0, addrs.size() - 1);
+	    sa << "remove " << addrs[i].unparse_with_mask(IPAddress::make_prefix(lens[i])) << '\n';
+	    random_route(addrs[i], lens[i]);
+	    sa << "add " << addrs[i].unparse_with_mask(IPAddress::make_prefix(lens[i]))
+	       << " 10.0.0." << (j % 64) << ' ' << (j % nout) << '\n';
+	}
+	if (write_ctrl(sa.take_string(), errh) < 0)
+	    break;
+    }
+    Timestamp t1 = Timestamp::now();
+    uint32_t lookups1 = _nlookups;
+    _done = true;
+
+    double elapsed = (t1 - t0).doubleval();
+    _update_rate = n / elapsed;
+    _lookup_rate = (lookups1 - lookups0) / elapsed;
+    if (_stop) {
+	click_chatter("%s: %d routes, %.0f updates/s in batches of %u, %.0f lookups/s meanwhile",
+		      declaration().c_str(), _nroutes, _update_rate, _batch,
+		      _lookup_rate);
+	router()->please_stop_driver();
+    }
+    return true;
+}
+
+String
+IPRouteUpdateBenchmark::read_handler(Element *e, void *thunk)
+{
+    IPRouteUpdateBenchmark *b = static_cast<IPRouteUpdateBenchmark *>(e);
+    return String(thunk ? b->_lookup_rate : b->_update_rate);
+}
+
+void
+IPRouteUpdateBenchmark::add_handlers()
+{
+    add_read_handler("update_rate", read_handler, 0);
+    add_read_handler("lookup_rate", read_handler, (void *) 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable)
+EXPORT_ELEMENT(IPRouteUpdateBenchmark)
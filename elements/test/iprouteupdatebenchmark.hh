@@ -0,0 +1,113 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPROUTEUPDATEBENCHMARK_HH
+#define CLICK_IPROUTEUPDATEBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/ipaddress.hh>
+CLICK_DECLS
+class IPRouteTable;
+
+/*
+=c
+
+IPRouteUpdateBenchmark(TABLE, N, [<keyword> UPDATES, BATCH, LOOKUP_THREAD, SEED, STOP])
+
+=s test
+
+measures IP route update speed under lookup load
+
+=d
+
+IPRouteUpdateBenchmark fills TABLE, an IPRouteTable element, with N random
+routes, and then measures how fast TABLE accepts route changes while another
+thread looks up random addresses as fast as it can.
+
+Changes are written to TABLE's `C<ctrl>' handler, BATCH lines at a time, the
+way a routing daemon would feed them.  Each change replaces a random
+existing route with a new random one, so a batch of BATCH lines removes
+BATCH/2 routes and adds BATCH/2.  Lookups run in a separate task on thread
+LOOKUP_THREAD, which should differ from IPRouteUpdateBenchmark's own thread.
+Both the update rate and the lookup rate seen during the updates are
+reported.
+
+Keyword arguments are:
+
+=over 8
+
+=item UPDATES
+
+Unsigned.  Number of route changes to measure.  Default is 100000.
+
+=item BATCH
+
+Unsigned.  Number of changes per `C<ctrl>' write.  Default is 64.
+
+=item LOOKUP_THREAD
+
+Integer.  The thread that runs the lookups.  Default is 1.
+
+=item SEED
+
+Unsigned.  Random number seed.  Default is 1.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h update_rate read-only
+
+Returns the measured route changes per second.
+
+=h lookup_rate read-only
+
+Returns the lookups per second completed while the changes ran.
+
+=a
+
+IPRouteTable, DirectIPLookup, IPLookupBenchmark */
+
+class IPRouteUpdateBenchmark : public Element { public:
+
+    IPRouteUpdateBenchmark();
+    ~IPRouteUpdateBenchmark();
+
+    const char *class_name() const		{ return "IPRouteUpdateBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    IPRouteTable *_table;
+    const Handler *_ctrl;
+    int _nroutes;
+    uint32_t _nupdates;
+    uint32_t _batch;
+    int _lookup_thread;
+    uint32_t _seed;
+    bool _stop;
+
+    Task _update_task;
+    Task _lookup_task;
+    Vector<IPAddress> _addrs;
+    volatile uint32_t _nlookups;
+    volatile bool _done;
+    uint32_t _sum;
+    double _update_rate;
+    double _lookup_rate;
+
+    void random_route(IPAddress &addr, int &len);
+    int write_ctrl(const String &, ErrorHandler *);
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,98 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSECCRYPTOBENCHMARK_HH
+#define CLICK_IPSECCRYPTOBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include "elements/ipsec/ipseccrypto.hh"
+CLICK_DECLS
+
+/*
+=c
+
+IPsecCryptoBenchmark([SIZES, <keyword> BYTES, STOP])
+
+=s test
+
+measures IPsec cipher and digest speed by packet size
+
+=d
+
+IPsecCryptoBenchmark first checks the IPsecCrypto routines used by IPsecAES,
+IPsecAuthHMACSHA1 and IPsecAuthSHA1 against known answers, in both their
+portable and accelerated versions.  It then checks that the accelerated
+versions agree with the portable ones, and the multi-buffer versions with the
+single-buffer ones, on random keys and data of random lengths.  Any mismatch
+is an initialization error.
+
+Then it measures the throughput of each routine on packets of each size in
+SIZES, a space-separated list of byte counts that are multiples of 16, up to
+16384.  The default is "64 256 1024 1504".  Packets are taken in turn from a
+256-kilobyte buffer of random data.
+
+Keyword arguments are:
+
+=over 8
+
+=item BYTES
+
+Unsigned.  Number of bytes to process for each size and routine.
+Default is 200000000.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h results read-only
+
+Returns one line per size, giving the size and then throughputs in Gbit/s
+for: AES CBC as IPsecAES used to do it, with a fresh table-driven key schedule
+per packet; AES CBC; AES CBC on batches of packets; AES CTR; HMAC-SHA1 with
+the original SSLeay code; HMAC-SHA1; and HMAC-SHA1 on batches of packets.
+
+=a
+
+IPsecAES, IPsecAuthHMACSHA1, IPsecAuthSHA1 */
+
+class IPsecCryptoBenchmark : public Element { public:
+
+    IPsecCryptoBenchmark();
+    ~IPsecCryptoBenchmark();
+
+    const char *class_name() const		{ return "IPsecCryptoBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    enum { BUFSIZE = 1 << 18, BATCH = 8 };
+    enum { T_AES_LEGACY, T_AES_CBC, T_AES_CBC_BATCH, T_AES_CTR,
+	   T_HMAC_LEGACY, T_HMAC, T_HMAC_BATCH, NTESTS };
+
+    Vector<int> _sizes;
+    uint32_t _nbytes;
+    bool _stop;
+    Task _task;
+    unsigned char *_buf;
+    unsigned char _user_key[IPsecCrypto::KEY_BYTES];
+    unsigned char _auth_key[IPsecCrypto::KEY_BYTES];
+    IPsecAESKey _key;
+    String _results;
+
+    int check_known_answers(ErrorHandler *);
+    int check(ErrorHandler *);
+    double measure(int size, int test, uint32_t &sum);
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
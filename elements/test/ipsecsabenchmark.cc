@@ -0,0 +1,176 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipsecsabenchmark.{cc,hh} -- measure IPsec SA database speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipsecsabenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/standard/scheduleinfo.hh>
+#include "elements/ipsec/ipsecroutetable.hh"
+CLICK_DECLS
+
+IPsecSABenchmark::IPsecSABenchmark()
+    : _table(0), _nsas(1000), _nthreads(1), _npackets(10000000),
+      _rekeys_on(true), _stop(true), _control_task(this), _workers(0),
+      _rekeys(0), _packet_rate(0), _rekey_rate(0)
+{
+}
+
+IPsecSABenchmark::~IPsecSABenchmark()
+{
+}
+
+int
+IPsecSABenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "TABLE", cpkP+cpkM, cpElementCast, "IPsecRouteTable", &_table,
+		     "SAS", 0, cpUnsigned, &_nsas,
+		     "THREADS", 0, cpUnsigned, &_nthreads,
+		     "PACKETS", 0, cpUnsigned, &_npackets,
+		     "REKEY", 0, cpBool, &_rekeys_on,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_nsas < 1 || _nthreads < 1)
+	return errh->error("SAS and THREADS must be positive");
+    return 0;
+}
+
+int
+IPsecSABenchmark::initialize(ErrorHandler *errh)
+{
+    if ((int) _nthreads > master()->nthreads())
+	errh->warning("THREADS %u, but only %d threads running", _nthreads, master()->nthreads());
+
+    for (uint32_t i = 0; i < _nsas; i++) {
+	char key[16];
+	memset(key, 'A' + i % 26, sizeof(key));
+	if (!_table->_sa_table.insert(SPI(SPI_BASE + i), new SADataTuple(key, key, 1, 255)))
+	    return errh->error("could not add SA %u", SPI_BASE + i);
+    }
+
+    _workers = new Worker[_nthreads];
+    _nfinished = 0;
+    for (uint32_t i = 0; i < _nthreads; i++) {
+	Worker &w = _workers[i];
+	w.task = new Task(this);
+	w.npackets = w.rejects = w.sum = 0;
+	ScheduleInfo::initialize_task(this, w.task, false, errh);
+	w.task->move_thread(i % master()->nthreads());
+    }
+    ScheduleInfo::initialize_task(this, &_control_task, errh);
+    return 0;
+}
+
+void
+IPsecSABenchmark::cleanup(CleanupStage)
+{
+    if (_workers)
+	for (uint32_t i = 0; i < _nthreads; i++)
+	    delete _workers[i].task;
+    delete[] _workers;
+    _workers = 0;
+}
+
+bool
+IPsecSABenchmark::run_worker(Worker &w)
+{
+    // Each packet takes the next sequence number of a random SA, as
+    // IPsecESPEncap would, and checks it as IPsecESPUnencap would.
+    uint32_t x = (uintptr_t) &w ^ w.npackets;
+    SATable &sat = _table->_sa_table;
+    int n = (_npackets - w.npackets < 4096 ? _npackets - w.npackets : 4096);
+    for (int i = 0; i < n; i++) {
+	x = x * 1103515245 + 12345;
+	SADataTuple *sa = sat.lookup(SPI(SPI_BASE + (x >> 8) % _nsas));
+	uint32_t seq = sa->next_sequence();
+	if (sa->check_replay(seq) != SADataTuple::REPLAY_OK)
+	    w.rejects++;
+	w.sum += sa->keys->Authentication_key[0];
+    }
+    w.npackets += n;
+    if (w.npackets < _npackets) {
+	w.task->fast_reschedule();
+	return true;
+    }
+    _nfinished.fetch_and_add(1);
+    return n > 0;
+}
+
+bool
+IPsecSABenchmark::run_task(Task *t)
+{
+    if (t != &_control_task) {
+	for (uint32_t i = 0; i < _nthreads; i++)
+	    if (_workers[i].task == t)
+		return run_worker(_workers[i]);
+	return false;
+    }
+
+    if (!_t0) {
+	_t0 = Timestamp::now();
+	for (uint32_t i = 0; i < _nthreads; i++)
+	    _workers[i].task->reschedule();
+    } else if (_nfinished.value() == _nthreads) {
+	finish();
+	return false;
+    } else if (_rekeys_on) {
+	char key[16];
+	memset(key, 'a' + _rekeys % 26, sizeof(key));
+	_table->_sa_table.rekey(SPI(SPI_BASE + click_random(0, _nsas - 1)), key, key);
+	_rekeys++;
+    }
+    _control_task.fast_reschedule();
+    return true;
+}
+
+void
+IPsecSABenchmark::finish()
+{
+    double delta = (Timestamp::now() - _t0).doubleval();
+    uint32_t packets = 0, rejects = 0;
+    for (uint32_t i = 0; i < _nthreads; i++) {
+	packets += _workers[i].npackets;
+	rejects += _workers[i].rejects;
+    }
+    _packet_rate = packets / delta;
+    _rekey_rate = _rekeys / delta;
+    if (_stop) {
+	click_chatter("%s: %u threads, %u packets, %u rejected by replay window, %.3f s", declaration().c_str(), _nthreads, packets, rejects, delta);
+	click_chatter("%s: %.0f packets/s, %.0f rekeys/s", declaration().c_str(), _packet_rate, _rekey_rate);
+	router()->please_stop_driver();
+    }
+}
+
+String
+IPsecSABenchmark::read_handler(Element *e, void *thunk)
+{
+    IPsecSABenchmark *sab = static_cast<IPsecSABenchmark *>(e);
+    return String(thunk ? sab->_rekey_rate : sab->_packet_rate);
+}
+
+void
+IPsecSABenchmark::add_handlers()
+{
+    add_read_handler("packet_rate", read_handler, 0);
+    add_read_handler("rekey_rate", read_handler, (void *) 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel IPsecRouteTable)
+EXPORT_ELEMENT(IPsecSABenchmark)
@@ -0,0 +1,125 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSECSABENCHMARK_HH
+#define CLICK_IPSECSABENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/atomic.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+class IPsecRouteTable;
+
+/*
+=c
+
+IPsecSABenchmark(TABLE, [<keyword> SAS, THREADS, PACKETS, REKEY, STOP])
+
+=s test
+
+measures IPsec SA database speed across threads
+
+=d
+
+IPsecSABenchmark adds SAS Security Associations to TABLE, an
+IPsecRouteTable element, and then runs THREADS tasks, on threads 0 through
+THREADS-1, that each process PACKETS simulated packets.  For each packet, a
+task looks up a random SA, takes the SA's next outgoing sequence number,
+and checks that number against the SA's replay window, as IPsecESPEncap and
+IPsecESPUnencap would.  Meanwhile, if REKEY is true, another task
+repeatedly rekeys random SAs through TABLE's `C<rekey>' handler.
+
+The total packet rate, the number of rekeys done meanwhile, and the number
+of packets the replay window rejected are reported.  Rejections are not
+errors: a task interrupted between taking and checking a sequence number
+may fall more than the window behind.  Run Click with at least THREADS
+threads to measure scaling.
+
+Keyword arguments are:
+
+=over 8
+
+=item SAS
+
+Unsigned.  Number of SAs.  Default is 1000.
+
+=item THREADS
+
+Unsigned.  Number of packet tasks.  Default is 1.
+
+=item PACKETS
+
+Unsigned.  Number of packets per task.  Default is 10000000.
+
+=item REKEY
+
+Boolean.  If true, rekey SAs while the packets run.  Default is true.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h packet_rate read-only
+
+Returns the measured packets per second, summed over all tasks.
+
+=h rekey_rate read-only
+
+Returns the rekeys per second done while the packets ran.
+
+=a
+
+IPsecRouteTable, IPsecESPEncap, IPsecESPUnencap */
+
+class IPsecSABenchmark : public Element { public:
+
+    IPsecSABenchmark();
+    ~IPsecSABenchmark();
+
+    const char *class_name() const		{ return "IPsecSABenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    enum { SPI_BASE = 1000 };
+
+    // one per packet task, padded so tasks do not share cache lines
+    struct Worker {
+	Task *task;
+	uint32_t npackets;
+	uint32_t rejects;
+	uint32_t sum;
+	char pad[64];
+    };
+
+    IPsecRouteTable *_table;
+    uint32_t _nsas;
+    uint32_t _nthreads;
+    uint32_t _npackets;
+    bool _rekeys_on;
+    bool _stop;
+
+    Task _control_task;
+    Worker *_workers;
+    uint32_t _rekeys;
+    atomic_uint32_t _nfinished;
+    Timestamp _t0;
+    double _packet_rate;
+    double _rekey_rate;
+
+    bool run_worker(Worker &);
+    void finish();
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,184 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * linktablebenchmark.{cc,hh} -- measure LinkTable shortest path speed
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "linktablebenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+#include "elements/wifi/linktable.hh"
+CLICK_DECLS
+
+LinkTableBenchmark::LinkTableBenchmark()
+    : _table(0), _nhosts(0), _degree(6), _nupdates(1000), _seed(1),
+      _stop(true), _task(this), _reference_time(0), _full_time(0),
+      _incremental_time(0), _ok(false)
+{
+}
+
+LinkTableBenchmark::~LinkTableBenchmark()
+{
+}
+
+int
+LinkTableBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "TABLE", cpkP+cpkM, cpElementCast, "LinkTable", &_table,
+		     "N", cpkP+cpkM, cpInteger, &_nhosts,
+		     "DEGREE", 0, cpUnsigned, &_degree,
+		     "UPDATES", 0, cpUnsigned, &_nupdates,
+		     "SEED", 0, cpUnsigned, &_seed,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_nhosts < 2 || _degree < 2)
+	return errh->error("N and DEGREE must be at least 2");
+    return 0;
+}
+
+int
+LinkTableBenchmark::initialize(ErrorHandler *errh)
+{
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+int
+LinkTableBenchmark::check(const Vector<IPAddress> &hosts, ErrorHandler *errh)
+{
+    // routes must follow their links, and match the reference metrics
+    Vector<uint32_t> metrics;
+    for (int i = 0; i < hosts.size(); i++)
+	for (int from_me = 0; from_me < 2; from_me++) {
+	    uint32_t m = (from_me ? _table->get_host_metric_from_me(hosts[i])
+			  : _table->get_host_metric_to_me(hosts[i]));
+	    Vector<IPAddress> route = _table->best_route(hosts[i], from_me);
+	    if (i && m != _table->get_route_metric(route))
+		return errh->error("%s: route %s %s does not have metric %u",
+				   declaration().c_str(),
+				   from_me ? "to" : "from",
+				   hosts[i].unparse().c_str(), m);
+	    metrics.push_back(m);
+	}
+
+    _table->dijkstra_reference(true);
+    _table->dijkstra_reference(false);
+    for (int i = 0; i < hosts.size(); i++)
+	if (metrics[2*i] != _table->get_host_metric_to_me(hosts[i])
+	    || metrics[2*i + 1] != _table->get_host_metric_from_me(hosts[i]))
+	    return errh->error("%s: metrics for %s differ from reference",
+			       declaration().c_str(), hosts[i].unparse().c_str());
+    return 0;
+}
+
+bool
+LinkTableBenchmark::run_task(Task *)
+{
+    click_srandom(_seed);
+    ErrorHandler *errh = ErrorHandler::default_handler();
+
+    // build a connected mesh: each host links to an earlier host, plus
+    // random others
+    _table->clear();
+    Vector<IPAddress> hosts;
+    hosts.push_back(_table->ip());
+    for (uint32_t a = 0x0A000001; hosts.size() < _nhosts; a++)
+	if (IPAddress(htonl(a)) != hosts[0])
+	    hosts.push_back(IPAddress(htonl(a)));
+
+    Vector<IPAddress> link_from, link_to;
+    for (int i = 1; i < hosts.size(); i++)
+	for (uint32_t j = 0; j < _degree / 2; j++) {
+	    int k = (j == 0 ? click_random(0, i - 1) : click_random(0, hosts.size() - 1));
+	    if (k == i)
+		continue;
+	    _table->update_link(hosts[i], hosts[k], 1, 0, click_random(100, 2000));
+	    _table->update_link(hosts[k], hosts[i], 1, 0, click_random(100, 2000));
+	    link_from.push_back(hosts[i]);
+	    link_to.push_back(hosts[k]);
+	}
+
+    Timestamp t0 = Timestamp::now();
+    _table->dijkstra_reference(true);
+    _table->dijkstra_reference(false);
+    Timestamp t1 = Timestamp::now();
+    _table->dijkstra(true, false);
+    _table->dijkstra(false, false);
+    Timestamp t2 = Timestamp::now();
+
+    // change one link's metric at a time
+    Timestamp elapsed;
+    for (uint32_t n = 0; n < _nupdates; n++) {
+	int l = click_random(0, link_from.size() - 1);
+	IPAddress from = link_from[l], to = link_to[l];
+	if (click_random(0, 1))
+	    from = link_to[l], to = link_from[l];
+	uint32_t seq = _table->get_link_seq(from, to) + 1;
+	_table->update_link(from, to, seq, 0, click_random(100, 2000));
+	Timestamp t3 = Timestamp::now();
+	_table->dijkstra(true);
+	_table->dijkstra(false);
+	elapsed += Timestamp::now() - t3;
+    }
+
+    _reference_time = (t1 - t0).doubleval();
+    _full_time = (t2 - t1).doubleval();
+    _incremental_time = (_nupdates ? elapsed.doubleval() / _nupdates : 0);
+    _ok = (check(hosts, errh) >= 0);
+
+    if (_stop) {
+	click_chatter("%s: %d hosts, %d links: reference %.3f ms, full %.3f ms, incremental %.3f ms",
+		      declaration().c_str(), _nhosts, 2 * link_from.size(),
+		      _reference_time * 1000, _full_time * 1000,
+		      _incremental_time * 1000);
+	router()->please_stop_driver();
+    }
+    return true;
+}
+
+enum { H_REFERENCE_TIME, H_FULL_TIME, H_INCREMENTAL_TIME, H_OK };
+
+String
+LinkTableBenchmark::read_handler(Element *e, void *thunk)
+{
+    LinkTableBenchmark *b = static_cast<LinkTableBenchmark *>(e);
+    switch ((intptr_t) thunk) {
+      case H_REFERENCE_TIME:
+	return String(b->_reference_time);
+      case H_FULL_TIME:
+	return String(b->_full_time);
+      case H_INCREMENTAL_TIME:
+	return String(b->_incremental_time);
+      case H_OK:
+	return cp_unparse_bool(b->_ok);
+      default:
+	return String();
+    }
+}
+
+void
+LinkTableBenchmark::add_handlers()
+{
+    add_read_handler("reference_time", read_handler, (void *) H_REFERENCE_TIME);
+    add_read_handler("full_time", read_handler, (void *) H_FULL_TIME);
+    add_read_handler("incremental_time", read_handler, (void *) H_INCREMENTAL_TIME);
+    add_read_handler("ok", read_handler, (void *) H_OK);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(LinkTable)
+EXPORT_ELEMENT(LinkTableBenchmark)
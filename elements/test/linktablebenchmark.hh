@@ -0,0 +1,111 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_LINKTABLEBENCHMARK_HH
+#define CLICK_LINKTABLEBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/ipaddress.hh>
+CLICK_DECLS
+class LinkTable;
+
+/*
+=c
+
+LinkTableBenchmark(TABLE, N, [<keyword> DEGREE, UPDATES, SEED, STOP])
+
+=s test
+
+measures LinkTable shortest path computation speed
+
+=d
+
+LinkTableBenchmark clears TABLE, a LinkTable element, fills it with a random
+connected mesh of N hosts, and then times TABLE's shortest path computations
+in both directions.  Three times are measured: the original O(N^2)
+computation (LinkTable's dijkstra_reference), a full heap-based computation,
+and an incremental computation after a single link's metric changes.  The
+incremental time is averaged over UPDATES random metric changes.
+
+After the changes, LinkTableBenchmark checks that the incrementally
+maintained routes have the same metrics as the reference computation and
+that each route's metric equals the sum of its links' metrics.  It reports an
+error if they do not.
+
+Keyword arguments are:
+
+=over 8
+
+=item DEGREE
+
+Unsigned.  Average number of neighbors per host.  Default is 6.
+
+=item UPDATES
+
+Unsigned.  Number of link metric changes to measure.  Default is 1000.
+
+=item SEED
+
+Unsigned.  Random number seed.  Default is 1.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h reference_time read-only
+
+Returns the time, in seconds, of the reference computation.
+
+=h full_time read-only
+
+Returns the time, in seconds, of a full heap-based computation.
+
+=h incremental_time read-only
+
+Returns the average time, in seconds, of an incremental computation.
+
+=h ok read-only
+
+Returns true if the incremental routes matched the reference routes.
+
+=a
+
+LinkTable */
+
+class LinkTableBenchmark : public Element { public:
+
+    LinkTableBenchmark();
+    ~LinkTableBenchmark();
+
+    const char *class_name() const		{ return "LinkTableBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    LinkTable *_table;
+    int _nhosts;
+    uint32_t _degree;
+    uint32_t _nupdates;
+    uint32_t _seed;
+    bool _stop;
+    Task _task;
+
+    double _reference_time;
+    double _full_time;
+    double _incremental_time;
+    bool _ok;
+
+    int check(const Vector<IPAddress> &hosts, ErrorHandler *);
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,100 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * replaybenchmark.{cc,hh} -- measure trace replay throughput
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "replaybenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+CLICK_DECLS
+
+ReplayBenchmark::ReplayBenchmark()
+    : _count(0), _bytes(0), _write(false), _stop(true), _done(false)
+{
+}
+
+ReplayBenchmark::~ReplayBenchmark()
+{
+}
+
+int
+ReplayBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return cp_va_kparse(conf, this, errh,
+			"WRITE", 0, cpBool, &_write,
+			"STOP", 0, cpBool, &_stop,
+			cpEnd);
+}
+
+void
+ReplayBenchmark::push(int, Packet *p)
+{
+    if (!_count)
+	_first = Timestamp::now();
+    if (_write && !(p = p->uniqueify()))
+	return;
+    _count++;
+    _bytes += p->length();
+    p->kill();
+}
+
+double
+ReplayBenchmark::packet_rate() const
+{
+    Timestamp last = (_done ? _last : Timestamp::now());
+    double t = (last - _first).doubleval();
+    return (_count && t > 0 ? _count / t / 1e6 : 0);
+}
+
+enum { H_COUNT, H_PACKET_RATE, H_DONE };
+
+String
+ReplayBenchmark::read_handler(Element *e, void *thunk)
+{
+    ReplayBenchmark *b = static_cast<ReplayBenchmark *>(e);
+    if (thunk == (void *) H_COUNT)
+	return String(b->_count);
+    else
+	return String(b->packet_rate());
+}
+
+int
+ReplayBenchmark::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    ReplayBenchmark *b = static_cast<ReplayBenchmark *>(e);
+    if (!b->_done) {
+	b->_last = Timestamp::now();
+	b->_done = true;
+    }
+    if (b->_stop) {
+	click_chatter("%s: %llu packets, %llu bytes in %s s, %.3f Mpps",
+		      b->declaration().c_str(), (unsigned long long) b->_count,
+		      (unsigned long long) b->_bytes,
+		      (b->_last - b->_first).unparse().c_str(), b->packet_rate());
+	b->router()->please_stop_driver();
+    }
+    return 0;
+}
+
+void
+ReplayBenchmark::add_handlers()
+{
+    add_read_handler("count", read_handler, (void *) H_COUNT);
+    add_read_handler("packet_rate", read_handler, (void *) H_PACKET_RATE);
+    add_write_handler("done", write_handler, (void *) H_DONE, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(ReplayBenchmark)
@@ -0,0 +1,96 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_REPLAYBENCHMARK_HH
+#define CLICK_REPLAYBENCHMARK_HH
+#include <click/element.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+ReplayBenchmark([<keyword> WRITE, STOP])
+
+=s test
+
+measures trace replay throughput
+
+=d
+
+ReplayBenchmark counts and discards the packets pushed to it, and measures
+the rate at which they arrive from the first packet until its `C<done>'
+handler is called.  Use it with FromDump's END_CALL argument to measure how
+fast a trace can be replayed:
+
+  FromDump(trace.pcap, BURST 32, END_CALL b.done) -> b :: ReplayBenchmark;
+
+Keyword arguments are:
+
+=over 8
+
+=item WRITE
+
+Boolean.  If true, make each packet writable before discarding it, as an
+element that modifies packets would.  With FromDump's MMAP this measures the
+cost of copying packet data out of the mapped file.  Default is false.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver when done.
+Default is true.
+
+=back
+
+=h count read-only
+
+Returns the number of packets received.
+
+=h packet_rate read-only
+
+Returns the measured rate in millions of packets per second (Mpps).
+
+=h done write-only
+
+Ends the measurement.
+
+=a
+
+FromDump, Discard */
+
+class ReplayBenchmark : public Element { public:
+
+    ReplayBenchmark();
+    ~ReplayBenchmark();
+
+    const char *class_name() const	{ return "ReplayBenchmark"; }
+    const char *port_count() const	{ return PORTS_1_0; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    void add_handlers();
+
+    void push(int, Packet *);
+
+  private:
+
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+    counter_t _count;
+    counter_t _bytes;
+    bool _write;
+    bool _stop;
+    bool _done;
+
+    Timestamp _first;
+    Timestamp _last;
+
+    double packet_rate() const;
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
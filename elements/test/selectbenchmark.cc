@@ -0,0 +1,140 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * selectbenchmark.{cc,hh} -- measure select loop event dispatch cost
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "selectbenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+CLICK_DECLS
+
+SelectBenchmark::SelectBenchmark()
+    : _nidle(1000), _events(100000), _count(0), _stop(true), _task(this)
+{
+    _busy[0] = _busy[1] = -1;
+}
+
+SelectBenchmark::~SelectBenchmark()
+{
+}
+
+int
+SelectBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return cp_va_kparse(conf, this, errh,
+			"IDLE", 0, cpInteger, &_nidle,
+			"EVENTS", 0, cpUnsigned, &_events,
+			"STOP", 0, cpBool, &_stop,
+			cpEnd);
+}
+
+int
+SelectBenchmark::initialize(ErrorHandler *errh)
+{
+    for (int i = 0; i < _nidle; i++) {
+	int fd = socket(PF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+	    return errh->error("socket %d: %s", i, strerror(errno));
+	_idle_fds.push_back(fd);
+	if (add_select(fd, SELECT_READ) < 0)
+	    return errh->error("cannot select on fd %d", fd);
+    }
+
+    if (pipe(_busy) < 0)
+	return errh->error("pipe: %s", strerror(errno));
+    fcntl(_busy[0], F_SETFL, O_NONBLOCK);
+    if (add_select(_busy[0], SELECT_READ) < 0)
+	return errh->error("cannot select on fd %d", _busy[0]);
+
+    _task.initialize(this, _events > 0);
+    return 0;
+}
+
+void
+SelectBenchmark::cleanup(CleanupStage)
+{
+    for (int *fdp = _idle_fds.begin(); fdp != _idle_fds.end(); ++fdp) {
+	remove_select(*fdp, SELECT_READ);
+	close(*fdp);
+    }
+    _idle_fds.clear();
+    if (_busy[0] >= 0) {
+	remove_select(_busy[0], SELECT_READ);
+	close(_busy[0]);
+	close(_busy[1]);
+	_busy[0] = _busy[1] = -1;
+    }
+}
+
+bool
+SelectBenchmark::run_task(Task *)
+{
+    if (_count == 0)
+	_start.assign_now();
+    ignore_result(write(_busy[1], "x", 1));
+    return true;
+}
+
+void
+SelectBenchmark::selected(int fd)
+{
+    char buf[16];
+    if (fd != _busy[0] || read(fd, buf, sizeof(buf)) <= 0)
+	return;
+    if (++_count < _events)
+	_task.reschedule();
+    else if (_count == _events) {
+	_end.assign_now();
+	if (_stop) {
+	    click_chatter("%s: %u events, %d idle fds, %s s, %.0f events/s",
+			  declaration().c_str(), _count, _nidle,
+			  (_end - _start).unparse().c_str(), rate());
+	    router()->please_stop_driver();
+	}
+    }
+}
+
+double
+SelectBenchmark::rate() const
+{
+    Timestamp end = (_count >= _events ? _end : Timestamp::now());
+    double d = (end - _start).doubleval();
+    return (d > 0 ? _count / d : 0);
+}
+
+String
+SelectBenchmark::read_handler(Element *e, void *thunk)
+{
+    SelectBenchmark *sb = static_cast<SelectBenchmark *>(e);
+    if (thunk)
+	return String(sb->rate());
+    else
+	return String(sb->_count);
+}
+
+void
+SelectBenchmark::add_handlers()
+{
+    add_read_handler("count", read_handler, (void *) 0);
+    add_read_handler("rate", read_handler, (void *) 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(SelectBenchmark)
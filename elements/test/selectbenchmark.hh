@@ -0,0 +1,99 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SELECTBENCHMARK_HH
+#define CLICK_SELECTBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SelectBenchmark([<keyword> IDLE, EVENTS, STOP])
+
+=s test
+
+measures file descriptor event dispatch cost
+
+=d
+
+SelectBenchmark measures how quickly the Master's select loop delivers file
+descriptor events when most registered descriptors are idle.  At
+initialization time it opens IDLE unconnected UDP sockets and registers each
+for readability; none of them will ever become ready.  It then passes one
+byte at a time through a pipe, waiting for each byte to be reported by
+selected() before writing the next, until EVENTS bytes have been delivered.
+
+Run it by itself, for example "click -e 'SelectBenchmark(IDLE 1000)'", and
+compare results for different --enable-select settings.  The per-event cost
+of select() and poll() grows with IDLE; the cost of kqueue and epoll does
+not.
+
+Keyword arguments are:
+
+=over 8
+
+=item IDLE
+
+Integer.  Number of idle file descriptors.  Default is 1000.  Make sure the
+process's file descriptor limit is large enough.
+
+=item EVENTS
+
+Unsigned.  Number of events to deliver on the busy descriptor.  Default is
+100000.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver after EVENTS events.
+Default is true.
+
+=back
+
+=h count read-only
+
+Returns the number of events delivered so far.
+
+=h rate read-only
+
+Returns the measured event rate, in events per second.
+
+=a
+
+Socket, ControlSocket */
+
+class SelectBenchmark : public Element { public:
+
+    SelectBenchmark();
+    ~SelectBenchmark();
+
+    const char *class_name() const		{ return "SelectBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *);
+    void selected(int fd);
+
+  private:
+
+    int _nidle;
+    uint32_t _events;
+    uint32_t _count;
+    bool _stop;
+    Vector<int> _idle_fds;
+    int _busy[2];
+    Task _task;
+    Timestamp _start;
+    Timestamp _end;
+
+    double rate() const;
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,120 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * taskbenchmark.{cc,hh} -- measure task scheduler overhead
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "taskbenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+CLICK_DECLS
+
+TaskBenchmark::TaskBenchmark()
+    : _ntasks(0), _runs(1000000), _count(0), _vary(true), _stop(true)
+{
+}
+
+TaskBenchmark::~TaskBenchmark()
+{
+}
+
+int
+TaskBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "N", cpkP+cpkM, cpInteger, &_ntasks,
+		     "RUNS", 0, cpUnsigned, &_runs,
+		     "VARY", 0, cpBool, &_vary,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_ntasks < 1)
+	return errh->error("N must be positive");
+    return 0;
+}
+
+int
+TaskBenchmark::initialize(ErrorHandler *errh)
+{
+    for (int i = 0; i < _ntasks; i++) {
+	Task *t = new Task(task_hook, this);
+	if (!t)
+	    return errh->error("out of memory!");
+	_tasks.push_back(t);
+	t->initialize(this, false);
+#if HAVE_STRIDE_SCHED
+	if (_vary)
+	    t->set_tickets(Task::DEFAULT_TICKETS / 2
+			   + (i * 37) % (Task::DEFAULT_TICKETS * 3 / 2));
+#endif
+    }
+    for (Task **tp = _tasks.begin(); tp != _tasks.end(); ++tp)
+	(*tp)->reschedule();
+    return 0;
+}
+
+void
+TaskBenchmark::cleanup(CleanupStage)
+{
+    for (Task **tp = _tasks.begin(); tp != _tasks.end(); ++tp)
+	delete *tp;
+    _tasks.clear();
+}
+
+bool
+TaskBenchmark::task_hook(Task *t, void *thunk)
+{
+    TaskBenchmark *tb = static_cast<TaskBenchmark *>(thunk);
+    if (tb->_count == 0)
+	tb->_start.assign_now();
+    if (++tb->_count < tb->_runs)
+	t->fast_reschedule();
+    else if (tb->_count == tb->_runs) {
+	tb->_end.assign_now();
+	if (tb->_stop) {
+	    click_chatter("%s: %d tasks, %u runs, %.1f ns/task",
+			  tb->declaration().c_str(), tb->_ntasks, tb->_runs,
+			  tb->nsec_per_task());
+	    tb->router()->please_stop_driver();
+	}
+    }
+    return true;
+}
+
+double
+TaskBenchmark::nsec_per_task() const
+{
+    Timestamp end = (_count >= _runs ? _end : Timestamp::now());
+    return (_count ? (end - _start).doubleval() * 1e9 / _count : 0);
+}
+
+String
+TaskBenchmark::read_handler(Element *e, void *thunk)
+{
+    TaskBenchmark *tb = static_cast<TaskBenchmark *>(e);
+    if (thunk)
+	return String(tb->nsec_per_task());
+    else
+	return String(tb->_count);
+}
+
+void
+TaskBenchmark::add_handlers()
+{
+    add_read_handler("count", read_handler, (void *) 0);
+    add_read_handler("nsec_per_task", read_handler, (void *) 1);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TaskBenchmark)
@@ -0,0 +1,94 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TASKBENCHMARK_HH
+#define CLICK_TASKBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TaskBenchmark(N, [<keyword> RUNS, VARY, STOP])
+
+=s test
+
+measures task scheduler overhead
+
+=d
+
+TaskBenchmark creates N tasks that do no work except reschedule themselves,
+and measures how long the RouterThread takes to fire them RUNS times in
+total.  Since the tasks do nothing, the result is almost entirely scheduler
+overhead: the cost of taking a task off the scheduled list and of
+fast_reschedule() putting it back in stride order.
+
+With the default linked-list task scheduler, fast_reschedule() walks the
+list, so the per-task cost grows with N.  Compare with a Click compiled with
+"./configure --enable-task-heap", whose cost grows with log N.
+
+Keyword arguments are:
+
+=over 8
+
+=item RUNS
+
+Unsigned.  Total number of task firings to measure.  Default is 1000000.
+
+=item VARY
+
+Boolean.  If true, give the tasks different ticket counts, between one half
+and twice the default, so that their passes diverge.  If false, every task
+has the default ticket count.  Default is true.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver after RUNS
+firings.  Default is true.
+
+=back
+
+=h count read-only
+
+Returns the number of task firings so far.
+
+=h nsec_per_task read-only
+
+Returns the measured time per task firing, in nanoseconds.
+
+=a
+
+SchedOrderTest, ScheduleInfo */
+
+class TaskBenchmark : public Element { public:
+
+    TaskBenchmark();
+    ~TaskBenchmark();
+
+    const char *class_name() const		{ return "TaskBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+  private:
+
+    int _ntasks;
+    uint32_t _runs;
+    uint32_t _count;
+    bool _vary;
+    bool _stop;
+    Vector<Task *> _tasks;
+    Timestamp _start;
+    Timestamp _end;
+
+    static bool task_hook(Task *, void *);
+    double nsec_per_task() const;
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,126 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * timerbenchmark.{cc,hh} -- measure timer rescheduling overhead
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "timerbenchmark.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+CLICK_DECLS
+
+TimerBenchmark::TimerBenchmark()
+    : _ntimers(0), _runs(1000000), _count(0), _stop(true), _task(this)
+{
+}
+
+TimerBenchmark::~TimerBenchmark()
+{
+}
+
+int
+TimerBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (cp_va_kparse(conf, this, errh,
+		     "N", cpkP+cpkM, cpInteger, &_ntimers,
+		     "RUNS", 0, cpUnsigned, &_runs,
+		     "STOP", 0, cpBool, &_stop,
+		     cpEnd) < 0)
+	return -1;
+    if (_ntimers < 1)
+	return errh->error("N must be positive");
+    return 0;
+}
+
+int
+TimerBenchmark::initialize(ErrorHandler *errh)
+{
+    Timestamp now = Timestamp::now();
+    for (int i = 0; i < _ntimers; i++) {
+	Timer *t = new Timer(this);
+	if (!t)
+	    return errh->error("out of memory!");
+	_timers.push_back(t);
+	t->initialize(this);
+	t->schedule_at(now + Timestamp::make_msec(10000 + (i * 7919) % 10000));
+    }
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+void
+TimerBenchmark::cleanup(CleanupStage)
+{
+    for (Timer **tp = _timers.begin(); tp != _timers.end(); ++tp)
+	delete *tp;
+    _timers.clear();
+}
+
+bool
+TimerBenchmark::run_task(Task *)
+{
+    if (_count == 0)
+	_start.assign_now();
+    uint32_t n = (_runs - _count < 1024 ? _runs - _count : 1024);
+    for (uint32_t i = 0; i < n; i++, _count++) {
+	Timer *t = _timers[(_count * 7919) % _ntimers];
+	t->schedule_at(t->expiry() + Timestamp::make_msec(1));
+    }
+    if (_count < _runs)
+	_task.fast_reschedule();
+    else {
+	_end.assign_now();
+	if (_stop) {
+	    click_chatter("%s: %d timers, %u runs, %.1f ns/timer",
+			  declaration().c_str(), _ntimers, _runs,
+			  nsec_per_timer());
+	    router()->please_stop_driver();
+	}
+    }
+    return true;
+}
+
+void
+TimerBenchmark::run_timer(Timer *)
+{
+}
+
+double
+TimerBenchmark::nsec_per_timer() const
+{
+    Timestamp end = (_count >= _runs ? _end : Timestamp::now());
+    return (_count ? (end - _start).doubleval() * 1e9 / _count : 0);
+}
+
+String
+TimerBenchmark::read_handler(Element *e, void *thunk)
+{
+    TimerBenchmark *tb = static_cast<TimerBenchmark *>(e);
+    if (thunk)
+	return String(tb->nsec_per_timer());
+    else
+	return String(tb->_count);
+}
+
+void
+TimerBenchmark::add_handlers()
+{
+    add_read_handler("count", read_handler, (void *) 0);
+    add_read_handler("nsec_per_timer", read_handler, (void *) 1);
+    add_task_handlers(&_task);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TimerBenchmark)
@@ -0,0 +1,88 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TIMERBENCHMARK_HH
+#define CLICK_TIMERBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timer.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TimerBenchmark(N, [<keyword> RUNS, STOP])
+
+=s test
+
+measures timer rescheduling overhead
+
+=d
+
+TimerBenchmark creates N timers, scheduled between 10 and 20 seconds in the
+future, then repeatedly picks one of them and pushes its expiry a little
+later.  This mimics soft-state elements, such as routing tables and flow
+tables, that refresh a timeout every time an entry is used.  The element
+measures how long RUNS such reschedulings take.
+
+None of the timers fires during the benchmark.
+
+Keyword arguments are:
+
+=over 8
+
+=item RUNS
+
+Unsigned.  Total number of reschedulings to measure.  Default is 1000000.
+
+=item STOP
+
+Boolean.  If true, print the results and stop the driver after RUNS
+reschedulings.  Default is true.
+
+=back
+
+=h count read-only
+
+Returns the number of reschedulings so far.
+
+=h nsec_per_timer read-only
+
+Returns the measured time per rescheduling, in nanoseconds.
+
+=a
+
+TaskBenchmark */
+
+class TimerBenchmark : public Element { public:
+
+    TimerBenchmark();
+    ~TimerBenchmark();
+
+    const char *class_name() const		{ return "TimerBenchmark"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *);
+    void run_timer(Timer *);
+
+  private:
+
+    int _ntimers;
+    uint32_t _runs;
+    uint32_t _count;
+    bool _stop;
+    Vector<Timer *> _timers;
+    Task _task;
+    Timestamp _start;
+    Timestamp _end;
+
+    double nsec_per_timer() const;
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
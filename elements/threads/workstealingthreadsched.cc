@@ -0,0 +1,66 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * workstealingthreadsched.{cc,hh} -- idle threads steal tasks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <click/config.h>
+#include "workstealingthreadsched.hh"
+#include <click/task.hh>
+#include <click/master.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+WorkStealingThreadSched::WorkStealingThreadSched()
+{
+}
+
+WorkStealingThreadSched::~WorkStealingThreadSched()
+{
+}
+
+int
+WorkStealingThreadSched::initialize(ErrorHandler *)
+{
+    master()->set_work_stealing(true);
+    return 0;
+}
+
+void
+WorkStealingThreadSched::cleanup(CleanupStage stage)
+{
+    if (stage >= CLEANUP_INITIALIZED)
+	master()->set_work_stealing(false);
+}
+
+String
+WorkStealingThreadSched::read_handler(Element *e, void *)
+{
+    Master *m = e->master();
+    StringAccum sa;
+    for (int tid = 0; tid < m->nthreads(); tid++) {
+	RouterThread *thread = m->thread(tid);
+	sa << tid << ' ' << thread->steals() << ' '
+	   << thread->steal_attempts() << ' ' << thread->idle_count() << '\n';
+    }
+    return sa.take_string();
+}
+
+void
+WorkStealingThreadSched::add_handlers()
+{
+    add_read_handler("stats", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel umultithread)
+EXPORT_ELEMENT(WorkStealingThreadSched)
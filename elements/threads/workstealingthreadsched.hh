@@ -0,0 +1,55 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef WORKSTEALINGTHREADSCHED_HH
+#define WORKSTEALINGTHREADSCHED_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * WorkStealingThreadSched()
+ * =s threads
+ * lets idle threads steal tasks from busy threads
+ * =d
+ *
+ * Turns on work stealing in a multithreaded user-level driver (click
+ * --threads N).  A thread that runs out of scheduled tasks takes one task
+ * from another thread that has at least two, and the task's home thread
+ * becomes the idle thread.  A busy thread with a backlog wakes a sleeping idle
+ * thread so it can steal.
+ *
+ * The victim keeps the task it would run next; the thief takes the one it
+ * would run last.  Tasks stay on their new thread until stolen again, so
+ * cache-warm tasks are not bounced between threads.
+ *
+ * Tasks assigned to a thread by StaticThreadSched, and tasks belonging to
+ * elements with the P flag, are never stolen.  As with BalancedThreadSched,
+ * the configuration must otherwise be safe for any task to run on any thread.
+ *
+ * =h stats read-only
+ * Returns one line per thread: the thread ID, the number of tasks the thread
+ * has stolen, the number of steal attempts, and the number of times the
+ * thread found itself idle.
+ *
+ * =a
+ * StaticThreadSched, BalancedThreadSched
+ */
+
+class WorkStealingThreadSched : public Element { public:
+
+    WorkStealingThreadSched();
+    ~WorkStealingThreadSched();
+
+    const char *class_name() const	{ return "WorkStealingThreadSched"; }
+
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+  private:
+
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,298 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * asyncwriter.{cc,hh} -- writes trace files from a separate thread
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "asyncwriter.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/element.hh>
+CLICK_DECLS
+
+AsyncWriter::AsyncWriter()
+    : _enabled(false), _drop(false), _running(false),
+      _buffer_size(DEFAULT_BUFFER), _nbuffers(2), _pos(0), _end(0), _cur(0),
+      _drops(0), _f(0), _owner(0), _next_write(0), _nfull(0),
+      _stopping(false), _error(0), _error_reported(false),
+      _timer(timer_hook, this)
+{
+    _flush_due = 0;
+}
+
+int
+AsyncWriter::configure_keywords(Vector<String> &conf, Element *e, ErrorHandler *errh)
+{
+    if (cp_va_kparse_remove_keywords(conf, e, errh,
+		    "ASYNC", 0, cpBool, &_enabled,
+		    "ASYNC_BUFFER", 0, cpUnsigned, &_buffer_size,
+		    "ASYNC_NBUFFERS", 0, cpUnsigned, &_nbuffers,
+		    "ASYNC_DROP", 0, cpBool, &_drop,
+		    cpEnd) < 0)
+	return -1;
+    if (_buffer_size < MIN_BUFFER)
+	return errh->error("ASYNC_BUFFER must be at least %d", MIN_BUFFER);
+    if (_nbuffers < 2)
+	return errh->error("ASYNC_NBUFFERS must be at least 2");
+    return 0;
+}
+
+int
+AsyncWriter::start(FILE *f, const String &filename, Element *owner, ErrorHandler *errh)
+{
+    if (!_enabled || _running)
+	return 0;
+
+    _buffers.resize(_nbuffers);
+    for (int i = 0; i < _buffers.size(); i++) {
+	_buffers[i].data = new char[_buffer_size];
+	_buffers[i].length = 0;
+	_buffers[i].full = false;
+	if (!_buffers[i].data) {
+	    for (int j = 0; j < i; j++)
+		delete[] _buffers[j].data;
+	    _buffers.clear();
+	    return errh->error("out of memory for output buffers");
+	}
+    }
+
+    _f = f;
+    _filename = filename;
+    _owner = owner;
+    _cur = _next_write = _nfull = 0;
+    _pos = _buffers[0].data;
+    _end = _pos + _buffer_size;
+    _flush_due = 0;
+    _stopping = false;
+
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_full_cond, 0);
+    pthread_cond_init(&_free_cond, 0);
+    if (int r = pthread_create(&_thread, 0, thread_hook, this)) {
+	pthread_cond_destroy(&_free_cond);
+	pthread_cond_destroy(&_full_cond);
+	pthread_mutex_destroy(&_lock);
+	for (int i = 0; i < _buffers.size(); i++)
+	    delete[] _buffers[i].data;
+	_buffers.clear();
+	_pos = _end = 0;
+	return errh->error("cannot start writer thread: %s", strerror(r));
+    }
+    _running = true;
+
+    _timer.initialize(owner);
+    _timer.schedule_after_sec(1);
+    return 0;
+}
+
+void
+AsyncWriter::stop()
+{
+    if (!_running)
+	return;
+    _timer.unschedule();
+    submit(true);
+
+    pthread_mutex_lock(&_lock);
+    _stopping = true;
+    pthread_cond_signal(&_full_cond);
+    pthread_mutex_unlock(&_lock);
+    pthread_join(_thread, 0);
+
+    pthread_cond_destroy(&_free_cond);
+    pthread_cond_destroy(&_full_cond);
+    pthread_mutex_destroy(&_lock);
+    for (int i = 0; i < _buffers.size(); i++)
+	delete[] _buffers[i].data;
+    _buffers.clear();
+    _pos = _end = 0;
+    _running = false;
+    fflush(_f);
+    _f = 0;
+}
+
+bool
+AsyncWriter::submit(bool block)
+{
+    // Hand the current buffer to the writer thread and move to the next one.
+    // Returns false if !block and the next buffer is still being written.
+    Buffer &b = _buffers[_cur];
+    size_t length = _pos - b.data;
+    if (length == 0)
+	return true;
+
+    int next = (_cur + 1 == _buffers.size() ? 0 : _cur + 1);
+    pthread_mutex_lock(&_lock);
+    while (_buffers[next].full) {
+	if (!block) {
+	    pthread_mutex_unlock(&_lock);
+	    return false;
+	}
+	pthread_cond_wait(&_free_cond, &_lock);
+    }
+    b.length = length;
+    b.full = true;
+    _nfull++;
+    pthread_cond_signal(&_full_cond);
+    pthread_mutex_unlock(&_lock);
+
+    _cur = next;
+    _pos = _buffers[next].data;
+    _end = _pos + _buffer_size;
+    return true;
+}
+
+void
+AsyncWriter::wait_idle()
+{
+    pthread_mutex_lock(&_lock);
+    while (_nfull)
+	pthread_cond_wait(&_free_cond, &_lock);
+    pthread_mutex_unlock(&_lock);
+}
+
+void
+AsyncWriter::write_direct(const void *a, size_t alen, const void *b, size_t blen)
+{
+    if ((alen && fwrite(a, 1, alen, _f) != alen)
+	|| (blen && fwrite(b, 1, blen, _f) != blen))
+	if (!_error)
+	    _error = errno;
+}
+
+bool
+AsyncWriter::slow_append(const void *a, size_t alen, const void *b, size_t blen)
+{
+    if (!_running) {
+	if (!_f)
+	    return false;
+	write_direct(a, alen, b, blen);
+	return true;
+    }
+
+    if (_flush_due.value()) {
+	// the timer asked for the buffer being filled
+	_flush_due = 0;
+	submit(false);
+    }
+
+    if ((size_t) (_end - _pos) < alen + blen) {
+	if (alen + blen > _buffer_size) {
+	    // Too big for any buffer: write it on this thread once the writer
+	    // thread has caught up, so the file stays in order.
+	    if (_drop) {
+		_drops++;
+		return false;
+	    }
+	    submit(true);
+	    wait_idle();
+	    write_direct(a, alen, b, blen);
+	    return true;
+	}
+
+	if (!submit(!_drop)) {
+	    _drops++;
+	    return false;
+	}
+    }
+    memcpy(_pos, a, alen);
+    if (blen)
+	memcpy(_pos + alen, b, blen);
+    _pos += alen + blen;
+    return true;
+}
+
+void
+AsyncWriter::flush(bool wait)
+{
+    if (!_running)
+	return;
+#if HAVE_MULTITHREAD
+    // another thread may be appending, so leave its buffer to append()
+    _flush_due = 1;
+#else
+    submit(wait);
+#endif
+    if (wait) {
+	wait_idle();
+	fflush(_f);
+    }
+}
+
+void *
+AsyncWriter::thread_hook(void *thunk)
+{
+    static_cast<AsyncWriter *>(thunk)->run_thread();
+    return 0;
+}
+
+void
+AsyncWriter::run_thread()
+{
+    pthread_mutex_lock(&_lock);
+    while (1) {
+	while (!_buffers[_next_write].full && !_stopping)
+	    pthread_cond_wait(&_full_cond, &_lock);
+	Buffer &b = _buffers[_next_write];
+	if (!b.full)
+	    break;
+	pthread_mutex_unlock(&_lock);
+
+	int error = 0;
+	if (fwrite(b.data, 1, b.length, _f) != b.length || fflush(_f) != 0)
+	    error = errno;
+
+	pthread_mutex_lock(&_lock);
+	if (error && !_error)
+	    _error = error;
+	b.full = false;
+	_nfull--;
+	_next_write = (_next_write + 1 == _buffers.size() ? 0 : _next_write + 1);
+	pthread_cond_broadcast(&_free_cond);
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+void
+AsyncWriter::timer_hook(Timer *t, void *thunk)
+{
+    AsyncWriter *w = static_cast<AsyncWriter *>(thunk);
+    w->flush(false);
+    pthread_mutex_lock(&w->_lock);
+    int error = w->_error;
+    pthread_mutex_unlock(&w->_lock);
+    if (error && !w->_error_reported) {
+	click_chatter("%{element}: %s: %s", w->_owner, w->_filename.c_str(), strerror(error));
+	w->_error_reported = true;
+    }
+    t->reschedule_after_sec(1);
+}
+
+String
+AsyncWriter::read_handler(Element *e, void *thunk)
+{
+    AsyncWriter *w = reinterpret_cast<AsyncWriter *>((uint8_t *)e + (intptr_t)thunk);
+    return String(w->_drops);
+}
+
+void
+AsyncWriter::add_handlers(Element *e) const
+{
+    intptr_t offset = (const uint8_t *)this - (const uint8_t *)e;
+    e->add_read_handler("drops", read_handler, (void *)offset);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel|ns)
+ELEMENT_PROVIDES(AsyncWriter)
+ELEMENT_LIBS(-lpthread)
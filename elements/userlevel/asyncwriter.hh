@@ -0,0 +1,124 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ASYNCWRITER_HH
+#define CLICK_ASYNCWRITER_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/timer.hh>
+#include <click/atomic.hh>
+#include <stdio.h>
+#include <pthread.h>
+CLICK_DECLS
+class ErrorHandler;
+class Element;
+
+/*
+ * AsyncWriter moves file writes off a trace-writing element's fast path.
+ * Records are appended to one of a ring of large preallocated buffers; a
+ * writer thread writes full buffers to the file in order.  When every buffer
+ * is full, append() either waits for the writer (the default) or drops the
+ * record and counts it (ASYNC_DROP).  A record is always written whole or
+ * not at all.
+ *
+ * Only the appending thread touches the buffer being filled.  Once a second
+ * a timer asks for that buffer to be handed to the writer; with several
+ * Click threads the timer may run on another thread, so append() does the
+ * handover, and a partly filled buffer waits for the next record.  For the
+ * same reason, flush() from another thread only waits for the buffers
+ * already handed over.
+ *
+ * Elements using AsyncWriter accept the keywords ASYNC, ASYNC_BUFFER,
+ * ASYNC_NBUFFERS and ASYNC_DROP; see ToDump's documentation.
+ */
+
+class AsyncWriter { public:
+
+    AsyncWriter();
+    ~AsyncWriter()			{ stop(); }
+
+    bool enabled() const		{ return _enabled; }
+    bool running() const		{ return _running; }
+
+    int configure_keywords(Vector<String> &conf, Element *, ErrorHandler *);
+    int start(FILE *, const String &filename, Element *, ErrorHandler *);
+    void stop();
+    void flush(bool wait);
+    void add_handlers(Element *) const;
+
+    inline bool append(const void *a, size_t alen,
+		       const void *b = 0, size_t blen = 0);
+
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+    counter_t drops() const		{ return _drops; }
+    int error() const			{ return _error; }
+
+  private:
+
+    enum { DEFAULT_BUFFER = 1048576, MIN_BUFFER = 4096 };
+
+    struct Buffer {
+	char *data;
+	size_t length;
+	bool full;
+    };
+
+    bool _enabled;
+    bool _drop;
+    bool _running;
+    uint32_t _buffer_size;
+    uint32_t _nbuffers;
+
+    // producer state: _cur is the buffer being filled, [_pos, _end) its space
+    char *_pos;
+    char *_end;
+    int _cur;
+    counter_t _drops;
+    atomic_uint32_t _flush_due;	// set by the timer, cleared by append()
+
+    FILE *_f;
+    String _filename;
+    Element *_owner;
+    Vector<Buffer> _buffers;
+    int _next_write;		// writer: next buffer to write
+    int _nfull;
+    bool _stopping;
+    int _error;			// errno of the first failed write
+    bool _error_reported;
+
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t _full_cond;	// signaled when a buffer becomes full
+    pthread_cond_t _free_cond;	// signaled when a buffer becomes free
+
+    Timer _timer;
+
+    bool slow_append(const void *a, size_t alen, const void *b, size_t blen);
+    bool submit(bool block);
+    void wait_idle();
+    void write_direct(const void *a, size_t alen, const void *b, size_t blen);
+
+    static void *thread_hook(void *);
+    void run_thread();
+    static void timer_hook(Timer *, void *);
+    static String read_handler(Element *, void *);
+
+};
+
+inline bool
+AsyncWriter::append(const void *a, size_t alen, const void *b, size_t blen)
+{
+    if (likely((size_t) (_end - _pos) >= alen + blen && !_flush_due.value())) {
+	memcpy(_pos, a, alen);
+	if (blen)
+	    memcpy(_pos + alen, b, blen);
+	_pos += alen + blen;
+	return true;
+    } else
+	return slow_append(a, alen, b, blen);
+}
+
+CLICK_ENDDECLS
+#endif
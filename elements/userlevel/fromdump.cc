@@ -85,6 +85,7 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool per_node = false;
 #endif
     _packet_filepos = 0;
+    _burst = 1;
 
     if (_ff.configure_keywords(conf, this, errh) < 0)
 	return -1;
@@ -105,8 +106,11 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
 		     "PER_NODE", 0, cpBool, &per_node,
 #endif
 		     "FILEPOS", 0, cpFileOffset, &_packet_filepos,
+		     "BURST", 0, cpUnsigned, &_burst,
 		     cpEnd) < 0)
 	return -1;
+    if (_burst == 0)
+	return errh->error("BURST must be positive");
 
     // check sampling rate
     if (_sampling_prob > (1 << SAMPLING_SHIFT)) {
@@ -422,40 +426,43 @@ FromDump::run_task(Task *)
     if (!_active)
 	return false;
 
+    unsigned n = 0;
     int retry_count = 0;
-  again:
-    if (!_packet && !read_packet(0)) {
-	if (_end_h)
-	    _end_h->call_write(ErrorHandler::default_handler());
-	return false;
-    }
-    if (_packet && _timing) {
-	Timestamp now = Timestamp::now();
-	Timestamp t = _packet->timestamp_anno() + _time_offset;
-	if (now < t) {
-	    t -= Timer::adjustment();
-	    if (now < t)
-		_timer.schedule_at(t);
-	    else
-		_task.fast_reschedule();
-	    return false;
+    while (n < _burst && _active) {
+	if (!_packet && !read_packet(0)) {
+	    if (_end_h)
+		_end_h->call_write(ErrorHandler::default_handler());
+	    return n > 0;
 	}
-    }
-    if (_packet && _force_ip && !fake_pcap_force_ip(_packet, _linktype)) {
-	checked_output_push(1, _packet);
+	if (_packet && _timing) {
+	    Timestamp now = Timestamp::now();
+	    Timestamp t = _packet->timestamp_anno() + _time_offset;
+	    if (now < t) {
+		t -= Timer::adjustment();
+		if (now < t)
+		    _timer.schedule_at(t);
+		else
+		    _task.fast_reschedule();
+		return n > 0;
+	    }
+	}
+	if (_packet && _force_ip && !fake_pcap_force_ip(_packet, _linktype)) {
+	    checked_output_push(1, _packet);
+	    _packet = 0;
+	}
+	if (!_packet) {
+	    if (++retry_count < 16)
+		continue;
+	    break;
+	}
+	output(0).push(_packet);
+	_count++;
 	_packet = 0;
+	n++;
     }
-    if (!_packet && ++retry_count < 16)
-	goto again;
 
     _task.fast_reschedule();
-    if (_packet) {
-	output(0).push(_packet);
-	_count++;
-	_packet = 0;
-	return true;
-    } else
-	return false;
+    return n > 0;
 }
 
 Packet *
@@ -12,7 +12,7 @@ class HandlerCall;
 /*
 =c
 
-FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP])
+FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP, BURST])
 
 =s traces
 
@@ -104,9 +104,18 @@ FromDump will emit garbage.
 =item MMAP
 
 Boolean. If true, then FromDump will use mmap(2) to access the tcpdump file.
-This can result in slightly better performance on some machines. FromDump's
-regular file discipline is pretty optimized, so the difference is often small
-in practice. Default is true on most operating systems, but false on Linux.
+Emitted packets then point directly into the mapped file rather than into
+copies; their data is shared, and the first element to modify a packet makes a
+private copy of that packet alone.  (Packets from the regular file discipline
+share FromDump's read buffer in the same way.)  Such packets have no headroom,
+so prepending a header always copies.  Default is true on most operating
+systems.
+
+=item BURST
+
+Integer. When FromDump is used in push mode, it emits up to BURST packets each
+time its task runs. Larger bursts amortize scheduling overhead when replaying
+large traces. Default is 1.
 
 =back
 
@@ -228,6 +237,7 @@ class FromDump : public Element { public:
     bool _last_time_relative : 1;
     bool _last_time_interval : 1;
     bool _active;
+    unsigned _burst;
     unsigned _extra_pkthdr_crap;
     unsigned _sampling_prob;
     int _minor_version;
@@ -270,6 +270,7 @@ FromFile::read_line(String &result, ErrorHandler *errh, bool temporary)
 	// check doneness
 	bool done;
 	if (sa && sa.back() == '\r') {
+	    _pos = 0;
 	    if (_len > 0 && _buffer[0] == '\n')
 		sa << '\n', _pos++;
 	    done = true;
@@ -315,7 +316,7 @@ int
 FromFile::seek(off_t want, ErrorHandler* errh)
 {
     if (want >= _file_offset && want < (off_t) (_file_offset + _len)) {
-	_pos = want;
+	_pos = want - _file_offset;
 	return 0;
     }
 
@@ -323,7 +324,8 @@ FromFile::seek(off_t want, ErrorHandler* errh)
     if (_mmap) {
 	_mmap_off = (want / _mmap_unit) * _mmap_unit;
 	_pos = _len + want - _mmap_off;
-	return 0;
+	// map now, so that _pos is valid for read_line()
+	return (read_buffer(errh) < 0 ? -1 : 0);
     }
 #endif
 
@@ -387,6 +389,13 @@ FromFile::initialize(ErrorHandler *errh)
     return 0;
 }
 
+bool
+FromFile::direct() const
+{
+    // true iff file offsets are offsets into the named file
+    return _fd >= 0 && _fd != STDIN_FILENO && !_pipe;
+}
+
 void
 FromFile::take_state(FromFile &o, ErrorHandler *errh)
 {
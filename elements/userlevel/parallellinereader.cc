@@ -0,0 +1,280 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * parallellinereader.{cc,hh} -- parses line-oriented trace files on threads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "parallellinereader.hh"
+#include "fromfile.hh"
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/element.hh>
+#include <click/straccum.hh>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+CLICK_DECLS
+
+ParallelLineReader::ParallelLineReader()
+    : _nthreads(0), _chunk_size(DEFAULT_CHUNK), _running(false), _fd(-1),
+      _serial_pos(-1), _error(0), _bad(0)
+{
+}
+
+int
+ParallelLineReader::configure_keywords(Vector<String> &conf, Element *e, ErrorHandler *errh)
+{
+    if (cp_va_kparse_remove_keywords(conf, e, errh,
+		    "THREADS", 0, cpUnsigned, &_nthreads,
+		    "CHUNK", 0, cpUnsigned, &_chunk_size,
+		    cpEnd) < 0)
+	return -1;
+    if (_chunk_size < MIN_CHUNK)
+	return errh->error("CHUNK must be at least %d", MIN_CHUNK);
+    return 0;
+}
+
+void
+ParallelLineReader::clear_chunk(Chunk &c)
+{
+    c.packets.clear();
+    c.bad = 0;
+    c.serial_pos = -1;
+    c.error = 0;
+    c.done = false;
+}
+
+int
+ParallelLineReader::start(const FromFile &ff, ParseFunction parse, void *thunk, ErrorHandler *errh)
+{
+    // Standard input and decompressed files are read serially.
+    if (!_nthreads || _running || !ff.direct())
+	return 0;
+
+    struct stat statbuf;
+    _fd = open(ff.filename().c_str(), O_RDONLY);
+    if (_fd < 0)
+	return errh->error("%s: %s", ff.filename().c_str(), strerror(errno));
+    if (fstat(_fd, &statbuf) < 0 || !S_ISREG(statbuf.st_mode)
+	|| statbuf.st_size <= ff.file_pos()) {
+	close(_fd);
+	_fd = -1;
+	return 0;
+    }
+
+    _base = ff.file_pos();
+    _size = statbuf.st_size;
+    _parse = parse;
+    _thunk = thunk;
+    _nchunks = (_size - _base + _chunk_size - 1) / _chunk_size;
+    _chunks.resize(2 * _nthreads);
+    for (int i = 0; i < _chunks.size(); i++)
+	clear_chunk(_chunks[i]);
+    _claim = _consume = 0;
+    _consume_pos = 0;
+    _consume_ready = _stopping = false;
+    _serial_pos = -1;
+    _error = _bad = 0;
+
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_done_cond, 0);
+    pthread_cond_init(&_space_cond, 0);
+    _running = true;
+    for (uint32_t i = 0; i < _nthreads; i++) {
+	pthread_t t;
+	if (int r = pthread_create(&t, 0, thread_hook, this)) {
+	    stop();
+	    return errh->error("cannot start parser thread: %s", strerror(r));
+	}
+	_threads.push_back(t);
+    }
+    return 0;
+}
+
+void
+ParallelLineReader::stop()
+{
+    if (!_running)
+	return;
+
+    pthread_mutex_lock(&_lock);
+    _stopping = true;
+    pthread_cond_broadcast(&_space_cond);
+    pthread_mutex_unlock(&_lock);
+    for (int i = 0; i < _threads.size(); i++)
+	pthread_join(_threads[i], 0);
+    _threads.clear();
+
+    // packets already returned by next() are zeroed
+    for (int i = 0; i < _chunks.size(); i++) {
+	for (int j = 0; j < _chunks[i].packets.size(); j++)
+	    if (Packet *p = _chunks[i].packets[j])
+		p->kill();
+	clear_chunk(_chunks[i]);
+    }
+
+    pthread_cond_destroy(&_space_cond);
+    pthread_cond_destroy(&_done_cond);
+    pthread_mutex_destroy(&_lock);
+    close(_fd);
+    _fd = -1;
+    _running = false;
+}
+
+Packet *
+ParallelLineReader::next()
+{
+    if (!_running)
+	return 0;
+
+    while (_consume < _nchunks) {
+	Chunk &c = _chunks[_consume % _chunks.size()];
+	if (!_consume_ready) {
+	    pthread_mutex_lock(&_lock);
+	    while (!c.done)
+		pthread_cond_wait(&_done_cond, &_lock);
+	    pthread_mutex_unlock(&_lock);
+	    _consume_ready = true;
+	    _bad += c.bad;
+	}
+
+	if (_consume_pos < c.packets.size()) {
+	    Packet *p = c.packets[_consume_pos];
+	    c.packets[_consume_pos++] = 0;
+	    return p;
+	} else if (c.serial_pos >= 0 || c.error) {
+	    // the caller must continue serially, or stop
+	    _serial_pos = c.serial_pos;
+	    _error = c.error;
+	    return 0;
+	}
+
+	pthread_mutex_lock(&_lock);
+	clear_chunk(c);
+	_consume++;
+	_consume_pos = 0;
+	_consume_ready = false;
+	pthread_cond_broadcast(&_space_cond);
+	pthread_mutex_unlock(&_lock);
+    }
+
+    return 0;
+}
+
+void *
+ParallelLineReader::thread_hook(void *thunk)
+{
+    static_cast<ParallelLineReader *>(thunk)->run_thread();
+    return 0;
+}
+
+void
+ParallelLineReader::run_thread()
+{
+    pthread_mutex_lock(&_lock);
+    while (!_stopping && _claim < _nchunks) {
+	if (_claim >= _consume + _chunks.size()) {
+	    pthread_cond_wait(&_space_cond, &_lock);
+	    continue;
+	}
+	off_t k = _claim++;
+	Chunk &c = _chunks[k % _chunks.size()];
+	pthread_mutex_unlock(&_lock);
+
+	parse_chunk(k, c);
+
+	pthread_mutex_lock(&_lock);
+	c.done = true;
+	pthread_cond_broadcast(&_done_cond);
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+int
+ParallelLineReader::read_more(StringAccum &sa, off_t pos, size_t len)
+{
+    if (pos + (off_t) len > _size)
+	len = _size - pos;
+    char *x = sa.extend(len);
+    if (!x)
+	return ENOMEM;
+    while (len > 0) {
+	ssize_t got = pread(_fd, x, len, pos);
+	if (got > 0)
+	    x += got, pos += got, len -= got;
+	else if (got == 0) {	// file shrank
+	    sa.adjust_length(-(int) len);
+	    break;
+	} else if (errno != EINTR && errno != EAGAIN)
+	    return errno;
+    }
+    return 0;
+}
+
+// Returns the end of the line starting at p, or -1 if more data is needed.
+// Line ends match FromFile::read_line: "\n", "\r\n", or "\r".
+static int
+line_end(const char *buf, int p, int len, bool eof)
+{
+    while (p < len && buf[p] != '\n' && buf[p] != '\r')
+	p++;
+    if (p < len && (buf[p] == '\n' || p + 1 < len))
+	return p + (buf[p] == '\r' && buf[p+1] == '\n' ? 2 : 1);
+    else
+	return (eof ? len : -1);
+}
+
+void
+ParallelLineReader::parse_chunk(off_t k, Chunk &c)
+{
+    // This chunk owns the lines that start in [s, e).  For k > 0, read from
+    // s - 1 to tell whether a line starts at s.
+    off_t s = _base + k * _chunk_size;
+    off_t e = (_size - s > (off_t) _chunk_size ? s + _chunk_size : _size);
+    off_t rs = (k ? s - 1 : s);
+    StringAccum sa;
+    if ((c.error = read_more(sa, rs, e - rs)))
+	return;
+
+    int limit = e - rs;
+    int p = 0;
+    bool first = (k != 0);
+    while (p < limit) {
+	int q = line_end(sa.data(), p, sa.length(), rs + sa.length() >= _size);
+	if (q < 0) {
+	    if ((c.error = read_more(sa, rs + sa.length(), EXTEND)))
+		return;
+	    continue;
+	}
+	if (first)		// the end of a line owned by an earlier chunk
+	    first = false;
+	else {
+	    Packet *packet = 0;
+	    int r = _parse(String::make_stable(sa.data() + p, q - p), &packet, _thunk);
+	    if (r == LINE_PACKET && packet)
+		c.packets.push_back(packet);
+	    else if (r == LINE_BAD)
+		c.bad++;
+	    else if (r == LINE_SERIAL) {
+		c.serial_pos = rs + p;
+		return;
+	    }
+	}
+	p = q;
+    }
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel FromFile)
+ELEMENT_PROVIDES(ParallelLineReader)
+ELEMENT_LIBS(-lpthread)
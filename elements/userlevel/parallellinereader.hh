@@ -0,0 +1,100 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PARALLELLINEREADER_HH
+#define CLICK_PARALLELLINEREADER_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <pthread.h>
+#include <sys/types.h>
+CLICK_DECLS
+class ErrorHandler;
+class StringAccum;
+class Element;
+class Packet;
+class FromFile;
+
+/*
+ * ParallelLineReader parses a line-oriented trace file on worker threads.
+ * The rest of the file, from a FromFile's current position, is split into
+ * CHUNK-byte pieces; each worker claims the next piece, parses the lines
+ * that start in it with the element's parse function, and stores the
+ * resulting packets.  next() returns those packets in file order, so the
+ * element emits exactly the packets that serial parsing would.  At most
+ * two chunks per thread are parsed ahead of the consumer.
+ *
+ * The parse function runs on worker threads, and must only read element
+ * state.  A line that would change parsing state (such as a new '!data'
+ * line) returns LINE_SERIAL; next() then returns the packets before that
+ * line, and the element continues serially from serial_pos().
+ *
+ * Elements using ParallelLineReader accept the keywords THREADS and CHUNK;
+ * see FromIPSummaryDump's documentation.
+ */
+
+class ParallelLineReader { public:
+
+    enum { LINE_SKIP = 0, LINE_PACKET, LINE_BAD, LINE_SERIAL };
+    typedef int (*ParseFunction)(const String &line, Packet **, void *thunk);
+
+    ParallelLineReader();
+    ~ParallelLineReader()		{ stop(); }
+
+    bool enabled() const		{ return _nthreads > 0; }
+    bool running() const		{ return _running; }
+
+    int configure_keywords(Vector<String> &conf, Element *, ErrorHandler *);
+    int start(const FromFile &ff, ParseFunction parse, void *thunk, ErrorHandler *);
+    void stop();
+
+    Packet *next();
+    off_t serial_pos() const		{ return _serial_pos; }
+    int error() const			{ return _error; }
+    int take_bad_lines()		{ int b = _bad; _bad = 0; return b; }
+
+  private:
+
+    enum { DEFAULT_CHUNK = 262144, MIN_CHUNK = 4096, EXTEND = 65536 };
+
+    struct Chunk {
+	Vector<Packet *> packets;
+	int bad;
+	off_t serial_pos;	// offset of a LINE_SERIAL line, or -1
+	int error;		// errno of a failed read
+	bool done;
+    };
+
+    uint32_t _nthreads;
+    uint32_t _chunk_size;
+    bool _running;
+
+    int _fd;
+    off_t _base;
+    off_t _size;
+    ParseFunction _parse;
+    void *_thunk;
+
+    Vector<Chunk> _chunks;	// chunk k is in _chunks[k % _chunks.size()]
+    off_t _nchunks;
+    off_t _claim;		// workers: next chunk to parse
+    off_t _consume;		// consumer: chunk being returned
+    int _consume_pos;
+    bool _consume_ready;
+    bool _stopping;
+    off_t _serial_pos;
+    int _error;
+    int _bad;
+
+    Vector<pthread_t> _threads;
+    pthread_mutex_t _lock;
+    pthread_cond_t _done_cond;	// signaled when a chunk is parsed
+    pthread_cond_t _space_cond;	// signaled when a chunk slot is freed
+
+    static void *thread_hook(void *);
+    void run_thread();
+    void parse_chunk(off_t k, Chunk &c);
+    int read_more(StringAccum &sa, off_t pos, size_t len);
+    void clear_chunk(Chunk &c);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -53,7 +53,8 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool per_node = false;
 #endif
 
-    if (cp_va_kparse(conf, this, errh,
+    if (_writer.configure_keywords(conf, this, errh) < 0
+	|| cp_va_kparse(conf, this, errh,
 		     "FILENAME", cpkP+cpkM, cpFilename, &_filename,
 		     "SNAPLEN", cpkP, cpUnsigned, &_snaplen,
 		     "ENCAP", cpkP, cpWord, &encap_type,
@@ -168,6 +169,8 @@ ToDump::initialize(ErrorHandler *errh)
 	size_t wrote_header = fwrite(&h, sizeof(h), 1, _fp);
 	if (wrote_header != 1)
 	    return errh->error("%s: unable to write file header", _filename.c_str());
+	if (_writer.start(_fp, _filename, this, errh) < 0)
+	    return -1;
     }
 
     if (input_is_pull(0) && noutputs() == 0) {
@@ -179,16 +182,19 @@ ToDump::initialize(ErrorHandler *errh)
 }
 
 void
-ToDump::take_state(Element *e, ErrorHandler *)
+ToDump::take_state(Element *e, ErrorHandler *errh)
 {
     ToDump *td = static_cast<ToDump *>(e); // result of hotswap_element()
+    td->_writer.stop();
     _fp = td->_fp;
     td->_fp = 0;
+    _writer.start(_fp, _filename, this, errh);
 }
 
 void
 ToDump::cleanup(CleanupStage)
 {
+    _writer.stop();
     if (_fp && _fp != stdout)
 	fclose(_fp);
     _fp = 0;
@@ -215,6 +221,12 @@ ToDump::write_packet(Packet *p)
 	to_write = _snaplen;
     ph.caplen = to_write;
 
+    if (_writer.running()) {
+	if (_writer.append(&ph, sizeof(ph), p->data(), to_write))
+	    _count++;
+	return;
+    }
+
     // XXX writing to pipe?
     if (fwrite(&ph, sizeof(ph), 1, _fp) == 0
 	|| fwrite(p->data(), 1, to_write, _fp) == 0) {
@@ -288,10 +300,11 @@ ToDump::add_handlers()
     add_read_handler("filename", read_handler, (void *)H_FILENAME);
     add_read_handler("count", read_handler, (void *)H_COUNT);
     add_write_handler("reset_counts", write_handler, (void *)H_RESET_COUNTS, Handler::BUTTON);
+    _writer.add_handlers(this);
     if (input_is_pull(0) && noutputs() == 0)
 	add_task_handlers(&_task);
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel|ns FakePcap)
+ELEMENT_REQUIRES(userlevel|ns FakePcap AsyncWriter)
 EXPORT_ELEMENT(ToDump)
@@ -5,13 +5,14 @@
 #include <click/element.hh>
 #include <click/task.hh>
 #include <click/notifier.hh>
+#include "asyncwriter.hh"
 #include <stdio.h>
 CLICK_DECLS
 
 /*
 =c
 
-ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH])
+ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH, ASYNC, ...])
 
 =s traces
 
@@ -60,6 +61,31 @@ USE_ENCAP_FROM. FromDump and FromDevice.u have `encap' handlers.
 Boolean. Set to true if you want ToDump to store any extra length as recorded
 in packets' extra length annotations. Default is true.
 
+=item ASYNC
+
+Boolean. If true, ToDump copies each packet record into a large in-memory
+buffer and a separate writer thread writes full buffers to the file, so the
+element never waits for the disk unless every buffer is full.  Buffers are
+also handed to the writer once a second; with several threads, a partly
+filled buffer waits for the next packet.  Default is false.
+
+=item ASYNC_BUFFER
+
+Unsigned. Size of each output buffer in bytes when ASYNC is true. Default is
+1048576 (1 MB).
+
+=item ASYNC_NBUFFERS
+
+Unsigned. Number of output buffers when ASYNC is true, at least 2. Default
+is 2.
+
+=item ASYNC_DROP
+
+Boolean. Determines what happens when ASYNC is true and every buffer is
+waiting to be written. If false, ToDump waits for the writer thread; if true,
+it drops the packet's record (the packet itself is still emitted) and counts
+it in the "drops" handler. Default is false.
+
 =back
 
 This element is only available at user level.
@@ -76,6 +102,11 @@ Returns the number of packets emitted so far.
 
 Resets "count" to 0.
 
+=h drops read-only
+
+Returns the number of packet records dropped because ASYNC_DROP was true and
+the output buffers were full.
+
 =h filename read-only
 
 Returns the filename.
@@ -115,6 +146,7 @@ class ToDump : public Element { public:
     int _linktype;
     bool _active;
     bool _extra_length;
+    AsyncWriter _writer;
 
 #if HAVE_INT64_TYPES
     typedef uint64_t counter_t;
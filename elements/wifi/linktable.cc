@@ -21,13 +21,15 @@
 #include <click/confparse.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/algorithm.hh>
 #include <elements/wifi/path.hh>
 #include <click/straccum.hh>
 CLICK_DECLS
 
 LinkTable::LinkTable()
-  : _timer(this)
+  : _timer(this), _root(-1), _graph_valid(false), _incremental(true)
 {
+  _spf[0]._valid = _spf[1]._valid = false;
 }
 
 
@@ -49,8 +51,8 @@ void
 LinkTable::run_timer(Timer *)
 {
   clear_stale();
-  dijkstra(true);
-  dijkstra(false);
+  dijkstra(true, _incremental);
+  dijkstra(false, _incremental);
   _timer.schedule_after_msec(5000);
 }
 void *
@@ -69,6 +71,7 @@ LinkTable::configure (Vector<String> &conf, ErrorHandler *errh)
   ret = cp_va_kparse(conf, this, errh,
 		     "IP", 0, cpIPAddress, &_ip,
 		     "STALE", 0, cpUnsigned, &stale_period,
+		     "INCREMENTAL", 0, cpBool, &_incremental,
 		     cpEnd);
 
   if (!_ip)
@@ -88,6 +91,7 @@ LinkTable::take_state(Element *e, ErrorHandler *) {
 
   _hosts = q->_hosts;
   _links = q->_links;
+  _graph_valid = false;
   dijkstra(true);
   dijkstra(false);
 }
@@ -138,7 +142,8 @@ LinkTable::clear()
 {
   _hosts.clear();
   _links.clear();
-
+  _hosts.insert(_ip, HostInfo(_ip));
+  _graph_valid = false;
 }
 bool
 LinkTable::update_link(IPAddress from, IPAddress to,
@@ -157,11 +162,13 @@ LinkTable::update_link(IPAddress from, IPAddress to,
     HostInfo foo = HostInfo(from);
     _hosts.insert(from, foo);
     nfrom = _hosts.findp(from);
+    _graph_valid = false;
   }
   HostInfo *nto = _hosts.findp(to);
   if (!nto) {
     _hosts.insert(to, HostInfo(to));
     nto = _hosts.findp(to);
+    _graph_valid = false;
   }
 
   assert(nfrom);
@@ -171,12 +178,38 @@ LinkTable::update_link(IPAddress from, IPAddress to,
   LinkInfo *lnfo = _links.findp(p);
   if (!lnfo) {
     _links.insert(p, LinkInfo(from, to, seq, age, metric));
+    _graph_valid = false;
   } else {
+    unsigned old_metric = lnfo->_metric;
     lnfo->update(seq, age, metric);
+    if (lnfo->_metric != old_metric) {
+      link_metric_changed(lnfo);
+    }
   }
   return true;
 }
 
+void
+LinkTable::link_metric_changed(const LinkInfo *lnfo)
+{
+  if (!_graph_valid) {
+    return;
+  }
+  if (lnfo->_edge < 0) {
+    _graph_valid = false;
+    return;
+  }
+  _edge_metric[lnfo->_edge] = lnfo->_metric;
+  for (int d = 0; d < 2; d++) {
+    SPFTree &t = _spf[d];
+    if (t._valid && t._changed.size() < _edge_metric.size()) {
+      t._changed.push_back(lnfo->_edge);
+    } else {
+      t._valid = false;
+    }
+  }
+}
+
 
 LinkTable::Link
 LinkTable::random_link()
@@ -477,6 +510,9 @@ LinkTable::clear_stale() {
       }
     }
   }
+  if (links.size() != _links.size()) {
+    _graph_valid = false;
+  }
   _links.clear();
 
   for (LTIter iter = links.begin(); iter.live(); iter++) {
@@ -512,11 +548,14 @@ LinkTable::get_neighbors(IPAddress ip)
 
   return neighbors;
 }
+/* The original O(V^2) computation, kept as a reference for testing and
+ * benchmarks. */
 void
-LinkTable::dijkstra(bool from_me)
+LinkTable::dijkstra_reference(bool from_me)
 {
   Timestamp start = Timestamp::now();
   IPAddress src = _ip;
+  _spf[from_me]._valid = false;
 
   typedef HashMap<IPAddress, bool> IPMap;
   IPMap ip_addrs;
@@ -624,6 +663,251 @@ LinkTable::dijkstra(bool from_me)
   //click_chatter("%s: %s\n", name().c_str(), sa.take_string().c_str());
 }
 
+void
+LinkTable::build_graph()
+{
+  _node_ip.clear();
+  for (HTable::iterator iter = _hosts.begin(); iter.live(); iter++) {
+    iter.value()._index = _node_ip.size();
+    _node_ip.push_back(iter.key());
+  }
+  HostInfo *root_info = _hosts.findp(_ip);
+  _root = (root_info ? root_info->_index : -1);
+
+  _edge_from.clear();
+  _edge_to.clear();
+  _edge_metric.clear();
+  for (LTable::iterator iter = _links.begin(); iter.live(); iter++) {
+    LinkInfo &l = iter.value();
+    HostInfo *from = _hosts.findp(l._from);
+    HostInfo *to = _hosts.findp(l._to);
+    if (!from || !to || !l._metric) {
+      l._edge = -1;
+      continue;
+    }
+    l._edge = _edge_metric.size();
+    _edge_from.push_back(from->_index);
+    _edge_to.push_back(to->_index);
+    _edge_metric.push_back(l._metric);
+  }
+
+  int n = _node_ip.size();
+  for (int d = 0; d < 2; d++) {
+    const Vector<int> &tail = (d ? _edge_from : _edge_to);
+    Adjacency &adj = _adj[d];
+    adj._start.assign(n + 1, 0);
+    for (int e = 0; e < tail.size(); e++) {
+      adj._start[tail[e] + 1]++;
+    }
+    for (int i = 0; i < n; i++) {
+      adj._start[i + 1] += adj._start[i];
+    }
+    Vector<int> pos(adj._start);
+    adj._edge.resize(tail.size());
+    for (int e = 0; e < tail.size(); e++) {
+      adj._edge[pos[tail[e]]++] = e;
+    }
+    _spf[d]._valid = false;
+  }
+  _graph_valid = true;
+}
+
+/* Settle the nodes in heap in metric order, relaxing the edges the
+ * search leaves each node by.  Nodes whose metric changes are appended
+ * to touched. */
+void
+LinkTable::spf_run(bool from_me, Vector<SPFEntry> &heap, Vector<int> *touched)
+{
+  SPFTree &t = _spf[from_me];
+  const Adjacency &adj = _adj[from_me];
+  const Vector<int> &head = (from_me ? _edge_to : _edge_from);
+  less<SPFEntry> comp;
+
+  while (heap.size()) {
+    pop_heap(heap.begin(), heap.end(), comp);
+    SPFEntry x = heap.back();
+    heap.pop_back();
+    int u = x.second;
+    if (x.first != t._metric[u]) {
+      continue;			// superseded by a shorter path
+    }
+    const int *eend = adj._edge.begin() + adj._start[u + 1];
+    for (const int *ep = adj._edge.begin() + adj._start[u]; ep != eend; ep++) {
+      int v = head[*ep];
+      uint32_t metric = x.first + _edge_metric[*ep];
+      if (t._prev[v] < 0 || metric < t._metric[v]) {
+	t._metric[v] = metric;
+	t._prev[v] = u;
+	if (touched) {
+	  touched->push_back(v);
+	}
+	heap.push_back(SPFEntry(metric, v));
+	push_heap(heap.begin(), heap.end(), comp);
+      }
+    }
+  }
+}
+
+void
+LinkTable::spf_full(bool from_me)
+{
+  SPFTree &t = _spf[from_me];
+  int n = _node_ip.size();
+  t._metric.assign(n, 0);
+  t._prev.assign(n, -1);
+  t._changed.clear();
+  t._prev[_root] = _root;
+
+  Vector<SPFEntry> heap;
+  heap.push_back(SPFEntry(0, _root));
+  spf_run(from_me, heap, 0);
+  t._valid = true;
+}
+
+/* Update the tree for the edges in _changed.  An edge whose metric rose
+ * can only lengthen paths through it, so if it is a tree edge, the
+ * subtree below it is cleared and recomputed from its neighbors outside
+ * the subtree.  An edge whose metric fell can only shorten paths, so a
+ * search is started from the node it leads to if that node got closer. */
+void
+LinkTable::spf_incremental(bool from_me, Vector<int> &touched)
+{
+  SPFTree &t = _spf[from_me];
+  const Vector<int> &tail = (from_me ? _edge_from : _edge_to);
+  const Vector<int> &head = (from_me ? _edge_to : _edge_from);
+  int n = _node_ip.size();
+  less<SPFEntry> comp;
+  Vector<SPFEntry> heap;
+
+  Vector<int> stack;
+  for (const int *ep = t._changed.begin(); ep != t._changed.end(); ep++) {
+    int u = tail[*ep], v = head[*ep];
+    if (u != v && t._prev[v] == u
+	&& t._metric[u] + _edge_metric[*ep] > t._metric[v]) {
+      stack.push_back(v);
+    }
+  }
+
+  if (stack.size()) {
+    Vector<int> child_start(n + 1, 0);
+    Vector<int> children(n, 0);
+    for (int i = 0; i < n; i++) {
+      if (t._prev[i] >= 0 && i != _root) {
+	child_start[t._prev[i] + 1]++;
+      }
+    }
+    for (int i = 0; i < n; i++) {
+      child_start[i + 1] += child_start[i];
+    }
+    Vector<int> pos(child_start);
+    for (int i = 0; i < n; i++) {
+      if (t._prev[i] >= 0 && i != _root) {
+	children[pos[t._prev[i]]++] = i;
+      }
+    }
+
+    Vector<uint8_t> cleared(n, 0);
+    Vector<int> subtree;
+    while (stack.size()) {
+      int v = stack.back();
+      stack.pop_back();
+      if (cleared[v]) {
+	continue;
+      }
+      cleared[v] = 1;
+      subtree.push_back(v);
+      for (int c = child_start[v]; c < child_start[v + 1]; c++) {
+	stack.push_back(children[c]);
+      }
+    }
+
+    for (const int *vp = subtree.begin(); vp != subtree.end(); vp++) {
+      t._prev[*vp] = -1;
+      t._metric[*vp] = 0;
+      touched.push_back(*vp);
+    }
+
+    const Adjacency &in = _adj[!from_me];
+    for (const int *vp = subtree.begin(); vp != subtree.end(); vp++) {
+      int v = *vp;
+      for (int i = in._start[v]; i < in._start[v + 1]; i++) {
+	int e = in._edge[i];
+	int u = tail[e];
+	if (cleared[u] || t._prev[u] < 0) {
+	  continue;
+	}
+	uint32_t metric = t._metric[u] + _edge_metric[e];
+	if (t._prev[v] < 0 || metric < t._metric[v]) {
+	  t._metric[v] = metric;
+	  t._prev[v] = u;
+	}
+      }
+      if (t._prev[v] >= 0) {
+	heap.push_back(SPFEntry(t._metric[v], v));
+	push_heap(heap.begin(), heap.end(), comp);
+      }
+    }
+    spf_run(from_me, heap, &touched);
+  }
+
+  for (const int *ep = t._changed.begin(); ep != t._changed.end(); ep++) {
+    int u = tail[*ep], v = head[*ep];
+    uint32_t metric = t._metric[u] + _edge_metric[*ep];
+    if (t._prev[u] >= 0 && (t._prev[v] < 0 || metric < t._metric[v])) {
+      t._metric[v] = metric;
+      t._prev[v] = u;
+      touched.push_back(v);
+      heap.push_back(SPFEntry(metric, v));
+      push_heap(heap.begin(), heap.end(), comp);
+    }
+  }
+  spf_run(from_me, heap, &touched);
+  t._changed.clear();
+}
+
+void
+LinkTable::spf_store(bool from_me, int i)
+{
+  const SPFTree &t = _spf[from_me];
+  HostInfo *nfo = _hosts.findp(_node_ip[i]);
+  IPAddress prev = (t._prev[i] >= 0 ? _node_ip[t._prev[i]] : IPAddress());
+  if (from_me) {
+    nfo->_metric_from_me = t._metric[i];
+    nfo->_prev_from_me = prev;
+    nfo->_marked_from_me = (t._prev[i] >= 0);
+  } else {
+    nfo->_metric_to_me = t._metric[i];
+    nfo->_prev_to_me = prev;
+    nfo->_marked_to_me = (t._prev[i] >= 0);
+  }
+}
+
+void
+LinkTable::dijkstra(bool from_me, bool incremental)
+{
+  Timestamp start = Timestamp::now();
+
+  if (!_graph_valid) {
+    build_graph();
+  }
+  if (_root >= 0) {
+    if (incremental && _spf[from_me]._valid) {
+      Vector<int> touched;
+      spf_incremental(from_me, touched);
+      for (const int *ip = touched.begin(); ip != touched.end(); ip++) {
+	spf_store(from_me, *ip);
+      }
+    } else {
+      spf_full(from_me);
+      for (int i = 0; i < _node_ip.size(); i++) {
+	spf_store(from_me, i);
+      }
+    }
+  }
+
+  dijkstra_time = Timestamp::now() - start;
+}
+
 
 enum {H_BLACKLIST,
       H_BLACKLIST_CLEAR,
@@ -694,7 +978,10 @@ LinkTable_write_param(const String &in_s, Element *e, void *vparam,
     break;
   }
   case H_CLEAR: f->clear(); break;
-  case H_DIJKSTRA: f->dijkstra(true); f->dijkstra(false); break;
+  case H_DIJKSTRA:
+    f->dijkstra(true, f->incremental());
+    f->dijkstra(false, f->incremental());
+    break;
   }
   return 0;
 }
@@ -6,18 +6,26 @@
 #include <click/element.hh>
 #include <click/bighashmap.hh>
 #include <click/hashmap.hh>
+#include <click/pair.hh>
 #include "path.hh"
 CLICK_DECLS
 
 /*
  * =c
- * LinkTable(IP Address, [STALE timeout])
+ * LinkTable(IP Address, [STALE timeout, INCREMENTAL bool])
  * =s Wifi
  * Keeps a Link state database and calculates Weighted Shortest Path
  * for other elements
  * =d
  * Runs dijkstra's algorithm occasionally.
- * =a ARPTable
+ *
+ * The shortest paths are computed with a binary heap over a dense copy of
+ * the link graph, which is rebuilt only when hosts or links are added or
+ * removed.  If INCREMENTAL is true (the default), a run after links have
+ * only changed metric recomputes just the part of each shortest path tree
+ * that the changes affect.  The dijkstra_time handler reports how long the
+ * last run took.  Writing the dijkstra handler runs it immediately.
+ * =a ARPTable, LinkTableBenchmark
  *
  */
 class IPPair {
@@ -93,7 +101,8 @@ public:
   bool valid_route(const Vector<IPAddress> &route);
   unsigned get_route_metric(const Vector<IPAddress> &route);
   Vector<IPAddress> get_neighbors(IPAddress ip);
-  void dijkstra(bool);
+  void dijkstra(bool from_me, bool incremental = true);
+  void dijkstra_reference(bool from_me);
   void clear_stale();
   Vector<IPAddress> best_route(IPAddress dst, bool from_me);
 
@@ -101,6 +110,8 @@ public:
   uint32_t get_host_metric_to_me(IPAddress s);
   uint32_t get_host_metric_from_me(IPAddress s);
   Vector<IPAddress> get_hosts();
+  IPAddress ip() const { return _ip; }
+  bool incremental() const { return _incremental; }
 
   class Link {
   public:
@@ -135,12 +146,14 @@ protected:
     uint32_t _seq;
     uint32_t _age;
     Timestamp _last_updated;
+    int _edge;
     LinkInfo() {
       _from = IPAddress();
       _to = IPAddress();
       _metric = 0;
       _seq = 0;
       _age = 0;
+      _edge = -1;
     }
 
     LinkInfo(IPAddress from, IPAddress to,
@@ -151,13 +164,15 @@ protected:
       _seq = seq;
       _age = age;
       _last_updated.assign_now();
+      _edge = -1;
     }
 
     LinkInfo(const LinkInfo &p) :
       _from(p._from), _to(p._to),
       _metric(p._metric), _seq(p._seq),
       _age(p._age),
-      _last_updated(p._last_updated)
+      _last_updated(p._last_updated),
+      _edge(p._edge)
     { }
 
     uint32_t age() {
@@ -188,6 +203,8 @@ protected:
     bool _marked_from_me;
     bool _marked_to_me;
 
+    int _index;
+
     HostInfo(IPAddress p) {
       _ip = p;
       _metric_from_me = 0;
@@ -196,6 +213,7 @@ protected:
       _prev_to_me = IPAddress();
       _marked_from_me = false;
       _marked_to_me = false;
+      _index = -1;
     }
     HostInfo() {
       HostInfo(IPAddress());
@@ -208,7 +226,8 @@ protected:
       _prev_from_me(p._prev_from_me),
       _prev_to_me(p._prev_to_me),
       _marked_from_me(p._marked_from_me),
-      _marked_to_me(p._marked_to_me)
+      _marked_to_me(p._marked_to_me),
+      _index(p._index)
     { }
 
     void clear(bool from_me) {
@@ -239,6 +258,44 @@ protected:
   IPAddress _ip;
   Timestamp _stale_timeout;
   Timer _timer;
+
+  /* dijkstra() runs on a dense copy of the graph.  Edge e goes from node
+   * _edge_from[e] to node _edge_to[e].  _adj[true] lists each node's
+   * edges by source and _adj[false] by destination, so a search from me
+   * leaves a node by _adj[true] and a search to me by _adj[false]. */
+  struct Adjacency {
+    Vector<int> _start;		// node i's edges: _edge[_start[i].._start[i+1])
+    Vector<int> _edge;
+  };
+
+  /* A shortest path tree, rooted at _root.  An unreached node has
+   * _prev -1 and _metric 0.  _changed lists edges whose metric changed
+   * since the tree was computed. */
+  struct SPFTree {
+    Vector<uint32_t> _metric;
+    Vector<int> _prev;
+    Vector<int> _changed;
+    bool _valid;
+  };
+
+  typedef Pair<uint32_t, int> SPFEntry;
+
+  Vector<IPAddress> _node_ip;
+  Vector<int> _edge_from;
+  Vector<int> _edge_to;
+  Vector<uint32_t> _edge_metric;
+  Adjacency _adj[2];
+  SPFTree _spf[2];
+  int _root;
+  bool _graph_valid;
+  bool _incremental;
+
+  void build_graph();
+  void link_metric_changed(const LinkInfo *);
+  void spf_full(bool from_me);
+  void spf_incremental(bool from_me, Vector<int> &touched);
+  void spf_run(bool from_me, Vector<SPFEntry> &heap, Vector<int> *touched);
+  void spf_store(bool from_me, int i);
 };
 
 
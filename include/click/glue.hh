@@ -294,6 +294,41 @@ typedef struct device net_device;
 #define static_assert(x) switch (x) case 0: case !!(x):
 
 
+// PREFETCHING AND MEMORY ORDERING
+// click_prefetch0(p) hints that the cache line containing p will soon be
+// read.  It never faults, so p may be any address.
+
+#if __GNUC__ >= 3
+# define click_prefetch0(p)	__builtin_prefetch((p), 0, 3)
+#else
+# define click_prefetch0(p)	((void) (p))
+#endif
+
+// click_write_fence() keeps earlier stores from becoming visible after later
+// ones.  Call it before publishing a pointer to freshly written data that
+// other processors read without locking.
+
+#if defined(__i386__) || defined(__x86_64__)
+# define click_write_fence()	asm volatile ("" : : : "memory")
+#elif __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1)
+# define click_write_fence()	__sync_synchronize()
+#else
+# define click_write_fence()	asm volatile ("" : : : "memory")
+#endif
+
+// click_read_fence() keeps earlier loads from being satisfied after later
+// ones.  Readers of data published with click_write_fence() call it between
+// loading a version or pointer and loading the data it guards.
+
+#if defined(__i386__) || defined(__x86_64__)
+# define click_read_fence()	asm volatile ("" : : : "memory")
+#elif __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1)
+# define click_read_fence()	__sync_synchronize()
+#else
+# define click_read_fence()	asm volatile ("" : : : "memory")
+#endif
+
+
 // PROCESSOR IDENTITIES
 
 #if CLICK_LINUXMODULE
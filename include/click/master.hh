@@ -14,6 +14,11 @@
 # elif (!HAVE_SYS_EVENT_H || !HAVE_KQUEUE) && HAVE_USE_KQUEUE
 #  error "--enable-select=kqueue is not supported on this system"
 # endif
+# if HAVE_SYS_EPOLL_H && HAVE_EPOLL_CREATE && !HAVE_USE_SELECT && !HAVE_USE_POLL && !HAVE_USE_KQUEUE && !defined(HAVE_USE_EPOLL)
+#  define HAVE_USE_EPOLL 1
+# elif (!HAVE_SYS_EPOLL_H || !HAVE_EPOLL_CREATE) && HAVE_USE_EPOLL
+#  error "--enable-select=epoll is not supported on this system"
+# endif
 #endif
 #if CLICK_NS
 # include <click/simclick.h>
@@ -58,6 +63,13 @@ class Master { public:
 
     void kill_router(Router*);
 
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    bool work_stealing() const			{ return _work_stealing; }
+    void set_work_stealing(bool work_stealing)	{ _work_stealing = work_stealing; }
+#endif
+
+    bool synchronize_threads();
+
 #if CLICK_NS
     void initialize_ns(simclick_node_t *simnode);
     simclick_node_t *simnode() const		{ return _simnode; }
@@ -98,6 +110,9 @@ class Master { public:
 
     // THREADS
     Vector<RouterThread*> _threads;
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    bool _work_stealing;
+#endif
 
     // DRIVERMANAGER
     volatile int _stopper;
@@ -114,7 +129,16 @@ class Master { public:
     unsigned _max_timer_stride;
     unsigned _timer_stride;
     unsigned _timer_count;
-    Vector<Timer *> _timer_heap;
+    struct heap_element {
+	Timestamp expiry;
+	Timer *t;
+	heap_element() {
+	}
+	heap_element(Timer *t_)
+	    : expiry(t_->_expiry), t(t_) {
+	}
+    };
+    Vector<heap_element> _timer_heap;
     Vector<Timer *> _timer_runchunk;
 #if CLICK_LINUXMODULE
     spinlock_t _timer_lock;
@@ -132,24 +156,29 @@ class Master { public:
 
     void set_timer_expiry() {
 	if (_timer_heap.size())
-	    _timer_expiry = _timer_heap.at_u(0)->_expiry;
+	    _timer_expiry = _timer_heap.at_u(0).expiry;
 	else
 	    _timer_expiry = Timestamp();
     }
     void check_timer_expiry(Timer *t);
 
+    // The heap stores each timer's expiry alongside the timer pointer, so
+    // comparisons during a sift don't touch the Timer objects themselves.
+    // The stored expiry may be earlier than the timer's real expiry: pushing
+    // a scheduled timer later is lazy, and run_timers() re-sifts it once the
+    // stale key reaches the top.
     struct timer_less {
-	bool operator()(Timer *a, Timer *b) {
-	    return a->expiry() < b->expiry();
+	bool operator()(const heap_element &a, const heap_element &b) {
+	    return a.expiry < b.expiry;
 	}
     };
     struct timer_place {
-	Timer **_begin;
-	timer_place(Timer **begin)
+	heap_element *_begin;
+	timer_place(heap_element *begin)
 	    : _begin(begin) {
 	}
-	void operator()(Timer **t) {
-	    (*t)->_schedpos1 = (t - _begin) + 1;
+	void operator()(heap_element *t) {
+	    t->t->_schedpos1 = (t - _begin) + 1;
 	}
     };
 
@@ -173,6 +202,9 @@ class Master { public:
     int _kqueue;
     unsigned _selected_callno;
 # endif
+# if HAVE_USE_EPOLL
+    int _epoll;
+# endif
 # if !HAVE_POLL_H || HAVE_USE_SELECT
     struct pollfd {
 	int fd;
@@ -193,6 +225,9 @@ class Master { public:
 # if HAVE_USE_KQUEUE
     void run_selects_kqueue(bool);
 # endif
+# if HAVE_USE_EPOLL
+    void run_selects_epoll(bool);
+# endif
 # if HAVE_POLL_H && !HAVE_USE_SELECT
     void run_selects_poll(bool);
 # else
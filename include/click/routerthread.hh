@@ -75,6 +75,17 @@ class RouterThread
 
     inline void wake();
 
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    // Work stealing statistics; see Master::set_work_stealing().
+    uint32_t steals() const		{ return _steals; }
+    uint32_t steal_attempts() const	{ return _steal_attempts; }
+    uint32_t idle_count() const		{ return _idle_count; }
+
+    // Incremented each time the driver loop starts over and after each task
+    // runs; see Master::synchronize_threads().
+    uint32_t quiescent_epoch() const	{ return _quiescent_epoch; }
+#endif
+
 #if CLICK_DEBUG_SCHEDULING
     enum { S_RUNNING, S_PAUSED, S_TIMER, S_BLOCKED };
     int thread_state() const		{ return _thread_state; }
@@ -116,6 +127,14 @@ class RouterThread
     bool _greedy;
 #endif
 
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    volatile bool _idle;
+    uint32_t _steals;
+    uint32_t _steal_attempts;
+    uint32_t _idle_count;
+    volatile uint32_t _quiescent_epoch;
+#endif
+
 #if CLICK_BSDMODULE
     // XXX FreeBSD
     u_int64_t _old_tsc; /* MARKO - temp. */
@@ -167,6 +186,10 @@ class RouterThread
 #endif
 #if HAVE_TASK_HEAP
     void task_reheapify_from(int pos, Task*);
+#endif
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    bool steal_task();
+    void wake_idle_thread();
 #endif
     inline bool current_thread_is_running() const;
 
@@ -141,9 +141,9 @@ class Timer { public:
      * @param delta interval until expiration time
      *
      * The schedule_after methods schedule the timer relative to the current
-     * system time, Timestamp::now().  When called from a timer's callback
-     * function, this will usually be slightly after the timer's nominal
-     * expiration time.  To schedule a timer at a strict interval,
+     * system time, as approximated by Timestamp::recent().  When called from
+     * a timer's callback function, this will usually be slightly after the
+     * timer's nominal expiration time.  To schedule a timer at a strict interval,
      * compensating for small amounts of drift, use the reschedule_after
      * methods. */
     void schedule_after(const Timestamp &delta);
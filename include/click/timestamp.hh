@@ -56,6 +56,16 @@ class String;
 #endif
 
 
+// Timestamp::recent() returns a cached value in single-threaded user-level
+// drivers, where the RouterThread loop can refresh it without locking.  The
+// ns driver's time moves under the simulator's control, so it always reads
+// the clock.
+
+#if CLICK_USERLEVEL && !CLICK_NS && !HAVE_MULTITHREAD
+# define TIMESTAMP_CACHED_RECENT 1
+#endif
+
+
 // Define TIMESTAMP_MATH_FLAT64 if despite a seconds-and-subseconds
 // representation, 64-bit arithmetic should be used for timestamp addition,
 // subtraction, and comparisons.  This can be faster than operating on two
@@ -329,6 +339,19 @@ class Timestamp { public:
      * The current time is measured in seconds since January 1, 1970 GMT.
      * @sa assign_now() */
     static inline Timestamp now();
+    /** @brief Return a recent approximation of the current time.
+     *
+     * In single-threaded user-level drivers, this returns a timestamp that
+     * the RouterThread driver refreshes on every iteration of its loop, so
+     * it is cheaper than now() but may lag it by the time taken to run one
+     * round of tasks.  Elsewhere, and when time is warped, it equals now().
+     * Use it on per-packet paths that only need coarse timestamps.
+     * @sa now(), refresh_recent() */
+    static inline Timestamp recent();
+    /** @brief Update the timestamp returned by recent().
+     *
+     * Called by the driver; elements need not call it. */
+    static inline void refresh_recent();
     /** @brief Return the smallest nonzero timestamp, Timestamp(0, 1). */
     static inline Timestamp epsilon() {
 	return Timestamp(0, 1);
@@ -596,6 +619,9 @@ class Timestamp { public:
 
     inline void assign_now(bool raw);
 
+#if TIMESTAMP_CACHED_RECENT
+    static Timestamp _recent;
+#endif
 #if !CLICK_LINUXMODULE && !CLICK_BSDMODULE
     static warp_class_type _warp_class;
     static Timestamp _warp_flat_offset;
@@ -725,6 +751,24 @@ Timestamp::now()
     return t;
 }
 
+inline Timestamp
+Timestamp::recent()
+{
+#if TIMESTAMP_CACHED_RECENT
+    if (likely(!_warp_class && _recent))
+	return _recent;
+#endif
+    return now();
+}
+
+inline void
+Timestamp::refresh_recent()
+{
+#if TIMESTAMP_CACHED_RECENT
+    _recent.assign_now(true);
+#endif
+}
+
 /** @brief Set this timestamp's seconds component.
 
     The subseconds component is left unchanged. */
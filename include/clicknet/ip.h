@@ -182,6 +182,25 @@ click_update_in_cksum(uint16_t *csum, uint16_t old_hw, uint16_t new_hw)
     *csum = ~(sum + (sum >> 16));
 }
 
+/** @brief Incrementally adjust an Internet checksum for a 32-bit change.
+ * @param[in, out] csum points to checksum
+ * @param old_w old word
+ * @param new_w new word
+ *
+ * Like click_update_in_cksum(), but accounts for a change of the two
+ * halfwords of @a old_w to those of @a new_w.  This suits IP address
+ * rewrites, which also change the TCP and UDP pseudoheader checksums.  Pass
+ * both words in the same byte order as the data, such as the raw s_addr of
+ * an IP address. */
+static inline void
+click_update_in_cksum32(uint16_t *csum, uint32_t old_w, uint32_t new_w)
+{
+    uint32_t sum = (~*csum & 0xFFFF) + (~old_w & 0xFFFF) + (~old_w >> 16)
+	+ (new_w & 0xFFFF) + (new_w >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    *csum = ~(sum + (sum >> 16));
+}
+
 /** @brief Potentially fix a zero-valued Internet checksum.
  * @param[in, out] csum points to checksum
  * @param x data to checksum
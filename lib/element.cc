@@ -1198,6 +1198,10 @@ Element::processing_vector(int* in_v, int* out_v, ErrorHandler* errh) const
  * RoundRobinSched has 0 inputs, are idle rather than busy, and waste no
  * CPU time.</dd>
  *
+ * <dt><tt>P</tt></dt> <dd>This element's tasks must stay on their home
+ * thread.  Work stealing (see WorkStealingThreadSched) never moves them to
+ * another thread.</dd>
+ *
  * </dl>
  */
 const char*
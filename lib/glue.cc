@@ -647,7 +647,7 @@ click_gettimeofday(timeval *tvp)
 click_jiffies_t
 click_jiffies()
 {
-    return Timestamp::now().msecval();
+    return Timestamp::recent().msecval();
 }
 
 CLICK_ENDDECLS
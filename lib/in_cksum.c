@@ -17,37 +17,154 @@
 #endif
 
 #if !CLICK_LINUXMODULE
-uint16_t
-click_in_cksum(const unsigned char *addr, int len)
+# if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#  define CLICK_IN_CKSUM_X86 1
+#  include <immintrin.h>
+# endif
+
+/*
+ * The Internet checksum is a one's-complement sum, and one's-complement
+ * addition is associative, commutative, and independent of byte order.  So
+ * instead of adding 16-bit words one at a time, the functions below add
+ * 32-bit words into 64-bit accumulators, and fold the carries back in only at
+ * the end.  They return an unfolded sum.
+ */
+
+static inline uint64_t
+in_cksum_add_tail(const unsigned char *addr, int len, uint64_t sum)
 {
-    int nleft = len;
-    const uint16_t *w = (const uint16_t *)addr;
-    uint32_t sum = 0;
-    uint16_t answer = 0;
-
-    /*
-     * Our algorithm is simple, using a 32 bit accumulator (sum), we add
-     * sequential 16 bit words to it, and at the end, fold back all the
-     * carry bits from the top 16 bits into the lower 16 bits.
-     */
-    while (nleft > 1)  {
-	sum += *w++;
-	nleft -= 2;
+    uint16_t w;
+    while (len > 1) {
+	memcpy(&w, addr, 2);
+	sum += w;
+	addr += 2;
+	len -= 2;
     }
 
     /* mop up an odd byte, if necessary */
-    if (nleft == 1) {
-	*(unsigned char *)(&answer) = *(const unsigned char *)w ;
-	sum += answer;
+    if (len == 1) {
+	w = 0;
+	*(unsigned char *)(&w) = *addr;
+	sum += w;
+    }
+    return sum;
+}
+
+static inline uint64_t
+in_cksum_load64(const unsigned char *addr)
+{
+    uint64_t w;
+    memcpy(&w, addr, 8);
+    return (w & 0xFFFFFFFFU) + (w >> 32);
+}
+
+static inline uint64_t
+in_cksum_add_generic(const unsigned char *addr, int len)
+{
+    uint64_t sum0 = 0, sum1 = 0;
+    uint32_t w;
+    while (len >= 32) {
+	sum0 += in_cksum_load64(addr) + in_cksum_load64(addr + 8);
+	sum1 += in_cksum_load64(addr + 16) + in_cksum_load64(addr + 24);
+	addr += 32;
+	len -= 32;
+    }
+    while (len >= 8) {
+	sum0 += in_cksum_load64(addr);
+	addr += 8;
+	len -= 8;
+    }
+    if (len >= 4) {
+	memcpy(&w, addr, 4);
+	sum1 += w;
+	addr += 4;
+	len -= 4;
+    }
+    return in_cksum_add_tail(addr, len, sum0 + sum1);
+}
+
+#if CLICK_IN_CKSUM_X86
+/* Zero-extend each 32-bit lane to 64 bits and add. */
+
+__attribute__((target("sse2"))) static uint64_t
+in_cksum_add_sse2(const unsigned char *addr, int len)
+{
+    __m128i zero = _mm_setzero_si128(), acc0 = zero, acc1 = zero;
+    uint64_t lanes[2];
+    while (len >= 32) {
+	__m128i v0 = _mm_loadu_si128((const __m128i *) addr);
+	__m128i v1 = _mm_loadu_si128((const __m128i *) (addr + 16));
+	acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v0, zero));
+	acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v0, zero));
+	acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v1, zero));
+	acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v1, zero));
+	addr += 32;
+	len -= 32;
     }
+    _mm_storeu_si128((__m128i *) lanes, _mm_add_epi64(acc0, acc1));
+    return in_cksum_add_generic(addr, len) + lanes[0] + lanes[1];
+}
+
+__attribute__((target("avx2"))) static uint64_t
+in_cksum_add_avx2(const unsigned char *addr, int len)
+{
+    __m256i zero = _mm256_setzero_si256(), acc0 = zero, acc1 = zero;
+    uint64_t lanes[4];
+    while (len >= 64) {
+	__m256i v0 = _mm256_loadu_si256((const __m256i *) addr);
+	__m256i v1 = _mm256_loadu_si256((const __m256i *) (addr + 32));
+	acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v0, zero));
+	acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v0, zero));
+	acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v1, zero));
+	acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v1, zero));
+	addr += 64;
+	len -= 64;
+    }
+    _mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi64(acc0, acc1));
+    return in_cksum_add_generic(addr, len) + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+static uint64_t in_cksum_add_dispatch(const unsigned char *addr, int len);
+static uint64_t (*in_cksum_add)(const unsigned char *, int) = in_cksum_add_dispatch;
+
+/* Pick an implementation on first use.  Racing threads store the same
+   pointer, so no locking is needed. */
+static uint64_t
+in_cksum_add_dispatch(const unsigned char *addr, int len)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+	in_cksum_add = in_cksum_add_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+	in_cksum_add = in_cksum_add_sse2;
+    else
+	in_cksum_add = in_cksum_add_generic;
+    return in_cksum_add(addr, len);
+}
+#endif
+
+uint16_t
+click_in_cksum(const unsigned char *addr, int len)
+{
+    uint64_t sum;
+#if CLICK_IN_CKSUM_X86
+    /* headers are too short to be worth the vector setup */
+    if (len < 64)
+	sum = in_cksum_add_generic(addr, len);
+    else
+	sum = in_cksum_add(addr, len);
+#else
+    sum = in_cksum_add_generic(addr, len);
+#endif
 
-    /* add back carry outs from top 16 bits to low 16 bits */
-    sum = (sum & 0xffff) + (sum >> 16);
+    /* add back carry outs from top bits to low 16 bits */
+    sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
     sum += (sum >> 16);
     /* guaranteed now that the lower 16 bits of sum are correct */
 
-    answer = ~sum;              /* truncate to 16 bits */
-    return answer;
+    return ~sum;		/* truncate to 16 bits */
 }
 
 uint16_t
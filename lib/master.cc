@@ -34,6 +34,12 @@
 #  define EV_SET_UDATA_CAST	/* nothing */
 # endif
 #endif
+#if CLICK_USERLEVEL && HAVE_USE_EPOLL
+# include <sys/epoll.h>
+#endif
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+# include <sched.h>
+#endif
 CLICK_DECLS
 
 #if CLICK_USERLEVEL && (!HAVE_POLL_H || HAVE_USE_SELECT)
@@ -54,6 +60,9 @@ Master::Master(int nthreads)
 
     for (int tid = -2; tid < nthreads; tid++)
 	_threads.push_back(new RouterThread(this, tid));
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    _work_stealing = false;
+#endif
 
     // timer information
 #if CLICK_NS
@@ -75,6 +84,9 @@ Master::Master(int nthreads)
     _kqueue = kqueue();
     _selected_callno = 0;
 # endif
+# if HAVE_USE_EPOLL
+    _epoll = epoll_create(64);
+# endif
 # if !HAVE_POLL_H || HAVE_USE_SELECT
     FD_ZERO(&_read_select_fd_set);
     FD_ZERO(&_write_select_fd_set);
@@ -139,6 +151,10 @@ Master::~Master()
     if (_kqueue >= 0)
 	close(_kqueue);
 #endif
+#if CLICK_USERLEVEL && HAVE_USE_EPOLL
+    if (_epoll >= 0)
+	close(_epoll);
+#endif
 }
 
 void
@@ -255,8 +271,8 @@ Master::kill_router(Router *router)
 	lock_timers();
 	assert(!_timer_runchunk.size());
 	Timer* t;
-	for (Timer** tp = _timer_heap.end(); tp > _timer_heap.begin(); )
-	    if ((t = *--tp, t->router() == router)) {
+	for (heap_element *tp = _timer_heap.end(); tp > _timer_heap.begin(); )
+	    if ((t = (--tp)->t, t->router() == router)) {
 		remove_heap(_timer_heap.begin(), _timer_heap.end(), tp, timer_less(), timer_place(_timer_heap.begin()));
 		_timer_heap.pop_back();
 		t->_owner = 0;
@@ -373,6 +389,48 @@ Master::check_driver()
 }
 
 
+// THREADS
+
+/** @brief Wait until no other thread can hold a stale pointer.
+ *
+ * Returns once every other running RouterThread has started a new pass
+ * through its driver loop, where no element code runs.  A structure that
+ * was unlinked before the call is then unreachable, and can be freed or
+ * reused even though readers never lock it.  Sleeping threads are woken so
+ * that they pass the quiescent point promptly.  Must not be called with a
+ * lock that another thread might wait for.
+ *
+ * Returns true if it is then safe to free unlinked structures.  At user
+ * level without threads this holds at once.  The kernel drivers also run
+ * element code outside RouterThreads, for instance when a device hands
+ * FromDevice a packet, and offer no such point; there the call returns
+ * false without waiting, and the caller must keep what it unlinked for as
+ * long as the router runs or refuse the change. */
+bool
+Master::synchronize_threads()
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    Vector<uint32_t> epochs;
+    for (int tid = 0; tid < nthreads(); tid++)
+	epochs.push_back(thread(tid)->quiescent_epoch());
+    for (int tid = 0; tid < nthreads(); tid++) {
+	RouterThread *t = thread(tid);
+	while (t->quiescent_epoch() == epochs[tid]
+	       && t->_running_processor != click_invalid_processor()
+	       && !t->current_thread_is_running()) {
+	    t->wake();
+	    sched_yield();
+	}
+    }
+#endif
+#if CLICK_USERLEVEL || CLICK_NS
+    return true;
+#else
+    return false;
+#endif
+}
+
+
 // PENDING TASKS
 
 void
@@ -449,11 +507,12 @@ Master::run_timers()
 	_timer_task = current;
 #endif
 	_timer_check = Timestamp::now();
-	Timer *t = _timer_heap.at_u(0);
+	Timestamp::refresh_recent();
+	heap_element *th = _timer_heap.begin();
 
-	if (t->_expiry <= _timer_check) {
+	if (th->expiry <= _timer_check) {
 	    // potentially adjust timer stride
-	    Timestamp adj_expiry = t->_expiry + Timer::adjustment();
+	    Timestamp adj_expiry = th->expiry + Timer::adjustment();
 	    if (adj_expiry <= _timer_check) {
 		_timer_count = 0;
 		if (_timer_stride > 1)
@@ -467,15 +526,25 @@ Master::run_timers()
 	    // actually run timers
 	    int max_timers = 64;
 	    do {
+		Timer *t = th->t;
+		if (t->_expiry > _timer_check) {
+		    // lazily rescheduled to a later expiry; sift it down now
+		    th->expiry = t->_expiry;
+		    change_heap(_timer_heap.begin(), _timer_heap.end(), th, timer_less(), timer_place(_timer_heap.begin()));
+		    set_timer_expiry();
+		    continue;
+		}
+
 		pop_heap(_timer_heap.begin(), _timer_heap.end(), timer_less(), timer_place(_timer_heap.begin()));
 		_timer_heap.pop_back();
 		set_timer_expiry();
 		t->_schedpos1 = 0;
 
 		run_one_timer(t);
+		--max_timers;
 	    } while (_timer_heap.size() > 0 && !_stopper
-		     && (t = _timer_heap.at_u(0), t->_expiry <= _timer_check)
-		     && --max_timers >= 0);
+		     && (th = _timer_heap.begin(), th->expiry <= _timer_check)
+		     && max_timers >= 0);
 
 	    // If we ran out of timers to run, then perhaps there's an
 	    // infinite timer loop or one timer is very far behind system
@@ -485,13 +554,19 @@ Master::run_timers()
 	    if (max_timers < 0 && !_stopper) {
 		_timer_runchunk.reserve(32);
 		do {
+		    Timer *t = th->t;
+		    if (t->_expiry > _timer_check) {
+			th->expiry = t->_expiry;
+			change_heap(_timer_heap.begin(), _timer_heap.end(), th, timer_less(), timer_place(_timer_heap.begin()));
+			continue;
+		    }
 		    pop_heap(_timer_heap.begin(), _timer_heap.end(), timer_less(), timer_place(_timer_heap.begin()));
 		    _timer_heap.pop_back();
 		    t->_schedpos1 = -_timer_runchunk.size() - 1;
 
 		    _timer_runchunk.push_back(t);
 		} while (_timer_heap.size() > 0
-			 && (t = _timer_heap.at_u(0), t->_expiry <= _timer_check));
+			 && (th = _timer_heap.begin(), th->expiry <= _timer_check));
 		set_timer_expiry();
 
 		Vector<Timer*>::iterator i = _timer_runchunk.begin();
@@ -525,6 +600,23 @@ Master::run_timers()
 
 namespace {
 enum { SELECT_READ = Element::SELECT_READ, SELECT_WRITE = Element::SELECT_WRITE };
+
+#if HAVE_USE_EPOLL
+inline int
+epoll_ctl_events(int epfd, int fd, int pollevents, bool add)
+{
+    struct epoll_event ev;
+    ev.events = (pollevents & POLLIN ? (uint32_t) EPOLLIN : 0)
+	| (pollevents & POLLOUT ? (uint32_t) EPOLLOUT : 0);
+    ev.data.fd = fd;
+    int r = epoll_ctl(epfd, (add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD), fd, &ev);
+    // An fd closed without remove_select() silently leaves the epoll set, so
+    // its number may come back registered or unregistered; try the other op.
+    if (r < 0 && (errno == (add ? EEXIST : ENOENT)))
+	r = epoll_ctl(epfd, (add ? EPOLL_CTL_MOD : EPOLL_CTL_ADD), fd, &ev);
+    return r;
+}
+#endif
 }
 
 int
@@ -563,6 +655,9 @@ Master::add_select(int fd, Element *element, int mask)
     // add the pollfd
     if (fd >= _fd_to_pollfd.size())
 	_fd_to_pollfd.resize(fd + 1, -1);
+#if HAVE_USE_EPOLL
+    bool new_pollfd = (_fd_to_pollfd[fd] < 0);
+#endif
     if (_fd_to_pollfd[fd] < 0) {
 	_fd_to_pollfd[fd] = _pollfds.size();
 	_pollfds.push_back(pollfd());
@@ -608,6 +703,18 @@ Master::add_select(int fd, Element *element, int mask)
     }
 #endif
 
+#if HAVE_USE_EPOLL
+    if (_epoll >= 0) {
+	// The epoll interest set is persistent, so only changes are passed to
+	// the kernel.  Regular files and some devices cannot be added to an
+	// epoll set; if that happens, fall back to poll().
+	if (epoll_ctl_events(_epoll, fd, _pollfds[pi].events, new_pollfd) < 0) {
+	    close(_epoll);
+	    _epoll = -1;
+	}
+    }
+#endif
+
 #if !HAVE_POLL_H || HAVE_USE_SELECT
     // Add 'mask' to the fd_sets
     if (fd < FD_SETSIZE) {
@@ -663,6 +770,20 @@ Master::remove_pollfd(int pi, int event)
 	    click_chatter("Master::remove_pollfd(fd %d): kevent: %s", _pollfds[pi].fd, strerror(errno));
     }
 #endif
+#if HAVE_USE_EPOLL
+    // remove event from epoll set
+    if (_epoll >= 0) {
+	int r;
+	if (_pollfds[pi].events)
+	    r = epoll_ctl_events(_epoll, fd, _pollfds[pi].events, false);
+	else {
+	    struct epoll_event ev;	// nonnull for pre-2.6.9 kernels
+	    r = epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, &ev);
+	}
+	if (r < 0 && errno != EBADF && errno != ENOENT)
+	    click_chatter("Master::remove_pollfd(fd %d): epoll_ctl: %s", fd, strerror(errno));
+    }
+#endif
 #if !HAVE_POLL_H || HAVE_USE_SELECT
     // remove event from select list
     if (fd < FD_SETSIZE) {
@@ -764,6 +885,7 @@ Master::run_selects_kqueue(bool more_tasks)
     struct kevent kev[64];
     int n = kevent(_kqueue, 0, 0, &kev[0], 64, wait_ptr);
     int was_errno = errno;
+    Timestamp::refresh_recent();
     run_signals();
 
 # if HAVE_MULTITHREAD
@@ -790,6 +912,76 @@ Master::run_selects_kqueue(bool more_tasks)
 }
 #endif /* HAVE_USE_KQUEUE */
 
+#if HAVE_USE_EPOLL
+void
+Master::run_selects_epoll(bool more_tasks)
+{
+    // Decide how long to wait.
+# if CLICK_NS
+    // Never block if we're running in the simulator.
+    int timeout = 0;
+    (void) more_tasks;
+# else
+    // Never wait if anything is scheduled; otherwise, if no timers, block
+    // indefinitely.
+    int timeout = 0;
+    if (!more_tasks) {
+	Timestamp t = next_timer_expiry_adjusted();
+	if (t.sec() == 0)
+	    timeout = -1;
+	else if (unlikely(Timestamp::warp_jumping()))
+	    Timestamp::warp_jump(t);
+	else if ((t -= Timestamp::now(), t.sec() >= 0)) {
+	    t = t.warp_real_delay();
+	    if (t.sec() >= INT_MAX / 1000)
+		timeout = INT_MAX - 1000;
+	    else
+		timeout = t.msecval();
+	}
+    }
+# endif /* CLICK_NS */
+
+# if HAVE_MULTITHREAD
+    // The kernel owns the interest set, so unlike poll(), no private copy is
+    // needed while other threads run.
+    _selecting_processor = click_current_processor();
+    _select_lock.release();
+# endif
+
+    // Retrieve ready events in one batch; the cost depends on the number
+    // of ready fds, not the number of registered fds.
+    struct epoll_event ev[64];
+    int n = epoll_wait(_epoll, &ev[0], 64, timeout);
+    int was_errno = errno;
+    Timestamp::refresh_recent();
+    run_signals();
+
+# if HAVE_MULTITHREAD
+    _select_lock.acquire();
+    _selecting_processor = click_invalid_processor();
+# endif
+
+    if (n < 0 && was_errno != EINTR)
+	perror("epoll_wait");
+    else if (n > 0)
+	for (struct epoll_event *p = &ev[0]; p < &ev[n]; p++) {
+	    // Beware: calling 'selected()' might call remove_select(), so
+	    // look up the selectors afresh for every event.
+	    int fd = p->data.fd;
+	    if (fd >= _element_selectors.size())
+		continue;
+	    Element *read_elt = 0, *write_elt;
+	    if ((p->events & ~EPOLLOUT)
+		&& (read_elt = _element_selectors[fd].read))
+		read_elt->selected(fd);
+	    if ((p->events & ~EPOLLIN) && fd < _element_selectors.size()
+		&& (write_elt = _element_selectors[fd].write)
+		&& read_elt != write_elt)
+		write_elt->selected(fd);
+	}
+}
+#endif /* HAVE_USE_EPOLL */
+
 #if HAVE_POLL_H && !HAVE_USE_SELECT
 void
 Master::run_selects_poll(bool more_tasks)
@@ -831,6 +1023,7 @@ Master::run_selects_poll(bool more_tasks)
 
     int n = poll(my_pollfds.begin(), my_pollfds.size(), timeout);
     int was_errno = errno;
+    Timestamp::refresh_recent();
     run_signals();
 
 # if HAVE_MULTITHREAD
@@ -903,6 +1096,7 @@ Master::run_selects_select(bool more_tasks)
 
     int n = select(_max_select_fd + 1, &read_mask, &write_mask, (fd_set*) 0, wait_ptr);
     int was_errno = errno;
+    Timestamp::refresh_recent();
     run_signals();
 
 # if HAVE_MULTITHREAD
@@ -989,6 +1183,12 @@ Master::run_selects(bool more_tasks)
 	goto unlock_select_exit;
     }
 #endif
+#if HAVE_USE_EPOLL
+    if (_epoll >= 0) {
+	run_selects_epoll(more_tasks);
+	goto unlock_select_exit;
+    }
+#endif
 #if HAVE_POLL_H && !HAVE_USE_SELECT
     run_selects_poll(more_tasks);
 #else
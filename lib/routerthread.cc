@@ -24,6 +24,7 @@
 #include <click/router.hh>
 #include <click/routerthread.hh>
 #include <click/master.hh>
+#include <click/standard/threadsched.hh>
 #if CLICK_LINUXMODULE
 # include <click/cxxprotect.h>
 CLICK_CXX_PROTECT
@@ -118,6 +119,11 @@ RouterThread::RouterThread(Master *m, int id)
 #if CLICK_LINUXMODULE
     greedy_schedule_jiffies = jiffies;
 #endif
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    _idle = false;
+    _steals = _steal_attempts = _idle_count = 0;
+    _quiescent_epoch = 0;
+#endif
 
 #if CLICK_DEBUG_SCHEDULING
     _thread_state = S_BLOCKED;
@@ -328,6 +334,67 @@ RouterThread::task_reheapify_from(int pos, Task* t)
 }
 #endif
 
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+/******************************/
+/* Work stealing              */
+/******************************/
+
+static inline bool
+task_stealable(Task *t)
+{
+    // Tasks whose elements are flagged 'P' (pinned), or that were assigned
+    // a thread by a ThreadSched such as StaticThreadSched, stay put.
+    Element *e = t->element();
+    return e->flag_value('P') <= 0
+	&& e->router()->initial_home_thread_id(e, t, t->scheduled()) == ThreadSched::THREAD_UNKNOWN;
+}
+
+bool
+RouterThread::steal_task()
+{
+    // Called by an idle thread, with its own tasks unlocked.  Take one task
+    // from the first other thread with at least two scheduled tasks.  The
+    // victim keeps the task it will run next, and we take the task it would
+    // run last, so recently run (cache-warm) tasks tend to stay put.
+    ++_steal_attempts;
+    int n = _master->nthreads();
+    for (int i = 1; i < n; ++i) {
+	RouterThread *victim = _master->thread((_id + i) % n);
+	if (!victim->active())
+	    continue;
+	victim->lock_tasks();
+	Task *steal = 0;
+	Task *end = victim->task_end();
+	Task *t = victim->task_begin();
+	if (t != end)
+	    for (t = victim->task_next(t); t != end; t = victim->task_next(t))
+		if (task_stealable(t))
+		    steal = t;
+	if (steal) {
+	    steal->move_thread(_id);
+	    ++_steals;
+	}
+	victim->unlock_tasks();
+	if (steal)
+	    return true;
+    }
+    return false;
+}
+
+void
+RouterThread::wake_idle_thread()
+{
+    int n = _master->nthreads();
+    for (int i = 1; i < n; ++i) {
+	RouterThread *t = _master->thread((_id + i) % n);
+	if (t->_idle) {
+	    t->wake();
+	    return;
+	}
+    }
+}
+#endif
+
 /* Run at most 'ntasks' tasks. */
 inline void
 RouterThread::run_tasks(int ntasks)
@@ -382,6 +449,9 @@ RouterThread::run_tasks(int ntasks)
 #endif
 
 	t->fire();
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+	_quiescent_epoch++;
+#endif
 
 #if HAVE_TASK_HEAP
 	if (_task_heap_hole) {
@@ -413,11 +483,29 @@ RouterThread::run_os()
 #if CLICK_LINUXMODULE
     // set state to interruptible early to avoid race conditions
     set_current_state(TASK_INTERRUPTIBLE);
+#endif
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    // check for a backlog while our task list is still locked
+    Task *first = task_begin();
+    bool backlog = first != task_end() && task_next(first) != task_end();
 #endif
     driver_unlock_tasks();
 
 #if CLICK_USERLEVEL
+# if HAVE_MULTITHREAD
+    if (_master->work_stealing()) {
+	if (!active()) {
+	    ++_idle_count;
+	    if (!steal_task())
+		_idle = true;
+	} else if (backlog)
+	    wake_idle_thread();
+    }
+# endif
     _master->run_selects(active());
+# if HAVE_MULTITHREAD
+    _idle = false;
+# endif
 #elif CLICK_LINUXMODULE		/* Linux kernel module */
     if (_greedy) {
 	if (time_after(jiffies, greedy_schedule_jiffies + 5 * CLICK_HZ)) {
@@ -496,6 +584,14 @@ RouterThread::driver()
 #if CLICK_DEBUG_SCHEDULING
     _driver_epoch++;
 #endif
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    // No element code is running here, so the thread holds no references
+    // into shared structures.  (The same holds between tasks; see
+    // run_tasks().)
+    _quiescent_epoch++;
+#endif
+
+    Timestamp::refresh_recent();
 
     if (*stopper == 0) {
 	// run occasional tasks: timers, select, etc.
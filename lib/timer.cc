@@ -232,6 +232,14 @@ Timer::schedule_at(const Timestamp& when)
     // set expiration timer
     _expiry = when;
 
+    // a scheduled timer that moves later stays put; run_timers() will
+    // re-sift it when its stale heap entry reaches the top
+    if (_schedpos1 > 0
+	&& master->_timer_heap.at_u(_schedpos1 - 1).expiry <= when) {
+	master->unlock_timers();
+	return;
+    }
+
     // manipulate list; this is essentially a "decrease-key" operation
     // any reschedule removes a timer from the runchunk (XXX -- even backwards
     // reschedulings)
@@ -240,11 +248,12 @@ Timer::schedule_at(const Timestamp& when)
 	if (_schedpos1 < 0)
 	    master->_timer_runchunk[-_schedpos1 - 1] = 0;
 	_schedpos1 = master->_timer_heap.size() + 1;
-	master->_timer_heap.push_back(this);
+	master->_timer_heap.push_back(Master::heap_element(this));
     }
     master->check_timer_expiry(this);
-    change_heap(master->_timer_heap.begin(), master->_timer_heap.end(),
-		master->_timer_heap.begin() + _schedpos1 - 1,
+    Master::heap_element *he = master->_timer_heap.begin() + _schedpos1 - 1;
+    he->expiry = _expiry;
+    change_heap(master->_timer_heap.begin(), master->_timer_heap.end(), he,
 		Master::timer_less(), Master::timer_place(master->_timer_heap.begin()));
     if (old_schedpos1 == 1 || _schedpos1 == 1)
 	master->set_timer_expiry();
@@ -260,7 +269,7 @@ Timer::schedule_at(const Timestamp& when)
 void
 Timer::schedule_after(const Timestamp &delta)
 {
-    schedule_at(Timestamp::now() + delta);
+    schedule_at(Timestamp::recent() + delta);
 }
 
 void
@@ -55,6 +55,10 @@ CLICK_DECLS
  -1, usec() == +900000.
  */
 
+#if TIMESTAMP_CACHED_RECENT
+Timestamp Timestamp::_recent;
+#endif
+
 #if !CLICK_LINUXMODULE && !CLICK_BSDMODULE
 Timestamp::warp_class_type Timestamp::_warp_class = Timestamp::warp_none;
 Timestamp Timestamp::_warp_flat_offset = Timestamp(0, 0);